@@ -0,0 +1,29 @@
+# Find the c-ares asynchronous DNS library
+#
+#  CARES_INCLUDE_DIRS - where to find ares.h, etc.
+#  CARES_LIBRARIES    - List of libraries when using c-ares.
+#  CARES_FOUND        - True if c-ares found.
+
+if (CARES_INCLUDE_DIRS)
+    set(CARES_FIND_QUIETLY ON)
+endif()
+
+find_path(CARES_INCLUDE_DIR ares.h)
+
+find_library(CARES_LIBRARY NAMES cares)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(CARES DEFAULT_MSG
+    CARES_LIBRARY
+    CARES_INCLUDE_DIR
+)
+
+if(CARES_FOUND)
+    set(CARES_LIBRARIES ${CARES_LIBRARY})
+    set(CARES_INCLUDE_DIRS ${CARES_INCLUDE_DIR})
+else()
+    set(CARES_LIBRARIES)
+    set(CARES_INCLUDE_DIRS)
+endif()
+
+mark_as_advanced( CARES_LIBRARIES CARES_INCLUDE_DIRS )
@@ -0,0 +1,49 @@
+#ifndef _bc519bf3caa844ecadaf3cf807b5f93e
+#define _bc519bf3caa844ecadaf3cf807b5f93e
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace intent {
+namespace core {
+namespace data {
+
+/**
+ * Byte offsets of a run of whole records: every record that begins in
+ * [begin, limit) belongs to the range. A range may be empty.
+ */
+struct xsv_chunk_range {
+    size_t begin;
+    size_t limit;
+};
+
+/**
+ * Cut xsv text into ranges of about chunk_size bytes whose boundaries fall
+ * exactly on record starts, honoring quoted line breaks. Chunks are probed in
+ * parallel (see probe_xsv_chunk()) and resolved with a sequential pass over
+ * quote parities.
+ */
+std::vector<xsv_chunk_range> split_xsv_chunks(char const * begin,
+        char const * end, char delim, size_t chunk_size, unsigned thread_count);
+
+/**
+ * Call fn(i) for every i in [0, count), on up to thread_count threads.
+ */
+void for_each_xsv_chunk(size_t count, unsigned thread_count,
+        std::function<void(size_t)> const & fn);
+
+/**
+ * Pick a chunk size that gives each thread several chunks, within sane
+ * bounds.
+ */
+size_t choose_xsv_chunk_size(size_t input_size, unsigned thread_count);
+
+/**
+ * Resolve 0 to one thread per core.
+ */
+unsigned choose_xsv_thread_count(unsigned requested);
+
+}}} // end namespace
+
+#endif // sentry
@@ -0,0 +1,300 @@
+#ifndef _8603bf0f887c4c7cabecb4add0a9e29a
+#define _8603bf0f887c4c7cabecb4add0a9e29a
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace intent {
+namespace core {
+namespace data {
+
+/**
+ * Helpers that find the structure of xsv text (delimiters, quotes, line
+ * breaks) 64 bytes at a time. Each byte of a block is classified into a bit
+ * of a uint64_t, using SIMD compares where the compiler targets SSE2 or AVX2,
+ * and plain loops elsewhere. Quoted regions are then found with a prefix-xor
+ * over the quote bits, so delimiters and line breaks inside quotes are masked
+ * away without ever looking at a byte individually.
+ *
+ * Quoting follows RFC 4180, loosely: any '"' toggles quoting, so '""' inside a
+ * quoted field is a literal quote. A record ends at "\n", "\r\n", or "\r".
+ */
+
+typedef uint32_t idx_t;
+
+static constexpr idx_t MAX_RECORD_SIZE = 1024 * 1024;
+
+/** Offset of a field from the start of its record, and its length. */
+typedef std::pair<idx_t, idx_t> field_boundaries;
+typedef std::vector<field_boundaries> fields_t;
+
+static_assert(std::numeric_limits<decltype(field_boundaries::first)>::max()
+        >= MAX_RECORD_SIZE,
+        "indexes must be capable of representing any offset <= MAX_RECORD_SIZE");
+
+static constexpr unsigned XSV_BLOCK_SIZE = 64;
+
+struct xsv_block_masks {
+    uint64_t quotes;
+    uint64_t delims;
+    uint64_t eols;
+};
+
+#if defined(__AVX2__) || defined(__SSE2__)
+inline uint64_t xsv_eq_mask(char const * p, char c) {
+#if defined(__AVX2__)
+    __m256i const needle = _mm256_set1_epi8(c);
+    uint64_t lo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+            _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p)), needle)));
+    uint64_t hi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+            _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p + 32)), needle)));
+    return lo | (hi << 32);
+#else
+    __m128i const needle = _mm_set1_epi8(c);
+    uint64_t mask = 0;
+    for (unsigned i = 0; i < 4; ++i) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p + 16 * i));
+        mask |= static_cast<uint64_t>(static_cast<uint16_t>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)))) << (16 * i);
+    }
+    return mask;
+#endif
+}
+#endif
+
+/**
+ * Classify a full block of XSV_BLOCK_SIZE bytes.
+ */
+inline void classify_xsv_block(char const * p, char delim, xsv_block_masks & m) {
+#if defined(__AVX2__) || defined(__SSE2__)
+    m.quotes = xsv_eq_mask(p, '"');
+    m.delims = xsv_eq_mask(p, delim);
+    m.eols = xsv_eq_mask(p, '\n') | xsv_eq_mask(p, '\r');
+#else
+    m.quotes = m.delims = m.eols = 0;
+    for (unsigned i = 0; i < XSV_BLOCK_SIZE; ++i) {
+        uint64_t bit = uint64_t(1) << i;
+        char c = p[i];
+        if (c == '"') {
+            m.quotes |= bit;
+        } else if (c == delim) {
+            m.delims |= bit;
+        } else if (c == '\n' || c == '\r') {
+            m.eols |= bit;
+        }
+    }
+#endif
+}
+
+/**
+ * Classify a block that may be shorter than XSV_BLOCK_SIZE. The tail is
+ * copied into a zero-padded block so we never read beyond len; nulls never
+ * match anything, because delim may not be null.
+ */
+inline void classify_xsv_block(char const * p, size_t len, char delim, xsv_block_masks & m) {
+    if (len >= XSV_BLOCK_SIZE) {
+        classify_xsv_block(p, delim, m);
+    } else {
+        char padded[XSV_BLOCK_SIZE] = {0};
+        memcpy(padded, p, len);
+        classify_xsv_block(padded, delim, m);
+    }
+}
+
+/**
+ * Return a mask where bit i is the xor of bits 0..i of x. Applied to quote
+ * bits, this marks every byte from an opening quote up to (but not including)
+ * the matching closing quote.
+ */
+inline uint64_t prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+inline unsigned lowest_bit_index(uint64_t x) {
+    return static_cast<unsigned>(__builtin_ctzll(x));
+}
+
+/**
+ * Find the fields of the record that begins at begin.
+ *
+ * @param fields Receives field boundaries, relative to begin. Not cleared
+ *     first.
+ * @param next Receives a pointer to the first char of the following record
+ *     (just past the line break), or end if the record is unterminated.
+ * @param has_quotes Set to true if any quote char appears in the record.
+ * @return true if the record was terminated by a line break; false if input
+ *     ran out first. In the latter case, fields describes everything up to
+ *     end, as if a line break followed.
+ * @throw std::runtime_error if the record is longer than MAX_RECORD_SIZE.
+ */
+inline bool scan_xsv_record(char const * begin, char const * end, char delim,
+        fields_t & fields, char const *& next, bool & has_quotes) {
+    size_t const total = end - begin;
+    size_t offset = 0;
+    idx_t field_start = 0;
+    uint64_t in_quote_carry = 0;
+    has_quotes = false;
+    xsv_block_masks m;
+
+    while (offset < total) {
+        if (offset > MAX_RECORD_SIZE) {
+            throw std::runtime_error("xsv record exceeds maximum record size");
+        }
+        size_t len = total - offset;
+        classify_xsv_block(begin + offset, len, delim, m);
+        uint64_t structural = m.delims | m.eols;
+        if (m.quotes) {
+            has_quotes = true;
+            uint64_t inside = prefix_xor(m.quotes) ^ in_quote_carry;
+            // Smear the top bit: all ones if the block ends inside quotes.
+            in_quote_carry = static_cast<uint64_t>(static_cast<int64_t>(inside) >> 63);
+            structural &= ~inside;
+        } else {
+            structural &= ~in_quote_carry;
+        }
+        while (structural) {
+            size_t pos = offset + lowest_bit_index(structural);
+            structural &= structural - 1;
+            if (pos > MAX_RECORD_SIZE) {
+                throw std::runtime_error("xsv record exceeds maximum record size");
+            }
+            fields.push_back(field_boundaries(field_start, static_cast<idx_t>(pos) - field_start));
+            char c = begin[pos];
+            if (c == delim) {
+                field_start = static_cast<idx_t>(pos + 1);
+                continue;
+            }
+            next = begin + pos + 1;
+            if (c == '\r' && next < end && *next == '\n') {
+                ++next;
+            }
+            return true;
+        }
+        offset += XSV_BLOCK_SIZE;
+    }
+    if (total > MAX_RECORD_SIZE) {
+        throw std::runtime_error("xsv record exceeds maximum record size");
+    }
+    fields.push_back(field_boundaries(field_start, static_cast<idx_t>(total) - field_start));
+    next = end;
+    return false;
+}
+
+/**
+ * What a chunk of xsv text looks like before we know whether it begins
+ * inside quotes. Because every quote toggles quoting, the state at any
+ * offset is just the parity of the quotes before it; a chunk can therefore
+ * be probed for both possibilities at once, in parallel with its neighbors,
+ * and the right answer picked afterward with a cheap prefix over parities.
+ */
+struct xsv_chunk_probe {
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    /** True if the chunk holds an odd number of quotes. */
+    bool odd_quotes;
+
+    /**
+     * Offset (from the start of the chunk) of the first record that begins
+     * after an unquoted line break, assuming the chunk starts outside quotes
+     * [0] or inside them [1]. npos if there is no such line break. Because a
+     * "\r\n" is one break, the offset may be 1 beyond the chunk.
+     */
+    size_t first_record[2];
+};
+
+inline size_t xsv_record_after_break(char const * begin, char const * end,
+        size_t pos) {
+    return (begin[pos] == '\r' && begin + pos + 1 < end && begin[pos + 1] == '\n')
+            ? pos + 2 : pos + 1;
+}
+
+/**
+ * Probe [begin, begin + len). end bounds the whole input, so a "\r\n" split
+ * across chunks is recognized.
+ */
+inline xsv_chunk_probe probe_xsv_chunk(char const * begin, size_t len,
+        char const * end, char delim) {
+    xsv_chunk_probe probe;
+    probe.first_record[0] = probe.first_record[1] = xsv_chunk_probe::npos;
+    uint64_t carry = 0;
+    unsigned quotes = 0;
+    xsv_block_masks m;
+    for (size_t offset = 0; offset < len; offset += XSV_BLOCK_SIZE) {
+        classify_xsv_block(begin + offset, len - offset, delim, m);
+        quotes += __builtin_popcountll(m.quotes);
+        uint64_t inside = prefix_xor(m.quotes) ^ carry;
+        carry = static_cast<uint64_t>(static_cast<int64_t>(inside) >> 63);
+        // Under the other assumption, every bit of inside is flipped.
+        uint64_t breaks[2] = { m.eols & ~inside, m.eols & inside };
+        for (unsigned h = 0; h < 2; ++h) {
+            if (breaks[h] && probe.first_record[h] == xsv_chunk_probe::npos) {
+                probe.first_record[h] = xsv_record_after_break(begin, end,
+                        offset + lowest_bit_index(breaks[h]));
+            }
+        }
+    }
+    probe.odd_quotes = quotes & 1;
+    return probe;
+}
+
+/**
+ * Strip the quotes from a field and collapse each '""' inside quotes to '"'.
+ * The output is never longer than the input, so src and dest may be the same.
+ *
+ * @return Length of the unescaped field.
+ */
+inline idx_t unescape_xsv_field(char const * src, idx_t len, char * dest) {
+    char * out = dest;
+    bool in_quote = false;
+    for (idx_t i = 0; i < len; ++i) {
+        char c = src[i];
+        if (c == '"') {
+            if (in_quote && i + 1 < len && src[i + 1] == '"') {
+                *out++ = '"';
+                ++i;
+            } else {
+                in_quote = !in_quote;
+            }
+        } else {
+            *out++ = c;
+        }
+    }
+    return static_cast<idx_t>(out - dest);
+}
+
+/**
+ * Null-terminate and unescape every field of a record in place. Afterward,
+ * each field's offset still marks its first char and its length excludes
+ * the null.
+ *
+ * @pre There is a writable byte just past the last field.
+ */
+inline void terminate_xsv_fields(char * record, fields_t & fields, bool has_quotes) {
+    for (auto & fb : fields) {
+        char * field = record + fb.first;
+        if (has_quotes && memchr(field, '"', fb.second)) {
+            fb.second = unescape_xsv_field(field, fb.second, field);
+        }
+        field[fb.second] = 0;
+    }
+}
+
+}}} // end namespace
+
+#endif // sentry
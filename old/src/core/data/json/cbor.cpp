@@ -0,0 +1,722 @@
+#include "cbor.h"
+#include <cmath>
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+namespace json {
+
+// Major types, from RFC 7049 section 2.1.
+enum {
+    mt_unsigned = 0,
+    mt_negative = 1,
+    mt_bytes = 2,
+    mt_text = 3,
+    mt_array = 4,
+    mt_map = 5,
+    mt_tag = 6,
+    mt_simple = 7
+};
+
+// Additional-info values with special meaning.
+static unsigned const ai_one_byte = 24;
+static unsigned const ai_indefinite = 31;
+
+static uint8_t const simple_false = 0xf4;
+static uint8_t const simple_true = 0xf5;
+static uint8_t const simple_null = 0xf6;
+static uint8_t const float32_head = 0xfa;
+static uint8_t const float64_head = 0xfb;
+static uint8_t const break_byte = 0xff;
+
+// Same limit as reader uses for recursion, for the same (security) reason.
+static int const nesting_limit = 1000;
+
+// Size at which the stage is handed to an ostream sink.
+static size_t const stage_flush_size = 64 * 1024;
+
+// Largest piece of a string we allocate before seeing its bytes on a stream.
+static size_t const stream_chunk_size = 64 * 1024;
+
+cbor_writer::cbor_writer(std::string* sout)
+    : string_sink_(sout)
+    , stream_sink_(0)
+    , stage_()
+{
+}
+
+cbor_writer::cbor_writer(std::ostream* sout)
+    : string_sink_(0)
+    , stream_sink_(sout)
+    , stage_()
+{
+    stage_.reserve(stage_flush_size);
+}
+
+cbor_writer::~cbor_writer()
+{
+    flush();
+}
+
+void cbor_writer::flush()
+{
+    if (stream_sink_ && !stage_.empty()) {
+        stream_sink_->write(stage_.data(), stage_.size());
+        stage_.clear();
+    }
+}
+
+void cbor_writer::maybe_flush()
+{
+    if (stream_sink_ && stage_.size() >= stage_flush_size)
+        flush();
+}
+
+void cbor_writer::write_head(unsigned major_type, largest_uint_t n)
+{
+    std::string& out = string_sink_ ? *string_sink_ : stage_;
+    char buf[9];
+    unsigned len;
+    uint8_t mt = static_cast<uint8_t>(major_type << 5);
+    if (n < ai_one_byte) {
+        buf[0] = static_cast<char>(mt | n);
+        len = 1;
+    }
+    else if (n <= 0xff) {
+        buf[0] = static_cast<char>(mt | 24);
+        len = 2;
+    }
+    else if (n <= 0xffff) {
+        buf[0] = static_cast<char>(mt | 25);
+        len = 3;
+    }
+    else if (n <= 0xffffffffu) {
+        buf[0] = static_cast<char>(mt | 26);
+        len = 5;
+    }
+    else {
+        buf[0] = static_cast<char>(mt | 27);
+        len = 9;
+    }
+    // Big-endian payload.
+    for (unsigned i = len - 1; i > 0; --i) {
+        buf[i] = static_cast<char>(n & 0xff);
+        n >>= 8;
+    }
+    out.append(buf, len);
+}
+
+void cbor_writer::begin_array(array_index size)
+{
+    write_head(mt_array, size);
+    maybe_flush();
+}
+
+void cbor_writer::begin_object(array_index size)
+{
+    write_head(mt_map, size);
+    maybe_flush();
+}
+
+void cbor_writer::write_key(char const* key, char const* end)
+{
+    write_string(key, end);
+}
+
+void cbor_writer::write_null()
+{
+    (string_sink_ ? *string_sink_ : stage_).push_back(static_cast<char>(simple_null));
+    maybe_flush();
+}
+
+void cbor_writer::write_bool(bool b)
+{
+    (string_sink_ ? *string_sink_ : stage_).push_back(static_cast<char>(b ? simple_true : simple_false));
+    maybe_flush();
+}
+
+void cbor_writer::write_int(largest_int_t n)
+{
+    if (n >= 0) {
+        write_head(mt_unsigned, static_cast<largest_uint_t>(n));
+    }
+    else {
+        // CBOR stores -1 - n, which cannot overflow for any negative int64.
+        write_head(mt_negative, static_cast<largest_uint_t>(-1 - n));
+    }
+    maybe_flush();
+}
+
+void cbor_writer::write_uint(largest_uint_t n)
+{
+    write_head(mt_unsigned, n);
+    maybe_flush();
+}
+
+void cbor_writer::write_real(double d)
+{
+    std::string& out = string_sink_ ? *string_sink_ : stage_;
+    char buf[9];
+    unsigned len;
+    float f = static_cast<float>(d);
+    if (static_cast<double>(f) == d || d != d) {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        buf[0] = static_cast<char>(float32_head);
+        for (unsigned i = 4; i > 0; --i) {
+            buf[i] = static_cast<char>(bits & 0xff);
+            bits >>= 8;
+        }
+        len = 5;
+    }
+    else {
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        buf[0] = static_cast<char>(float64_head);
+        for (unsigned i = 8; i > 0; --i) {
+            buf[i] = static_cast<char>(bits & 0xff);
+            bits >>= 8;
+        }
+        len = 9;
+    }
+    out.append(buf, len);
+    maybe_flush();
+}
+
+void cbor_writer::write_string(char const* begin, char const* end)
+{
+    size_t len = static_cast<size_t>(end - begin);
+    write_head(mt_text, len);
+    if (stream_sink_ && len >= stage_flush_size) {
+        // Big strings go straight to the stream instead of through the stage.
+        flush();
+        stream_sink_->write(begin, len);
+        return;
+    }
+    (string_sink_ ? *string_sink_ : stage_).append(begin, len);
+    maybe_flush();
+}
+
+void cbor_writer::write(value const& root)
+{
+    switch (root.type()) {
+    case vt_null:
+        write_null();
+        break;
+    case vt_int:
+        write_int(root.as_largest_int());
+        break;
+    case vt_uint:
+        write_uint(root.as_largest_uint());
+        break;
+    case vt_real:
+        write_real(root.as_double());
+        break;
+    case vt_bool:
+        write_bool(root.as_bool());
+        break;
+    case vt_string: {
+        char const* str;
+        char const* end;
+        root.get_string(&str, &end);
+        write_string(str, end);
+    } break;
+    case vt_array: {
+        array_index size = root.size();
+        begin_array(size);
+        for (array_index index = 0; index < size; ++index)
+            write(root[index]);
+    } break;
+    case vt_object: {
+        begin_object(root.size());
+        for (value::const_iterator it = root.begin(); it != root.end(); ++it) {
+            char const* end;
+            char const* key = it.member_name(&end);
+            write_key(key, end);
+            write(*it);
+        }
+    } break;
+    }
+}
+
+std::string write_cbor(value const& root)
+{
+    std::string out;
+    cbor_writer writer(&out);
+    writer.write(root);
+    return out;
+}
+
+namespace {
+
+// Decoding is written once, against two kinds of byte source: a memory range
+// (which lets strings be copied straight into values, and skipped for free),
+// and an istream.
+
+struct memory_source {
+    char const* current;
+    char const* end;
+
+    memory_source(char const* begin, char const* e)
+        : current(begin)
+        , end(e)
+    {
+    }
+
+    bool get(uint8_t& byte)
+    {
+        if (current >= end)
+            return false;
+        byte = static_cast<uint8_t>(*current++);
+        return true;
+    }
+
+    bool peek(uint8_t& byte)
+    {
+        if (current >= end)
+            return false;
+        byte = static_cast<uint8_t>(*current);
+        return true;
+    }
+
+    bool read(void* dest, size_t n)
+    {
+        if (static_cast<size_t>(end - current) < n)
+            return false;
+        memcpy(dest, current, n);
+        current += n;
+        return true;
+    }
+
+    bool skip(largest_uint_t n)
+    {
+        if (static_cast<largest_uint_t>(end - current) < n)
+            return false;
+        current += n;
+        return true;
+    }
+
+    bool append_to(std::string& s, largest_uint_t n)
+    {
+        if (static_cast<largest_uint_t>(end - current) < n)
+            return false;
+        s.append(current, static_cast<size_t>(n));
+        current += n;
+        return true;
+    }
+
+    bool read_string_value(largest_uint_t n, value& out)
+    {
+        if (static_cast<largest_uint_t>(end - current) < n)
+            return false;
+        out = value(current, current + n);
+        current += n;
+        return true;
+    }
+
+    // Every element of a container occupies at least one byte, so a count
+    // that exceeds the remaining input is corrupt.
+    bool plausible_count(largest_uint_t n) const
+    {
+        return n <= static_cast<largest_uint_t>(end - current);
+    }
+};
+
+struct stream_source {
+    std::istream& in;
+
+    explicit stream_source(std::istream& sin)
+        : in(sin)
+    {
+    }
+
+    bool get(uint8_t& byte)
+    {
+        int c = in.get();
+        if (c == std::char_traits<char>::eof())
+            return false;
+        byte = static_cast<uint8_t>(c);
+        return true;
+    }
+
+    bool peek(uint8_t& byte)
+    {
+        int c = in.peek();
+        if (c == std::char_traits<char>::eof())
+            return false;
+        byte = static_cast<uint8_t>(c);
+        return true;
+    }
+
+    bool read(void* dest, size_t n)
+    {
+        in.read(static_cast<char*>(dest), n);
+        return static_cast<size_t>(in.gcount()) == n;
+    }
+
+    bool skip(largest_uint_t n)
+    {
+        while (n) {
+            std::streamsize chunk = static_cast<std::streamsize>(n < stream_chunk_size ? n : stream_chunk_size);
+            in.ignore(chunk);
+            if (in.gcount() != chunk)
+                return false;
+            n -= static_cast<largest_uint_t>(chunk);
+        }
+        return true;
+    }
+
+    bool append_to(std::string& s, largest_uint_t n)
+    {
+        while (n) {
+            size_t chunk = static_cast<size_t>(n < stream_chunk_size ? n : stream_chunk_size);
+            size_t old_size = s.size();
+            s.resize(old_size + chunk);
+            if (!read(&s[old_size], chunk))
+                return false;
+            n -= chunk;
+        }
+        return true;
+    }
+
+    bool read_string_value(largest_uint_t n, value& out)
+    {
+        std::string s;
+        if (!append_to(s, n))
+            return false;
+        out = value(s);
+        return true;
+    }
+
+    bool plausible_count(largest_uint_t) const { return true; }
+};
+
+template <typename SOURCE>
+class cbor_decoder {
+public:
+    cbor_decoder(SOURCE& src, std::string* errs)
+        : src_(src)
+        , errs_(errs)
+        , depth_(0)
+    {
+    }
+
+    bool decode(value& out);
+    bool skip();
+
+private:
+    bool fail(char const* message)
+    {
+        if (errs_)
+            *errs_ = message;
+        return false;
+    }
+
+    bool read_head(unsigned& major_type, unsigned& info, largest_uint_t& n);
+    bool read_string(unsigned major_type, unsigned info, largest_uint_t n, std::string& s);
+    bool decode_simple(unsigned info, largest_uint_t n, value& out);
+    bool skip_string(unsigned major_type, unsigned info, largest_uint_t n);
+
+    SOURCE& src_;
+    std::string* errs_;
+    int depth_;
+};
+
+template <typename SOURCE>
+bool cbor_decoder<SOURCE>::read_head(unsigned& major_type, unsigned& info, largest_uint_t& n)
+{
+    uint8_t initial;
+    if (!src_.get(initial))
+        return fail("Unexpected end of CBOR input.");
+    major_type = initial >> 5;
+    info = initial & 0x1f;
+    if (info < ai_one_byte) {
+        n = info;
+        return true;
+    }
+    if (info == ai_indefinite) {
+        n = 0;
+        if (major_type == mt_unsigned || major_type == mt_negative || major_type == mt_tag)
+            return fail("Invalid indefinite length in CBOR input.");
+        return true;
+    }
+    if (info > 27)
+        return fail("Reserved additional info in CBOR input.");
+    unsigned len = 1u << (info - ai_one_byte);
+    uint8_t buf[8];
+    if (!src_.read(buf, len))
+        return fail("Unexpected end of CBOR input.");
+    n = 0;
+    for (unsigned i = 0; i < len; ++i)
+        n = (n << 8) | buf[i];
+    return true;
+}
+
+template <typename SOURCE>
+bool cbor_decoder<SOURCE>::read_string(unsigned major_type, unsigned info, largest_uint_t n, std::string& s)
+{
+    if (info != ai_indefinite)
+        return src_.append_to(s, n) || fail("Unexpected end of CBOR input.");
+    // Indefinite strings are a series of definite chunks of the same major
+    // type, ended by a break.
+    for (;;) {
+        uint8_t next;
+        if (!src_.peek(next))
+            return fail("Unexpected end of CBOR input.");
+        if (next == break_byte) {
+            src_.get(next);
+            return true;
+        }
+        unsigned chunk_type, chunk_info;
+        largest_uint_t chunk_len;
+        if (!read_head(chunk_type, chunk_info, chunk_len))
+            return false;
+        if (chunk_type != major_type || chunk_info == ai_indefinite)
+            return fail("Malformed indefinite-length string in CBOR input.");
+        if (!src_.append_to(s, chunk_len))
+            return fail("Unexpected end of CBOR input.");
+    }
+}
+
+template <typename SOURCE>
+bool cbor_decoder<SOURCE>::skip_string(unsigned major_type, unsigned info, largest_uint_t n)
+{
+    if (info != ai_indefinite)
+        return src_.skip(n) || fail("Unexpected end of CBOR input.");
+    for (;;) {
+        uint8_t next;
+        if (!src_.peek(next))
+            return fail("Unexpected end of CBOR input.");
+        if (next == break_byte) {
+            src_.get(next);
+            return true;
+        }
+        unsigned chunk_type, chunk_info;
+        largest_uint_t chunk_len;
+        if (!read_head(chunk_type, chunk_info, chunk_len))
+            return false;
+        if (chunk_type != major_type || chunk_info == ai_indefinite)
+            return fail("Malformed indefinite-length string in CBOR input.");
+        if (!src_.skip(chunk_len))
+            return fail("Unexpected end of CBOR input.");
+    }
+}
+
+static double decode_half(unsigned half)
+{
+    int exponent = (half >> 10) & 0x1f;
+    int mantissa = half & 0x3ff;
+    double magnitude;
+    if (exponent == 0)
+        magnitude = ldexp(mantissa, -24);
+    else if (exponent != 31)
+        magnitude = ldexp(mantissa + 1024, exponent - 25);
+    else
+        magnitude = mantissa == 0 ? HUGE_VAL : NAN;
+    return (half & 0x8000) ? -magnitude : magnitude;
+}
+
+template <typename SOURCE>
+bool cbor_decoder<SOURCE>::decode_simple(unsigned info, largest_uint_t n, value& out)
+{
+    switch (info) {
+    case 20:
+        out = value(false);
+        return true;
+    case 21:
+        out = value(true);
+        return true;
+    case 22:
+    case 23: // undefined
+        out = value();
+        return true;
+    case 25:
+        out = value(decode_half(static_cast<unsigned>(n)));
+        return true;
+    case 26: {
+        uint32_t bits = static_cast<uint32_t>(n);
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        out = value(static_cast<double>(f));
+        return true;
+    }
+    case 27: {
+        uint64_t bits = n;
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        out = value(d);
+        return true;
+    }
+    case ai_indefinite:
+        return fail("Unexpected break in CBOR input.");
+    default:
+        return fail("Unsupported simple value in CBOR input.");
+    }
+}
+
+template <typename SOURCE>
+bool cbor_decoder<SOURCE>::decode(value& out)
+{
+    unsigned major_type, info;
+    largest_uint_t n;
+    if (!read_head(major_type, info, n))
+        return false;
+    // Tags only add semantics to the following item; JSON has no way to
+    // carry them, so decode the content alone. A run of them is taken in a
+    // loop: tags aren't containers, so depth_ wouldn't stop recursion here.
+    while (major_type == mt_tag) {
+        if (!read_head(major_type, info, n))
+            return false;
+    }
+
+    switch (major_type) {
+    case mt_unsigned:
+        if (n <= static_cast<largest_uint_t>(value::max_int))
+            out = value(static_cast<largest_int_t>(n));
+        else
+            out = value(n);
+        return true;
+    case mt_negative:
+        if (n > static_cast<largest_uint_t>(value::max_largest_int))
+            return fail("Negative integer out of range in CBOR input.");
+        out = value(-1 - static_cast<largest_int_t>(n));
+        return true;
+    case mt_bytes:
+    case mt_text: {
+        if (info != ai_indefinite)
+            return src_.read_string_value(n, out) || fail("Unexpected end of CBOR input.");
+        std::string s;
+        if (!read_string(major_type, info, n, s))
+            return false;
+        out = value(s);
+        return true;
+    }
+    case mt_simple:
+        return decode_simple(info, n, out);
+    default:
+        break;
+    }
+
+    // Containers.
+    if (depth_ >= nesting_limit)
+        return fail("Exceeded nesting limit in CBOR input.");
+    bool indefinite = (info == ai_indefinite);
+    if (!indefinite && (n > value::max_uint || !src_.plausible_count(n)))
+        return fail("Container length out of range in CBOR input.");
+    ++depth_;
+    value container(major_type == mt_array ? vt_array : vt_object);
+    out.swap_payload(container);
+    for (largest_uint_t i = 0; indefinite || i < n; ++i) {
+        if (indefinite) {
+            uint8_t next;
+            if (!src_.peek(next))
+                return fail("Unexpected end of CBOR input.");
+            if (next == break_byte) {
+                src_.get(next);
+                break;
+            }
+        }
+        if (major_type == mt_array) {
+            if (!decode(out.append(value())))
+                return false;
+        }
+        else {
+            unsigned key_type, key_info;
+            largest_uint_t key_len;
+            if (!read_head(key_type, key_info, key_len))
+                return false;
+            std::string key;
+            if (key_type == mt_text || key_type == mt_bytes) {
+                if (!read_string(key_type, key_info, key_len, key))
+                    return false;
+            }
+            else {
+                return fail("Object member names must be strings in CBOR input.");
+            }
+            if (!decode(out[key]))
+                return false;
+        }
+    }
+    --depth_;
+    return true;
+}
+
+template <typename SOURCE>
+bool cbor_decoder<SOURCE>::skip()
+{
+    unsigned major_type, info;
+    largest_uint_t n;
+    if (!read_head(major_type, info, n))
+        return false;
+    while (major_type == mt_tag) {
+        if (!read_head(major_type, info, n))
+            return false;
+    }
+
+    switch (major_type) {
+    case mt_unsigned:
+    case mt_negative:
+        return true;
+    case mt_bytes:
+    case mt_text:
+        return skip_string(major_type, info, n);
+    case mt_simple:
+        return info != ai_indefinite || fail("Unexpected break in CBOR input.");
+    default:
+        break;
+    }
+
+    if (depth_ >= nesting_limit)
+        return fail("Exceeded nesting limit in CBOR input.");
+    ++depth_;
+    bool indefinite = (info == ai_indefinite);
+    largest_uint_t items_per_entry = (major_type == mt_map) ? 2 : 1;
+    for (largest_uint_t i = 0; indefinite || i < n * items_per_entry; ++i) {
+        if (indefinite) {
+            uint8_t next;
+            if (!src_.peek(next))
+                return fail("Unexpected end of CBOR input.");
+            if (next == break_byte) {
+                src_.get(next);
+                break;
+            }
+        }
+        if (!skip())
+            return false;
+    }
+    --depth_;
+    return true;
+}
+
+} // namespace
+
+char const* read_cbor(char const* begin, char const* end, value* root, std::string* errs)
+{
+    memory_source src(begin, end);
+    cbor_decoder<memory_source> decoder(src, errs);
+    value decoded;
+    if (!decoder.decode(decoded))
+        return 0;
+    root->swap_payload(decoded);
+    return src.current;
+}
+
+bool read_cbor(std::istream& sin, value* root, std::string* errs)
+{
+    stream_source src(sin);
+    cbor_decoder<stream_source> decoder(src, errs);
+    value decoded;
+    if (!decoder.decode(decoded))
+        return false;
+    root->swap_payload(decoded);
+    return true;
+}
+
+char const* cbor_skip(char const* begin, char const* end)
+{
+    memory_source src(begin, end);
+    cbor_decoder<memory_source> decoder(src, 0);
+    return decoder.skip() ? src.current : 0;
+}
+
+} // namespace json
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "value.h"
+#include <iosfwd>
+#include <string>
+
+// Disable warning C4251: <data member>: <type> needs to have dll-interface to
+// be used by...
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+namespace json {
+
+/** \brief Serialize a value tree as <a HREF="http://cbor.io">CBOR</a> (RFC 7049).
+
+CBOR is a compact binary equivalent of JSON. It is much cheaper to load than
+text, because numbers are stored in binary, and strings carry their length
+instead of needing to be scanned for quotes and escapes.
+
+Arrays and objects are always written with a definite length, so a reader can
+step over any subtree without materializing it (see cbor_skip()). Comments
+and source offsets are not serialized.
+
+Bytes are staged in an internal buffer and handed to the sink in large
+chunks, so writing to an unbuffered stream is cheap. Besides write(), the
+writer exposes the primitives it is built from; these let a caller emit a
+document that is too big to hold as a tree, one element at a time.
+
+Usage:
+\code
+  json::cbor_writer writer(&out_stream);
+  writer.write(root);
+  writer.flush();
+\endcode
+*/
+class JSON_API cbor_writer {
+public:
+	/// Append encoded bytes to a string. The string is not owned.
+	explicit cbor_writer(std::string* sout);
+
+	/// Write encoded bytes to a stream. The stream is not owned.
+	explicit cbor_writer(std::ostream* sout);
+
+	/// Flush any staged bytes.
+	~cbor_writer();
+
+	/// Encode a complete value tree.
+	void write(value const& root);
+
+	/// Start an array; exactly \c size values must follow.
+	void begin_array(array_index size);
+
+	/// Start an object; exactly \c size key/value pairs must follow.
+	void begin_object(array_index size);
+
+	/// Write an object member name. \param key may contain embedded nulls.
+	void write_key(char const* key, char const* end);
+
+	void write_null();
+	void write_bool(bool b);
+	void write_int(largest_int_t n);
+	void write_uint(largest_uint_t n);
+	/// Written as a 4-byte float when that is lossless; otherwise 8 bytes.
+	void write_real(double d);
+	/// \param begin may contain embedded nulls.
+	void write_string(char const* begin, char const* end);
+
+	/// Push staged bytes to the sink. Called automatically as the stage fills.
+	void flush();
+
+private:
+	cbor_writer(cbor_writer const&);
+	cbor_writer& operator=(cbor_writer const&);
+
+	void write_head(unsigned major_type, largest_uint_t n);
+	void maybe_flush();
+
+	std::string* string_sink_;
+	std::ostream* stream_sink_;
+	std::string stage_;
+};
+
+/** \brief Encode a value tree as CBOR, for convenience.
+ */
+std::string JSON_API write_cbor(value const& root);
+
+/** \brief Decode one CBOR data item from memory.
+
+Definite- and indefinite-length items are accepted, so output from other CBOR
+encoders can be read. Tags are ignored (their content is decoded), byte
+strings become strings, and "undefined" becomes null. Unsigned integers up to
+value::max_int become #vt_int and larger ones #vt_uint, which matches what
+reader produces for the same numbers in text; negative integers become #vt_int.
+
+\param begin First byte of the item.
+\param end First byte beyond the available input.
+\param root [out] Receives the decoded value.
+\param errs [out] Receives a description of the problem on failure (if not NULL).
+\return First byte beyond the decoded item, or NULL if input was malformed or
+	truncated. A buffer can therefore hold a sequence of items.
+*/
+char const* JSON_API read_cbor(char const* begin, char const* end,
+	value* root, std::string* errs);
+
+/** \brief Decode one CBOR data item from a stream.
+
+Only the bytes of the item are consumed, so the stream may hold a sequence of
+items. Large strings are read in bounded chunks, so a corrupt length cannot
+trigger a huge allocation before the data actually arrives.
+
+\return \c true on success, \c false if input was malformed or truncated.
+*/
+bool JSON_API read_cbor(std::istream& sin, value* root, std::string* errs);
+
+/** \brief Step over one CBOR data item without decoding it.
+
+Only item headers are examined; string payloads are jumped over. This is how a
+reader gets to the part of a cached document it cares about.
+
+\return First byte beyond the item, or NULL if input was malformed or truncated.
+*/
+char const* JSON_API cbor_skip(char const* begin, char const* end);
+
+} // namespace json
+
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(pop)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
@@ -10,6 +10,8 @@
 #include "value.h"
 #include "reader.h"
 #include "writer.h"
+#include "cbor.h"
+#include "lazy_document.h"
 #include "features.h"
 
 #endif // JSON_JSON_H_INCLUDED
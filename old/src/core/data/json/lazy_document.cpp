@@ -0,0 +1,331 @@
+#include "lazy_document.h"
+#include "reader.h"
+#include <cstring>
+#include <sstream>
+
+namespace json {
+
+// The indexer below only needs to find where each top-level value ends. It
+// does that by tracking bracket depth and stepping over strings and comments;
+// it never decodes numbers, literals, or escapes.
+
+static char const* skip_space_and_comments(char const* p, char const* end)
+{
+    while (p < end) {
+        char c = *p;
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            ++p;
+        }
+        else if (c == '/' && p + 1 < end && p[1] == '/') {
+            p = static_cast<char const*>(memchr(p, '\n', end - p));
+            if (!p)
+                return end;
+        }
+        else if (c == '/' && p + 1 < end && p[1] == '*') {
+            p += 2;
+            while (p + 1 < end && !(p[0] == '*' && p[1] == '/'))
+                ++p;
+            p = (p + 1 < end) ? p + 2 : end;
+        }
+        else {
+            break;
+        }
+    }
+    return p;
+}
+
+// p points at an opening quote. Return the char just beyond the closing quote,
+// or NULL if the string is unterminated.
+static char const* skip_string(char const* p, char const* end)
+{
+    ++p;
+    for (;;) {
+        char const* quote = static_cast<char const*>(memchr(p, '"', end - p));
+        if (!quote)
+            return 0;
+        // The quote is escaped iff it is preceded by an odd number of
+        // backslashes.
+        char const* q = quote;
+        while (q > p && q[-1] == '\\')
+            --q;
+        if (((quote - q) & 1) == 0)
+            return quote + 1;
+        p = quote + 1;
+    }
+}
+
+// Return the char just beyond the value that starts at p, or NULL if the
+// value is malformed in a way that prevents finding its end.
+static char const* skip_value(char const* p, char const* end)
+{
+    unsigned depth = 0;
+    while (p < end) {
+        char c = *p;
+        switch (c) {
+        case '"':
+            p = skip_string(p, end);
+            if (!p)
+                return 0;
+            if (depth == 0)
+                return p;
+            continue;
+        case '{':
+        case '[':
+            ++depth;
+            break;
+        case '}':
+        case ']':
+            if (depth == 0)
+                return p; // End of a scalar that is the last in its container.
+            if (--depth == 0)
+                return p + 1;
+            break;
+        case ',':
+            if (depth == 0)
+                return p;
+            break;
+        case '/':
+            if (p + 1 < end && (p[1] == '/' || p[1] == '*')) {
+                char const* after = skip_space_and_comments(p, end);
+                if (depth == 0)
+                    return p;
+                p = after;
+                continue;
+            }
+            break;
+        case ' ':
+        case '\t':
+        case '\r':
+        case '\n':
+            if (depth == 0)
+                return p;
+            break;
+        default:
+            break;
+        }
+        ++p;
+    }
+    return depth == 0 ? p : 0;
+}
+
+static bool index_error(std::string* errs, char const* begin, char const* where, char const* message)
+{
+    if (errs) {
+        std::ostringstream oss;
+        oss << message << " (at byte " << (where - begin) << ")";
+        *errs = oss.str();
+    }
+    return false;
+}
+
+lazy_document::slot::slot(char const* s, char const* l)
+    : start(s)
+    , limit(l)
+    , parsed(false)
+    , parsed_value()
+{
+}
+
+lazy_document::lazy_document()
+    : owned_text_()
+    , type_(vt_null)
+    , member_index_()
+    , slots_()
+    , scalar_root_()
+    , reader_()
+{
+    char_reader_builder builder;
+    builder["collect_comments"] = false;
+    reader_.reset(builder.new_char_reader());
+}
+
+lazy_document::~lazy_document()
+{
+}
+
+void lazy_document::reset()
+{
+    type_ = vt_null;
+    member_index_.clear();
+    slots_.clear();
+    scalar_root_ = value();
+}
+
+bool lazy_document::load(std::string text, std::string* errs)
+{
+    owned_text_.swap(text);
+    char const* begin = owned_text_.data();
+    return load(begin, begin + owned_text_.size(), errs);
+}
+
+bool lazy_document::load(char const* begin, char const* end, std::string* errs)
+{
+    reset();
+    char const* p = skip_space_and_comments(begin, end);
+    if (p >= end)
+        return index_error(errs, begin, p, "Empty document.");
+
+    char open = *p;
+    if (open != '{' && open != '[') {
+        // A scalar root has no subtrees to defer.
+        value root;
+        if (!reader_->parse(p, end, &root, errs))
+            return false;
+        type_ = root.type();
+        scalar_root_.swap(root);
+        return true;
+    }
+
+    bool is_object = (open == '{');
+    char close = is_object ? '}' : ']';
+    ++p;
+    for (;;) {
+        p = skip_space_and_comments(p, end);
+        if (p >= end)
+            return index_error(errs, begin, p, "Unexpected end of document.");
+        if (*p == close && slots_.empty())
+            break;
+
+        std::string key;
+        if (is_object) {
+            if (*p != '"')
+                return index_error(errs, begin, p, "Missing '}' or object member name.");
+            char const* key_end = skip_string(p, end);
+            if (!key_end)
+                return index_error(errs, begin, p, "Unterminated member name.");
+            if (memchr(p, '\\', key_end - p)) {
+                // Rare: let the real parser decode escapes.
+                value decoded;
+                if (!reader_->parse(p, key_end, &decoded, errs))
+                    return false;
+                key = decoded.as_string();
+            }
+            else {
+                key.assign(p + 1, key_end - 1);
+            }
+            p = skip_space_and_comments(key_end, end);
+            if (p >= end || *p != ':')
+                return index_error(errs, begin, p, "Missing ':' after object member name.");
+            p = skip_space_and_comments(p + 1, end);
+        }
+
+        char const* value_start = p;
+        p = skip_value(p, end);
+        if (!p || p == value_start)
+            return index_error(errs, begin, value_start, "Value expected.");
+        if (is_object)
+            member_index_[key] = slots_.size();
+        slots_.push_back(slot(value_start, p));
+
+        p = skip_space_and_comments(p, end);
+        if (p >= end)
+            return index_error(errs, begin, p, "Unexpected end of document.");
+        if (*p == ',') {
+            ++p;
+            continue;
+        }
+        if (*p == close)
+            break;
+        return index_error(errs, begin, p, is_object ? "Missing ',' or '}' in object." : "Missing ',' or ']' in array.");
+    }
+    type_ = is_object ? vt_object : vt_array;
+    return true;
+}
+
+value_type lazy_document::type() const
+{
+    return type_;
+}
+
+array_index lazy_document::size() const
+{
+    if (type_ == vt_object)
+        return static_cast<array_index>(member_index_.size());
+    if (type_ == vt_array)
+        return static_cast<array_index>(slots_.size());
+    return 0;
+}
+
+bool lazy_document::is_member(std::string const& key) const
+{
+    return member_index_.find(key) != member_index_.end();
+}
+
+value::members lazy_document::get_member_names() const
+{
+    value::members names;
+    names.reserve(member_index_.size());
+    for (std::map<std::string, size_t>::const_iterator it = member_index_.begin(); it != member_index_.end(); ++it)
+        names.push_back(it->first);
+    return names;
+}
+
+value const& lazy_document::materialize(slot& s) const
+{
+    if (!s.parsed) {
+        std::string errs;
+        value parsed;
+        if (!reader_->parse(s.start, s.limit, &parsed, &errs))
+            throw_runtime_error(errs);
+        s.parsed_value.swap(parsed);
+        s.parsed = true;
+    }
+    return s.parsed_value;
+}
+
+value const& lazy_document::operator[](std::string const& key) const
+{
+    std::map<std::string, size_t>::const_iterator it = member_index_.find(key);
+    if (it == member_index_.end())
+        return value::null_ref;
+    return materialize(slots_[it->second]);
+}
+
+value const& lazy_document::operator[](char const* key) const
+{
+    return (*this)[std::string(key)];
+}
+
+value const& lazy_document::operator[](array_index index) const
+{
+    if (type_ != vt_array || index >= slots_.size())
+        return value::null_ref;
+    return materialize(slots_[index]);
+}
+
+value const& lazy_document::operator[](int index) const
+{
+    if (index < 0)
+        return value::null_ref;
+    return (*this)[array_index(index)];
+}
+
+value lazy_document::get(std::string const& key, value const& default_value) const
+{
+    std::map<std::string, size_t>::const_iterator it = member_index_.find(key);
+    return it == member_index_.end() ? default_value : materialize(slots_[it->second]);
+}
+
+value lazy_document::get(array_index index, value const& default_value) const
+{
+    return (type_ != vt_array || index >= slots_.size()) ? default_value : materialize(slots_[index]);
+}
+
+value lazy_document::to_value() const
+{
+    if (type_ == vt_object) {
+        value root(vt_object);
+        for (std::map<std::string, size_t>::const_iterator it = member_index_.begin(); it != member_index_.end(); ++it)
+            root[it->first] = materialize(slots_[it->second]);
+        return root;
+    }
+    if (type_ == vt_array) {
+        value root(vt_array);
+        for (size_t i = 0; i < slots_.size(); ++i)
+            root.append(materialize(slots_[i]));
+        return root;
+    }
+    return scalar_root_;
+}
+
+} // namespace json
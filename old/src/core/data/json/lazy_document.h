@@ -0,0 +1,128 @@
+#pragma once
+
+#include "value.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Disable warning C4251: <data member>: <type> needs to have dll-interface to
+// be used by...
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+
+namespace json {
+
+class char_reader;
+
+/** \brief A JSON document that parses its top-level members on demand.
+
+load() only indexes the top level of the document: for an object, the name
+and byte range of each member's value; for an array, the byte range of each
+element. Nothing below the top level is parsed until it is requested through
+operator[]() or get(); the first access parses just that subtree, and the
+result is cached, so later accesses cost only a lookup.
+
+This makes it cheap to pull one branch out of a very large document. A
+subtree that is never touched is only scanned for brackets and quotes; its
+contents are not validated, so a syntax error inside it will only be
+reported if it is accessed.
+
+If the root is neither an object nor an array, it is parsed fully by load().
+
+Comments are skipped, not collected. Duplicate member names resolve to the
+last occurrence, as with reader.
+
+\note A lazy_document is not thread-safe, even for const access, because
+	access updates the cache.
+*/
+class JSON_API lazy_document {
+public:
+	lazy_document();
+	~lazy_document();
+
+	/** \brief Index a document that the lazy_document takes ownership of.
+	 * \param errs [out] Description of the problem, if indexing fails (may be NULL).
+	 * \return \c true if the top level was well-formed.
+	 */
+	bool load(std::string text, std::string* errs);
+
+	/** \brief Index a document without copying it.
+	 * \pre [begin, end) must remain valid and unchanged for the lifetime of
+	 *     the lazy_document (or until the next load()).
+	 */
+	bool load(char const* begin, char const* end, std::string* errs);
+
+	/// Type of the root value; vt_null before a successful load().
+	value_type type() const;
+
+	/// Number of top-level members or elements.
+	array_index size() const;
+
+	/// Return true if the root is an object with a member named key.
+	bool is_member(std::string const& key) const;
+
+	/** \brief Return the list of top-level member names, sorted as
+	 * value::get_member_names() would sort them.
+	 */
+	value::members get_member_names() const;
+
+	/** \brief Access a top-level member, parsing it on first use.
+	 * \return value::null if the root is not an object or has no such member.
+	 * \throw json::runtime_error if the member's text is not valid JSON.
+	 */
+	value const& operator[](std::string const& key) const;
+	value const& operator[](char const* key) const;
+
+	/** \brief Access a top-level array element, parsing it on first use.
+	 * \return value::null if the root is not an array or index is out of range.
+	 * \throw json::runtime_error if the element's text is not valid JSON.
+	 */
+	value const& operator[](array_index index) const;
+
+	/// Same as above, so doc[0] doesn't look like doc[(char const*)0]. A
+	/// negative index is out of range.
+	value const& operator[](int index) const;
+
+	/// Return the named member if it exists, default_value otherwise.
+	value get(std::string const& key, value const& default_value) const;
+
+	/// Return the indexed element if it exists, default_value otherwise.
+	value get(array_index index, value const& default_value) const;
+
+	/** \brief Parse everything that has not been parsed yet, and assemble
+	 * the whole document as a value.
+	 */
+	value to_value() const;
+
+private:
+	lazy_document(lazy_document const&);
+	lazy_document& operator=(lazy_document const&);
+
+	struct slot {
+		char const* start;
+		char const* limit;
+		bool parsed;
+		value parsed_value;
+
+		slot(char const* s, char const* l);
+	};
+
+	void reset();
+	value const& materialize(slot& s) const;
+
+	std::string owned_text_;
+	value_type type_;
+	std::map<std::string, size_t> member_index_;
+	mutable std::vector<slot> slots_;
+	value scalar_root_;
+	std::unique_ptr<char_reader> reader_;
+};
+
+} // namespace json
+
+#if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
+#pragma warning(pop)
+#endif // if defined(JSONCPP_DISABLE_DLL_INTERFACE_WARNING)
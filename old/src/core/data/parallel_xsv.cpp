@@ -0,0 +1,381 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/util/dbc.h"
+#include "core/io/mapped_file.h"
+#include "core/data/parallel_xsv.h"
+#include "core/data/.private/xsv_chunks.h"
+#include "core/data/.private/xsv_scan.h"
+
+using std::vector;
+
+using intent::core::io::map_hints;
+using intent::core::io::mapped_file;
+using intent::core::text::str_view;
+
+namespace intent {
+namespace core {
+namespace data {
+
+static constexpr size_t MIN_CHUNK_SIZE = 64 * 1024;
+static constexpr size_t MAX_CHUNK_SIZE = 4 * 1024 * 1024;
+
+// How many chunks each thread may parse before the consumer gets to them.
+static constexpr size_t CHUNKS_AHEAD_PER_THREAD = 2;
+
+namespace {
+
+struct parsed_field {
+    size_t offset; // into the input, or into the chunk's arena
+    idx_t length;
+    bool in_arena;
+};
+
+struct parsed_chunk {
+    // Records that begin in [begin, limit) belong to this chunk.
+    size_t begin;
+    size_t limit;
+
+    bool ready;
+    std::exception_ptr error;
+
+    // For each record, the index just past its last field.
+    vector<size_t> record_ends;
+    vector<parsed_field> fields;
+    // Unescaped text of fields that contained quotes.
+    std::string arena;
+
+    parsed_chunk() : begin(0), limit(0), ready(false), error(), record_ends(),
+            fields(), arena() {
+    }
+
+    void release() {
+        vector<size_t>().swap(record_ends);
+        vector<parsed_field>().swap(fields);
+        std::string().swap(arena);
+    }
+};
+
+} // end anonymous namespace
+
+size_t choose_xsv_chunk_size(size_t input_size, unsigned thread_count) {
+    return std::min(MAX_CHUNK_SIZE, std::max(MIN_CHUNK_SIZE,
+            input_size / (thread_count * 4)));
+}
+
+unsigned choose_xsv_thread_count(unsigned requested) {
+    return requested ? requested : std::max(1u, std::thread::hardware_concurrency());
+}
+
+void for_each_xsv_chunk(size_t count, unsigned thread_count,
+        std::function<void(size_t)> const & fn) {
+    thread_count = static_cast<unsigned>(std::min<size_t>(thread_count, count));
+    auto some = [&](unsigned first) {
+        for (size_t i = first; i < count; i += thread_count) {
+            fn(i);
+        }
+    };
+    if (thread_count <= 1) {
+        some(0);
+        return;
+    }
+    vector<std::thread> threads;
+    for (unsigned t = 0; t < thread_count; ++t) {
+        threads.emplace_back(some, t);
+    }
+    for (auto & t : threads) {
+        t.join();
+    }
+}
+
+vector<xsv_chunk_range> split_xsv_chunks(char const * begin, char const * end,
+        char delim, size_t chunk_size, unsigned thread_count) {
+    size_t size = end - begin;
+    size_t chunk_count = (size + chunk_size - 1) / chunk_size;
+    vector<xsv_chunk_range> ranges(chunk_count);
+    if (!chunk_count) {
+        return ranges;
+    }
+
+    // Probe every chunk under both quoting assumptions.
+    vector<xsv_chunk_probe> probes(chunk_count);
+    for_each_xsv_chunk(chunk_count, thread_count, [&](size_t i) {
+        size_t offset = i * chunk_size;
+        probes[i] = probe_xsv_chunk(begin + offset,
+                std::min(chunk_size, size - offset), end, delim);
+    });
+
+    // Resolve: quote parity so far tells which assumption was right.
+    vector<size_t> starts(chunk_count);
+    starts[0] = 0;
+    bool inside = false;
+    for (size_t i = 1; i < chunk_count; ++i) {
+        inside ^= probes[i - 1].odd_quotes;
+        size_t first = probes[i].first_record[inside ? 1 : 0];
+        starts[i] = (first == xsv_chunk_probe::npos)
+                ? xsv_chunk_probe::npos : i * chunk_size + first;
+    }
+    // A chunk with no record break of its own is left empty; its bytes
+    // belong to the record that began before it.
+    size_t limit = size;
+    for (size_t i = chunk_count; i-- > 0; ) {
+        ranges[i].limit = limit;
+        if (starts[i] == xsv_chunk_probe::npos) {
+            ranges[i].begin = limit;
+        } else {
+            ranges[i].begin = starts[i];
+            limit = starts[i];
+        }
+    }
+    return ranges;
+}
+
+struct parallel_xsv_reader::data_t {
+    std::unique_ptr<mapped_file> mapping;
+    char const * begin;
+    char const * end;
+    char delim;
+
+    vector<parsed_chunk> chunks;
+
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable chunk_ready;
+    size_t next_to_parse;
+    size_t window;
+    bool stopping;
+    vector<std::thread> threads;
+
+    // Consumer position. Only the consumer touches these.
+    size_t current_chunk;
+    size_t next_in_chunk;
+    parsed_chunk * record_chunk;
+    size_t first_field;
+    size_t field_end;
+    bool record_copied;
+    std::string scratch;
+    vector<size_t> scratch_offsets;
+
+    data_t(char c) : mapping(), begin(nullptr), end(nullptr), delim(c),
+            chunks(), next_to_parse(0), window(0), stopping(false), threads(),
+            current_chunk(0), next_in_chunk(0), record_chunk(nullptr),
+            first_field(0), field_end(0), record_copied(false), scratch(),
+            scratch_offsets() {
+    }
+
+    ~data_t() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work_available.notify_all();
+        for (auto & t : threads) {
+            t.join();
+        }
+    }
+
+    void start(unsigned thread_count) {
+        thread_count = choose_xsv_thread_count(thread_count);
+        size_t size = end - begin;
+        if (size == 0) {
+            return;
+        }
+        auto ranges = split_xsv_chunks(begin, end, delim,
+                choose_xsv_chunk_size(size, thread_count), thread_count);
+        chunks.resize(ranges.size());
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            chunks[i].begin = ranges[i].begin;
+            chunks[i].limit = ranges[i].limit;
+        }
+        thread_count = static_cast<unsigned>(std::min<size_t>(thread_count, chunks.size()));
+
+        // Parse ahead of the consumer.
+        window = thread_count * CHUNKS_AHEAD_PER_THREAD;
+        for (unsigned t = 0; t < thread_count; ++t) {
+            threads.emplace_back(&data_t::work, this);
+        }
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            work_available.wait(lock, [this] {
+                return stopping || next_to_parse >= chunks.size()
+                        || next_to_parse < current_chunk + window;
+            });
+            if (stopping || next_to_parse >= chunks.size()) {
+                return;
+            }
+            parsed_chunk & c = chunks[next_to_parse++];
+            lock.unlock();
+            try {
+                parse(c);
+            } catch (...) {
+                c.error = std::current_exception();
+            }
+            lock.lock();
+            c.ready = true;
+            chunk_ready.notify_all();
+        }
+    }
+
+    void parse(parsed_chunk & c) {
+        fields_t fields;
+        char const * p = begin + c.begin;
+        char const * limit = begin + c.limit;
+        while (p < limit) {
+            fields.clear();
+            char const * next;
+            bool has_quotes;
+            // Scan against the end of all input; a record that begins in
+            // this chunk may run on into the next.
+            scan_xsv_record(p, end, delim, fields, next, has_quotes);
+            size_t record_offset = p - begin;
+            for (auto const & fb : fields) {
+                parsed_field pf;
+                char const * text = p + fb.first;
+                if (has_quotes && memchr(text, '"', fb.second)) {
+                    pf.offset = c.arena.size();
+                    c.arena.resize(pf.offset + fb.second);
+                    pf.length = unescape_xsv_field(text, fb.second, &c.arena[pf.offset]);
+                    c.arena.resize(pf.offset + pf.length);
+                    pf.in_arena = true;
+                } else {
+                    pf.offset = record_offset + fb.first;
+                    pf.length = fb.second;
+                    pf.in_arena = false;
+                }
+                c.fields.push_back(pf);
+            }
+            c.record_ends.push_back(c.fields.size());
+            p = next;
+        }
+    }
+
+    parsed_chunk & wait_for(size_t k) {
+        std::unique_lock<std::mutex> lock(mutex);
+        chunk_ready.wait(lock, [this, k] { return chunks[k].ready; });
+        return chunks[k];
+    }
+
+    bool next_record() {
+        record_copied = false;
+        record_chunk = nullptr;
+        while (current_chunk < chunks.size()) {
+            parsed_chunk & c = wait_for(current_chunk);
+            if (next_in_chunk < c.record_ends.size()) {
+                record_chunk = &c;
+                first_field = next_in_chunk ? c.record_ends[next_in_chunk - 1] : 0;
+                field_end = c.record_ends[next_in_chunk];
+                ++next_in_chunk;
+                return true;
+            }
+            // Records before a bad one are still delivered, in order.
+            if (c.error) {
+                std::rethrow_exception(c.error);
+            }
+            c.release();
+            next_in_chunk = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++current_chunk;
+            }
+            work_available.notify_all();
+        }
+        return false;
+    }
+
+    size_t field_count() const {
+        return record_chunk ? field_end - first_field : 0;
+    }
+
+    str_view field(size_t i) const {
+        auto const & pf = record_chunk->fields[first_field + i];
+        char const * base = pf.in_arena ? record_chunk->arena.data() : begin;
+        return str_view(base + pf.offset, pf.length);
+    }
+
+    void copy_record() {
+        if (!record_copied) {
+            scratch.clear();
+            scratch_offsets.clear();
+            for (size_t i = 0; i < field_count(); ++i) {
+                str_view v = field(i);
+                scratch_offsets.push_back(scratch.size());
+                scratch.append(v.begin, v.length);
+                scratch.push_back(0);
+            }
+            record_copied = true;
+        }
+    }
+};
+
+parallel_xsv_reader::parallel_xsv_reader(char const * begin, char const * end,
+        char delim, unsigned thread_count) : data(nullptr) {
+    precondition(begin || begin == end);
+    precondition(delim && delim != '"' && delim != '\r' && delim != '\n');
+    std::unique_ptr<data_t> d(new data_t(delim));
+    d->begin = begin;
+    d->end = end;
+    d->start(thread_count);
+    data = d.release();
+}
+
+parallel_xsv_reader::parallel_xsv_reader(filesystem::path const & file,
+        char delim, unsigned thread_count) : data(nullptr) {
+    precondition(delim && delim != '"' && delim != '\r' && delim != '\n');
+    std::unique_ptr<data_t> d(new data_t(delim));
+    d->mapping.reset(new mapped_file(file, mapped_file::access::read_only,
+            map_hints::sequential | map_hints::huge_pages));
+    d->begin = d->mapping->begin();
+    d->end = d->mapping->end();
+    d->start(thread_count);
+    data = d.release();
+}
+
+parallel_xsv_reader::parallel_xsv_reader(parallel_xsv_reader && rhs) :
+        data(nullptr) {
+    *this = std::move(rhs);
+}
+
+parallel_xsv_reader & parallel_xsv_reader::operator =(parallel_xsv_reader && other) {
+    if (this != &other) {
+        delete data;
+        data = other.data;
+        other.data = nullptr;
+    }
+    return *this;
+}
+
+parallel_xsv_reader::~parallel_xsv_reader() {
+    delete data;
+}
+
+bool parallel_xsv_reader::next_record() {
+    return data->next_record();
+}
+
+size_t parallel_xsv_reader::get_field_count() const {
+    return data->field_count();
+}
+
+str_view parallel_xsv_reader::get_field(size_t i) const {
+    return i < data->field_count() ? data->field(i) : str_view();
+}
+
+char const * parallel_xsv_reader::get_field_by_index(size_t i) const {
+    if (i >= data->field_count()) {
+        return nullptr;
+    }
+    data->copy_record();
+    return data->scratch.data() + data->scratch_offsets[i];
+}
+
+}}} // end namespace
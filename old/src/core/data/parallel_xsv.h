@@ -0,0 +1,88 @@
+#ifndef _e5221c24550f469a9051e1759f2d2add
+#define _e5221c24550f469a9051e1759f2d2add
+
+#include <cstddef>
+
+#include "core/filesystem.h"
+#include "core/text/str_view.h"
+#include "core/util/value_semantics.h"
+
+namespace intent {
+namespace core {
+namespace data {
+
+/**
+ * Read comma-, tab-, and *-separated-values data on many cores at once.
+ *
+ * The input is cut into chunks of a few MB. A first parallel pass works out,
+ * for each chunk, where its first record would begin both if the chunk
+ * started inside quotes and if it didn't; a quick sequential pass over
+ * quote parities then picks the true split points, so delimiters and line
+ * breaks inside quotes are handled exactly as xsv_reader handles them. A
+ * pool of threads then parses chunks ahead of the consumer, and records are
+ * handed out strictly in their original order.
+ *
+ * Parsing runs at most a few chunks per thread ahead of the caller, so memory
+ * use stays bounded however big the input is.
+ *
+ * Fields are views into the input, except that a field that contained
+ * quotes is unescaped into storage owned by the reader.
+ */
+class parallel_xsv_reader {
+    struct data_t;
+    data_t * data;
+
+public:
+    /**
+     * Read data from memory that the caller keeps alive and unchanged for
+     * the lifetime of the reader.
+     *
+     * @param delim Which character delimits fields?
+     * @param thread_count How many threads parse; 0 means one per core.
+     */
+    parallel_xsv_reader(char const * begin, char const * end, char delim,
+            unsigned thread_count = 0);
+
+    /**
+     * Map an existing file and read its data.
+     *
+     * @throw std::runtime_error if the file can't be opened or mapped.
+     */
+    parallel_xsv_reader(filesystem::path const & file, char delim,
+            unsigned thread_count = 0);
+
+    /**
+     * Stops and joins the parsing threads.
+     */
+    ~parallel_xsv_reader();
+
+    MOVEABLE_BUT_NOT_COPYABLE(parallel_xsv_reader);
+
+    /**
+     * Advance to the next record, waiting for it to be parsed if need be.
+     *
+     * @return false when input is exhausted.
+     * @throw std::runtime_error if a record exceeds the maximum record size
+     *     (1 MB). The error surfaces when the reader reaches the chunk that
+     *     holds the bad record.
+     */
+    bool next_record();
+
+    size_t get_field_count() const;
+
+    /**
+     * Get a field of the current record without copying it. The view is not
+     * null-terminated. It is null if i is out of range.
+     */
+    text::str_view get_field(size_t i) const;
+
+    /**
+     * Get a null-terminated copy of a field of the current record, or
+     * nullptr if i is out of range. Valid until the next record.
+     */
+    char const * get_field_by_index(size_t i) const;
+};
+
+}}} // end namespace
+
+#endif // sentry
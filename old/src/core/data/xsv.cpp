@@ -1,47 +1,77 @@
+#include <cerrno>
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
 #include <vector>
 
 #include "core/util/dbc.h"
+#include "core/io/buffered_writer.h"
 #include "core/io/ioutil.h"
+#include "core/io/mapped_file.h"
 #include "core/data/xsv.h"
+#include "core/data/.private/xsv_scan.h"
+#include "core/text/format_numbers.h"
 
 using std::vector;
 using std::pair;
 
+using intent::core::io::buffered_writer;
 using intent::core::io::c_file;
+using intent::core::io::map_hints;
+using intent::core::io::mapped_file;
+using intent::core::text::format_double;
+using intent::core::text::format_int64;
+using intent::core::text::format_uint64;
+using intent::core::text::MAX_FORMATTED_NUMBER_LEN;
+using intent::core::text::str_view;
 
 namespace intent {
 namespace core {
 namespace data {
 
-typedef uint32_t idx_t;
-
-static constexpr idx_t MAX_RECORD_SIZE = 1024 * 1024;
 static constexpr idx_t INITIAL_ALLOCED_SIZE = 8 * 1024;
 
+// A buffer this big can hold a maximal record plus its line break, so a
+// record that still doesn't fit is guaranteed to be too long.
+static constexpr idx_t MAX_ALLOCED_SIZE = MAX_RECORD_SIZE + INITIAL_ALLOCED_SIZE;
+
+static_assert(MAX_RECORD_SIZE % INITIAL_ALLOCED_SIZE == 0,
+        "MAX_RECORD_SIZE must be a multiple of INITIAL_ALLOCED_SIZE");
+
+enum class xsv_source {
+    memory, // caller's mutable buffer; fields terminated in place
+    stream, // our own buffer, refilled from f; fields terminated in place
+    mapped, // read-only mapping; fields are only located, never written
+};
+
 struct xsv_reader::data_t {
+    xsv_source source;
     c_file * f;
+    bool exhausted; // f has no more to give
     char * buf;
-    char * p;
-    char * end;
     idx_t alloced_size;
-    idx_t content_size;
+    mapped_file * mapping;
 
-    typedef pair<idx_t, idx_t> field_boundaries;
+    // The current record, and the first char we haven't scanned yet.
+    char const * record;
+    char const * p;
+    char const * end;
 
-    static_assert(std::numeric_limits<decltype(field_boundaries::first)>::max()
-            >= MAX_RECORD_SIZE,
-            "indexes must be capable of representing any offset <= MAX_RECORD_SIZE");
+    fields_t fields;
+    bool record_has_quotes;
 
-    static_assert(MAX_RECORD_SIZE % INITIAL_ALLOCED_SIZE == 0,
-            "MAX_RECORD_SIZE must be a multiple of INITIAL_ALLOCED_SIZE");
+    // In mapped mode, a null-terminated, unescaped copy of the current
+    // record, made only when a caller needs one.
+    bool record_copied;
+    std::string scratch;
 
-    typedef vector<field_boundaries> fields_t;
-    fields_t fields;
     char delim;
 
-    data_t(char c) : f(nullptr), buf(nullptr), p(nullptr), end(nullptr),
-            alloced_size(0), content_size(0), fields(), delim(c) {
+    data_t(char c, xsv_source s) : source(s), f(nullptr), exhausted(false), buf(nullptr),
+            alloced_size(0), mapping(nullptr), record(nullptr),
+            p(nullptr), end(nullptr), fields(), record_has_quotes(false),
+            record_copied(false), scratch(), delim(c) {
     }
 
     ~data_t() {
@@ -49,88 +79,115 @@ struct xsv_reader::data_t {
         if (alloced_size && buf) {
             free(buf);
         }
+        delete mapping;
         delete f;
     }
 
-    inline void shift(idx_t n) {
-        content_size -= n;
-        memmove(buf, buf + n, content_size);
-    }
-
-    inline char * extend(char * p) {
-        auto current_offset = p - buf;
-        bool extended = false;
-
-        if (f) {
-            // Do we have room to read in more content?
-            if (content_size < MAX_RECORD_SIZE) {
-
-                // Do we have any unused buffer space?
-                auto bytes_to_read = alloced_size - content_size;
+    /**
+     * Slide unread content to the front of the buffer (growing the buffer if
+     * it is full), then read as much more as will fit.
+     *
+     * @return true if more content was read.
+     */
+    bool refill() {
+        if (!f || exhausted) {
+            return false;
+        }
+        idx_t unread = static_cast<idx_t>(end - p);
+        if (p > buf && unread) {
+            memmove(buf, p, unread);
+        }
+        if (unread == alloced_size) {
+            if (alloced_size >= MAX_ALLOCED_SIZE) {
+                throw std::runtime_error("xsv record exceeds maximum record size");
+            }
+            auto new_alloced_size = std::min(MAX_ALLOCED_SIZE,
+                    std::max(alloced_size * 2, INITIAL_ALLOCED_SIZE));
+            // One extra byte, so the last field of input can be terminated.
+            auto new_buf = reinterpret_cast<char *>(realloc(buf, new_alloced_size + 1));
+            if (!new_buf) {
+                throw std::bad_alloc();
+            }
+            buf = new_buf;
+            alloced_size = new_alloced_size;
+        }
+        p = buf;
+        end = buf + unread;
 
-                // If no, then try growing the buffer.
-                if (bytes_to_read == 0 && alloced_size < MAX_RECORD_SIZE) {
-                    auto new_alloced_size = std::min(MAX_RECORD_SIZE,
-                            std::max(alloced_size * 2, INITIAL_ALLOCED_SIZE));
-                    buf = reinterpret_cast<char *>(realloc(buf, new_alloced_size));
-                    if (!buf) {
-                        throw std::bad_alloc();
-                    }
-                    alloced_size = new_alloced_size;
-                    bytes_to_read = alloced_size - content_size;
-                }
+        auto bytes_to_read = alloced_size - unread;
+        auto bytes_read = fread(buf + unread, 1, bytes_to_read, *f);
+        end += bytes_read;
+        buf[end - buf] = 0;
 
-                // See what we can read from our file.
-                auto bytes_read = fread(buf + content_size, 1, bytes_to_read, *f);
-                extended = (bytes_read > 0);
+        // The file stays open, in case of a seek.
+        if (bytes_read < bytes_to_read) {
+            exhausted = true;
+        }
+        return bytes_read > 0;
+    }
 
-            } else {
-                extended = false;
+    bool next_record() {
+        fields.clear();
+        record_copied = false;
+        if (p >= end && !refill()) {
+            return false;
+        }
+        char const * next;
+        for (;;) {
+            bool terminated = scan_xsv_record(p, end, delim, fields, next,
+                    record_has_quotes);
+            if (source != xsv_source::stream || exhausted) {
+                break;
             }
-
-            // Close file as soon as we're done with it; do not wait until
-            // reader is destroyed.
-            if (feof(*f)) {
-                delete f;
-                f = nullptr;
+            // A record that runs to the end of the buffer may continue in
+            // the file--as may a "\r\n" that was split by a read.
+            if (terminated && (next < end || end[-1] != '\r')) {
+                break;
             }
+            fields.clear();
+            refill();
+        }
+        record = p;
+        p = next;
+        if (source != xsv_source::mapped) {
+            terminate_xsv_fields(const_cast<char *>(record), fields, record_has_quotes);
         }
-        return extended ? buf + current_offset : nullptr;
+        return true;
     }
 
-    inline char next_char() {
-        // If we reached the end of the content we're currently holding in the
-        // buffer without finding the end of a record...
-        if (p >= end) {
-
-            // See if we can read more.
-            auto resume_point = extend(p);
-
-            // If we couldn't get any more data, then finish with what we have.
-            if (resume_point == nullptr) {
-
-                // If we started a field, end it.
-                if (p > buf) {
-                    add_field(p);
-                }
-
-                return 0; // final null terminator indicates end of input.
-            } else {
-                p = resume_point;
+    void seek(uint64_t offset) {
+        fields.clear();
+        record_copied = false;
+        switch (source) {
+        case xsv_source::stream:
+            if (fseeko(*f, static_cast<off_t>(offset), SEEK_SET) != 0) {
+                throw std::runtime_error("Unable to seek in xsv file");
             }
-            end = buf + content_size;
+            exhausted = false;
+            p = end = buf;
+            break;
+        case xsv_source::memory:
+            p = buf + offset;
+            break;
+        case xsv_source::mapped:
+            p = mapping->begin() + offset;
+            break;
         }
-        return *p++;
     }
 
-    inline void add_field(char const * p) {
-#if 0
-        uint16_t fbegin = static_cast<uint16_t>(field_begin - buf);
-        uint16_t fend = static_cast<uint16_t>(p - field_begin);
-        fields.push_back(field_boundaries(fbegin, fend));
-#endif
+    void copy_record() {
+        if (!record_copied) {
+            auto const & last = fields.back();
+            scratch.assign(record, last.first + last.second);
+            scratch.push_back(0);
+            terminate_xsv_fields(&scratch[0], fields, record_has_quotes);
+            record_copied = true;
+        }
     }
 
+    char const * field_base() {
+        return record_copied ? scratch.data() : record;
+    }
 };
 
 xsv_reader::xsv_reader(xsv_reader && rhs): data(nullptr) {
@@ -139,10 +196,11 @@ xsv_reader::xsv_reader(xsv_reader && rhs): data(nullptr) {
 
 xsv_reader::xsv_reader(char * txt, char delim): data(nullptr) {
     precondition(txt);
-    precondition(delim);
-    data = new data_t(delim);
+    precondition(delim && delim != '"' && delim != '\r' && delim != '\n');
+    data = new data_t(delim, xsv_source::memory);
     data->buf = txt;
-    data->content_size = strlen(txt);
+    data->p = txt;
+    data->end = txt + strlen(txt);
 }
 
 xsv_reader::xsv_reader(std::string & txt, char delim) :
@@ -156,12 +214,74 @@ xsv_reader::xsv_reader(std::string & txt, char delim) :
     xsv_reader(const_cast<char *>(txt.data()), delim) {
 }
 
+xsv_reader::xsv_reader(c_file && file, char delim): data(nullptr) {
+    precondition(delim && delim != '"' && delim != '\r' && delim != '\n');
+    data = new data_t(delim, xsv_source::stream);
+    data->f = new c_file(std::move(file));
+}
+
+xsv_reader::xsv_reader(boost::filesystem::path const & path, char delim,
+        xsv_file_access access) : data(nullptr) {
+    precondition(delim && delim != '"' && delim != '\r' && delim != '\n');
+    if (access == xsv_file_access::memory_mapped) {
+        std::unique_ptr<mapped_file> mapping(new mapped_file(path,
+                mapped_file::access::read_only, map_hints::sequential));
+        data = new data_t(delim, xsv_source::mapped);
+        data->mapping = mapping.release();
+        data->p = data->mapping->begin();
+        data->end = data->mapping->end();
+    } else {
+        c_file f(path, "r");
+        if (!f) {
+            throw std::runtime_error("Unable to open " + path.string());
+        }
+        data = new data_t(delim, xsv_source::stream);
+        data->f = new c_file(std::move(f));
+    }
+}
+
+xsv_reader::~xsv_reader() {
+    delete data;
+}
+
 size_t xsv_reader::get_field_count() const {
     return data->fields.size();
 }
 
 char const * xsv_reader::get_field_by_index(size_t i) const {
-    return (i < data->fields.size()) ? data->buf + data->fields[i].first : nullptr;
+    if (i >= data->fields.size()) {
+        return nullptr;
+    }
+    if (data->source == xsv_source::mapped) {
+        data->copy_record();
+    }
+    return data->field_base() + data->fields[i].first;
+}
+
+str_view xsv_reader::get_field(size_t i) const {
+    if (i >= data->fields.size()) {
+        return str_view();
+    }
+    // Quoted fields in a mapping must be unescaped somewhere writable.
+    if (data->source == xsv_source::mapped && data->record_has_quotes) {
+        data->copy_record();
+    }
+    auto const & fb = data->fields[i];
+    return str_view(data->field_base() + fb.first, fb.second);
+}
+
+bool xsv_reader::next_record() {
+    return data->next_record();
+}
+
+void xsv_reader::seek(uint64_t offset) {
+    if (data->source == xsv_source::stream) {
+        precondition(data->f);
+    } else {
+        precondition(offset <= static_cast<uint64_t>(data->end - (data->source
+                == xsv_source::mapped ? data->mapping->begin() : data->buf)));
+    }
+    data->seek(offset);
 }
 
 xsv_reader & xsv_reader::operator =(xsv_reader && other) {
@@ -173,72 +293,240 @@ xsv_reader & xsv_reader::operator =(xsv_reader && other) {
     return *this;
 }
 
-#if 0
-bool xsv_reader::next_record() {
-    data->fields.clear();
-
-    char c;
-    bool more_fields = true;
-    bool in_quote = false;
-    uint16_t field_begin = 0;
-    char * p = data->buf;
-    //char * write_ptr = p;
-
-    for ( ; more_fields && (c = data->next_char() != 0); ++p, ++field_begin) {
-        char c = *p;
-        switch (c) {
-        case '\n':
-        case '\r':
-            more_fields = false;
+static constexpr size_t WRITE_BUFFER_SIZE = 1024 * 1024;
+// A buffered_writer sink does the heavy buffering; this just batches fields.
+static constexpr size_t STAGING_BUFFER_SIZE = 16 * 1024;
+
+enum class xsv_sink {
+    file,
+    fd,
+    string,
+    writer,
+};
+
+/**
+ * Does a field have to be quoted? Checks 64 bytes at a time.
+ */
+static bool needs_quoting(char const * p, size_t len, char delim) {
+    xsv_block_masks m;
+    for (size_t offset = 0; offset < len; offset += XSV_BLOCK_SIZE) {
+        classify_xsv_block(p + offset, len - offset, delim, m);
+        if (m.quotes | m.delims | m.eols) {
+            return true;
+        }
+    }
+    return false;
+}
+
+struct xsv_writer::data_t {
+    xsv_sink sink;
+    c_file * f;
+    int fd;
+    std::string * str;
+    buffered_writer * writer;
+    char * buf;
+    size_t capacity;
+    size_t used;
+    bool at_record_start;
+    char delim;
+
+    data_t(xsv_sink s, char c) : sink(s), f(nullptr), fd(-1), str(nullptr),
+            writer(nullptr), buf(nullptr), capacity(s == xsv_sink::writer
+            ? STAGING_BUFFER_SIZE : WRITE_BUFFER_SIZE), used(0),
+            at_record_start(true), delim(c) {
+        buf = reinterpret_cast<char *>(malloc(capacity));
+        if (!buf) {
+            throw std::bad_alloc();
+        }
+    }
+
+    ~data_t() {
+        free(buf);
+        delete f;
+    }
+
+    void drain(char const * p, size_t n) {
+        switch (sink) {
+        case xsv_sink::file:
+            if (fwrite(p, 1, n, *f) != n) {
+                throw std::runtime_error("Unable to write xsv data to file");
+            }
             break;
-        case '"':
-            if (!in_quote) {
-                ++field_begin;
-            } else {
+        case xsv_sink::fd:
+            while (n) {
+                ssize_t written = ::write(fd, p, n);
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw std::runtime_error(std::string(
+                            "Unable to write xsv data: ") + strerror(errno));
+                }
+                p += written;
+                n -= written;
             }
-            in_quote = !in_quote;
             break;
-        case
-        if (c == data->delim) {
-            *write_ptr = 0;
-            add_field(fields, field_begin, p);
-            field_begin += 2;
-        } else if (c == '\r' || c == '\n') {
-            *write_ptr = 0;
-            add_field(fields, field_begin, p);
-            ++field_begin;
-            if (c == '\r' && (c = next_char() == '\n')) {
-                ++field_begin;
+        case xsv_sink::string:
+            str->append(p, n);
+            break;
+        case xsv_sink::writer:
+            writer->write(p, n);
+            break;
+        }
+    }
+
+    void flush_buffer() {
+        if (used) {
+            // Reset first, so a throwing sink doesn't see the same bytes twice.
+            size_t n = used;
+            used = 0;
+            drain(buf, n);
+        }
+    }
+
+    inline char * reserve(size_t n) {
+        if (capacity - used < n) {
+            flush_buffer();
+        }
+        return buf + used;
+    }
+
+    inline void put(char c) {
+        *reserve(1) = c;
+        ++used;
+    }
+
+    inline void append(char const * p, size_t n) {
+        if (capacity - used < n) {
+            flush_buffer();
+            // Huge fields skip the buffer.
+            if (n >= capacity) {
+                drain(p, n);
+                return;
             }
-            data->shift();
+        }
+        memcpy(buf + used, p, n);
+        used += n;
+    }
+
+    inline void begin_field() {
+        if (at_record_start) {
+            at_record_start = false;
         } else {
-            if (write_ptr < p) {
-                *write_ptr = c;
-            }
+            put(delim);
         }
-            *write_ptr = 0;
-            add_field(fields, field_begin, p);
-            ++field_begin;
-            if (c == '\r' && (c = next_char() == '\n')) {
-                ++field_begin;
-            }
-            data->shift();
+    }
+
+    void write_text(char const * p, size_t len) {
+        begin_field();
+        if (!needs_quoting(p, len, delim)) {
+            append(p, len);
+            return;
+        }
+        put('"');
+        // Double each embedded quote, copying the spans between them whole.
+        char const * end = p + len;
+        while (char const * quote = static_cast<char const *>(memchr(p, '"', end - p))) {
+            append(p, quote + 1 - p);
+            put('"');
+            p = quote + 1;
         }
+        append(p, end - p);
+        put('"');
     }
-    return false;
+};
+
+xsv_writer::xsv_writer(c_file && file, char delim) : data(nullptr) {
+    precondition(delim && delim != '"' && delim != '\r' && delim != '\n');
+    data = new data_t(xsv_sink::file, delim);
+    data->f = new c_file(std::move(file));
 }
-#endif
 
-xsv_reader::xsv_reader(c_file && file, char delim) {
+xsv_writer::xsv_writer(int fd, char delim) : data(nullptr) {
+    precondition(fd >= 0);
+    precondition(delim && delim != '"' && delim != '\r' && delim != '\n');
+    data = new data_t(xsv_sink::fd, delim);
+    data->fd = fd;
 }
 
-xsv_reader::xsv_reader(boost::filesystem::path const & path, char delim) :
-    xsv_reader(c_file(path, "r"), delim) {
+xsv_writer::xsv_writer(std::string & out, char delim) : data(nullptr) {
+    precondition(delim && delim != '"' && delim != '\r' && delim != '\n');
+    data = new data_t(xsv_sink::string, delim);
+    data->str = &out;
 }
 
-xsv_reader::~xsv_reader() {
-    delete data;
+xsv_writer::xsv_writer(buffered_writer & out, char delim) : data(nullptr) {
+    precondition(delim && delim != '"' && delim != '\r' && delim != '\n');
+    data = new data_t(xsv_sink::writer, delim);
+    data->writer = &out;
 }
 
-}}} // end namespace
+xsv_writer::xsv_writer(xsv_writer && rhs) : data(nullptr) {
+    *this = std::move(rhs);
+}
+
+xsv_writer & xsv_writer::operator =(xsv_writer && other) {
+    if (this != &other) {
+        delete data;
+        data = other.data;
+        other.data = nullptr;
+    }
+    return *this;
+}
+
+xsv_writer::~xsv_writer() {
+    if (data) {
+        try {
+            flush();
+        } catch (...) {
+        }
+        delete data;
+    }
+}
+
+void xsv_writer::write_field(str_view const & txt) {
+    data->write_text(txt.begin, txt.length);
+}
 
+void xsv_writer::write_field(char const * txt) {
+    data->write_text(txt ? txt : "", txt ? strlen(txt) : 0);
+}
+
+void xsv_writer::write_field(long long n) {
+    data->begin_field();
+    char * p = data->reserve(MAX_FORMATTED_NUMBER_LEN);
+    data->used = format_int64(n, p) - data->buf;
+}
+
+void xsv_writer::write_field(unsigned long long n) {
+    data->begin_field();
+    char * p = data->reserve(MAX_FORMATTED_NUMBER_LEN);
+    data->used = format_uint64(n, p) - data->buf;
+}
+
+void xsv_writer::write_field(double d) {
+    data->begin_field();
+    char * p = data->reserve(MAX_FORMATTED_NUMBER_LEN);
+    data->used = format_double(d, p) - data->buf;
+}
+
+void xsv_writer::write_empty_field() {
+    data->begin_field();
+}
+
+void xsv_writer::end_record() {
+    data->put('\n');
+    data->at_record_start = true;
+}
+
+void xsv_writer::flush() {
+    data->flush_buffer();
+    if (data->sink == xsv_sink::file && fflush(*data->f) != 0) {
+        throw std::runtime_error("Unable to flush xsv data to file");
+    }
+    if (data->sink == xsv_sink::writer) {
+        data->writer->flush();
+    }
+}
+
+}}} // end namespace
@@ -1,19 +1,42 @@
 #ifndef _f8b95b7b70694c47bc20694ee3cee5fc
 #define _f8b95b7b70694c47bc20694ee3cee5fc
 
+#include <cstdint>
+#include <string>
+
+#include "core/text/str_view.h"
 #include "core/util/value_semantics.h"
 
-namespace boost { namespace filessytem { class path; }}
+namespace boost { namespace filesystem { class path; }}
 
 namespace intent {
 namespace core {
 
 namespace io {
+    class buffered_writer;
     class c_file;
 }
 
 namespace data {
 
+/**
+ * How an xsv_reader that opens a file gets at its bytes.
+ */
+enum class xsv_file_access {
+    /**
+     * Read through a growable buffer with fread(). Works on pipes and other
+     * files that can't be mapped; fields are null-terminated in the buffer.
+     */
+    buffered,
+    /**
+     * Map the whole file read-only and scan it where it lies. Nothing is
+     * copied or moved to find fields; a record is only copied if a caller
+     * asks for a null-terminated or unescaped field (see get_field_by_index).
+     * This is the fastest way to read a large regular file.
+     */
+    memory_mapped,
+};
+
 /**
  * Implement reading of comma-, tab-, and *-separated-values data.
  */
@@ -54,18 +77,132 @@ public:
      * Open an existing file and read its data.
      *
      * @param delim Which character delimits fields?
+     * @param access Whether to map the file or read it through a buffer.
+     * @throw std::runtime_error if the file can't be opened or mapped.
      */
-    xsv_reader(boost::filesystem::path const & file, char delim);
+    xsv_reader(boost::filesystem::path const & file, char delim,
+            xsv_file_access access = xsv_file_access::memory_mapped);
 
     ~xsv_reader();
 
     MOVEABLE_BUT_NOT_COPYABLE(xsv_reader);
 
     size_t get_field_count() const;
+
+    /**
+     * Get a null-terminated, unescaped field of the current record, or
+     * nullptr if i is out of range. In memory_mapped mode, the first call for
+     * a record copies that record into a scratch buffer.
+     */
     char const * get_field_by_index(size_t i) const;
+
+    /**
+     * Get a field of the current record without copying it. The view is
+     * not null-terminated in memory_mapped mode. It is null if i is out of
+     * range. Fields that contained quotes are unescaped first.
+     */
+    text::str_view get_field(size_t i) const;
+
+    /**
+     * Advance to the next record.
+     *
+     * @return false when input is exhausted.
+     * @throw std::runtime_error if a record exceeds the maximum record size
+     *     (1 MB).
+     */
     bool next_record();
+
+    /**
+     * Jump to the record that begins at a byte offset from the start of
+     * input, so that the next call to next_record() reads it. Offsets come
+     * from xsv_index.
+     *
+     * With char * or string input, records that have already been read were
+     * altered in place, so only seek forward.
+     *
+     * @throw std::runtime_error if a file can't seek (e.g., a pipe).
+     */
+    void seek(uint64_t offset);
 };
 
+/**
+ * Write comma-, tab-, and *-separated-values data.
+ *
+ * Fields are appended to a large reusable buffer, which is handed to the
+ * destination only when it fills (or on flush()), so the cost per field is a
+ * few memcpy's. A field is quoted only if it contains the delimiter, a quote,
+ * or a line break; that test runs 64 bytes at a time, using SIMD where
+ * available, and embedded quotes are doubled a span at a time. Numbers are
+ * formatted without printf (see core/text/format_numbers.h).
+ *
+ * Records end with "\n". Output can be read back by xsv_reader.
+ */
+class xsv_writer {
+    struct data_t;
+    data_t * data;
+
+public:
+    /**
+     * Write to a file that was fopen()'ed in write or append mode. The writer
+     * takes ownership of the file and closes it when done.
+     */
+    xsv_writer(intent::core::io::c_file && file, char delim);
+
+    /**
+     * Write to a file descriptor with write(). The descriptor is not owned.
+     */
+    xsv_writer(int fd, char delim);
+
+    /**
+     * Append to a string. The string is not owned.
+     */
+    xsv_writer(std::string & out, char delim);
+
+    /**
+     * Write through a buffered_writer, which is not owned. Use this to share
+     * one output buffer (and, optionally, its background flushing) with other
+     * producers; the xsv_writer then keeps only a small staging buffer.
+     * flush() flushes the buffered_writer too.
+     */
+    xsv_writer(intent::core::io::buffered_writer & out, char delim);
+
+    /**
+     * Flush. Errors are swallowed here; call flush() first to see them.
+     */
+    ~xsv_writer();
+
+    MOVEABLE_BUT_NOT_COPYABLE(xsv_writer);
+
+    /**
+     * Add a field to the current record. The delimiter is written
+     * automatically before every field but the first.
+     */
+    void write_field(text::str_view const & txt);
+    void write_field(char const * txt);
+    // One overload per builtin integer type, so no integer (int64_t, size_t,
+    // whatever they're typedefs of) is ambiguous.
+    void write_field(long long n);
+    void write_field(unsigned long long n);
+    void write_field(int n) { write_field(static_cast<long long>(n)); }
+    void write_field(unsigned n) { write_field(static_cast<unsigned long long>(n)); }
+    void write_field(long n) { write_field(static_cast<long long>(n)); }
+    void write_field(unsigned long n) { write_field(static_cast<unsigned long long>(n)); }
+    void write_field(double d);
+
+    /** Add an empty field. */
+    void write_empty_field();
+
+    /** Finish the current record. */
+    void end_record();
+
+    /**
+     * Hand everything buffered so far to the destination (and fflush() a
+     * c_file).
+     *
+     * @throw std::runtime_error if the destination reports an error.
+     */
+    void flush();
+};
 
 }}} // end namespace
 
@@ -0,0 +1,347 @@
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <strings.h>
+
+#include "core/util/dbc.h"
+#include "core/data/parallel_xsv.h"
+#include "core/data/xsv.h"
+#include "core/data/xsv_batch.h"
+#include "core/text/scan_numbers.h"
+
+using std::string;
+using std::vector;
+
+using intent::core::text::number_info;
+using intent::core::text::numeric_formats;
+using intent::core::text::scan_number;
+using intent::core::text::str_view;
+
+namespace intent {
+namespace core {
+namespace data {
+
+static inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * Check what scan_number() doesn't: that there is at least one digit, that
+ * a leading 0 isn't followed by another digit, that the value doesn't end in
+ * a dangling sign or exponent, and that there are too few whole digits for
+ * scan_number's uint64 accumulator to have wrapped.
+ */
+static bool plausible_number(char const * p, char const * end) {
+    if (p < end && (*p == '+' || *p == '-')) {
+        ++p;
+    }
+    if (end - p >= 2 && p[0] == '0' && is_digit(p[1])) {
+        return false;
+    }
+    unsigned whole_digits = 0;
+    bool any_digits = false;
+    char const * q = p;
+    for (; q < end && (is_digit(*q) || *q == '_'); ++q) {
+        whole_digits += (*q != '_');
+    }
+    any_digits = whole_digits > 0;
+    if (q < end && *q == '.') {
+        for (++q; q < end && (is_digit(*q) || *q == '_'); ++q) {
+            any_digits |= (*q != '_');
+        }
+    }
+    return any_digits && whole_digits <= 18 && (is_digit(end[-1]) || end[-1] == '.');
+}
+
+static bool to_int64(str_view v, int64_t & n) {
+    char const * end = v.end();
+    if (!plausible_number(v.begin, end)) {
+        return false;
+    }
+    number_info info;
+    if (scan_number(v.begin, end, numeric_formats::decimal, info) != end) {
+        return false;
+    }
+    n = static_cast<int64_t>(info.whole_number);
+    if (info.negative) {
+        n = -n;
+    }
+    return true;
+}
+
+static bool to_float64(str_view v, double & d) {
+    char const * end = v.end();
+    if (!plausible_number(v.begin, end)) {
+        return false;
+    }
+    number_info info;
+    if (scan_number(v.begin, end, numeric_formats::floating_point, info) != end) {
+        return false;
+    }
+    if (info.format == numeric_formats::floating_point_only) {
+        d = info.floating_point;
+    } else {
+        d = static_cast<double>(info.whole_number);
+        if (info.negative) {
+            d = -d;
+        }
+    }
+    return true;
+}
+
+static bool to_boolean(str_view v, bool & b) {
+    if (v.length == 4 && strncasecmp(v.begin, "true", 4) == 0) {
+        b = true;
+        return true;
+    }
+    if (v.length == 5 && strncasecmp(v.begin, "false", 5) == 0) {
+        b = false;
+        return true;
+    }
+    return false;
+}
+
+xsv_column::xsv_column() : type(xsv_column_type::text), valid(), bools(),
+        ints(), reals(), offsets(), chars(), rejected(0) {
+}
+
+str_view xsv_column::get_text(size_t row) const {
+    return str_view(chars.data() + offsets[row], offsets[row + 1] - offsets[row]);
+}
+
+xsv_batch::xsv_batch() : row_count(0), columns() {
+}
+
+namespace {
+
+/**
+ * Lets one batch reader sit on top of either kind of xsv reader.
+ */
+struct record_source {
+    virtual ~record_source() {}
+    virtual bool next_record() = 0;
+    virtual size_t get_field_count() const = 0;
+    virtual str_view get_field(size_t i) const = 0;
+};
+
+template <typename R>
+struct reader_source : public record_source {
+    R & reader;
+    explicit reader_source(R & r) : reader(r) {}
+    virtual bool next_record() { return reader.next_record(); }
+    virtual size_t get_field_count() const { return reader.get_field_count(); }
+    virtual str_view get_field(size_t i) const { return reader.get_field(i); }
+};
+
+struct candidate_types {
+    bool boolean;
+    bool int64;
+    bool float64;
+
+    candidate_types() : boolean(true), int64(true), float64(true) {}
+
+    void observe(str_view v) {
+        if (v.length == 0) {
+            return;
+        }
+        bool b;
+        int64_t n;
+        double d;
+        boolean = boolean && to_boolean(v, b);
+        int64 = int64 && to_int64(v, n);
+        float64 = float64 && to_float64(v, d);
+    }
+
+    xsv_column_type best(bool any_values) const {
+        if (!any_values) {
+            return xsv_column_type::text;
+        }
+        return boolean ? xsv_column_type::boolean
+            : int64 ? xsv_column_type::int64
+            : float64 ? xsv_column_type::float64
+            : xsv_column_type::text;
+    }
+};
+
+} // end anonymous namespace
+
+struct xsv_batch_reader::data_t {
+    std::unique_ptr<record_source> source;
+    vector<string> names;
+    vector<xsv_column_type> types;
+
+    // Records consumed while inferring types; handed out before any others.
+    vector<vector<string>> sample;
+    size_t sample_pos;
+
+    data_t(record_source * s) : source(s), names(), types(), sample(),
+            sample_pos(0) {
+    }
+
+    void start(bool has_header, size_t sample_size) {
+        size_t width = 0;
+        if (has_header && source->next_record()) {
+            width = source->get_field_count();
+            for (size_t i = 0; i < width; ++i) {
+                str_view v = source->get_field(i);
+                names.push_back(string(v.begin, v.length));
+            }
+        }
+        vector<candidate_types> candidates;
+        vector<bool> any_values;
+        while (sample.size() < sample_size && source->next_record()) {
+            size_t n = source->get_field_count();
+            if (n > candidates.size()) {
+                candidates.resize(n);
+                any_values.resize(n, false);
+            }
+            sample.push_back(vector<string>());
+            auto & row = sample.back();
+            row.reserve(n);
+            for (size_t i = 0; i < n; ++i) {
+                str_view v = source->get_field(i);
+                row.push_back(string(v.begin, v.length));
+                candidates[i].observe(v);
+                if (v.length) {
+                    any_values[i] = true;
+                }
+            }
+        }
+        width = std::max(width, candidates.size());
+        candidates.resize(width);
+        any_values.resize(width, false);
+        for (size_t i = 0; i < width; ++i) {
+            types.push_back(candidates[i].best(any_values[i]));
+        }
+    }
+
+    static void reset(xsv_column & col, xsv_column_type type, size_t max_rows) {
+        col.type = type;
+        col.rejected = 0;
+        col.valid.clear();
+        col.bools.clear();
+        col.ints.clear();
+        col.reals.clear();
+        col.offsets.clear();
+        col.chars.clear();
+        col.valid.reserve(max_rows);
+        switch (type) {
+        case xsv_column_type::boolean: col.bools.reserve(max_rows); break;
+        case xsv_column_type::int64: col.ints.reserve(max_rows); break;
+        case xsv_column_type::float64: col.reals.reserve(max_rows); break;
+        case xsv_column_type::text:
+            col.offsets.reserve(max_rows + 1);
+            col.offsets.push_back(0);
+            break;
+        }
+    }
+
+    static void append(xsv_column & col, str_view v) {
+        bool ok = true;
+        switch (col.type) {
+        case xsv_column_type::boolean: {
+            bool b = false;
+            ok = v.length && to_boolean(v, b);
+            col.bools.push_back(ok && b);
+            break;
+        }
+        case xsv_column_type::int64: {
+            int64_t n = 0;
+            ok = v.length && to_int64(v, n);
+            col.ints.push_back(ok ? n : 0);
+            break;
+        }
+        case xsv_column_type::float64: {
+            double d = 0;
+            ok = v.length && to_float64(v, d);
+            col.reals.push_back(ok ? d : 0);
+            break;
+        }
+        case xsv_column_type::text:
+            col.chars.append(v.begin, v.length);
+            col.offsets.push_back(col.chars.size());
+            break;
+        }
+        if (!ok && v.length) {
+            ++col.rejected;
+        }
+        col.valid.push_back(ok);
+    }
+
+    size_t next_batch(xsv_batch & batch, size_t max_rows) {
+        batch.columns.resize(types.size());
+        for (size_t i = 0; i < types.size(); ++i) {
+            reset(batch.columns[i], types[i], max_rows);
+        }
+        size_t rows = 0;
+        for (; rows < max_rows && sample_pos < sample.size(); ++rows) {
+            auto & row = sample[sample_pos++];
+            for (size_t i = 0; i < types.size(); ++i) {
+                append(batch.columns[i], i < row.size() ? str_view(row[i]) : str_view("", size_t(0)));
+            }
+        }
+        if (sample_pos == sample.size() && !sample.empty()) {
+            vector<vector<string>>().swap(sample);
+            sample_pos = 0;
+        }
+        for (; rows < max_rows && source->next_record(); ++rows) {
+            size_t n = source->get_field_count();
+            for (size_t i = 0; i < types.size(); ++i) {
+                append(batch.columns[i], i < n ? source->get_field(i) : str_view("", size_t(0)));
+            }
+        }
+        batch.row_count = rows;
+        return rows;
+    }
+};
+
+xsv_batch_reader::xsv_batch_reader(xsv_reader & reader, bool has_header,
+        size_t sample_size) : data(nullptr) {
+    std::unique_ptr<data_t> d(new data_t(new reader_source<xsv_reader>(reader)));
+    d->start(has_header, sample_size);
+    data = d.release();
+}
+
+xsv_batch_reader::xsv_batch_reader(parallel_xsv_reader & reader, bool has_header,
+        size_t sample_size) : data(nullptr) {
+    std::unique_ptr<data_t> d(new data_t(new reader_source<parallel_xsv_reader>(reader)));
+    d->start(has_header, sample_size);
+    data = d.release();
+}
+
+xsv_batch_reader::xsv_batch_reader(xsv_batch_reader && rhs) : data(nullptr) {
+    *this = std::move(rhs);
+}
+
+xsv_batch_reader & xsv_batch_reader::operator =(xsv_batch_reader && other) {
+    if (this != &other) {
+        delete data;
+        data = other.data;
+        other.data = nullptr;
+    }
+    return *this;
+}
+
+xsv_batch_reader::~xsv_batch_reader() {
+    delete data;
+}
+
+size_t xsv_batch_reader::get_column_count() const {
+    return data->types.size();
+}
+
+vector<string> const & xsv_batch_reader::get_column_names() const {
+    return data->names;
+}
+
+xsv_column_type xsv_batch_reader::get_column_type(size_t i) const {
+    precondition(i < data->types.size());
+    return data->types[i];
+}
+
+size_t xsv_batch_reader::next_batch(xsv_batch & batch, size_t max_rows) {
+    precondition(max_rows > 0);
+    return data->next_batch(batch, max_rows);
+}
+
+}}} // end namespace
@@ -0,0 +1,119 @@
+#ifndef _54898693bec34414841f3ccac3ceb58f
+#define _54898693bec34414841f3ccac3ceb58f
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "core/text/str_view.h"
+#include "core/util/value_semantics.h"
+
+namespace intent {
+namespace core {
+namespace data {
+
+class xsv_reader;
+class parallel_xsv_reader;
+
+enum class xsv_column_type {
+    boolean,
+    int64,
+    float64,
+    text,
+};
+
+/**
+ * One column of an xsv_batch. Only the value vector that matches type is
+ * populated; each has one entry per row.
+ */
+struct xsv_column {
+    xsv_column_type type;
+
+    /**
+     * 1 if the row's cell held a value of the column's type; 0 if it was
+     * empty or didn't convert. (The value slot then holds 0, false, or "".)
+     * Text cells are always valid.
+     */
+    std::vector<uint8_t> valid;
+
+    std::vector<uint8_t> bools;
+    std::vector<int64_t> ints;
+    std::vector<double> reals;
+
+    /** Text of row i is chars[offsets[i], offsets[i + 1]). */
+    std::vector<size_t> offsets;
+    std::string chars;
+
+    /** How many non-empty cells in this batch failed to convert. */
+    size_t rejected;
+
+    xsv_column();
+
+    text::str_view get_text(size_t row) const;
+};
+
+/**
+ * A run of records, stored column by column.
+ */
+struct xsv_batch {
+    size_t row_count;
+    std::vector<xsv_column> columns;
+
+    xsv_batch();
+};
+
+/**
+ * Pull records from an xsv_reader or a parallel_xsv_reader and hand them
+ * out in columnar batches, with typed columns.
+ *
+ * Column types are inferred once, from the first sample_size records: a
+ * column is boolean if every non-empty sample cell is "true" or "false"
+ * (in any case), int64 if every one is a decimal whole number that fits,
+ * float64 if every one is a decimal or floating-point number, and text
+ * otherwise. Numbers are converted with text::scan_number(), so digit
+ * grouping with '_' is allowed; a leading 0 followed by more digits makes a
+ * value text (as with zip codes), not octal.
+ *
+ * The number of columns is the widest record in the sample (or the header).
+ * Later records with fewer fields get invalid cells; extra fields are
+ * dropped.
+ */
+class xsv_batch_reader {
+    struct data_t;
+    data_t * data;
+
+public:
+    /**
+     * Read the header (if any) and the sample. The reader must outlive this
+     * object, and should not be advanced by anyone else.
+     *
+     * @param has_header If true, the first record names the columns.
+     * @throw std::runtime_error if the reader throws.
+     */
+    xsv_batch_reader(xsv_reader & reader, bool has_header = false,
+            size_t sample_size = 1024);
+    xsv_batch_reader(parallel_xsv_reader & reader, bool has_header = false,
+            size_t sample_size = 1024);
+    ~xsv_batch_reader();
+
+    MOVEABLE_BUT_NOT_COPYABLE(xsv_batch_reader);
+
+    size_t get_column_count() const;
+
+    /** Column names from the header; empty if there was no header. */
+    std::vector<std::string> const & get_column_names() const;
+
+    xsv_column_type get_column_type(size_t i) const;
+
+    /**
+     * Fill batch with up to max_rows records. The batch's buffers are reused,
+     * so keeping one batch for a whole read avoids most allocation.
+     *
+     * @return Number of rows in the batch; 0 when input is exhausted.
+     */
+    size_t next_batch(xsv_batch & batch, size_t max_rows);
+};
+
+}}} // end namespace
+
+#endif // sentry
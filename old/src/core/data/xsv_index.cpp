@@ -0,0 +1,323 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "core/util/dbc.h"
+#include "core/io/ioutil.h"
+#include "core/io/mapped_file.h"
+#include "core/data/xsv.h"
+#include "core/data/xsv_index.h"
+#include "core/data/.private/xsv_chunks.h"
+#include "core/data/.private/xsv_scan.h"
+
+using std::vector;
+
+using intent::core::io::c_file;
+using intent::core::io::map_hints;
+using intent::core::io::mapped_file;
+
+namespace intent {
+namespace core {
+namespace data {
+
+constexpr unsigned xsv_index::DEFAULT_STRIDE;
+
+namespace {
+
+struct index_sample {
+    uint64_t record;
+    uint64_t offset;
+};
+
+static char const SIDECAR_MAGIC[8] = { 'X', 'S', 'V', 'I', 'D', 'X', '0', '1' };
+
+struct sidecar_header {
+    char magic[8];
+    uint64_t file_size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t record_count;
+    uint64_t sample_count;
+    uint32_t stride;
+    uint8_t delim;
+    uint8_t reserved[3];
+};
+
+/**
+ * What identifies a version of the data file.
+ */
+struct file_stamp {
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+
+    explicit file_stamp(filesystem::path const & path) {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) {
+            throw std::runtime_error("Unable to stat " + path.string());
+        }
+        size = static_cast<uint64_t>(info.st_size);
+        mtime_sec = info.st_mtime;
+#if defined(__APPLE__)
+        mtime_nsec = info.st_mtimespec.tv_nsec;
+#else
+        mtime_nsec = info.st_mtim.tv_nsec;
+#endif
+    }
+};
+
+/**
+ * Offset of the record after the one that begins at offset; size if none.
+ * Unlike scan_xsv_record(), this has no record size limit, and collects no
+ * fields.
+ */
+size_t next_record_start(char const * base, size_t size, size_t offset,
+        char delim) {
+    char const * end = base + size;
+    uint64_t carry = 0;
+    xsv_block_masks m;
+    for (size_t block = offset; block < size; block += XSV_BLOCK_SIZE) {
+        classify_xsv_block(base + block, size - block, delim, m);
+        uint64_t inside = prefix_xor(m.quotes) ^ carry;
+        carry = static_cast<uint64_t>(static_cast<int64_t>(inside) >> 63);
+        uint64_t breaks = m.eols & ~inside;
+        if (breaks) {
+            return xsv_record_after_break(base, end, block + lowest_bit_index(breaks));
+        }
+    }
+    return size;
+}
+
+/**
+ * Count the records that begin in a range, sampling every stride'th one.
+ * Sample record numbers are relative to the range.
+ */
+uint64_t index_range(char const * base, size_t size, xsv_chunk_range const & r,
+        char delim, unsigned stride, vector<index_sample> & samples) {
+    if (r.begin >= r.limit) {
+        return 0;
+    }
+    char const * end = base + size;
+    uint64_t count = 0;
+    auto note = [&](size_t offset) {
+        if (count % stride == 0) {
+            samples.push_back(index_sample{count, offset});
+        }
+        ++count;
+    };
+    note(r.begin);
+    uint64_t carry = 0;
+    xsv_block_masks m;
+    for (size_t block = r.begin; block < r.limit; block += XSV_BLOCK_SIZE) {
+        classify_xsv_block(base + block, r.limit - block, delim, m);
+        uint64_t inside = prefix_xor(m.quotes) ^ carry;
+        carry = static_cast<uint64_t>(static_cast<int64_t>(inside) >> 63);
+        uint64_t breaks = m.eols & ~inside;
+        while (breaks) {
+            size_t pos = block + lowest_bit_index(breaks);
+            breaks &= breaks - 1;
+            // The \n of \r\n was accounted for with the \r.
+            if (base[pos] == '\n' && pos > 0 && base[pos - 1] == '\r') {
+                continue;
+            }
+            size_t after = xsv_record_after_break(base, end, pos);
+            if (after < r.limit) {
+                note(after);
+            }
+        }
+    }
+    return count;
+}
+
+} // end anonymous namespace
+
+struct xsv_index::data_t {
+    std::unique_ptr<mapped_file> mapping;
+    char delim;
+    unsigned stride;
+    uint64_t record_count;
+    vector<index_sample> samples;
+    bool loaded;
+
+    data_t(char c, unsigned s) : mapping(), delim(c), stride(s),
+            record_count(0), samples(), loaded(false) {
+    }
+
+    bool load(filesystem::path const & sidecar, file_stamp const & stamp) {
+        c_file f(sidecar, "rb");
+        if (!f) {
+            return false;
+        }
+        sidecar_header h;
+        if (fread(&h, sizeof(h), 1, f) != 1
+                || memcmp(h.magic, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC)) != 0
+                || h.file_size != stamp.size
+                || h.mtime_sec != stamp.mtime_sec
+                || h.mtime_nsec != stamp.mtime_nsec
+                || h.delim != static_cast<uint8_t>(delim)
+                || h.stride == 0
+                || h.sample_count > h.record_count + 1
+                || h.sample_count > h.file_size) {
+            return false;
+        }
+        vector<index_sample> s(h.sample_count);
+        if (h.sample_count && fread(&s[0], sizeof(index_sample), s.size(), f) != s.size()) {
+            return false;
+        }
+        // A damaged (or hand-edited) sidecar can pass the checks above;
+        // lookups rely on the samples starting at record 0 and climbing.
+        if ((h.record_count == 0) != s.empty()) {
+            return false;
+        }
+        for (size_t i = 0; i < s.size(); ++i) {
+            if (s[i].record >= h.record_count || s[i].offset >= h.file_size
+                    || (i == 0 ? s[i].record != 0 :
+                        s[i].record <= s[i - 1].record || s[i].offset <= s[i - 1].offset)) {
+                return false;
+            }
+        }
+        stride = h.stride;
+        record_count = h.record_count;
+        samples.swap(s);
+        return true;
+    }
+
+    void build(unsigned thread_count) {
+        char const * base = mapping->begin();
+        size_t size = mapping->size();
+        // Each chunk is read front to back once; lookups afterward hop around.
+        mapping->advise(map_hints::sequential);
+        thread_count = choose_xsv_thread_count(thread_count);
+        auto ranges = split_xsv_chunks(base, base + size, delim,
+                choose_xsv_chunk_size(size, thread_count), thread_count);
+        vector<vector<index_sample>> chunk_samples(ranges.size());
+        vector<uint64_t> chunk_counts(ranges.size());
+        for_each_xsv_chunk(ranges.size(), thread_count, [&](size_t i) {
+            chunk_counts[i] = index_range(base, size, ranges[i], delim, stride,
+                    chunk_samples[i]);
+        });
+        mapping->advise(map_hints::random);
+        record_count = 0;
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            for (auto const & s : chunk_samples[i]) {
+                samples.push_back(index_sample{record_count + s.record, s.offset});
+            }
+            record_count += chunk_counts[i];
+        }
+    }
+
+    void save(filesystem::path const & sidecar, file_stamp const & stamp) {
+        // Write a temp file and rename it, so readers never see a partial
+        // index, and concurrent builders don't collide.
+        filesystem::path tmp;
+        try {
+            tmp = filesystem::unique_path(sidecar.string() + ".%%%%-%%%%");
+            {
+                c_file f(tmp, "wb");
+                if (!f) {
+                    return;
+                }
+                sidecar_header h;
+                memset(&h, 0, sizeof(h));
+                memcpy(h.magic, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC));
+                h.file_size = stamp.size;
+                h.mtime_sec = stamp.mtime_sec;
+                h.mtime_nsec = stamp.mtime_nsec;
+                h.record_count = record_count;
+                h.sample_count = samples.size();
+                h.stride = stride;
+                h.delim = static_cast<uint8_t>(delim);
+                bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+                if (ok && !samples.empty()) {
+                    ok = fwrite(&samples[0], sizeof(index_sample), samples.size(), f)
+                            == samples.size();
+                }
+                if (!ok || fflush(f) != 0) {
+                    throw std::runtime_error("short write");
+                }
+            }
+            filesystem::rename(tmp, sidecar);
+        } catch (...) {
+            // An index we can't persist is still an index.
+            boost::system::error_code ignored;
+            if (!tmp.empty()) {
+                filesystem::remove(tmp, ignored);
+            }
+        }
+    }
+};
+
+xsv_index::xsv_index(filesystem::path const & file, char delim,
+        unsigned stride, unsigned thread_count) : data(nullptr) {
+    precondition(delim && delim != '"' && delim != '\r' && delim != '\n');
+    precondition(stride > 0);
+    std::unique_ptr<data_t> d(new data_t(delim, stride));
+    d->mapping.reset(new mapped_file(file, mapped_file::access::read_only,
+            map_hints::random));
+    file_stamp stamp(file);
+    auto sidecar = get_sidecar_path(file);
+    if (stamp.size == d->mapping->size() && d->load(sidecar, stamp)) {
+        d->loaded = true;
+    } else {
+        d->build(thread_count);
+        d->save(sidecar, stamp);
+    }
+    data = d.release();
+}
+
+xsv_index::xsv_index(xsv_index && rhs) : data(nullptr) {
+    *this = std::move(rhs);
+}
+
+xsv_index & xsv_index::operator =(xsv_index && other) {
+    if (this != &other) {
+        delete data;
+        data = other.data;
+        other.data = nullptr;
+    }
+    return *this;
+}
+
+xsv_index::~xsv_index() {
+    delete data;
+}
+
+uint64_t xsv_index::get_record_count() const {
+    return data->record_count;
+}
+
+uint64_t xsv_index::get_record_offset(uint64_t n) const {
+    precondition(n <= data->record_count);
+    size_t size = data->mapping->size();
+    if (n == data->record_count) {
+        return size;
+    }
+    // Last sample at or before n.
+    auto it = std::upper_bound(data->samples.begin(), data->samples.end(), n,
+            [](uint64_t record, index_sample const & s) { return record < s.record; });
+    --it;
+    size_t offset = it->offset;
+    for (uint64_t i = it->record; i < n; ++i) {
+        offset = next_record_start(data->mapping->begin(), size, offset, data->delim);
+    }
+    return offset;
+}
+
+void xsv_index::seek(xsv_reader & reader, uint64_t n) const {
+    reader.seek(get_record_offset(n));
+}
+
+bool xsv_index::was_loaded() const {
+    return data->loaded;
+}
+
+filesystem::path xsv_index::get_sidecar_path(filesystem::path const & file) {
+    return filesystem::path(file.string() + ".xsvidx");
+}
+
+}}} // end namespace
@@ -0,0 +1,83 @@
+#ifndef _faacebeb32e441308e8c5c7468f7efaf
+#define _faacebeb32e441308e8c5c7468f7efaf
+
+#include <cstdint>
+
+#include "core/filesystem.h"
+#include "core/util/value_semantics.h"
+
+namespace intent {
+namespace core {
+namespace data {
+
+class xsv_reader;
+
+/**
+ * A random-access index of the records in an xsv file.
+ *
+ * The index samples the byte offset of at least every stride'th record, so
+ * finding record N means a binary search plus a scan over at most stride
+ * records, instead of a scan from the start of the file. The record count is
+ * stored, so it costs nothing.
+ *
+ * The index is built in one parallel pass over a mapping of the file (using
+ * the same quote-aware chunking as parallel_xsv_reader), then persisted in a
+ * sidecar file next to the data (see get_sidecar_path()). Later opens load
+ * the sidecar instead, as long as the data file's size and modification time
+ * still match and it was built for the same delimiter; otherwise it is
+ * rebuilt. If the sidecar can't be written (e.g., a read-only directory), the
+ * index still works; it just isn't reused.
+ *
+ * The sidecar is in native byte order; it is a cache, not an interchange
+ * format.
+ *
+ * Usage:
+ *
+ *     xsv_index idx(path, ',');
+ *     xsv_reader reader(path, ',');
+ *     idx.seek(reader, 10 * 1000 * 1000);
+ *     for (int i = 0; i < 50 && reader.next_record(); ++i) { ... }
+ */
+class xsv_index {
+    struct data_t;
+    data_t * data;
+
+public:
+    static constexpr unsigned DEFAULT_STRIDE = 1024;
+
+    /**
+     * Load or build the index for a file.
+     *
+     * @param stride Sample spacing for a newly built index.
+     * @param thread_count Threads to build with; 0 means one per core.
+     * @throw std::runtime_error if the file can't be opened or mapped.
+     */
+    xsv_index(filesystem::path const & file, char delim,
+            unsigned stride = DEFAULT_STRIDE, unsigned thread_count = 0);
+    ~xsv_index();
+
+    MOVEABLE_BUT_NOT_COPYABLE(xsv_index);
+
+    uint64_t get_record_count() const;
+
+    /**
+     * Byte offset at which record n begins. Record get_record_count() is
+     * allowed, and begins at the end of the file.
+     */
+    uint64_t get_record_offset(uint64_t n) const;
+
+    /**
+     * Position a reader of the same file so its next record is record n.
+     */
+    void seek(xsv_reader & reader, uint64_t n) const;
+
+    /** True if the index came from an up-to-date sidecar. */
+    bool was_loaded() const;
+
+    /** Where the index for file is persisted: file + ".xsvidx". */
+    static filesystem::path get_sidecar_path(filesystem::path const & file);
+};
+
+}}} // end namespace
+
+#endif // sentry
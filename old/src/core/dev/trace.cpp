@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+
+#include "core/dev/trace.h"
+
+
+using std::atomic;
+using std::lock_guard;
+using std::memory_order_acquire;
+using std::memory_order_relaxed;
+using std::memory_order_release;
+using std::mutex;
+
+
+namespace intent {
+namespace core {
+namespace dev {
+
+
+namespace {
+
+/**
+ * One thread's events. Only that thread writes; anyone may read. Every word
+ * is atomic, so a reader can copy a slot while it is being overwritten; the
+ * slot's sequence number tells it whether the copy is whole (a seqlock).
+ */
+struct ring {
+    struct slot {
+        // 2n+1 while event n is being written, 2n+2 once it is.
+        atomic<uint64_t> seq;
+        atomic<uint64_t> words[6];
+    };
+
+    uint32_t thread; // +<guarded_by(registry::mtx)
+    atomic<uint64_t> written;
+    atomic<uint64_t> cleared; // events before this are forgotten
+    atomic<bool> in_use;
+    slot slots[tracer::ring_size];
+
+    ring() : thread(0), written(0), cleared(0), in_use(true) {
+        for (auto & s : slots) {
+            s.seq.store(0, memory_order_relaxed);
+        }
+    }
+};
+
+
+struct registry {
+    mutex mtx;
+    std::vector<std::unique_ptr<ring>> rings; // +<guarded_by(mtx); never shrinks
+    uint32_t next_thread; // +<guarded_by(mtx)
+
+    registry() : mtx(), rings(), next_thread(1) {}
+};
+
+
+// Never destroyed; threads may still record while statics are torn down.
+registry & get_registry() {
+    static registry * the_registry = new registry();
+    return *the_registry;
+}
+
+
+ring * adopt_ring() {
+    auto & reg = get_registry();
+    lock_guard<mutex> lock(reg.mtx);
+    ring * r = nullptr;
+    for (auto & x : reg.rings) {
+        if (!x->in_use.load()) {
+            r = x.get();
+            r->in_use.store(true);
+            break;
+        }
+    }
+    if (!r) {
+        reg.rings.emplace_back(new ring());
+        r = reg.rings.back().get();
+    }
+    r->thread = reg.next_thread++;
+    return r;
+}
+
+
+struct ring_holder {
+    ring * r;
+    ring_holder() : r(adopt_ring()) {}
+    ~ring_holder() { r->in_use.store(false); }
+};
+
+
+ring & get_my_ring() {
+    static thread_local ring_holder holder;
+    return *holder.r;
+}
+
+
+atomic<trace_level> & get_threshold() {
+    static atomic<trace_level> the_threshold(trace_level::info);
+    return the_threshold;
+}
+
+
+int64_t now_nanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // end anonymous namespace
+
+
+constexpr unsigned tracer::ring_size;
+
+
+void tracer::set_level(trace_level level) {
+    get_threshold().store(level);
+}
+
+
+trace_level tracer::get_level() {
+    return get_threshold().load(memory_order_relaxed);
+}
+
+
+bool tracer::is_enabled(trace_level level) {
+    return level != trace_level::off &&
+            level >= get_threshold().load(memory_order_relaxed);
+}
+
+
+void tracer::record(trace_point const & point, uint32_t subject, uint64_t a,
+        uint64_t b, uint64_t c) {
+    auto & r = get_my_ring();
+    auto n = r.written.load(memory_order_relaxed);
+    auto & s = r.slots[n % ring_size];
+    s.seq.store(2 * n + 1, memory_order_relaxed);
+    std::atomic_thread_fence(memory_order_release);
+    s.words[0].store(static_cast<uint64_t>(now_nanos()), memory_order_relaxed);
+    s.words[1].store(static_cast<uint64_t>(r.thread) << 32 | subject, memory_order_relaxed);
+    s.words[2].store(reinterpret_cast<uintptr_t>(&point), memory_order_relaxed);
+    s.words[3].store(a, memory_order_relaxed);
+    s.words[4].store(b, memory_order_relaxed);
+    s.words[5].store(c, memory_order_relaxed);
+    s.seq.store(2 * n + 2, memory_order_release);
+    r.written.store(n + 1, memory_order_release);
+}
+
+
+std::vector<trace_record> tracer::snapshot() {
+    std::vector<trace_record> records;
+    auto & reg = get_registry();
+    lock_guard<mutex> lock(reg.mtx);
+    for (auto & x : reg.rings) {
+        auto & r = *x;
+        auto end = r.written.load(memory_order_acquire);
+        auto begin = std::max(end > ring_size ? end - ring_size : 0,
+                r.cleared.load(memory_order_relaxed));
+        for (auto n = begin; n < end; ++n) {
+            auto & s = r.slots[n % ring_size];
+            auto seq = s.seq.load(memory_order_acquire);
+            if (seq != 2 * n + 2) {
+                // Overwritten since we looked at the count.
+                continue;
+            }
+            uint64_t words[6];
+            for (int i = 0; i < 6; ++i) {
+                words[i] = s.words[i].load(memory_order_relaxed);
+            }
+            std::atomic_thread_fence(memory_order_acquire);
+            if (s.seq.load(memory_order_relaxed) != seq) {
+                continue;
+            }
+            trace_record rec;
+            rec.nanos = static_cast<int64_t>(words[0]);
+            rec.thread = static_cast<uint32_t>(words[1] >> 32);
+            rec.subject = static_cast<uint32_t>(words[1]);
+            rec.point = reinterpret_cast<trace_point const *>(static_cast<uintptr_t>(words[2]));
+            rec.args[0] = words[3];
+            rec.args[1] = words[4];
+            rec.args[2] = words[5];
+            records.push_back(rec);
+        }
+    }
+    std::stable_sort(records.begin(), records.end(),
+            [](trace_record const & a, trace_record const & b) { return a.nanos < b.nanos; });
+    return records;
+}
+
+
+void tracer::dump(std::ostream & out) {
+    auto records = snapshot();
+    if (records.empty()) {
+        return;
+    }
+    auto start = records.front().nanos;
+    for (auto & rec : records) {
+        out << '+' << (rec.nanos - start) / 1000 << "us t" << rec.thread << ' '
+                << rec.to_string() << '\n';
+    }
+}
+
+
+void tracer::clear() {
+    auto & reg = get_registry();
+    lock_guard<mutex> lock(reg.mtx);
+    for (auto & x : reg.rings) {
+        x->cleared.store(x->written.load());
+    }
+}
+
+
+std::string trace_record::to_string() const {
+    std::string txt = point->name;
+    if (subject) {
+        txt += " #";
+        txt += std::to_string(subject);
+    }
+    auto fmt = point->format;
+    if (!fmt || !*fmt) {
+        return txt;
+    }
+    txt += ": ";
+    for (auto p = fmt; *p; ++p) {
+        if (p[0] == '{' && p[1] >= '1' && p[1] <= '3' && p[2] == '}') {
+            txt += std::to_string(args[p[1] - '1']);
+            p += 2;
+        } else {
+            txt += *p;
+        }
+    }
+    return txt;
+}
+
+
+}}} // end namespace
@@ -0,0 +1,129 @@
+#ifndef _4a8e2f61c0d94b7fa35e9b0c6d2718e4
+#define _4a8e2f61c0d94b7fa35e9b0c6d2718e4
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "core/marks/concurrency_marks.h"
+
+
+/**
+ * Trace points below this level are compiled out. Define it on the command
+ * line (0=debug ... 4=off) to trim a release build.
+ */
+#ifndef INTENT_TRACE_MIN_LEVEL
+#define INTENT_TRACE_MIN_LEVEL 0
+#endif
+
+
+namespace intent {
+namespace core {
+namespace dev {
+
+
+enum class trace_level : uint8_t {
+    debug,
+    info,
+    warn,
+    error,
+    off
+};
+
+
+/**
+ * A kind of event. Define each one once, with static storage; events record
+ * only its address, and look up the rest when they are dumped.
+ *
+ *     static constexpr dev::trace_point sending = {
+ *             "session.send", "url is {1} bytes long", dev::trace_level::info};
+ *
+ * {1}, {2} and {3} in the format stand for the event's numeric args.
+ */
+struct trace_point {
+    char const * name;
+    char const * format;
+    trace_level level;
+};
+
+
+/**
+ * One event, as read back from the buffers.
+ */
+struct trace_record {
+    /** Steady-clock time it happened. */
+    int64_t nanos;
+    /** Small number for the thread that recorded it, in order of first use. */
+    uint32_t thread;
+    /** What it was about; for instance, a session id. */
+    uint32_t subject;
+    trace_point const * point;
+    uint64_t args[3];
+
+    /** Like "session.send #3: url is 20 bytes long". */
+    std::string to_string() const;
+};
+
+
+/**
+ * Record events cheaply, so they can be left on in production code.
+ *
+ * Each thread writes binary events into its own fixed-size ring, with no
+ * locks and no formatting; once a ring is full, the oldest events give way.
+ * Text is only made when someone asks for a dump. A thread's ring outlives
+ * the thread, and is handed on to the next new thread, so what a pool thread
+ * recorded before exiting can still be dumped.
+ */
+mark(+, threadsafe)
+class tracer {
+public:
+    /** Events each thread keeps. */
+    static constexpr unsigned ring_size = 1024;
+
+    /** Only events at or above this level are recorded. Default: info. */
+    static void set_level(trace_level);
+    static trace_level get_level();
+    static bool is_enabled(trace_level);
+
+    static void record(trace_point const &, uint32_t subject, uint64_t a = 0,
+            uint64_t b = 0, uint64_t c = 0);
+
+    /** What all threads have recorded, oldest first. */
+    static std::vector<trace_record> snapshot();
+
+    /** Write a snapshot as text, one event per line. */
+    static void dump(std::ostream &);
+
+    /** Forget everything recorded so far. */
+    static void clear();
+};
+
+
+}}} // end namespace
+
+
+// Whether events at a level are compiled in. With nothing trimmed, the
+// comparison would be against 0, which -Wtype-limits calls always true.
+#if INTENT_TRACE_MIN_LEVEL > 0
+#define intent_trace_compiled_in(level) \
+    (static_cast<int>(level) >= INTENT_TRACE_MIN_LEVEL)
+#else
+#define intent_trace_compiled_in(level) true
+#endif
+
+
+/**
+ * Record an event if its level is compiled in and switched on. Arguments
+ * aren't evaluated otherwise.
+ */
+#define trace_event(point, subject, ...) \
+    do { \
+        if (intent_trace_compiled_in((point).level) && \
+                ::intent::core::dev::tracer::is_enabled((point).level)) { \
+            ::intent::core::dev::tracer::record((point), (subject), ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+
+#endif // sentry
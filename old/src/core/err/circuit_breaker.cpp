@@ -0,0 +1,156 @@
+#include <algorithm>
+
+#include "core/err/circuit_breaker.h"
+#include "core/util/dbc.h"
+
+using std::lock_guard;
+using std::mutex;
+
+namespace intent {
+namespace core {
+namespace err {
+
+static constexpr int64_t ns_per_ms = 1000000;
+
+circuit_breaker::config::config() : window_millisecs(10000), window_slices(10),
+        failure_ratio(0.5), min_calls(20), open_millisecs(5000),
+        retest_calls(1) {
+}
+
+circuit_breaker::circuit_breaker(state initial_state) :
+        circuit_breaker(config(), initial_state) {
+}
+
+circuit_breaker::circuit_breaker(config const & c, state initial_state) :
+        cfg(c), current(state::closed), retest_at(0), retest_permits(0), mtx(),
+        slices(std::max(1u, c.window_slices), slice{-1, 0, 0}),
+        retest_successes(0) {
+    precondition(c.window_millisecs > 0);
+    precondition(c.failure_ratio > 0 && c.failure_ratio <= 1);
+    precondition(c.retest_calls > 0);
+    switch (initial_state) {
+    case state::open:
+        open_prelocked(time::now());
+        break;
+    case state::needs_retest:
+        begin_retest_prelocked();
+        break;
+    default:
+        break;
+    }
+}
+
+int64_t circuit_breaker::ticks(time::time_point t) const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            t.time_since_epoch()).count();
+}
+
+circuit_breaker::state circuit_breaker::get_state() const {
+    auto s = current.load();
+    if (s == state::open && ticks(time::now()) >= retest_at.load()) {
+        return state::needs_retest;
+    }
+    return s;
+}
+
+bool circuit_breaker::allow() {
+    auto s = current.load();
+    if (s == state::closed) {
+        return true;
+    }
+    // Time to (re)issue permits to test the circuit? When retesting, this
+    // also covers callers that took a permit and never reported back.
+    if (ticks(time::now()) >= retest_at.load()) {
+        lock_guard<mutex> lock(mtx);
+        s = current.load();
+        if (s != state::closed && ticks(time::now()) >= retest_at.load()) {
+            begin_retest_prelocked();
+        }
+    }
+    if (current.load() == state::closed) {
+        return true;
+    }
+    int n = retest_permits.load();
+    while (n > 0) {
+        if (retest_permits.compare_exchange_weak(n, n - 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+circuit_breaker::state circuit_breaker::update(bool is_healthy) {
+    lock_guard<mutex> lock(mtx);
+    auto now = time::now();
+    switch (current.load()) {
+    case state::closed: {
+        auto slice_ns = std::max<int64_t>(1, cfg.window_millisecs * ns_per_ms / slices.size());
+        auto epoch = ticks(now) / slice_ns;
+        auto & sl = slices[epoch % slices.size()];
+        if (sl.epoch != epoch) {
+            sl = slice{epoch, 0, 0};
+        }
+        ++sl.calls;
+        if (!is_healthy) {
+            ++sl.failures;
+            unsigned calls = 0, failures = 0;
+            auto oldest = epoch - static_cast<int64_t>(slices.size());
+            for (auto & x : slices) {
+                if (x.epoch > oldest) {
+                    calls += x.calls;
+                    failures += x.failures;
+                }
+            }
+            if (calls >= cfg.min_calls && failures >= cfg.failure_ratio * calls) {
+                open_prelocked(now);
+            }
+        }
+        break;
+    }
+    case state::needs_retest:
+        if (!is_healthy) {
+            open_prelocked(now);
+        } else if (++retest_successes >= cfg.retest_calls) {
+            close_prelocked();
+        }
+        break;
+    default:
+        // A call that began before the circuit opened; it proves nothing.
+        break;
+    }
+    return current.load();
+}
+
+void circuit_breaker::trip() {
+    lock_guard<mutex> lock(mtx);
+    open_prelocked(time::now());
+}
+
+void circuit_breaker::reset() {
+    lock_guard<mutex> lock(mtx);
+    close_prelocked();
+}
+
+void circuit_breaker::open_prelocked(time::time_point now) {
+    retest_permits.store(0);
+    retest_at.store(ticks(now) + cfg.open_millisecs * ns_per_ms);
+    current.store(state::open);
+}
+
+void circuit_breaker::close_prelocked() {
+    for (auto & x : slices) {
+        x = slice{-1, 0, 0};
+    }
+    retest_permits.store(0);
+    current.store(state::closed);
+}
+
+void circuit_breaker::begin_retest_prelocked() {
+    retest_successes = 0;
+    // If the testers don't all report back by then, let others try.
+    retest_at.store(ticks(time::now()) + cfg.open_millisecs * ns_per_ms);
+    retest_permits.store(static_cast<int>(cfg.retest_calls));
+    current.store(state::needs_retest);
+}
+
+}}} // end namespace
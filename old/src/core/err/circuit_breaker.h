@@ -1,6 +1,14 @@
 #ifndef _1ce97458919b4622b41513e7293d9840
 #define _1ce97458919b4622b41513e7293d9840
 
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "core/marks/concurrency_marks.h"
+#include "core/time/assignable_clock.h"
+
 namespace intent {
 namespace core {
 namespace err {
@@ -13,47 +21,123 @@ namespace err {
  *
  * This class has little internal state--just enough to emulate the behavior
  * of a circuit breaker in electronics. Code that uses it should monitor a
- * function call, signal, or similar interaction (a "circuit"). Each time the
- * circuit When
+ * function call, signal, or similar interaction (a "circuit"), asking allow()
+ * before each call and reporting the outcome to update() afterward. When
  * the circuit is healthy, use normal behavior. Upon sufficient evidence that
- * the circuit is not healthy, transition to a failsafe/gracefully degraded mode.
- * Possibly test the interaction later to see if it's healthy again.
+ * the circuit is not healthy--too large a share of recent calls failed--
+ * transition to a failsafe/gracefully degraded mode. After a cooling-off
+ * period, let a few calls test the interaction to see if it's healthy again;
+ * close if they succeed, and open for another period if they don't.
+ *
+ * Checking the state and asking permission are lock-free, so a breaker can
+ * guard a hot path on many threads. Only update() takes a lock.
+ *
+ * Time comes from core::time::now(), so tests can drive a breaker with
+ * assignable_clock.
  *
  * Implements the circuit_breaker pattern described by Michael Nygard in
  * _Release It_ and discussed by Martin Fowler at http://j.mp/1w2Vun2.
  */
-struct circuit_breaker {
+mark(+, threadsafe)
+class circuit_breaker {
+public:
 
     /**
      * Describe the three possible states of the circuit_breaker.
      */
-    enum class state {
+    enum class state : uint8_t {
         /** Circuit is closed (healthy). */
         closed,
         /** Circuit is open (unhealthy/tripped). */
         open,
-        /** Circuit is open but might be ready to close again. */
+        /**
+         * Circuit is open but might be ready to close again ("half-open"). A
+         * limited number of calls are let through to test it.
+         */
         needs_retest
     };
 
-    state current;
+    /**
+     * Tune when the breaker trips and recovers.
+     */
+    struct config {
+        /** How far back failures count toward the ratio. */
+        unsigned window_millisecs;
+        /**
+         * How many slices the window is kept in; old outcomes expire a slice
+         * at a time.
+         */
+        unsigned window_slices;
+        /** Trip when at least this share of calls in the window failed. */
+        double failure_ratio;
+        /** ...but only once the window holds at least this many calls. */
+        unsigned min_calls;
+        /** How long to stay open before retesting. */
+        unsigned open_millisecs;
+        /** How many calls to let through while retesting. */
+        unsigned retest_calls;
+
+        config();
+    };
+
+    circuit_breaker(state initial_state=state::closed);
+    explicit circuit_breaker(config const &, state initial_state=state::closed);
+
+    /**
+     * What state is the circuit in? An open circuit whose cooling-off period
+     * has passed reports needs_retest.
+     */
+    state get_state() const;
 
-    circuit_breaker(state initial_state=state::closed) : current(initial_state) {}
+    /**
+     * May a call go through? Always true when closed; false when open. When
+     * retesting, true for only the first few callers; each of them must
+     * report back with update().
+     */
+    bool allow();
 
     /**
      * Choose which code path to execute, based on the condition of the circuit.
      */
     template <typename FUNC>
     FUNC choose_path(FUNC on_closed, FUNC on_open) {
-        return current == state::closed ? on_closed : on_open;
+        return allow() ? on_closed : on_open;
     }
 
-    state update(bool is_healthy) {
-        if (!is_healthy) {
-            current = state::open;
-        }
-        return current;
-    }
+    /**
+     * Report how a call went.
+     *
+     * @return the state afterward.
+     */
+    state update(bool is_healthy);
+
+    /** Open the circuit now, as if calls had been failing. */
+    void trip();
+
+    /** Close the circuit, and forget recent history. */
+    void reset();
+
+    config const & get_config() const { return cfg; }
+
+private:
+    struct slice {
+        int64_t epoch; // which slice of time this counts
+        unsigned calls;
+        unsigned failures;
+    };
+
+    int64_t ticks(time::time_point) const;
+    void open_prelocked(time::time_point now);
+    void close_prelocked();
+    void begin_retest_prelocked();
+
+    config const cfg;
+    std::atomic<state> current;
+    std::atomic<int64_t> retest_at; // ns since the clock's epoch
+    std::atomic<int> retest_permits;
+    std::mutex mtx;
+    std::vector<slice> slices; // +<guarded_by(mtx)
+    unsigned retest_successes; // +<guarded_by(mtx)
 };
 
 
@@ -0,0 +1,115 @@
+#ifndef _82ef03e82b6d4210b25fd26766be18d3
+#define _82ef03e82b6d4210b25fd26766be18d3
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "core/io/async_reader.h"
+
+namespace intent {
+namespace core {
+namespace io {
+
+/**
+ * Page-aligned buffers, recycled by power-of-two size class. Threadsafe.
+ */
+class read_buffer_pool : public std::enable_shared_from_this<read_buffer_pool> {
+    static constexpr unsigned CLASS_COUNT = 15; // 4KB .. 64MB
+    std::mutex mutex;
+    std::vector<char *> free_lists[CLASS_COUNT];
+    size_t retained;
+
+public:
+    static constexpr size_t ALIGNMENT = 4096;
+    /** Stop keeping idle buffers once they add up to this much. */
+    static constexpr size_t MAX_RETAINED = 64 * 1024 * 1024;
+
+    read_buffer_pool();
+    ~read_buffer_pool();
+
+    NOT_COPYABLE(read_buffer_pool);
+    NOT_MOVEABLE(read_buffer_pool);
+
+    /**
+     * A buffer that can hold size bytes plus a trailing null.
+     * @throw std::bad_alloc
+     */
+    read_buffer get(size_t size);
+
+    void release(char * bytes, size_t capacity);
+
+    static void set_size(read_buffer & buffer, size_t size);
+};
+
+/**
+ * What the engines share with async_reader.
+ */
+struct read_context {
+    std::shared_ptr<read_buffer_pool> pool;
+    work::progress_tracker * progress;
+
+    bool should_stop() const;
+    void note_bytes_read(size_t n) const;
+};
+
+/**
+ * One submitted read, as it moves through an engine.
+ */
+struct read_op {
+    std::string path;
+    uint64_t tag;
+    uint64_t offset;
+    uint64_t length;
+    int fd;
+    int error;
+    /** Bytes to read, once the file's size is known. */
+    size_t wanted;
+    size_t done;
+    read_buffer buffer;
+
+    read_op(std::string const & p, uint64_t t, uint64_t off, uint64_t len);
+};
+
+/**
+ * Size the read for the open file in op.fd, and give it a buffer. Sets
+ * op.error on failure.
+ */
+void prepare_read_op(read_op & op, read_context const & ctx);
+
+/**
+ * Close op.fd, settle progress accounting, and hand over the result.
+ */
+read_completion finish_read_op(read_op & op, read_context const & ctx);
+
+/**
+ * The part of an async_reader that does the I/O.
+ */
+class async_read_engine {
+public:
+    virtual ~async_read_engine();
+    virtual read_engine get_kind() const = 0;
+    virtual void submit(std::unique_ptr<read_op> op) = 0;
+
+    /**
+     * Move between min_count and max_count completions into out, blocking
+     * as needed. Callers never ask for more than they have submitted.
+     */
+    virtual size_t reap(std::vector<read_completion> & out, size_t min_count,
+            size_t max_count) = 0;
+};
+
+/**
+ * @return nullptr if the kernel doesn't support the io_uring operations we
+ *     need (or io_uring at all, or it's blocked).
+ */
+std::unique_ptr<async_read_engine> make_uring_read_engine(unsigned queue_depth,
+        read_context const & ctx);
+
+std::unique_ptr<async_read_engine> make_threaded_read_engine(
+        unsigned queue_depth, read_context const & ctx);
+
+}}} // end namespace
+
+#endif // sentry
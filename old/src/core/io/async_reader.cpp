@@ -0,0 +1,394 @@
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core/io/async_reader.h"
+#include "core/io/.private/read_engines.h"
+#include "core/util/dbc.h"
+#include "core/work/progress_tracker.h"
+
+using std::unique_ptr;
+using std::vector;
+
+using intent::core::text::str_view;
+using intent::core::work::work_type;
+
+namespace intent {
+namespace core {
+namespace io {
+
+constexpr uint64_t async_reader::WHOLE_FILE;
+constexpr unsigned async_reader::DEFAULT_QUEUE_DEPTH;
+constexpr unsigned read_buffer_pool::CLASS_COUNT;
+constexpr size_t read_buffer_pool::ALIGNMENT;
+constexpr size_t read_buffer_pool::MAX_RETAINED;
+
+read_buffer_pool::read_buffer_pool() : retained(0) {
+}
+
+read_buffer_pool::~read_buffer_pool() {
+    for (auto & list : free_lists) {
+        for (auto bytes : list) {
+            free(bytes);
+        }
+    }
+}
+
+static unsigned size_class(size_t capacity) {
+    unsigned c = 0;
+    while ((read_buffer_pool::ALIGNMENT << c) < capacity) {
+        ++c;
+    }
+    return c;
+}
+
+read_buffer read_buffer_pool::get(size_t size) {
+    size_t needed = size + 1;
+    unsigned c = size_class(needed);
+    size_t capacity = c < CLASS_COUNT ? ALIGNMENT << c
+            : (needed + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    char * bytes = nullptr;
+    if (c < CLASS_COUNT) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto & list = free_lists[c];
+        if (!list.empty()) {
+            bytes = list.back();
+            list.pop_back();
+            retained -= capacity;
+        }
+    }
+    if (!bytes) {
+        void * p = nullptr;
+        if (posix_memalign(&p, ALIGNMENT, capacity) != 0) {
+            throw std::bad_alloc();
+        }
+        bytes = static_cast<char *>(p);
+    }
+    read_buffer buffer;
+    buffer.bytes = bytes;
+    buffer.capacity = capacity;
+    buffer.pool = shared_from_this();
+    bytes[0] = 0;
+    return buffer;
+}
+
+void read_buffer_pool::release(char * bytes, size_t capacity) {
+    unsigned c = size_class(capacity);
+    if (c < CLASS_COUNT) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (retained + capacity <= MAX_RETAINED) {
+            free_lists[c].push_back(bytes);
+            retained += capacity;
+            return;
+        }
+    }
+    free(bytes);
+}
+
+void read_buffer_pool::set_size(read_buffer & buffer, size_t size) {
+    buffer.length = size;
+    buffer.bytes[size] = 0;
+}
+
+read_buffer::read_buffer() : bytes(nullptr), length(0), capacity(0), pool() {
+}
+
+read_buffer::~read_buffer() {
+    if (bytes) {
+        pool->release(bytes, capacity);
+    }
+}
+
+read_buffer::read_buffer(read_buffer && rhs) : read_buffer() {
+    *this = std::move(rhs);
+}
+
+read_buffer & read_buffer::operator =(read_buffer && other) {
+    if (this != &other) {
+        if (bytes) {
+            pool->release(bytes, capacity);
+        }
+        bytes = other.bytes;
+        length = other.length;
+        capacity = other.capacity;
+        pool = std::move(other.pool);
+        other.bytes = nullptr;
+        other.length = 0;
+        other.capacity = 0;
+    }
+    return *this;
+}
+
+char const * read_buffer::begin() const {
+    return bytes;
+}
+
+char const * read_buffer::end() const {
+    return bytes + length;
+}
+
+size_t read_buffer::size() const {
+    return length;
+}
+
+char * read_buffer::data() {
+    return bytes;
+}
+
+str_view read_buffer::get_text() const {
+    return bytes ? str_view(bytes, length) : str_view();
+}
+
+bool read_context::should_stop() const {
+    return progress && progress->should_stop();
+}
+
+void read_context::note_bytes_read(size_t n) const {
+    if (progress) {
+        progress->complete_work(work_type::read_bytes, n);
+    }
+}
+
+read_op::read_op(std::string const & p, uint64_t t, uint64_t off,
+        uint64_t len) : path(p), tag(t), offset(off), length(len), fd(-1),
+        error(0), wanted(0), done(0), buffer() {
+}
+
+void prepare_read_op(read_op & op, read_context const & ctx) {
+    struct stat info;
+    if (fstat(op.fd, &info) != 0) {
+        op.error = errno;
+        return;
+    }
+    uint64_t size = static_cast<uint64_t>(info.st_size);
+    uint64_t available = op.offset < size ? size - op.offset : 0;
+    uint64_t wanted = std::min(op.length, available);
+    if (wanted > SIZE_MAX - read_buffer_pool::ALIGNMENT) {
+        op.error = EFBIG;
+        return;
+    }
+    op.wanted = static_cast<size_t>(wanted);
+    try {
+        op.buffer = ctx.pool->get(op.wanted);
+    } catch (std::bad_alloc const &) {
+        op.error = ENOMEM;
+        return;
+    }
+    if (ctx.progress && op.wanted) {
+        ctx.progress->expect_work(work_type::read_bytes, op.wanted);
+    }
+}
+
+read_completion finish_read_op(read_op & op, read_context const & ctx) {
+    if (op.fd >= 0) {
+        close(op.fd);
+        op.fd = -1;
+    }
+    if (ctx.progress && op.done < op.wanted) {
+        ctx.progress->skip_work(work_type::read_bytes, op.wanted - op.done);
+    }
+    if (op.buffer.data()) {
+        read_buffer_pool::set_size(op.buffer, op.done);
+    }
+    return read_completion{op.tag, op.error, std::move(op.buffer)};
+}
+
+async_read_engine::~async_read_engine() {
+}
+
+namespace {
+
+/**
+ * Blocking calls on a pool of threads. Works everywhere.
+ */
+class threaded_read_engine : public async_read_engine {
+    read_context ctx;
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable results_ready;
+    std::deque<unique_ptr<read_op>> queue;
+    std::deque<read_completion> results;
+    vector<std::thread> threads;
+    bool stopping;
+
+    void run(read_op & op) {
+        if (ctx.should_stop()) {
+            op.error = ECANCELED;
+            return;
+        }
+        op.fd = open(op.path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (op.fd < 0) {
+            op.error = errno;
+            return;
+        }
+        prepare_read_op(op, ctx);
+        while (!op.error && op.done < op.wanted) {
+            ssize_t n = pread(op.fd, op.buffer.data() + op.done,
+                    op.wanted - op.done, static_cast<off_t>(op.offset + op.done));
+            if (n < 0) {
+                if (errno != EINTR) {
+                    op.error = errno;
+                }
+            } else if (n == 0) {
+                break; // The file shrank.
+            } else {
+                op.done += static_cast<size_t>(n);
+                ctx.note_bytes_read(static_cast<size_t>(n));
+            }
+        }
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            work_ready.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping) {
+                return;
+            }
+            auto op = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+            run(*op);
+            auto result = finish_read_op(*op, ctx);
+            op.reset();
+            lock.lock();
+            results.push_back(std::move(result));
+            results_ready.notify_one();
+        }
+    }
+
+public:
+    threaded_read_engine(unsigned thread_count, read_context const & c) :
+            ctx(c), stopping(false) {
+        for (unsigned i = 0; i < thread_count; ++i) {
+            threads.emplace_back([this] { work(); });
+        }
+    }
+
+    ~threaded_read_engine() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            queue.clear();
+        }
+        work_ready.notify_all();
+        for (auto & t : threads) {
+            t.join();
+        }
+    }
+
+    read_engine get_kind() const {
+        return read_engine::thread_pool;
+    }
+
+    void submit(unique_ptr<read_op> op) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(op));
+        }
+        work_ready.notify_one();
+    }
+
+    size_t reap(vector<read_completion> & out, size_t min_count,
+            size_t max_count) {
+        std::unique_lock<std::mutex> lock(mutex);
+        results_ready.wait(lock, [&] { return results.size() >= min_count; });
+        size_t n = std::min(results.size(), max_count);
+        for (size_t i = 0; i < n; ++i) {
+            out.push_back(std::move(results.front()));
+            results.pop_front();
+        }
+        return n;
+    }
+};
+
+} // end anonymous namespace
+
+unique_ptr<async_read_engine> make_threaded_read_engine(unsigned queue_depth,
+        read_context const & ctx) {
+    // The threads mostly wait on the disk, so more of them than cores pays.
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    unsigned n = std::max(1u, std::min(queue_depth, std::min(cores * 4, 64u)));
+    return unique_ptr<async_read_engine>(new threaded_read_engine(n, ctx));
+}
+
+struct async_reader::data_t {
+    unique_ptr<async_read_engine> engine;
+    size_t pending;
+
+    data_t() : engine(), pending(0) {
+    }
+};
+
+async_reader::async_reader(unsigned queue_depth, read_engine engine,
+        work::progress_tracker * progress) : data(nullptr) {
+    precondition(queue_depth > 0);
+    read_context ctx{std::make_shared<read_buffer_pool>(), progress};
+    unique_ptr<data_t> d(new data_t);
+    if (engine != read_engine::thread_pool) {
+        d->engine = make_uring_read_engine(queue_depth, ctx);
+        if (!d->engine && engine == read_engine::io_uring) {
+            throw std::runtime_error("io_uring is not available.");
+        }
+    }
+    if (!d->engine) {
+        d->engine = make_threaded_read_engine(queue_depth, ctx);
+    }
+    data = d.release();
+}
+
+async_reader::async_reader(async_reader && rhs) : data(nullptr) {
+    *this = std::move(rhs);
+}
+
+async_reader & async_reader::operator =(async_reader && other) {
+    if (this != &other) {
+        delete data;
+        data = other.data;
+        other.data = nullptr;
+    }
+    return *this;
+}
+
+async_reader::~async_reader() {
+    delete data;
+}
+
+read_engine async_reader::get_engine() const {
+    return data->engine->get_kind();
+}
+
+void async_reader::submit(filesystem::path const & fpath, uint64_t tag,
+        uint64_t offset, uint64_t length) {
+    data->engine->submit(unique_ptr<read_op>(new read_op(fpath.string(), tag,
+            offset, length)));
+    ++data->pending;
+}
+
+size_t async_reader::get_pending_count() const {
+    return data->pending;
+}
+
+size_t async_reader::wait(vector<read_completion> & completions,
+        size_t min_count, size_t max_count) {
+    size_t max_n = std::min(max_count, data->pending);
+    size_t min_n = std::min(min_count, max_n);
+    if (max_n == 0) {
+        return 0;
+    }
+    size_t n = data->engine->reap(completions, min_n, max_n);
+    data->pending -= n;
+    return n;
+}
+
+}}} // end namespace
@@ -0,0 +1,158 @@
+#ifndef _e9368a3b1c2e4ce4bb0bbd4fbb74337f
+#define _e9368a3b1c2e4ce4bb0bbd4fbb74337f
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "core/filesystem.h"
+#include "core/text/str_view.h"
+#include "core/util/value_semantics.h"
+
+namespace intent { namespace core { namespace work { class progress_tracker; }}}
+
+namespace intent {
+namespace core {
+namespace io {
+
+class read_buffer_pool;
+
+/**
+ * How an async_reader gets its work done.
+ */
+enum class read_engine {
+    /** io_uring if the kernel offers what we need; otherwise thread_pool. */
+    automatic,
+    /** Linux io_uring: opens and reads are queued to the kernel in batches. */
+    io_uring,
+    /** Blocking open()/pread() calls spread across a pool of threads. */
+    thread_pool,
+};
+
+/**
+ * Bytes read by an async_reader. The storage is page-aligned, comes from a
+ * pool, and goes back to the pool when the buffer is destroyed; holding a
+ * buffer does not keep its async_reader alive, or vice versa.
+ *
+ * The bytes are followed by a null, so a buffer can be handed to anything
+ * that wants a null-terminated, mutable string (e.g., xsv_reader).
+ */
+class read_buffer {
+    friend class read_buffer_pool;
+    char * bytes;
+    size_t length;
+    size_t capacity;
+    std::shared_ptr<read_buffer_pool> pool;
+
+public:
+    read_buffer();
+    ~read_buffer();
+
+    MOVEABLE_BUT_NOT_COPYABLE(read_buffer);
+
+    char const * begin() const;
+    char const * end() const;
+    size_t size() const;
+    char * data();
+    text::str_view get_text() const;
+};
+
+/**
+ * The outcome of one read submitted to an async_reader.
+ */
+struct read_completion {
+    /** Whatever the caller passed to submit(). */
+    uint64_t tag;
+    /** 0, or the errno value that stopped the read. */
+    int error;
+    /**
+     * What was read. If error is nonzero, this may hold whatever arrived
+     * before the failure.
+     */
+    read_buffer buffer;
+};
+
+/**
+ * Read many files, or ranges of files, concurrently, and collect the results
+ * in batches. This is meant for bulk ingest--thousands of small files, where
+ * a synchronous open()/read() loop leaves both the disk queue and the cores
+ * idle.
+ *
+ * On Linux, opens and reads go through io_uring where the kernel supports
+ * it; elsewhere (or when asked) a pool of threads makes blocking calls. epoll
+ * can't help here, since regular files are always "ready".
+ *
+ * If a progress_tracker is supplied, bytes are reported as
+ * work_type::read_bytes: expected once a file's size is known, completed as
+ * they arrive, and skipped if a read fails. If the tracker asks to stop,
+ * reads that haven't started yet complete with ECANCELED.
+ *
+ * An async_reader is used from one thread at a time. Destroying it waits for
+ * reads already handed to the OS, and discards everything else.
+ *
+ * Usage:
+ *
+ *     async_reader reader;
+ *     for (size_t i = 0; i < paths.size(); ++i) {
+ *         reader.submit(paths[i], i);
+ *     }
+ *     std::vector<read_completion> batch;
+ *     while (reader.get_pending_count()) {
+ *         batch.clear();
+ *         reader.wait(batch);
+ *         for (auto & c : batch) { ... }
+ *     }
+ */
+class async_reader {
+    struct data_t;
+    data_t * data;
+
+public:
+    /** Pass as length to read from offset to the end of the file. */
+    static constexpr uint64_t WHOLE_FILE = UINT64_MAX;
+    static constexpr unsigned DEFAULT_QUEUE_DEPTH = 128;
+
+    /**
+     * @param queue_depth How many reads may be in progress at once; more can
+     *     be submitted, but they wait their turn.
+     * @param engine What does the work. Asking for io_uring where it isn't
+     *     available throws std::runtime_error.
+     * @param progress Where to report bytes read; may be null. Must outlive
+     *     the reader.
+     */
+    explicit async_reader(unsigned queue_depth = DEFAULT_QUEUE_DEPTH,
+            read_engine engine = read_engine::automatic,
+            work::progress_tracker * progress = nullptr);
+    ~async_reader();
+
+    MOVEABLE_BUT_NOT_COPYABLE(async_reader);
+
+    /** Which engine was chosen; never automatic. */
+    read_engine get_engine() const;
+
+    /**
+     * Queue a read. Reading past the end of the file is not an error; the
+     * buffer is just shorter than length.
+     *
+     * @param tag Returned in the read_completion, to identify it.
+     */
+    void submit(filesystem::path const & fpath, uint64_t tag,
+            uint64_t offset = 0, uint64_t length = WHOLE_FILE);
+
+    /** Reads submitted but not yet returned by wait(). */
+    size_t get_pending_count() const;
+
+    /**
+     * Append finished reads to completions, blocking until at least min_count
+     * (or everything pending, if less) are available.
+     *
+     * @return How many completions were appended.
+     */
+    size_t wait(std::vector<read_completion> & completions,
+            size_t min_count = 1, size_t max_count = SIZE_MAX);
+};
+
+}}} // end namespace
+
+#endif // sentry
@@ -0,0 +1,373 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "core/io/buffered_writer.h"
+#include "core/util/dbc.h"
+
+using std::vector;
+
+using intent::core::text::str_view;
+
+namespace intent {
+namespace core {
+namespace io {
+
+constexpr size_t buffered_writer::DEFAULT_BUFFER_SIZE;
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+namespace {
+
+/**
+ * writev() until every byte is out, coping with short writes, EINTR, and
+ * the cap on fragments per call. Modifies iov.
+ *
+ * @return 0, or the errno value of the failure.
+ */
+int write_all(int fd, iovec * iov, size_t count) {
+    while (count) {
+        int batch = static_cast<int>(std::min(count, static_cast<size_t>(IOV_MAX)));
+        ssize_t n = ::writev(fd, iov, batch);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        size_t left = static_cast<size_t>(n);
+        while (count && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count) {
+            iov->iov_base = static_cast<char *>(iov->iov_base) + left;
+            iov->iov_len -= left;
+        }
+    }
+    return 0;
+}
+
+int write_all(int fd, char const * p, size_t n) {
+    iovec iov{const_cast<char *>(p), n};
+    return n ? write_all(fd, &iov, 1) : 0;
+}
+
+std::runtime_error write_error(int err) {
+    return std::runtime_error(std::string("Unable to write buffered output: ")
+            + strerror(err));
+}
+
+char * new_buffer(size_t size) {
+    char * p = static_cast<char *>(malloc(size));
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+} // end anonymous namespace
+
+struct buffered_writer::data_t {
+    int fd;
+    bool owns_fd;
+    c_file * file;
+    size_t capacity;
+    char * active;
+    size_t used;
+    uint64_t byte_count;
+
+    // Background flushing. The flusher owns pending while it's set; the
+    // caller owns active. spare is whichever buffer is idle.
+    bool background;
+    char * spare;
+    char * pending;
+    size_t pending_len;
+    int error;
+    bool stopping;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread flusher;
+
+    data_t(int d, bool own, size_t size, bool bg) : fd(d), owns_fd(own),
+            file(nullptr), capacity(size), active(nullptr), used(0),
+            byte_count(0), background(bg), spare(nullptr), pending(nullptr),
+            pending_len(0), error(0), stopping(false) {
+        active = new_buffer(capacity);
+        if (background) {
+            try {
+                spare = new_buffer(capacity);
+                flusher = std::thread([this] { run_flusher(); });
+            } catch (...) {
+                free(spare);
+                free(active);
+                throw;
+            }
+        }
+    }
+
+    ~data_t() {
+        if (background) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            cv.notify_all();
+            flusher.join();
+        }
+        free(active);
+        free(spare);
+        if (owns_fd) {
+            close(fd);
+        }
+        delete file;
+    }
+
+    void run_flusher() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            cv.wait(lock, [this] { return stopping || pending; });
+            if (!pending) {
+                return;
+            }
+            char * p = pending;
+            size_t n = pending_len;
+            lock.unlock();
+            int err = write_all(fd, p, n);
+            lock.lock();
+            if (err && !error) {
+                error = err;
+            }
+            spare = pending;
+            pending = nullptr;
+            cv.notify_all();
+        }
+    }
+
+    /**
+     * In background mode, wait until the flusher has nothing, and report
+     * any error it hit.
+     */
+    void wait_idle() {
+        if (background) {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return !pending; });
+            if (error) {
+                int err = error;
+                error = 0;
+                throw write_error(err);
+            }
+        }
+    }
+
+    /**
+     * Get the buffer's content on its way to the OS, and empty the buffer.
+     */
+    void flush_buffer() {
+        if (!used) {
+            return;
+        }
+        if (background) {
+            wait_idle();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending = active;
+                pending_len = used;
+                active = spare;
+                spare = nullptr;
+            }
+            used = 0;
+            cv.notify_all();
+        } else {
+            // Reset first, so a failure doesn't send the same bytes twice.
+            size_t n = used;
+            used = 0;
+            int err = write_all(fd, active, n);
+            if (err) {
+                throw write_error(err);
+            }
+        }
+    }
+
+    /**
+     * Send the buffer's content and some fragments straight to the OS, in
+     * one go, on this thread.
+     */
+    void write_through(str_view const * fragments, size_t count) {
+        wait_idle();
+        vector<iovec> iov;
+        iov.reserve(count + 1);
+        if (used) {
+            iov.push_back(iovec{active, used});
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (fragments[i].length) {
+                iov.push_back(iovec{const_cast<char *>(fragments[i].begin),
+                        fragments[i].length});
+            }
+        }
+        used = 0;
+        int err = write_all(fd, iov.data(), iov.size());
+        if (err) {
+            throw write_error(err);
+        }
+    }
+};
+
+buffered_writer::buffered_writer(int fd, size_t buffer_size,
+        bool background_flush) : data(nullptr) {
+    precondition(fd >= 0);
+    precondition(buffer_size > 0);
+    data = new data_t(fd, false, buffer_size, background_flush);
+}
+
+buffered_writer::buffered_writer(c_file && file, size_t buffer_size,
+        bool background_flush) : data(nullptr) {
+    precondition(static_cast<bool>(file));
+    precondition(buffer_size > 0);
+    c_file f(std::move(file));
+    fflush(f);
+    data = new data_t(fileno(f), false, buffer_size, background_flush);
+    data->file = new c_file(std::move(f));
+}
+
+buffered_writer::buffered_writer(filesystem::path const & fpath,
+        size_t buffer_size, bool background_flush) : data(nullptr) {
+    precondition(buffer_size > 0);
+    int fd = open(fpath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open " + fpath.string() + ": "
+                + strerror(errno));
+    }
+    try {
+        data = new data_t(fd, true, buffer_size, background_flush);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+}
+
+buffered_writer::buffered_writer(buffered_writer && rhs) : data(nullptr) {
+    *this = std::move(rhs);
+}
+
+buffered_writer & buffered_writer::operator =(buffered_writer && other) {
+    if (this != &other) {
+        delete data;
+        data = other.data;
+        other.data = nullptr;
+    }
+    return *this;
+}
+
+buffered_writer::~buffered_writer() {
+    if (data) {
+        try {
+            flush();
+        } catch (...) {
+        }
+        delete data;
+    }
+}
+
+void buffered_writer::write(char const * p, size_t n) {
+    str_view fragment(p, n);
+    writev(&fragment, 1);
+}
+
+void buffered_writer::put(char c) {
+    if (data->used == data->capacity) {
+        data->flush_buffer();
+    }
+    data->active[data->used++] = c;
+    ++data->byte_count;
+}
+
+void buffered_writer::writev(str_view const * fragments, size_t count) {
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        total += fragments[i].length;
+    }
+    data->byte_count += total;
+    if (total > data->capacity - data->used) {
+        if (total >= data->capacity) {
+            data->write_through(fragments, count);
+            return;
+        }
+        data->flush_buffer();
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (fragments[i].length) {
+            memcpy(data->active + data->used, fragments[i].begin, fragments[i].length);
+            data->used += fragments[i].length;
+        }
+    }
+}
+
+char * buffered_writer::reserve(size_t n) {
+    precondition(n <= data->capacity);
+    if (n > data->capacity - data->used) {
+        data->flush_buffer();
+    }
+    return data->active + data->used;
+}
+
+void buffered_writer::commit(size_t n) {
+    precondition(n <= data->capacity - data->used);
+    data->used += n;
+    data->byte_count += n;
+}
+
+void buffered_writer::flush() {
+    data->flush_buffer();
+    data->wait_idle();
+}
+
+size_t buffered_writer::get_buffer_size() const {
+    return data->capacity;
+}
+
+uint64_t buffered_writer::get_byte_count() const {
+    return data->byte_count;
+}
+
+buffered_writer_streambuf::int_type buffered_writer_streambuf::overflow(
+        int_type c) {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        out.put(traits_type::to_char_type(c));
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize buffered_writer_streambuf::xsputn(char const * s,
+        std::streamsize n) {
+    out.write(s, static_cast<size_t>(n));
+    return n;
+}
+
+int buffered_writer_streambuf::sync() {
+    try {
+        out.flush();
+        return 0;
+    } catch (std::runtime_error const &) {
+        return -1;
+    }
+}
+
+}}} // end namespace
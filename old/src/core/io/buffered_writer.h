@@ -0,0 +1,139 @@
+#ifndef _92b50204db57472a89621185b396ce52
+#define _92b50204db57472a89621185b396ce52
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+
+#include "core/filesystem.h"
+#include "core/io/ioutil.h"
+#include "core/text/str_view.h"
+#include "core/util/value_semantics.h"
+
+namespace intent {
+namespace core {
+namespace io {
+
+/**
+ * Collect output in a buffer and hand it to the OS in large writes.
+ *
+ * Small writes cost a memcpy. A write too big for the buffer skips it: the
+ * buffered bytes and the new ones go out together in one writev(). Scattered
+ * fragments (e.g., a header, a body, and a trailer) can be written in one
+ * call with writev(), which takes the same shortcut.
+ *
+ * With background_flush, the writer keeps two buffers and a thread: when one
+ * buffer fills, the thread writes it out while the caller fills the other.
+ * That pays off for large sequential output, where the producer would
+ * otherwise stall on every write(); for small output it's just a thread.
+ *
+ * Errors throw std::runtime_error. In background mode, an error is thrown by
+ * the first call after it happens. The destructor flushes, but has to swallow
+ * errors; call flush() first to see them.
+ *
+ * A buffered_writer is used from one thread at a time. For output through
+ * std::ostream (e.g., json::stream_writer), see buffered_ostream.
+ */
+class buffered_writer {
+    struct data_t;
+    data_t * data;
+
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+    /**
+     * Write to a file descriptor. The descriptor is not owned.
+     */
+    buffered_writer(int fd, size_t buffer_size = DEFAULT_BUFFER_SIZE,
+            bool background_flush = false);
+
+    /**
+     * Write to a file that was fopen()'ed in write or append mode. Anything
+     * already buffered in the FILE is flushed first. The writer takes
+     * ownership of the file and closes it when done.
+     */
+    buffered_writer(c_file && file, size_t buffer_size = DEFAULT_BUFFER_SIZE,
+            bool background_flush = false);
+
+    /**
+     * Create or truncate a file, and write to it.
+     *
+     * @throw std::runtime_error if the file can't be opened.
+     */
+    buffered_writer(filesystem::path const & fpath,
+            size_t buffer_size = DEFAULT_BUFFER_SIZE,
+            bool background_flush = false);
+
+    ~buffered_writer();
+
+    MOVEABLE_BUT_NOT_COPYABLE(buffered_writer);
+
+    void write(char const * p, size_t n);
+    void write(text::str_view const & txt) { write(txt.begin, txt.length); }
+    void put(char c);
+
+    /**
+     * Write count fragments, in order, as if by consecutive write() calls.
+     */
+    void writev(text::str_view const * fragments, size_t count);
+
+    /**
+     * Get room to format up to n bytes directly into the buffer. Follow with
+     * commit() to say how many were used.
+     *
+     * @pre n <= get_buffer_size()
+     */
+    char * reserve(size_t n);
+    void commit(size_t n);
+
+    /**
+     * Hand everything written so far to the OS, and wait until it's taken.
+     */
+    void flush();
+
+    size_t get_buffer_size() const;
+
+    /** Total bytes accepted by write(), writev(), put() and commit(). */
+    uint64_t get_byte_count() const;
+};
+
+/**
+ * A std::streambuf that passes everything through to a buffered_writer.
+ * It keeps no buffer of its own.
+ */
+class buffered_writer_streambuf : public std::streambuf {
+    buffered_writer & out;
+
+public:
+    explicit buffered_writer_streambuf(buffered_writer & w) : out(w) {}
+
+protected:
+    virtual int_type overflow(int_type c);
+    virtual std::streamsize xsputn(char const * s, std::streamsize n);
+    virtual int sync();
+};
+
+/**
+ * A std::ostream over a buffered_writer, for code that writes to streams,
+ * such as json::stream_writer:
+ *
+ *     buffered_writer w(path);
+ *     buffered_ostream os(w);
+ *     json_writer->write(root, &os);
+ *
+ * Flushing the stream flushes the writer.
+ */
+class buffered_ostream : public std::ostream {
+    buffered_writer_streambuf buf;
+
+public:
+    explicit buffered_ostream(buffered_writer & w) : std::ostream(nullptr),
+            buf(w) {
+        rdbuf(&buf);
+    }
+};
+
+}}} // end namespace
+
+#endif // sentry
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+#include <string>
+
+#include <zlib.h>
+
+#include "core/io/gzip.h"
+
+using std::string;
+
+using intent::core::text::str_view;
+
+namespace intent {
+namespace core {
+namespace io {
+
+namespace {
+
+// Adds 16 to zlib's usual window bits, which asks for a gzip wrapper rather
+// than a zlib one.
+constexpr int gzip_window_bits = 15 + 16;
+
+// Room to add to the output before each deflate() call.
+constexpr size_t min_output_room = 16 * 1024;
+
+} // end anonymous namespace
+
+struct gzip_encoder::data_t {
+    z_stream z;
+    bool finished;
+    uint64_t input_count;
+
+    explicit data_t(int level) : z(), finished(false), input_count(0) {
+        if (deflateInit2(&z, level, Z_DEFLATED, gzip_window_bits, 8,
+                Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::runtime_error("Can't start a gzip stream.");
+        }
+    }
+
+    ~data_t() {
+        deflateEnd(&z);
+    }
+
+    // Run deflate over whatever input z points at, appending to out, until
+    // it has taken all of it (or, when finishing, written all it holds).
+    void pump(string & out, int flush) {
+        do {
+            auto used = out.size();
+            auto room = std::max(min_output_room, static_cast<size_t>(z.avail_in / 2));
+            room = std::min(room, static_cast<size_t>(UINT_MAX));
+            out.resize(used + room);
+            z.next_out = reinterpret_cast<Bytef *>(&out[used]);
+            z.avail_out = static_cast<uInt>(room);
+            auto result = deflate(&z, flush);
+            out.resize(used + room - z.avail_out);
+            if (result == Z_STREAM_END) {
+                return;
+            }
+            if (result != Z_OK && result != Z_BUF_ERROR) {
+                throw std::runtime_error("Can't gzip data.");
+            }
+        } while (z.avail_in || z.avail_out == 0 || flush == Z_FINISH);
+    }
+};
+
+gzip_encoder::gzip_encoder(int level) : data(new data_t(level)) {
+}
+
+gzip_encoder::~gzip_encoder() {
+    delete data;
+}
+
+gzip_encoder::gzip_encoder(gzip_encoder && rhs) : data(nullptr) {
+    *this = std::move(rhs);
+}
+
+gzip_encoder & gzip_encoder::operator =(gzip_encoder && other) {
+    if (this != &other) {
+        delete data;
+        data = other.data;
+        other.data = nullptr;
+    }
+    return *this;
+}
+
+void gzip_encoder::write(char const * p, size_t n, string & out) {
+    if (data->finished) {
+        throw std::runtime_error("A gzip stream can't take more data once finished.");
+    }
+    // zlib counts in uInt, so feed it in slices.
+    while (n) {
+        auto slice = std::min(n, static_cast<size_t>(UINT_MAX));
+        data->z.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(p));
+        data->z.avail_in = static_cast<uInt>(slice);
+        data->pump(out, Z_NO_FLUSH);
+        data->input_count += slice;
+        p += slice;
+        n -= slice;
+    }
+}
+
+void gzip_encoder::finish(string & out) {
+    if (!data->finished) {
+        data->z.next_in = nullptr;
+        data->z.avail_in = 0;
+        data->pump(out, Z_FINISH);
+        data->finished = true;
+    }
+}
+
+bool gzip_encoder::is_finished() const {
+    return data->finished;
+}
+
+uint64_t gzip_encoder::get_input_count() const {
+    return data->input_count;
+}
+
+string gzip(str_view const & txt, int level) {
+    gzip_encoder gz(level);
+    string out;
+    out.reserve(txt.length / 4 + 64);
+    gz.write(txt.begin, txt.length, out);
+    gz.finish(out);
+    return out;
+}
+
+}}} // end namespace
@@ -0,0 +1,72 @@
+#ifndef _a4e17c093d5b4f2e8c6b10f7d9e25a31
+#define _a4e17c093d5b4f2e8c6b10f7d9e25a31
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "core/text/str_view.h"
+#include "core/util/value_semantics.h"
+
+namespace intent {
+namespace core {
+namespace io {
+
+/**
+ * Compress a stream into gzip format (RFC 1952), a piece at a time, so the
+ * whole input never has to be in memory at once. Output is appended to a
+ * string the caller owns; reuse it between calls to avoid reallocating.
+ *
+ *     gzip_encoder gz;
+ *     string out;
+ *     while (read_more(chunk)) {
+ *         gz.write(chunk.data(), chunk.size(), out);
+ *         send(out);
+ *         out.clear();
+ *     }
+ *     gz.finish(out);
+ *     send(out);
+ *
+ * Errors throw std::runtime_error. An encoder is used from one thread at a
+ * time.
+ */
+class gzip_encoder {
+    struct data_t;
+    data_t * data;
+
+public:
+    /**
+     * @param level 1 (fastest) to 9 (smallest). The default suits text and
+     *     json, which shrink a lot even at low levels.
+     */
+    explicit gzip_encoder(int level = 6);
+    ~gzip_encoder();
+
+    MOVEABLE_BUT_NOT_COPYABLE(gzip_encoder);
+
+    /**
+     * Compress n more bytes. zlib holds some back until it has enough to
+     * work with, so out may not grow.
+     */
+    void write(char const * p, size_t n, std::string & out);
+
+    /**
+     * End the stream: append whatever was held back, and the trailer. After
+     * this, the encoder takes no more input.
+     */
+    void finish(std::string & out);
+
+    bool is_finished() const;
+
+    /** Bytes taken by write(). */
+    uint64_t get_input_count() const;
+};
+
+/**
+ * Compress a whole buffer at once.
+ */
+std::string gzip(text::str_view const & txt, int level = 6);
+
+}}} // end namespace
+
+#endif // sentry
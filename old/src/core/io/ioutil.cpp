@@ -16,6 +16,21 @@ c_file::c_file(boost::filesystem::path const & fpath, char const * mode) :
     f(fopen(fpath.c_str(), mode)) {
 }
 
+c_file::c_file(c_file && other) : f(other.f) {
+    other.f = nullptr;
+}
+
+c_file & c_file::operator =(c_file && other) {
+    if (this != &other) {
+        if (f) {
+            fclose(f);
+        }
+        f = other.f;
+        other.f = nullptr;
+    }
+    return *this;
+}
+
 c_file::~c_file() {
     if (f) {
         fclose(f);
@@ -0,0 +1,202 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core/io/mapped_file.h"
+#include "core/util/dbc.h"
+
+namespace intent {
+namespace core {
+namespace io {
+
+using filesystem::path;
+using text::str_view;
+
+static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static std::runtime_error map_error(char const * what, path const & fpath) {
+    return std::runtime_error(std::string("Unable to ") + what + " "
+            + fpath.string() + ": " + strerror(errno));
+}
+
+static bool has(map_hints hints, map_hints which) {
+    return static_cast<bool>(hints & which);
+}
+
+/**
+ * Map at a huge-page boundary by reserving a little more address space than
+ * needed, mapping the file over the aligned part, and giving the slack back.
+ * Return nullptr if that didn't work out.
+ */
+static void * map_aligned(size_t length, int prot, int flags, int fd) {
+    size_t reserved = length + HUGE_PAGE_SIZE;
+    void * r = mmap(nullptr, reserved, PROT_NONE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (r == MAP_FAILED) {
+        return nullptr;
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(r);
+    uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    void * m = mmap(reinterpret_cast<void *>(aligned), length, prot,
+            flags | MAP_FIXED, fd, 0);
+    if (m == MAP_FAILED) {
+        munmap(r, reserved);
+        return nullptr;
+    }
+    uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t mapped_end = (aligned + length + page - 1) & ~(page - 1);
+    if (aligned > start) {
+        munmap(r, aligned - start);
+    }
+    if (start + reserved > mapped_end) {
+        munmap(reinterpret_cast<void *>(mapped_end), start + reserved - mapped_end);
+    }
+    return m;
+}
+
+mapped_file::mapped_file(path const & fpath, access mode, map_hints hints) :
+        base(nullptr), length(0), writable(mode == access::read_write) {
+    int fd = open(fpath.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        throw map_error("open", fpath);
+    }
+    map(fd, fpath, hints);
+}
+
+mapped_file::mapped_file(path const & fpath, size_t size, map_hints hints) :
+        base(nullptr), length(0), writable(true) {
+    int fd = open(fpath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        throw map_error("create", fpath);
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        auto e = map_error("size", fpath);
+        close(fd);
+        throw e;
+    }
+    map(fd, fpath, hints);
+}
+
+void mapped_file::map(int fd, path const & fpath, map_hints hints) {
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        auto e = map_error("stat", fpath);
+        close(fd);
+        throw e;
+    }
+    length = static_cast<size_t>(info.st_size);
+    if (length) {
+        int prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+        int flags = writable ? MAP_SHARED : MAP_PRIVATE;
+        void * m = nullptr;
+        if (has(hints, map_hints::huge_pages) && length >= HUGE_PAGE_SIZE) {
+            m = map_aligned(length, prot, flags, fd);
+        }
+        if (!m) {
+            m = mmap(nullptr, length, prot, flags, fd, 0);
+        }
+        if (m == MAP_FAILED) {
+            auto e = map_error("map", fpath);
+            close(fd);
+            length = 0;
+            throw e;
+        }
+        base = static_cast<char *>(m);
+#ifdef MADV_HUGEPAGE
+        if (has(hints, map_hints::huge_pages)) {
+            madvise(base, length, MADV_HUGEPAGE);
+        }
+#endif
+        advise(hints);
+    }
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+}
+
+void mapped_file::unmap() {
+    if (base) {
+        munmap(base, length);
+        base = nullptr;
+        length = 0;
+    }
+}
+
+mapped_file::mapped_file(mapped_file && other) : base(other.base),
+        length(other.length), writable(other.writable) {
+    other.base = nullptr;
+    other.length = 0;
+}
+
+mapped_file & mapped_file::operator =(mapped_file && other) {
+    if (this != &other) {
+        unmap();
+        base = other.base;
+        length = other.length;
+        writable = other.writable;
+        other.base = nullptr;
+        other.length = 0;
+    }
+    return *this;
+}
+
+mapped_file::~mapped_file() {
+    unmap();
+}
+
+char const * mapped_file::begin() const {
+    return base;
+}
+
+char const * mapped_file::end() const {
+    return base + length;
+}
+
+size_t mapped_file::size() const {
+    return length;
+}
+
+bool mapped_file::is_writable() const {
+    return writable;
+}
+
+char * mapped_file::data() {
+    precondition(writable);
+    return base;
+}
+
+str_view mapped_file::get_text() const {
+    return base ? str_view(base, length) : str_view();
+}
+
+bool mapped_file::advise(map_hints hints) {
+    if (!base) {
+        return true;
+    }
+    bool ok = true;
+    if (has(hints, map_hints::sequential)) {
+        ok &= madvise(base, length, MADV_SEQUENTIAL) == 0;
+    }
+    if (has(hints, map_hints::random)) {
+        ok &= madvise(base, length, MADV_RANDOM) == 0;
+    }
+    if (has(hints, map_hints::willneed)) {
+        ok &= madvise(base, length, MADV_WILLNEED) == 0;
+    }
+    return ok;
+}
+
+void mapped_file::sync() {
+    if (base && writable && msync(base, length, MS_SYNC) != 0) {
+        throw std::runtime_error(std::string("Unable to sync mapped file: ")
+                + strerror(errno));
+    }
+}
+
+}}} // end namespace
@@ -0,0 +1,128 @@
+#ifndef _9612004abcaa4b668df3edd6773e7440
+#define _9612004abcaa4b668df3edd6773e7440
+
+#include <cstddef>
+
+#include "core/filesystem.h"
+#include "core/text/str_view.h"
+#include "core/util/enum_operators.h"
+#include "core/util/value_semantics.h"
+
+namespace intent {
+namespace core {
+namespace io {
+
+/**
+ * Hints about how a mapped file will be used. Supports bitmasking.
+ */
+enum class map_hints : unsigned {
+    none = 0,
+    /** Pages will be read in order; read ahead aggressively, drop behind. */
+    sequential = 1,
+    /** Pages will be read in no particular order; don't read ahead. */
+    random = 2,
+    /** Start paging the whole file in now. */
+    willneed = 4,
+    /**
+     * Align the mapping to a huge-page boundary and ask the OS to back it
+     * with huge pages, to cut TLB misses on very large files. This only
+     * takes effect where the kernel supports huge pages for the file's
+     * filesystem; elsewhere it is harmless.
+     */
+    huge_pages = 8,
+};
+
+}}} // end namespace
+
+define_bitwise_operators_for_enum(intent::core::io::map_hints);
+
+namespace intent {
+namespace core {
+namespace io {
+
+/**
+ * Map a whole file into memory, and unmap it when destroyed.
+ *
+ * Reading through a mapping costs no heap buffer and no copy: the page cache
+ * is the buffer. get_text() hands the content to anything that takes a
+ * str_view (lang::lexer, lang::parser), and begin()/end() suit anything that
+ * takes a char range (json::char_reader::parse, json::lazy_document::load).
+ * The mapping must outlive whatever reads it.
+ *
+ * An empty file maps to an empty range (with null begin and end), since
+ * mmap() can't map zero bytes.
+ */
+class mapped_file {
+public:
+    enum class access {
+        /** Map privately, for reading only. */
+        read_only,
+        /**
+         * Map shared and writable; changes reach the file (see sync()).
+         */
+        read_write,
+    };
+
+    /**
+     * Map an existing file.
+     *
+     * @throw std::runtime_error if the file can't be opened or mapped.
+     */
+    mapped_file(filesystem::path const & fpath, access mode = access::read_only,
+            map_hints hints = map_hints::none);
+
+    /**
+     * Create a file (or truncate or extend an existing one) to exactly size
+     * bytes, and map it read_write. New bytes are zero.
+     *
+     * @throw std::runtime_error if the file can't be created, sized, or mapped.
+     */
+    mapped_file(filesystem::path const & fpath, size_t size,
+            map_hints hints = map_hints::none);
+
+    ~mapped_file();
+
+    MOVEABLE_BUT_NOT_COPYABLE(mapped_file);
+
+    char const * begin() const;
+    char const * end() const;
+    size_t size() const;
+    bool is_writable() const;
+
+    /**
+     * Writable view of the bytes.
+     *
+     * @pre is_writable()
+     */
+    char * data();
+
+    /** The whole file, as text. Not null-terminated. */
+    text::str_view get_text() const;
+
+    /**
+     * Apply hints after the fact. huge_pages can't be added here, because
+     * alignment is settled when the file is mapped.
+     *
+     * @return false if the OS rejected a hint.
+     */
+    bool advise(map_hints hints);
+
+    /**
+     * Write changes back to the file and wait for the write.
+     *
+     * @throw std::runtime_error on failure.
+     */
+    void sync();
+
+private:
+    char * base;
+    size_t length;
+    bool writable;
+
+    void map(int fd, filesystem::path const & fpath, map_hints hints);
+    void unmap();
+};
+
+}}} // end namespace
+
+#endif // sentry
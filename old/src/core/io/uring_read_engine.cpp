@@ -0,0 +1,399 @@
+#include "core/io/.private/read_engines.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using std::unique_ptr;
+using std::vector;
+
+namespace intent {
+namespace core {
+namespace io {
+
+namespace {
+
+/**
+ * A bare io_uring: the shared rings and the three syscalls. We talk to the
+ * kernel directly rather than take a dependency on liburing for the handful
+ * of operations we use.
+ */
+class uring {
+    int fd;
+    void * sq_ring;
+    size_t sq_ring_size;
+    void * cq_ring;
+    size_t cq_ring_size;
+    io_uring_sqe * sqes;
+    size_t sqes_size;
+    unsigned * sq_head;
+    unsigned * sq_tail;
+    unsigned sq_mask;
+    unsigned * sq_array;
+    unsigned * cq_head;
+    unsigned * cq_tail;
+    unsigned cq_mask;
+    io_uring_cqe * cqes;
+    unsigned unsubmitted;
+
+    static char * at(void * ring, uint32_t offset) {
+        return static_cast<char *>(ring) + offset;
+    }
+
+public:
+    unsigned entries;
+
+    uring() : fd(-1), sq_ring(MAP_FAILED), sq_ring_size(0),
+            cq_ring(MAP_FAILED), cq_ring_size(0),
+            sqes(static_cast<io_uring_sqe *>(MAP_FAILED)), sqes_size(0),
+            sq_head(nullptr), sq_tail(nullptr), sq_mask(0), sq_array(nullptr),
+            cq_head(nullptr), cq_tail(nullptr), cq_mask(0), cqes(nullptr),
+            unsubmitted(0), entries(0) {
+    }
+
+    ~uring() {
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqes_size);
+        }
+        if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+            munmap(cq_ring, cq_ring_size);
+        }
+        if (sq_ring != MAP_FAILED) {
+            munmap(sq_ring, sq_ring_size);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    NOT_COPYABLE(uring);
+    NOT_MOVEABLE(uring);
+
+    bool setup(unsigned depth) {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &p));
+        if (fd < 0) {
+            return false;
+        }
+        entries = p.sq_entries;
+        sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) {
+            sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+        }
+        sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sq_ring == MAP_FAILED) {
+            return false;
+        }
+        cq_ring = single ? sq_ring : mmap(nullptr, cq_ring_size,
+                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED) {
+            return false;
+        }
+        sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe *>(mmap(nullptr, sqes_size,
+                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+        sq_head = reinterpret_cast<unsigned *>(at(sq_ring, p.sq_off.head));
+        sq_tail = reinterpret_cast<unsigned *>(at(sq_ring, p.sq_off.tail));
+        sq_mask = *reinterpret_cast<unsigned *>(at(sq_ring, p.sq_off.ring_mask));
+        sq_array = reinterpret_cast<unsigned *>(at(sq_ring, p.sq_off.array));
+        cq_head = reinterpret_cast<unsigned *>(at(cq_ring, p.cq_off.head));
+        cq_tail = reinterpret_cast<unsigned *>(at(cq_ring, p.cq_off.tail));
+        cq_mask = *reinterpret_cast<unsigned *>(at(cq_ring, p.cq_off.ring_mask));
+        cqes = reinterpret_cast<io_uring_cqe *>(at(cq_ring, p.cq_off.cqes));
+        return true;
+    }
+
+    /**
+     * True if the kernel knows every opcode we plan to use. (Rings exist in
+     * kernels older than some of the opcodes.)
+     */
+    bool supports(vector<unsigned> const & opcodes) {
+        size_t len = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+        unique_ptr<char[]> buf(new char[len]());
+        auto probe = reinterpret_cast<io_uring_probe *>(buf.get());
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe,
+                256) < 0) {
+            return false;
+        }
+        for (auto op : opcodes) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * The next free submission slot, zeroed. Callers keep no more requests
+     * in flight than there are entries, so there always is one.
+     */
+    io_uring_sqe * next_sqe() {
+        unsigned tail = *sq_tail;
+        unsigned i = tail & sq_mask;
+        io_uring_sqe * sqe = &sqes[i];
+        memset(sqe, 0, sizeof(*sqe));
+        sq_array[i] = i;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        ++unsubmitted;
+        return sqe;
+    }
+
+    /**
+     * Hand queued submissions to the kernel, and optionally wait for at
+     * least one completion.
+     */
+    int enter(bool wait) {
+        while (true) {
+            unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+            long n = syscall(__NR_io_uring_enter, fd, unsubmitted, wait ? 1 : 0,
+                    flags, nullptr, 0);
+            if (n >= 0) {
+                unsubmitted -= std::min(unsubmitted, static_cast<unsigned>(n));
+                return 0;
+            }
+            if (errno != EINTR) {
+                return errno;
+            }
+        }
+    }
+
+    /**
+     * Call fn(user_data, res) for every completion posted so far.
+     */
+    template <typename FN>
+    size_t drain(FN fn) {
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        size_t n = 0;
+        for (; head != tail; ++head, ++n) {
+            io_uring_cqe const & cqe = cqes[head & cq_mask];
+            uint64_t user_data = cqe.user_data;
+            int res = cqe.res;
+            // Free the slot before acting on it; fn may submit more.
+            __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+            fn(user_data, res);
+        }
+        return n;
+    }
+};
+
+// Keep each read under what an sqe's 32-bit length can say.
+constexpr size_t MAX_READ_CHUNK = 1u << 30;
+
+/**
+ * Each read is an IORING_OP_OPENAT followed by one or more IORING_OP_READs,
+ * all posted to one ring and reaped on the caller's thread. Path lookup and
+ * open--most of the cost for small files--happen in the kernel's workers, in
+ * parallel, instead of one at a time on ours.
+ */
+class uring_read_engine : public async_read_engine {
+    read_context ctx;
+    uring ring;
+    std::deque<unique_ptr<read_op>> backlog;
+    std::deque<read_completion> results;
+    size_t in_flight;
+    bool draining;
+
+    void queue_open(read_op * op) {
+        auto sqe = ring.next_sqe();
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uintptr_t>(op->path.c_str());
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        sqe->user_data = reinterpret_cast<uintptr_t>(op);
+    }
+
+    void queue_read(read_op * op) {
+        auto sqe = ring.next_sqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = op->fd;
+        sqe->addr = reinterpret_cast<uintptr_t>(op->buffer.data() + op->done);
+        sqe->len = static_cast<uint32_t>(std::min(op->wanted - op->done,
+                MAX_READ_CHUNK));
+        sqe->off = op->offset + op->done;
+        sqe->user_data = reinterpret_cast<uintptr_t>(op);
+    }
+
+    void finish(read_op * op) {
+        unique_ptr<read_op> owned(op);
+        results.push_back(finish_read_op(*op, ctx));
+        --in_flight;
+    }
+
+    /**
+     * Move work from the backlog to the ring while there's room.
+     */
+    void launch() {
+        while (!backlog.empty() && in_flight < ring.entries) {
+            read_op * op = backlog.front().release();
+            backlog.pop_front();
+            ++in_flight;
+            if (ctx.should_stop()) {
+                op->error = ECANCELED;
+                finish(op);
+            } else {
+                queue_open(op);
+            }
+        }
+    }
+
+    void on_complete(read_op * op, int res) {
+        if (draining) {
+            if (op->fd < 0 && res >= 0) {
+                close(res);
+            }
+            return finish(op);
+        }
+        if (op->fd < 0) {
+            // The open finished.
+            if (res < 0) {
+                op->error = -res;
+                return finish(op);
+            }
+            op->fd = res;
+            prepare_read_op(*op, ctx);
+            if (op->error || op->wanted == 0) {
+                return finish(op);
+            }
+            return queue_read(op);
+        }
+        if (res < 0) {
+            if (res == -EINTR || res == -EAGAIN) {
+                return queue_read(op);
+            }
+            op->error = -res;
+            return finish(op);
+        }
+        if (res == 0) {
+            return finish(op); // The file shrank.
+        }
+        op->done += static_cast<size_t>(res);
+        ctx.note_bytes_read(static_cast<size_t>(res));
+        if (op->done < op->wanted) {
+            return queue_read(op);
+        }
+        finish(op);
+    }
+
+    void pump(bool wait) {
+        launch();
+        int err = ring.enter(wait && in_flight > 0);
+        if (err && err != EAGAIN && err != EBUSY) {
+            throw std::runtime_error(std::string("io_uring_enter failed: ")
+                    + strerror(err));
+        }
+        ring.drain([this](uint64_t user_data, int res) {
+            on_complete(reinterpret_cast<read_op *>(user_data), res);
+        });
+    }
+
+public:
+    explicit uring_read_engine(read_context const & c) : ctx(c), ring(),
+            backlog(), results(), in_flight(0), draining(false) {
+    }
+
+    ~uring_read_engine() {
+        // The kernel may still be writing into buffers we own, so wait for
+        // everything it has, and start nothing new.
+        backlog.clear();
+        draining = true;
+        while (in_flight) {
+            int err = ring.enter(true);
+            if (err && err != EAGAIN && err != EBUSY) {
+                break;
+            }
+            ring.drain([this](uint64_t user_data, int res) {
+                on_complete(reinterpret_cast<read_op *>(user_data), res);
+            });
+        }
+    }
+
+    bool setup(unsigned queue_depth) {
+        return ring.setup(queue_depth) && ring.supports({IORING_OP_OPENAT,
+                IORING_OP_READ});
+    }
+
+    read_engine get_kind() const {
+        return read_engine::io_uring;
+    }
+
+    void submit(unique_ptr<read_op> op) {
+        backlog.push_back(std::move(op));
+        launch();
+        // Let the kernel get started; completions are collected in reap().
+        if (ring.enter(false) == 0) {
+            ring.drain([this](uint64_t user_data, int res) {
+                on_complete(reinterpret_cast<read_op *>(user_data), res);
+            });
+        }
+    }
+
+    size_t reap(vector<read_completion> & out, size_t min_count,
+            size_t max_count) {
+        while (results.size() < min_count) {
+            pump(true);
+        }
+        pump(false);
+        size_t n = std::min(results.size(), max_count);
+        for (size_t i = 0; i < n; ++i) {
+            out.push_back(std::move(results.front()));
+            results.pop_front();
+        }
+        return n;
+    }
+};
+
+} // end anonymous namespace
+
+unique_ptr<async_read_engine> make_uring_read_engine(unsigned queue_depth,
+        read_context const & ctx) {
+    unique_ptr<uring_read_engine> engine(new uring_read_engine(ctx));
+    if (!engine->setup(queue_depth)) {
+        return nullptr;
+    }
+    return unique_ptr<async_read_engine>(engine.release());
+}
+
+}}} // end namespace
+
+#else
+
+namespace intent {
+namespace core {
+namespace io {
+
+std::unique_ptr<async_read_engine> make_uring_read_engine(unsigned,
+        read_context const &) {
+    return nullptr;
+}
+
+}}} // end namespace
+
+#endif
@@ -1,19 +1,21 @@
 #ifndef _5182a79d693244daaf448fd5977a5f6b
 #define _5182a79d693244daaf448fd5977a5f6b
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <mutex>
-#include <thread>
-
-#include "asio.hpp"
+#include <string>
+#include <vector>
 
 #include "core/net/curl/channel.h"
-#include "core/net/curl/.private/multi.h"
-#include "core/net/curl/.private/libcurl_callbacks.h"
-
-
-using std::map;
-using std::mutex;
+#include "core/net/curl/shared_state.h"
+#include "core/net/curl/.private/event_loop.h"
+#include "core/net/curl/.private/metrics.h"
+#include "core/net/curl/.private/resolver.h"
+#include "core/net/curl/.private/scheduler.h"
+#include "core/net/curl/.private/session_pool.h"
+#include "core/util/slot_table.h"
 
 
 namespace intent {
@@ -22,42 +24,76 @@ namespace net {
 namespace curl {
 
 
-typedef asio::ip::tcp::socket asio_socket_t;
-typedef map<curl_socket_t, asio_socket_t *> socket_map_t;
-typedef std::pair<curl_socket_t, asio_socket_t *> socket_pair_t;
-
-
 /**
  * Hold all state for a channel.
  */
 struct channel::impl_t {
 
     uint32_t id;
-    struct multi multi;
-    int still_running;
-    asio::io_service io_service;
-    asio::deadline_timer timeout;
-    socket_map_t socket_map;
-    std::thread service_runner;
-    asio::io_service::work work;
+    std::vector<std::unique_ptr<event_loop>> loops; // +<final
+    // Declared after the loops, because its timer runs on the first one.
+    std::unique_ptr<scheduler> admission; // +<final
+    // Likewise; its lookups run on the first loop.
+    std::unique_ptr<resolver> dns; // +<final
+    // Likewise; its dumps run on the first loop.
+    std::unique_ptr<metrics> meters; // +<final
+    std::atomic<unsigned> next_loop;
+    bool open;
+    shared_state default_shared_state; // +<guarded_by(mtx)
+
+    // Guards open/close and defaults.
+    std::mutex mtx;
 
-    std::map<uint32_t, session *> sessions;
+    // Every attached session, in the slot its impl remembers. Attaching and
+    // detaching take no lock, so making sessions on many threads at once
+    // doesn't contend.
+    util::slot_table<session> sessions;
+    // Spare impls and easy handles, left by sessions that were destroyed.
+    session_pool pool; // +<final
 
-    std::mutex mtx;
+    // Held while the loops take up a new policy; loop threads never take it.
+    std::mutex policy_mtx;
+    connection_policy connections; // +<guarded_by(policy_mtx)
 
-    impl_t();
-    ~impl_t();
+    std::mutex breaker_mtx;
+    bool breakers_enabled; // +<guarded_by(breaker_mtx)
+    err::circuit_breaker::config breaker_config; // +<guarded_by(breaker_mtx)
+    std::map<std::string, std::shared_ptr<err::circuit_breaker>> breakers; // +<guarded_by(breaker_mtx)
 
-    void on_socket_event(asio_socket_t * tcp_socket, int action, int * socket_state);
-    void on_timeout(asio::error_code const & error);
+    std::mutex cache_mtx;
+    std::shared_ptr<http_cache::impl_t> cache; // +<guarded_by(cache_mtx)
 
-    void add_socket(curl_socket_t sock, CURL *easy, int action);
-    void change_socket_state(int *fdp, curl_socket_t sock, CURL*easy, int act);
-    void handle_done_transfers();
-    void queue_callback_when_socket_is_ready(int * socket_state, asio_socket_t * tcp_socket);
-    void remove_socket(int *f);
+    impl_t(unsigned loop_count);
+    ~impl_t();
 
-    bool is_open() const;
+    /**
+     * Stop admitting transfers, wake anyone waiting on a queued one, and stop
+     * the loops, which abandons the rest.
+     */
+    void stop_loops();
+
+    /**
+     * Pick the loop for a new session: the one with the fewest sessions,
+     * starting the search at a rotating offset so ties spread out.
+     */
+    event_loop * choose_loop();
+
+    /**
+     * Pick the loop for a session that uses a pool of shared state. Sessions
+     * that share connections all go to the loop the first one was given.
+     *
+     * @throw state_error if the pool's connections belong to another channel.
+     */
+    event_loop * choose_loop(shared_state::impl_t *);
+
+    /** Move a session to a particular loop. Its hedges run beside it. */
+    void move_to_loop(session *, event_loop *);
+
+    /** The breaker for a host, or nullptr if breakers aren't enabled. */
+    std::shared_ptr<err::circuit_breaker> get_breaker(std::string const & host);
+
+    /** The cache that GETs consult, or nullptr. */
+    std::shared_ptr<http_cache::impl_t> get_cache();
 };
 
 
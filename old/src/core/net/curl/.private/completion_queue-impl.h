@@ -0,0 +1,49 @@
+#ifndef _0b7d52e6a1c34f0e8d93a6c2f54e18b7
+#define _0b7d52e6a1c34f0e8d93a6c2f54e18b7
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "core/net/curl/completion_queue.h"
+#include "core/net/curl/.private/response-impl.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * Sessions hold a shared_ptr to this while one of their transfers belongs to
+ * the queue, so it outlives the completion_queue if need be.
+ */
+struct completion_queue::impl_t {
+
+    class channel * channel; // +<final
+    mutable std::mutex mtx;
+    std::condition_variable ready_signal;
+    std::deque<response> ready; // +<guarded_by(mtx)
+    size_t pending; // +<guarded_by(mtx)
+    bool closed; // +<guarded_by(mtx); the completion_queue is gone
+    std::set<session *> owned; // +<guarded_by(mtx)
+    std::vector<session *> spare; // +<guarded_by(mtx); owned, and idle
+
+    impl_t(class channel *);
+
+    // A session's transfer finished. Called without the session's lock, and
+    // perhaps after the session is gone; we don't touch it.
+    void complete(session *, response::impl_t *, completion_handler);
+
+    // A session went away in the middle of a transfer.
+    void abandon();
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
@@ -2,6 +2,7 @@
 #define _f37e5b11b9104df39cba822ba7b1820e
 
 #include "core/net/curl/.private/libcurl.h"
+#include "core/net/curl/.private/trace_points.h"
 
 
 namespace intent {
@@ -17,9 +18,21 @@ namespace curl {
 struct easy {
 	CURL * _wrapped;
 	easy() : _wrapped(curl_easy_init()) {}
+	// Adopt a handle, or make one if given nullptr.
+	explicit easy(CURL * adopted) : _wrapped(adopted ? adopted : curl_easy_init()) {}
+	easy(easy const &) = delete;
+	easy & operator =(easy const &) = delete;
 	~easy() {
-		fprintf(stderr, "about to call curl_easy_cleanup\n");
-		curl_easy_cleanup(_wrapped);
+		if (_wrapped) {
+			trace_event(trace::easy_cleanup, 0);
+			curl_easy_cleanup(_wrapped);
+		}
+	}
+	// Give up the handle, without cleaning it up.
+	CURL * release() {
+		auto handle = _wrapped;
+		_wrapped = nullptr;
+		return handle;
 	}
 	// Allow this object to be used as if it were a CURL *.
 	operator CURL *() { return _wrapped; }
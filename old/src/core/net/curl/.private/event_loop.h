@@ -0,0 +1,151 @@
+#ifndef _aaadd96f6d3f4c7f8c31744cba7b23a4
+#define _aaadd96f6d3f4c7f8c31744cba7b23a4
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "asio.hpp"
+
+#include "core/net/curl/channel.h"
+#include "core/net/curl/connection_policy.h"
+#include "core/net/curl/session.h"
+#include "core/net/curl/.private/multi.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * One event pump inside a channel: a thread running an io_service, plus the
+ * curl multi handle whose sockets and timer that io_service watches.
+ *
+ * A multi handle is not thread-safe, so everything that touches it happens on
+ * the loop's own thread; other threads hand work over with post() or
+ * run_sync(). A session is bound to one loop for its whole life, so all of its
+ * transfers share that loop's connection cache.
+ *
+ * Each loop also counts the sessions bound to it, so new ones can go to the
+ * least loaded.
+ */
+struct channel::event_loop {
+
+    /**
+     * A socket that curl asked us to watch. We don't own the descriptor; curl
+     * opens and closes it. We only register it with the reactor.
+     */
+    struct watched_socket {
+        asio::posix::stream_descriptor descriptor;
+        uint64_t serial;
+        int wanted; // most recent CURL_POLL_* that curl asked for
+        bool reading; // a wait for readability is outstanding
+        bool writing; // a wait for writability is outstanding
+
+        watched_socket(asio::io_service &, uint64_t serial);
+        ~watched_socket();
+    };
+
+    typedef std::map<curl_socket_t, std::unique_ptr<watched_socket>> socket_map_t;
+
+    unsigned index; // +<final
+    asio::io_service io_service;
+    std::unique_ptr<asio::io_service::work> work;
+    asio::deadline_timer timeout;
+    socket_map_t sockets;
+    uint64_t next_socket_serial;
+    std::set<session::impl_t *> transfers;
+    // Calls scheduled for transfers (retries, hedges), so they can be
+    // cancelled when the transfer goes away.
+    std::multimap<session::impl_t *, std::shared_ptr<asio::deadline_timer>> timers;
+    // Transfers waiting for their host to be looked up, each with the ticket
+    // its answer carries, so an answer can't start a later transfer.
+    std::map<session::impl_t *, uint64_t> resolving;
+    uint64_t next_resolve_ticket;
+    // Declared after the members above, so it is cleaned up while they still
+    // exist; curl calls back into them during curl_multi_cleanup().
+    struct multi multi;
+    connection_policy policy;
+    int still_running;
+    std::thread runner;
+
+    std::atomic<unsigned> session_count;
+
+    // Written on the loop's thread, read by anyone.
+    std::atomic<uint64_t> finished_transfers;
+    std::atomic<uint64_t> connections_opened;
+    std::atomic<uint64_t> reused_transfers;
+    std::atomic<uint64_t> http2_transfers;
+
+    explicit event_loop(unsigned index);
+    ~event_loop();
+
+    void start();
+    void stop();
+    bool is_running() const;
+    bool is_current_thread() const;
+
+    /**
+     * Run fn on the loop's thread, and wait for it to finish. If we're already
+     * on that thread, or the loop isn't running, fn runs right away.
+     */
+    void run_sync(std::function<void()> const & fn);
+
+    // Safe to call from any thread.
+    void add_transfer(session::impl_t *);
+    void resume_transfer(session::impl_t *, uint32_t session_id);
+
+    // These run on the loop's thread.
+
+    /**
+     * Take a transfer off the loop for good, cancelling anything scheduled
+     * for it, and free its admission slot.
+     */
+    void remove_transfer(session::impl_t *);
+
+    /**
+     * Take a transfer's handle out of the multi handle, but keep it on the
+     * loop (for instance, to wait for a hedge, or a retry).
+     */
+    void suspend_transfer(session::impl_t *);
+
+    /** Suspend a transfer, and start it over after a delay. */
+    void retry_transfer(session::impl_t *, unsigned delay_millisecs);
+
+    /** Call fn after a delay, unless the transfer is removed first. */
+    void run_later(session::impl_t *, unsigned delay_millisecs,
+            std::function<void()> fn);
+
+    void abort_transfers();
+
+    /** Put a channel's connection policy into effect for later transfers. */
+    void set_connection_policy(connection_policy const &);
+
+    bool watch_socket(curl_socket_t fd, int what, watched_socket *);
+    void forget_socket(curl_socket_t fd);
+    void set_timeout(long timeout_ms);
+
+private:
+    void arm(curl_socket_t fd, watched_socket &);
+    void on_socket_ready(curl_socket_t fd, uint64_t serial, int flag,
+            asio::error_code const &);
+    void on_timeout(asio::error_code const &);
+    void act(curl_socket_t fd, int flags);
+    void resolve_then_start(session::impl_t *, bool may_wait);
+    void start_transfer(session::impl_t *);
+    void apply_connection_policy(CURL * easy, char const * url);
+    void count_connections(CURL * easy);
+    void handle_done_transfers();
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
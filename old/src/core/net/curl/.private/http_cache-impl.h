@@ -0,0 +1,204 @@
+#ifndef _58c2e9a07b1d4f3c96e4a0d7b21f8c65
+#define _58c2e9a07b1d4f3c96e4a0d7b21f8c65
+
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "core/filesystem.h"
+#include "core/net/headers.h"
+#include "core/net/curl/http_cache.h"
+#include "core/net/curl/.private/request-impl.h"
+#include "core/net/curl/.private/response-impl.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * A response as the cache keeps it; or, for GETs that were coalesced, what
+ * the shared transfer produced. Never changed once made, so it can be served
+ * to many sessions at once without a lock.
+ */
+struct cached_response {
+    uint16_t status_code;
+    std::vector<std::pair<std::string, std::string>> header_lines;
+    std::string body;
+    std::string url;
+    std::string error; // only for a transfer that failed
+    std::string etag;
+    std::string last_modified;
+    time_t stored_at;
+    time_t fresh_until; // no later than stored_at means always revalidate
+
+    cached_response() : status_code(0), header_lines(), body(), url(), error(),
+            etag(), last_modified(), stored_at(0), fresh_until(0) {
+    }
+
+    bool is_fresh(time_t now) const { return now < fresh_until; }
+    bool has_validator() const { return !etag.empty() || !last_modified.empty(); }
+    size_t get_size() const;
+    net::headers make_headers() const;
+};
+
+typedef std::shared_ptr<cached_response const> cached_response_ptr;
+
+
+/**
+ * The disk tier. Each response's metadata lives in a file named for a hash of
+ * its key; bodies live in files named for a hash of their content, so urls
+ * that return the same bytes share one. The least recently used responses are
+ * dropped once the bodies outgrow the budget; a body goes when the last
+ * response that uses it does.
+ */
+mark(+, threadsafe)
+class content_store {
+    struct entry {
+        std::string blob;
+        uint64_t used; // the clock, at last use
+    };
+    struct blob_info {
+        uint64_t size;
+        unsigned refs;
+    };
+
+    filesystem::path index_folder; // +<final
+    filesystem::path blob_folder; // +<final
+    uint64_t budget; // +<final
+    mutable std::mutex mtx;
+    std::map<std::string, entry> entries; // +<guarded_by(mtx); by key hash
+    std::map<std::string, blob_info> blobs; // +<guarded_by(mtx)
+    uint64_t bytes; // +<guarded_by(mtx)
+    uint64_t clock; // +<guarded_by(mtx)
+
+    void forget(std::string const & key_hash); // caller must lock
+    void shrink(); // caller must lock
+
+public:
+    /** @throw state_error if the folder can't be made. */
+    content_store(filesystem::path const & folder, uint64_t budget);
+
+    cached_response_ptr load(std::string const & key);
+    void save(std::string const & key, cached_response const &);
+    void clear();
+
+    size_t get_entry_count() const;
+    uint64_t get_byte_count() const;
+};
+
+
+struct http_cache::impl_t {
+
+    config cfg; // +<final
+    std::unique_ptr<content_store> disk; // +<final; null without a folder
+
+    mutable std::mutex mtx;
+    typedef std::list<std::pair<std::string, cached_response_ptr>> lru_list;
+    lru_list lru; // +<guarded_by(mtx); most recently used first
+    std::unordered_map<std::string, lru_list::iterator> by_key; // +<guarded_by(mtx)
+    size_t memory_bytes; // +<guarded_by(mtx)
+    // GETs underway, by key, with the sessions waiting on each.
+    typedef std::vector<session::impl_t *> followers;
+    std::map<std::string, followers> in_flight; // +<guarded_by(mtx)
+    // Followers taken from in_flight, but not yet answered.
+    std::multiset<session::impl_t *> answering; // +<guarded_by(mtx)
+    std::condition_variable answered;
+
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> revalidated;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> coalesced;
+    std::atomic<uint64_t> stored;
+
+    enum class plan {
+        serve, // entry is fresh; answer with it
+        follow, // an identical GET is underway; wait for it
+        fetch // go to the server (revalidating entry, if it is set)
+    };
+
+    impl_t(config const &);
+
+    /**
+     * Decide how a session should answer a GET. The session's lock is held;
+     * once it is told to follow, it is completed by whoever finishes the
+     * transfer it waits for.
+     */
+    plan begin(std::string const & key, session::impl_t *, cached_response_ptr & entry);
+
+    /**
+     * A GET that begin() said to fetch is over. Keep what it got, if that's
+     * allowed, and return the sessions that waited for it, to pass to
+     * answer(). Called with the leader's lock held, before it goes idle, so
+     * that whoever waits for it finds the response stored, and a repeat of
+     * the GET can't join a transfer that has already ended.
+     *
+     * @param keep What to store, or null.
+     */
+    followers finish(std::string const & key, cached_response_ptr keep);
+
+    /**
+     * Give the sessions that waited for a GET what it got, and deliver to
+     * their completion queues. Takes their locks, so the caller should hold
+     * none but (at most) the leader's.
+     */
+    void answer(followers const &, cached_response const & outcome);
+
+    /**
+     * A session that was told to follow is going away. If it is being
+     * answered right now, waits until that's done.
+     */
+    void withdraw(std::string const & key, session::impl_t *);
+
+    void clear();
+
+    // Serve entry (or what memory has) if it's fresh, or follow a GET
+    // underway. Caller must lock.
+    plan consider(std::string const & key, session::impl_t *,
+            cached_response_ptr & entry, time_t now);
+
+    // Memory tier. Caller must lock.
+    cached_response_ptr recall(std::string const & key);
+    void remember(std::string const & key, cached_response_ptr);
+    void evict(lru_list::iterator);
+
+    /**
+     * What a cache keys a request by: its url, any headers it sets, since
+     * those may change the answer, and whether it decodes the body.
+     */
+    static std::string get_key(request::impl_t &);
+
+    /**
+     * Turn a finished response into what a cache keeps. Returns null if it
+     * may not be kept.
+     */
+    static cached_response_ptr make_cacheable(response::impl_t &,
+            char const * url, size_t max_bytes, time_t now);
+
+    /** Capture a finished response, kept or not, to share with waiting GETs. */
+    static cached_response_ptr make_snapshot(response::impl_t &, char const * error);
+
+    /** Keep a response's headers, less those about the connection. */
+    static void copy_headers(response::impl_t &, cached_response &);
+
+    /** Apply the headers of a 304 to the copy it confirmed. */
+    static cached_response_ptr refresh(cached_response const & stale,
+            response::impl_t & not_modified, time_t now);
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
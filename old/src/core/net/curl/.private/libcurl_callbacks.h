@@ -15,12 +15,14 @@ namespace curl {
 void mcode_or_die(const char *where, CURLMcode code);
 
 struct libcurl_callbacks {
-    static int on_adjust_timeout(CURLM * multi, long timeout_ms, void * _chimpl);
-    static curl_socket_t on_open_socket(void * _chimpl, curlsocktype purpose, curl_sockaddr *address);
-    static int on_close_socket(void * _chimpl, curl_socket_t item);
-    static int on_socket_update(CURL * easy, curl_socket_t sock, int what, void * _chimpl, void * sockp);
+    static int on_adjust_timeout(CURLM * multi, long timeout_ms, void * _loop);
+    static int on_socket_update(CURL * easy, curl_socket_t sock, int what, void * _loop, void * sockp);
+    static void on_share_lock(CURL * easy, curl_lock_data data, curl_lock_access access, void * _shimpl);
+    static void on_share_unlock(CURL * easy, curl_lock_data data, void * _shimpl);
     static int on_progress(void * _session, uint64_t expected_receive_total, uint64_t received_so_far, uint64_t expected_send_total, uint64_t sent_so_far);
     static size_t on_receive_data(void * bytes, size_t size_per_record, size_t num_records, void * _rimpl);
+    static size_t on_send_data(char * buffer, size_t size_per_record, size_t num_records, void * _simpl);
+    static int on_seek(void * _simpl, curl_off_t offset, int origin);
     static size_t on_receive_header(void * bytes, size_t size_per_record, size_t num_records, void * _rimpl);
 };
 
@@ -0,0 +1,105 @@
+#ifndef _a83f52e0c6d14b9e87b1f4d2c05e6a39
+#define _a83f52e0c6d14b9e87b1f4d2c05e6a39
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "asio.hpp"
+
+#include "core/net/curl/channel.h"
+#include "core/net/curl/transfer_metrics.h"
+#include "core/net/curl/.private/libcurl.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * Collect a channel's transfer metrics, in total and per host, and hand them
+ * to a callback periodically.
+ *
+ * Attempts are recorded on the loop threads, where they finish. Recording
+ * takes no lock: every count is an atomic, and a session finds its host's
+ * recorder once, when it sends a request. A snapshot reads the counts one at
+ * a time, so one taken while transfers finish may catch some of an attempt's
+ * numbers and not the rest.
+ *
+ * The dump runs on a timer on the channel's first event loop, so it only
+ * fires while the channel is open.
+ */
+class channel::metrics {
+public:
+    // Hosts past this many aren't tracked separately, so a channel that
+    // roams over many hosts doesn't grow without end.
+    static constexpr size_t max_hosts = 1000;
+
+    struct histogram {
+        std::atomic<uint64_t> buckets[latency_histogram::bucket_count];
+        std::atomic<uint64_t> sum_usecs;
+        std::atomic<uint64_t> max_usecs;
+
+        histogram();
+        void add(uint64_t usecs);
+        latency_histogram snapshot() const;
+    };
+
+    struct recorder {
+        std::atomic<uint64_t> transfers;
+        std::atomic<uint64_t> failures;
+        std::atomic<uint64_t> retries;
+        std::atomic<uint64_t> bytes_received;
+        std::atomic<uint64_t> bytes_sent;
+        histogram dns;
+        histogram connect;
+        histogram tls;
+        histogram first_byte;
+        histogram total;
+
+        recorder();
+        transfer_metrics snapshot() const;
+    };
+
+    // Dumps run on this io_service's thread.
+    explicit metrics(asio::io_service &);
+    ~metrics();
+
+    /** A host's recorder, or nullptr if there are already max_hosts. */
+    std::shared_ptr<recorder> get_host(std::string const & host);
+
+    /** Count an attempt that just finished on easy. Loop thread only. */
+    void record_attempt(recorder * host, CURL * easy, CURLcode result);
+    void record_retry(recorder * host);
+
+    transfer_metrics get_totals() const;
+    transfer_metrics get_host_totals(std::string const & host) const;
+    transfer_metrics_report get_report() const;
+
+    void set_dump(channel *, unsigned interval_secs, metrics_callback);
+
+private:
+    // These run on the io_service's thread.
+    void arm_dump();
+    void dump();
+
+    asio::io_service & io_service;
+    asio::deadline_timer timer;
+    recorder totals;
+
+    mutable std::mutex mtx;
+    std::map<std::string, std::shared_ptr<recorder>> hosts; // +<guarded_by(mtx)
+    channel * owner; // +<guarded_by(mtx)
+    unsigned dump_interval_secs; // +<guarded_by(mtx)
+    metrics_callback on_dump; // +<guarded_by(mtx)
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
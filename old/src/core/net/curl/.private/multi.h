@@ -27,6 +27,8 @@ struct multi {
 		get_env(flags);
 		_wrapped = curl_multi_init();
 	}
+	multi(multi const &) = delete;
+	multi & operator =(multi const &) = delete;
 	~multi() {
 		curl_multi_cleanup(_wrapped);
 	}
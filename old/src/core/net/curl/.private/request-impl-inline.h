@@ -26,6 +26,17 @@ inline request::impl_t::impl_t(class session * s):
         verb(nullptr),
         url(nullptr),
         headers(),
+        body(),
+        compress_over(0),
+        packed_body(),
+        source(nullptr),
+        decode(true),
+        encodings(),
+        sink(nullptr),
+        priority(0),
+        retries(),
+        hedge_after_millisecs(0),
+        use_cache(true),
         ref_count(1) {
 }
 
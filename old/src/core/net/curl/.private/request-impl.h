@@ -2,8 +2,10 @@
 #define _cde04c2b82b54983831f2f6400d83bb4
 
 #include <atomic>
+#include <string>
 
 #include "core/net/curl/request.h"
+#include "core/net/curl/retry_policy.h"
 #include "core/net/curl/.private/libcurl.h"
 
 
@@ -23,6 +25,17 @@ struct request::impl_t {
     char * verb; // own
     char * url; // own
     headers headers;
+    std::string body;
+    size_t compress_over; // 0 = never
+    std::string packed_body; // body, gzipped for sending
+    body_source * source; // not owned
+    bool decode;
+    std::string encodings; // for Accept-Encoding, if decode
+    body_sink * sink; // not owned
+    int priority;
+    retry_policy retries;
+    unsigned hedge_after_millisecs; // 0 = never
+    bool use_cache;
     mutable std::atomic<unsigned> ref_count;
 
     impl_t(class session *);
@@ -0,0 +1,132 @@
+#ifndef _9d27f4b0e1c84a6f8b3e5c0a71d2f968
+#define _9d27f4b0e1c84a6f8b3e5c0a71d2f968
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <ares.h>
+
+#include "asio.hpp"
+
+#include "core/net/curl/channel.h"
+#include "core/net/curl/resolve_policy.h"
+#include "core/net/curl/.private/libcurl.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * A channel's resolve cache, and the c-ares channel that fills it.
+ *
+ * c-ares is driven by the io_service of the channel's first event loop: its
+ * sockets are watched by the same reactor that watches curl's, and its
+ * timeouts run on a timer there. Everything that touches the ares channel
+ * happens on that thread; the cache itself is guarded by a mutex, so
+ * transfers on any loop can consult it.
+ *
+ * Answers reach curl as CURLOPT_RESOLVE entries on each transfer's handle,
+ * which curl loads into its own DNS cache when the transfer starts. They are
+ * written "+host:port:addresses", so curl lets them expire like its own
+ * answers, rather than keeping them forever.
+ */
+class channel::resolver {
+public:
+    // Lookups run on this io_service's thread.
+    explicit resolver(asio::io_service &);
+    ~resolver();
+
+    void set_policy(resolve_policy const &);
+    resolve_policy get_policy() const;
+    resolve_stats get_stats() const;
+
+    /**
+     * Pin a host and port to addresses, or (with empty addresses) unpin it.
+     */
+    void set_override(std::string const & host, unsigned port,
+            std::string const & addresses);
+
+    /**
+     * Work out the CURLOPT_RESOLVE entries for a transfer to url, replacing
+     * whatever entries holds.
+     *
+     * @param ready If the url's host has to be looked up first, called (on
+     *     the resolver's thread) once the answer is in the cache, and
+     *     prepare() returns false. Empty means don't wait (as after waiting
+     *     once): a lookup goes on in the background, and curl resolves the
+     *     host itself this time.
+     * @return true if entries are ready now.
+     */
+    bool prepare(char const * url, curl_slist *& entries,
+            std::function<void()> ready);
+
+private:
+    typedef std::chrono::steady_clock::time_point steady_time;
+
+    struct entry {
+        std::string addresses; // empty if the lookup failed
+        steady_time resolved;
+        steady_time expires;
+    };
+
+    // A socket c-ares asked us to watch; c-ares owns the descriptor.
+    struct watched_socket {
+        asio::posix::stream_descriptor descriptor;
+        uint64_t serial;
+        bool want_read;
+        bool want_write;
+        bool reading;
+        bool writing;
+
+        watched_socket(asio::io_service &, uint64_t serial);
+        ~watched_socket();
+    };
+
+    struct query;
+
+    // Call with mtx held.
+    void start_lookup(std::string const & host);
+    void evict(steady_time now);
+
+    // These run on the io_service's thread.
+    void lookup(std::string const & host);
+    void on_answer(std::string const & host, int status, ares_addrinfo *);
+    void arm(ares_socket_t fd, watched_socket &);
+    void on_socket_ready(ares_socket_t fd, uint64_t serial, bool read,
+            asio::error_code const &);
+    void reset_timer();
+
+    static void on_socket_state(void * data, ares_socket_t fd, int readable,
+            int writable);
+    static void on_addrinfo(void * arg, int status, int timeouts, ares_addrinfo *);
+
+    asio::io_service & io_service;
+    asio::deadline_timer timer;
+    std::map<ares_socket_t, std::unique_ptr<watched_socket>> sockets;
+    uint64_t next_socket_serial;
+    ares_channel ares;
+    bool ares_ready;
+
+    mutable std::mutex mtx;
+    resolve_policy policy; // +<guarded_by(mtx)
+    std::map<std::string, entry> cache; // +<guarded_by(mtx)
+    // Lookups underway, and the transfers waiting on each.
+    std::map<std::string, std::vector<std::function<void()>>> pending; // +<guarded_by(mtx)
+    // "host:port" to addresses, as curl writes them.
+    std::map<std::string, std::string> overrides; // +<guarded_by(mtx)
+    resolve_stats stats; // +<guarded_by(mtx)
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
@@ -19,11 +19,14 @@ inline response::impl_t::impl_t(class session * s) :
         session_owned_by_me(false),
         headers(),
         received_bytes(),
+        sink(nullptr),
         expected_receive_total(0),
+        received_byte_count(0),
         sent_byte_count(0),
         expected_send_total(0),
         status_code(0),
         effective_url(nullptr),
+        cache(cache_outcome::none),
         ref_count(1) {
 }
 
@@ -23,11 +23,14 @@ struct response::impl_t {
 	bool session_owned_by_me; // only true if using invisible sessions
 	headers headers;
 	std::string received_bytes;
+	body_sink * sink; // not owned; if set, received bytes go here instead
 	size_t expected_receive_total;
+	size_t received_byte_count;
 	size_t sent_byte_count;
 	size_t expected_send_total;
 	uint16_t status_code;
 	char * effective_url;
+	cache_outcome cache;
 	mutable std::atomic<unsigned> ref_count;
 
 	impl_t(class session *);
@@ -45,6 +48,12 @@ struct response::impl_t {
 			uint64_t sent_so_far);
 
 	void cleanup_after_transfer();
+
+	/** Forget what a failed attempt received, before the next one. */
+	void clear_for_retry();
+
+	/** Take what another response (a winning hedge) received. */
+	void adopt_body(impl_t & other);
 };
 
 
@@ -0,0 +1,158 @@
+#ifndef _f2855f2c78bd4b45923c165eca494c42
+#define _f2855f2c78bd4b45923c165eca494c42
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "asio.hpp"
+
+#include "core/net/curl/admission.h"
+#include "core/net/curl/channel.h"
+#include "core/net/curl/session.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+typedef std::chrono::steady_clock::time_point steady_time;
+
+
+/**
+ * Allow events at a steady rate, with bursts up to a fixed size.
+ */
+struct token_bucket {
+    double rate; // tokens per second; 0 means unlimited
+    double capacity;
+    double tokens;
+    steady_time last;
+
+    token_bucket();
+
+    void configure(admission_limits const &, steady_time now);
+
+    // Refill for the time that has passed, and say whether a token is ready.
+    bool ready(steady_time now);
+    void spend();
+    bool is_full() const;
+
+    // How long until ready() will be true. Call after ready() said false.
+    std::chrono::microseconds time_to_next() const;
+};
+
+
+/**
+ * Decide when each transfer a channel is asked for actually starts.
+ *
+ * Sent transfers wait in a queue per host, highest priority first, until
+ * their host and the channel both have a free slot and a token. Whenever a
+ * transfer finishes or a token comes due, the hosts are visited round robin,
+ * so a host with a deep queue can't starve the others; within a visit, the
+ * highest priority waiting anywhere goes first.
+ *
+ * All methods are safe to call from any thread. Starting a transfer only
+ * posts it to its event loop, so the mutex is never held for long.
+ */
+class channel::scheduler {
+public:
+    // The timer is run by the channel's first event loop.
+    explicit scheduler(asio::io_service &);
+    ~scheduler();
+
+    void set_channel_limits(admission_limits const &);
+    void set_default_host_limits(admission_limits const &);
+    void set_host_limits(std::string const & host, admission_limits const &);
+    admission_stats get_channel_stats() const;
+    admission_stats get_host_stats(std::string const & host) const;
+
+    /** Queue a transfer, and start whatever may start. */
+    void submit(session::impl_t *, char const * url, int priority);
+
+    /**
+     * A transfer is over; free its slot. Does nothing for a transfer that
+     * never started.
+     */
+    void release(session::impl_t *);
+
+    /**
+     * Take a transfer out of the queue, if it's still waiting there.
+     *
+     * @return true if it was waiting.
+     */
+    bool withdraw(session::impl_t *);
+
+    /** Start transfers again, after close(). */
+    void open();
+
+    /**
+     * Stop starting transfers. Those already waiting stay queued, until
+     * taken with take_waiting().
+     */
+    void close();
+
+    /** Empty the queue of the transfers that run on one event loop. */
+    std::vector<session::impl_t *> take_waiting(event_loop *);
+
+    /** The part of a url that identifies its host: host name and port. */
+    static std::string get_host_key(char const * url);
+
+private:
+    struct pending {
+        int priority;
+        uint64_t serial;
+        session::impl_t * simpl;
+        bool operator <(pending const & other) const;
+    };
+
+    struct host_state {
+        admission_limits limits;
+        bool has_own_limits;
+        token_bucket bucket;
+        std::set<pending> queue;
+        size_t in_flight;
+        uint64_t admitted;
+        uint64_t delayed;
+
+        bool is_idle() const { return queue.empty() && !in_flight; }
+    };
+
+    typedef std::map<std::string, host_state> host_map_t;
+
+    host_state & get_host(std::string const & host, steady_time now);
+    bool may_start(host_state &, steady_time now);
+    void pump();
+    void forget_if_idle(host_map_t::iterator);
+    void arm_timer(steady_time due);
+    void on_timer(asio::error_code const &);
+
+    mutable std::mutex mtx;
+    bool closed; // +<guarded_by(mtx)
+    admission_limits channel_limits; // +<guarded_by(mtx)
+    admission_limits default_host_limits; // +<guarded_by(mtx)
+    token_bucket channel_bucket; // +<guarded_by(mtx)
+    size_t in_flight; // +<guarded_by(mtx)
+    size_t queued; // +<guarded_by(mtx)
+    uint64_t admitted; // +<guarded_by(mtx)
+    uint64_t delayed; // +<guarded_by(mtx)
+    uint64_t next_serial; // +<guarded_by(mtx)
+    host_map_t hosts; // +<guarded_by(mtx)
+    std::string cursor; // +<guarded_by(mtx); the host visited last
+    std::map<session::impl_t *, host_map_t::iterator> waiting; // +<guarded_by(mtx)
+    std::map<session::impl_t *, host_map_t::iterator> running; // +<guarded_by(mtx)
+    asio::deadline_timer timer; // +<guarded_by(mtx)
+    bool timer_armed; // +<guarded_by(mtx)
+    steady_time timer_due; // +<guarded_by(mtx)
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
@@ -15,16 +15,41 @@ namespace curl {
 uint32_t get_next_session_id();
 
 
-inline session::impl_t::impl_t(session * wrapped, class channel * ch):
+inline session::impl_t::impl_t(session * wrapped, class channel * ch,
+        CURL * recycled):
         id(get_next_session_id()),
+        slot(util::slot_table<session>::none),
         wrapper(wrapped),
         channel(ch),
+        loop(nullptr),
         mtx(),
         current_request(new request::impl_t(wrapped)),
         current_response(new response::impl_t(wrapped)),
-        easy(),
+        shared(),
+        easy(recycled),
         state(session_state::configuring),
-        curl_socket_state(CURL_POLL_NONE) {
+        paused(false),
+        source(nullptr),
+        source_ended(false),
+        verbose(false),
+        breaker(),
+        retries(),
+        idempotent(true),
+        attempt(0),
+        body_delivered(false),
+        hedge_after_millisecs(0),
+        hedge(nullptr),
+        hedge_of(nullptr),
+        awaiting_hedge(false),
+        parked_result(CURLE_OK),
+        completions(),
+        on_complete(),
+        header_list(nullptr),
+        resolve_list(nullptr),
+        cache(),
+        cache_key(),
+        cache_leading(false),
+        stale() {
     error[0] = 0;
 }
 
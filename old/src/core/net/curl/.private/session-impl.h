@@ -6,11 +6,19 @@
 #include <cstdint>
 #include <map>
 #include <mutex>
+#include <string>
 
+#include "core/err/circuit_breaker.h"
+#include "core/net/curl/completion_queue.h"
+#include "core/net/curl/http_cache.h"
 #include "core/net/curl/request.h"
 #include "core/net/curl/response.h"
+#include "core/net/curl/retry_policy.h"
 #include "core/net/curl/session.h"
+#include "core/net/curl/shared_state.h"
 #include "core/net/curl/.private/easy.h"
+#include "core/net/curl/.private/metrics.h"
+#include "core/util/slot_table.h"
 
 
 namespace intent {
@@ -18,31 +26,146 @@ namespace core {
 namespace net {
 namespace curl {
 
+struct cached_response;
 struct timeout;
 
 
 struct session::impl_t /* --<threadsafe */ {
 
+    /**
+     * A finished response that still has to reach its completion_queue.
+     * Taken under the session's lock, delivered after releasing it, since the
+     * queue's handler may do anything (including destroy the session).
+     */
+    struct delivery {
+        std::shared_ptr<completion_queue::impl_t> queue;
+        completion_queue::completion_handler handler;
+        session * from;
+        response::impl_t * done; // holds a ref until delivered
+
+        delivery() : queue(), handler(), from(nullptr), done(nullptr) {}
+        void deliver();
+    };
+
     uint32_t id; // +<final
+    uint32_t slot; // in the channel's session table, while attached
     session * wrapper;
     channel * channel;
+    channel::event_loop * loop; // chosen by channel::attach()
     std::mutex mtx;
     std::condition_variable state_signal;
     request::impl_t * current_request;
     response::impl_t * current_response;
+    // Declared before easy, so the pool outlives the handle that uses it.
+    shared_state shared;
     struct easy easy;
     char error[CURL_ERROR_SIZE];
     std::atomic<session_state> state;
-    int curl_socket_state;
-
-    impl_t(session *, class channel *);
+    bool paused; // a body sink was full, or a source empty; loop thread only
+    // Where the current transfer's body comes from, if not a string. Not
+    // owned. Read only on the loop's thread.
+    body_source * source;
+    bool source_ended;
+    bool verbose; // let curl narrate transfers on stderr
+
+    // How the current send copes with failure. Set up by send(); after that,
+    // touched only on the loop's thread.
+    std::shared_ptr<err::circuit_breaker> breaker; // the host's, if enabled
+    std::shared_ptr<channel::metrics::recorder> host_meter; // may be null
+    retry_policy retries;
+    bool idempotent;
+    unsigned attempt; // 1 for the first
+    bool body_delivered; // some went to a sink, so we can't start over
+    unsigned hedge_after_millisecs;
+    session * hedge; // own; made the first time we hedge
+    impl_t * hedge_of; // on a hedge: the session it races for
+    bool awaiting_hedge; // we failed, but our hedge may yet succeed
+    CURLcode parked_result;
+
+    // Where the current transfer's response goes when it is done, if it was
+    // sent through a completion_queue. Guarded by mtx.
+    std::shared_ptr<completion_queue::impl_t> completions;
+    completion_queue::completion_handler on_complete;
+
+    // The request's headers, as curl wants them. Own.
+    curl_slist * header_list;
+    // CURLOPT_RESOLVE entries for the current transfer; set on the loop's
+    // thread. Own.
+    curl_slist * resolve_list;
+
+    // How the current GET uses the channel's http cache, if at all. Guarded by
+    // mtx. A session either leads (its transfer answers every identical GET
+    // sent meanwhile) or follows (it has no transfer; the leader answers it).
+    std::shared_ptr<http_cache::impl_t> cache;
+    std::string cache_key;
+    bool cache_leading;
+    std::shared_ptr<cached_response const> stale; // what a leader revalidates
+
+    // A recycled handle must already be reset; otherwise, we make one.
+    impl_t(session *, class channel *, CURL * recycled = nullptr);
     ~impl_t();
 
+    // Do what the destructor does, short of freeing memory: finish with any
+    // transfer, leave the channel, and let go of the request and response.
+    // Safe to call more than once.
+    void retire();
+
     // Implements response::wait(). See its doc comment for semantics.
     bool wait(unsigned timeout_millisecs);
 
-    // Implements respone::impl_t::cleanup_after_transfer().
-    void cleanup_after_transfer();
+    // Implements respone::impl_t::cleanup_after_transfer(). The result is
+    // CURLE_OK unless the transfer failed or was abandoned. The status and
+    // effective url come from source's handle; by default, our own.
+    void cleanup_after_transfer(CURLcode result = CURLE_OK, impl_t * source = nullptr);
+
+    // Point the easy handle at a request, and at our response.
+    void configure_transfer(request::impl_t *);
+
+    // End a send that never started. Caller must lock.
+    void fail_fast(char const * why);
+
+    // See whether the channel's http cache answers a request, or sets up the
+    // transfer as its leader. Returns true if no transfer is needed. Caller
+    // must lock.
+    bool consult_cache(request::impl_t *);
+
+    // Answer from what the cache holds, or what a leader got. Caller must lock.
+    void answer_from(cached_response const &, cache_outcome);
+
+    // A leader's transfer is over. If the server confirmed our stale copy,
+    // answer with it. Returns what the cache may keep (or null), and sets
+    // outcome to what the followers get. Caller must lock.
+    std::shared_ptr<cached_response const> settle_cache(CURLcode result,
+            std::shared_ptr<cached_response const> & outcome);
+
+    // Hand the current response to our completion queue, if it has one. Caller
+    // must lock. Returns false if there is no queue.
+    bool take_completion(delivery &);
+
+    // The loop calls this when curl is done with a transfer. Decides whether
+    // to retry, to wait for a hedge, or to finish.
+    void finish_attempt(CURLcode result);
+
+    // Start a duplicate of the current transfer, and let them race.
+    void start_hedge();
+    void on_hedge_done(impl_t * h, bool ok, CURLcode result);
+    void cancel_hedge();
+
+    // Unhook the response's body sink, if any, and tell it the body is over.
+    void release_body_sink(bool ok);
+
+    // Fill curl's upload buffer from our body source. Returns what curl's read
+    // callback should.
+    size_t read_body(char * buffer, size_t capacity);
+
+    // Start the body over. False if the source can't.
+    bool rewind_body();
+
+    // Unhook our body source, if any, and tell it the transfer is over.
+    void release_body_source(bool ok);
+
+    // Point the easy handle at a (possibly empty) pool of shared state.
+    void use_shared_state(shared_state const &);
 };
 
 
@@ -0,0 +1,74 @@
+#ifndef _e4a2c7f05b9d4c1e8f36d0b71a95c28e
+#define _e4a2c7f05b9d4c1e8f36d0b71a95c28e
+
+#include <atomic>
+#include <cstdint>
+
+#include "core/net/curl/channel.h"
+#include "core/net/curl/session.h"
+#include "core/net/curl/.private/libcurl.h"
+#include "core/util/slot_table.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * Keep what destroyed sessions leave behind, for the channel's next sessions:
+ * the memory of their impl_t, and their easy handles, reset with
+ * curl_easy_reset(). A handle keeps the buffers curl allocated for it, so a
+ * recycled session costs neither a trip to the allocator nor curl_easy_init().
+ *
+ * Sessions are made and destroyed on any thread, so the pool takes no lock:
+ * spares sit in a fixed array, and two index_stacks track which entries are
+ * full and which are free. Once the array is full, sessions are freed as
+ * usual.
+ */
+class channel::session_pool {
+public:
+    session_pool();
+    ~session_pool();
+
+    /** A new session's impl, built from a spare if there is one. */
+    session::impl_t * make(session * wrapper, channel *);
+
+    /**
+     * Retire a session's impl, as its destructor would, and keep its memory
+     * and handle if there's room.
+     */
+    void recycle(session::impl_t *);
+
+    /** Spares on hand. */
+    size_t get_spare_count() const;
+
+private:
+    static constexpr uint32_t capacity = 256;
+
+    struct spare {
+        void * memory;
+        CURL * easy;
+        std::atomic<uint32_t> next; // while on a stack
+    };
+
+    // How the stacks find a spare's link.
+    struct links {
+        spare * spares;
+        std::atomic<uint32_t> & operator ()(uint32_t i) const {
+            return spares[i].next;
+        }
+    };
+
+    spare spares[capacity];
+    util::index_stack full;
+    util::index_stack empty;
+    std::atomic<size_t> spare_count;
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
@@ -1,6 +1,11 @@
 #ifndef _3177ced09a404921a53553991123de3e
 #define _3177ced09a404921a53553991123de3e
 
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include "core/net/curl/shared_state.h"
 #include "core/net/curl/.private/libcurl.h"
 
 
@@ -26,6 +31,37 @@ struct share {
 };
 
 
+struct shared_state::impl_t {
+
+    sharing what; // +<final
+    // One lock per kind of data, so e.g. a DNS lookup doesn't wait on a
+    // cookie update. Indexed by curl_lock_data.
+    std::mutex locks[CURL_LOCK_DATA_LAST];
+
+    // Sessions that share connections must all run on one event loop. The
+    // first one to attach picks it. We remember ids rather than pointers,
+    // because the pool can outlive the channel.
+    std::mutex home_mtx;
+    bool has_home; // +<guarded_by(home_mtx)
+    uint32_t home_channel_id; // +<guarded_by(home_mtx)
+    unsigned home_loop_index; // +<guarded_by(home_mtx)
+
+    mutable std::atomic<unsigned> ref_count;
+
+    // Declared last, so it's cleaned up while the locks still exist.
+    struct share share;
+
+    explicit impl_t(sharing);
+
+    void add_ref() const { ++ref_count; }
+    void release_ref() const {
+        if (ref_count.fetch_sub(1) == 1) {
+            delete this;
+        }
+    }
+};
+
+
 }}}} // end namespace
 
 
@@ -0,0 +1,55 @@
+#ifndef _d27b6e0c85f34a1b9e6a04c3f1b75d28
+#define _d27b6e0c85f34a1b9e6a04c3f1b75d28
+
+#include "core/dev/trace.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+namespace trace {
+
+
+using dev::trace_level;
+using dev::trace_point;
+
+// Subjects are session ids unless noted.
+
+static constexpr trace_point send = {
+        "curl.send", "priority {1}", trace_level::info};
+static constexpr trace_point failed_fast = {
+        "curl.failed_fast", "circuit breaker is open", trace_level::warn};
+static constexpr trace_point retry = {
+        "curl.retry", "attempt {1} in {2} ms, after curl code {3}", trace_level::info};
+static constexpr trace_point hedge = {
+        "curl.hedge", "racing session {1}", trace_level::info};
+static constexpr trace_point cache = {
+        "curl.cache", "outcome {1}", trace_level::info};
+static constexpr trace_point done = {
+        "curl.done", "curl code {1}, status {2}", trace_level::info};
+static constexpr trace_point wait = {
+        "curl.wait", "state {1}, timeout {2} ms", trace_level::debug};
+static constexpr trace_point session_gone = {
+        "curl.session_gone", "", trace_level::debug};
+static constexpr trace_point easy_cleanup = {
+        "curl.easy_cleanup", "", trace_level::debug};
+// Subject is a channel id.
+static constexpr trace_point channel_gone = {
+        "curl.channel_gone", "", trace_level::debug};
+// Subject is a response id.
+static constexpr trace_point progress = {
+        "curl.progress", "expected {1}, received {2}, sent {3}", trace_level::debug};
+static constexpr trace_point empty_header = {
+        "curl.empty_header", "", trace_level::debug};
+// Subject is a loop index.
+static constexpr trace_point unwatchable = {
+        "curl.unwatchable", "socket {1}, errno {2}", trace_level::warn};
+static constexpr trace_point multi_error = {
+        "curl.multi_error", "CURLMcode {1}", trace_level::error};
+
+
+}}}}} // end namespace
+
+
+#endif // sentry
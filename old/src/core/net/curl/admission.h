@@ -0,0 +1,66 @@
+#ifndef _9c88062ab64f498ab6b8588b95bf3572
+#define _9c88062ab64f498ab6b8588b95bf3572
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * Limits on how fast, and how many, transfers are started. They apply either
+ * to a whole channel, or to each host separately. A zero means no limit.
+ *
+ *     ch.set_host_admission_limits(admission_limits(10, 20, 6));
+ *
+ * lets each host see at most 6 transfers at once, and at most 10 new ones per
+ * second, after an initial burst of up to 20.
+ */
+struct admission_limits {
+    /** Long-run rate at which transfers may start. */
+    double requests_per_second;
+    /**
+     * How many transfers may start back to back after a quiet spell. 0 means
+     * the larger of 1 and requests_per_second.
+     */
+    unsigned burst;
+    /** How many transfers may be underway at once. */
+    unsigned max_in_flight;
+
+    admission_limits(double requests_per_second = 0, unsigned burst = 0,
+            unsigned max_in_flight = 0) :
+            requests_per_second(requests_per_second), burst(burst),
+            max_in_flight(max_in_flight) {
+    }
+
+    bool is_unlimited() const {
+        return requests_per_second <= 0 && !max_in_flight;
+    }
+};
+
+
+/**
+ * A snapshot of admission control for a channel, or one host.
+ */
+struct admission_stats {
+    /** Transfers sent, but held back by the limits. */
+    size_t queued;
+    /** Transfers started and not yet done. */
+    size_t in_flight;
+    /** Transfers started so far. */
+    uint64_t admitted;
+    /** Of those, how many had to wait in the queue first. */
+    uint64_t delayed;
+    /** Hosts with transfers queued. Always 0 for a host. */
+    size_t waiting_hosts;
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
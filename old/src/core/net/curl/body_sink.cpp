@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "core/net/curl/body_sink.h"
+#include "core/util/dbc.h"
+
+
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+body_sink::body_sink() : resume_mtx(), resumer() {
+}
+
+
+body_sink::~body_sink() {
+}
+
+
+void body_sink::finish(bool) {
+}
+
+
+void body_sink::resume() {
+    lock_guard<mutex> lock(resume_mtx);
+    if (resumer) {
+        resumer();
+    }
+}
+
+
+fd_body_sink::fd_body_sink(int f) : fd(f), byte_count(0), error(0) {
+    precondition(f >= 0);
+}
+
+
+sink_result fd_body_sink::accept(char const * bytes, size_t n) {
+    while (n) {
+        auto written = ::write(fd, bytes, n);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = errno;
+            return sink_result::failed;
+        }
+        bytes += written;
+        n -= static_cast<size_t>(written);
+        byte_count += static_cast<uint64_t>(written);
+    }
+    return sink_result::accepted;
+}
+
+
+buffer_pool_body_sink::buffer_pool_body_sink() : mtx(), filled_signal(),
+        empties(), filled(), current{nullptr, 0, 0}, paused(false),
+        finished(false), ok(false) {
+}
+
+
+void buffer_pool_body_sink::give(char * buffer, size_t capacity) {
+    precondition(buffer && capacity);
+    bool was_paused;
+    {
+        lock_guard<mutex> lock(mtx);
+        empties.push_back(chunk{buffer, 0, capacity});
+        was_paused = paused;
+        paused = false;
+    }
+    if (was_paused) {
+        resume();
+    }
+}
+
+
+sink_result buffer_pool_body_sink::accept(char const * bytes, size_t n) {
+    {
+        lock_guard<mutex> lock(mtx);
+        size_t room = current.capacity - current.size;
+        for (auto & e : empties) {
+            room += e.capacity;
+        }
+        if (room < n) {
+            paused = true;
+            return sink_result::full;
+        }
+        while (n) {
+            if (current.size == current.capacity) {
+                if (current.data) {
+                    filled.push_back(current);
+                }
+                current = empties.front();
+                empties.pop_front();
+            }
+            size_t len = std::min(n, current.capacity - current.size);
+            memcpy(current.data + current.size, bytes, len);
+            current.size += len;
+            bytes += len;
+            n -= len;
+        }
+        if (current.size == current.capacity) {
+            filled.push_back(current);
+            current = chunk{nullptr, 0, 0};
+        }
+    }
+    filled_signal.notify_all();
+    return sink_result::accepted;
+}
+
+
+void buffer_pool_body_sink::finish(bool succeeded) {
+    {
+        lock_guard<mutex> lock(mtx);
+        if (current.size) {
+            filled.push_back(current);
+            current = chunk{nullptr, 0, 0};
+        }
+        finished = true;
+        ok = succeeded;
+    }
+    filled_signal.notify_all();
+}
+
+
+bool buffer_pool_body_sink::take(chunk & out, unsigned timeout_millisecs) {
+    unique_lock<mutex> lock(mtx);
+    filled_signal.wait_for(lock, std::chrono::milliseconds(timeout_millisecs),
+            [this] { return finished || !filled.empty(); });
+    if (filled.empty()) {
+        return false;
+    }
+    out = filled.front();
+    filled.pop_front();
+    return true;
+}
+
+
+bool buffer_pool_body_sink::is_finished() const {
+    lock_guard<mutex> lock(mtx);
+    return finished;
+}
+
+
+bool buffer_pool_body_sink::succeeded() const {
+    lock_guard<mutex> lock(mtx);
+    return finished && ok;
+}
+
+
+}}}} // end namespace
@@ -0,0 +1,174 @@
+#ifndef _66f7fd5d562c4c84a8cd092db617d2b8
+#define _66f7fd5d562c4c84a8cd092db617d2b8
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#include "core/marks/concurrency_marks.h"
+#include "core/net/curl/fwd.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * What a body_sink did with the bytes it was offered.
+ */
+enum class sink_result {
+    /** All of the bytes were consumed. */
+    accepted,
+    /**
+     * None of the bytes were consumed, because the consumer is behind. The
+     * transfer pauses until the sink calls resume(); then the same bytes are
+     * offered again. The server is throttled by TCP flow control meanwhile,
+     * so nothing piles up in memory.
+     */
+    full,
+    /** Abandon the transfer. */
+    failed,
+};
+
+
+/**
+ * A destination for a response body, for bodies too big (or too hot) to
+ * collect in the response. Bytes go from curl's receive buffer straight to the
+ * sink; the response keeps no copy.
+ *
+ *     fd_body_sink sink(fd);
+ *     auto req = s.reset();
+ *     req.set_url(url);
+ *     req.set_body_sink(&sink);
+ *     s.send().wait();
+ *
+ * accept() and finish() are called on the event loop that runs the transfer,
+ * so they should be quick; a sink that hands data to a slower consumer should
+ * return sink_result::full rather than block, and resume() when the consumer
+ * catches up. They must not call back into the session.
+ */
+class body_sink {
+    friend class session;
+
+    std::mutex resume_mtx;
+    std::function<void()> resumer; // +<guarded_by(resume_mtx)
+
+public:
+    body_sink();
+    virtual ~body_sink();
+
+    /**
+     * Take the next bytes of the body. Chunks are at most CURL_MAX_WRITE_SIZE
+     * (16 KB) long.
+     */
+    virtual sink_result accept(char const * bytes, size_t byte_count) = 0;
+
+    /**
+     * Called once when the transfer is over.
+     *
+     * @param ok false if the transfer failed or was abandoned, in which case
+     *     the body is incomplete.
+     */
+    virtual void finish(bool ok);
+
+protected:
+    /**
+     * Continue a transfer that accept() paused by returning sink_result::full.
+     * Safe to call from any thread at any time; it does nothing if no
+     * transfer is paused.
+     */
+    void resume();
+};
+
+
+/**
+ * Write a body to a file descriptor as it arrives. The descriptor is not
+ * owned.
+ */
+class fd_body_sink : public body_sink {
+    int fd;
+    uint64_t byte_count;
+    int error;
+
+public:
+    explicit fd_body_sink(int fd);
+
+    virtual sink_result accept(char const * bytes, size_t byte_count);
+
+    uint64_t get_byte_count() const { return byte_count; }
+
+    /** The errno value that stopped the transfer, or 0. */
+    int get_error() const { return error; }
+};
+
+
+/**
+ * Deliver a body into buffers that the caller owns and recycles, so a
+ * consumer on another thread can work through a body of any size in bounded
+ * memory:
+ *
+ *     buffer_pool_body_sink sink;
+ *     for (auto & b : my_buffers) sink.give(b.data, b.size);
+ *     ...send...
+ *     buffer_pool_body_sink::chunk c;
+ *     while (sink.take(c)) {
+ *         consume(c.data, c.size);
+ *         sink.give(c.data, c.capacity);
+ *     }
+ *
+ * When every buffer is full, the transfer pauses until one is given back.
+ * Buffers should add up to at least 16 KB, the most curl delivers at once.
+ */
+mark(+, threadsafe)
+class buffer_pool_body_sink : public body_sink {
+public:
+    struct chunk {
+        char * data;
+        size_t size; // bytes of body in data
+        size_t capacity;
+    };
+
+    buffer_pool_body_sink();
+
+    /** Lend the sink an empty buffer to fill. */
+    void give(char * buffer, size_t capacity);
+
+    /**
+     * Wait for the next buffer with body in it. Every buffer but the last one
+     * is full.
+     *
+     * @return false if the body has ended and every filled buffer has been
+     *     taken, or on timeout.
+     */
+    bool take(chunk & out, unsigned timeout_millisecs = 60000);
+
+    /** Has the transfer ended? */
+    bool is_finished() const;
+
+    /** Did the transfer end well? Only meaningful once finished. */
+    bool succeeded() const;
+
+    virtual sink_result accept(char const * bytes, size_t byte_count);
+    virtual void finish(bool ok);
+
+private:
+    mutable std::mutex mtx;
+    std::condition_variable filled_signal;
+    std::deque<chunk> empties; // +<guarded_by(mtx)
+    std::deque<chunk> filled; // +<guarded_by(mtx)
+    chunk current; // +<guarded_by(mtx)
+    bool paused; // +<guarded_by(mtx)
+    bool finished; // +<guarded_by(mtx)
+    bool ok; // +<guarded_by(mtx)
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core/net/curl/body_source.h"
+#include "core/util/dbc.h"
+
+
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+constexpr uint64_t body_source::unknown_size;
+
+
+body_source::body_source() : resume_mtx(), resumer() {
+}
+
+
+body_source::~body_source() {
+}
+
+
+uint64_t body_source::get_size() const {
+    return unknown_size;
+}
+
+
+bool body_source::rewind() {
+    return false;
+}
+
+
+void body_source::finish(bool) {
+}
+
+
+void body_source::resume() {
+    lock_guard<mutex> lock(resume_mtx);
+    if (resumer) {
+        resumer();
+    }
+}
+
+
+span_body_source::span_body_source(void const * d, size_t n) :
+        data(static_cast<char const *>(d)), size(n), offset(0) {
+    precondition(d || !n);
+}
+
+
+span_body_source::span_body_source() : data(nullptr), size(0), offset(0) {
+}
+
+
+uint64_t span_body_source::get_size() const {
+    return size;
+}
+
+
+stream_state span_body_source::read(char * buffer, size_t capacity, size_t & n) {
+    n = std::min(capacity, size - offset);
+    memcpy(buffer, data + offset, n);
+    offset += n;
+    return offset == size ? stream_state::finished : stream_state::more;
+}
+
+
+bool span_body_source::rewind() {
+    offset = 0;
+    return true;
+}
+
+
+mapped_file_body_source::mapped_file_body_source(filesystem::path const & fpath) :
+        file(fpath, io::mapped_file::access::read_only, io::map_hints::sequential) {
+    data = file.begin();
+    size = file.size();
+}
+
+
+fd_body_source::fd_body_source(int f) : fd(f), start(-1), size(unknown_size),
+        byte_count(0), error(0) {
+    precondition(f >= 0);
+    start = lseek(fd, 0, SEEK_CUR);
+    struct stat info;
+    if (start >= 0 && fstat(fd, &info) == 0 && S_ISREG(info.st_mode)
+            && info.st_size >= start) {
+        size = static_cast<uint64_t>(info.st_size - start);
+    }
+}
+
+
+uint64_t fd_body_source::get_size() const {
+    return size;
+}
+
+
+stream_state fd_body_source::read(char * buffer, size_t capacity, size_t & n) {
+    n = 0;
+    for (;;) {
+        auto got = ::read(fd, buffer, capacity);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = errno;
+            return stream_state::premature_close;
+        }
+        n = static_cast<size_t>(got);
+        byte_count += n;
+        return n ? stream_state::more : stream_state::finished;
+    }
+}
+
+
+bool fd_body_source::rewind() {
+    if (start < 0 || lseek(fd, start, SEEK_SET) != start) {
+        return false;
+    }
+    byte_count = 0;
+    return true;
+}
+
+
+producer_body_source::producer_body_source(size_t capacity) : mtx(),
+        room_signal(), ring(capacity), head(0), count(0), closed(false),
+        waiting(false), finished(false), ok(false) {
+    precondition(capacity > 0);
+}
+
+
+bool producer_body_source::write(void const * bytes, size_t n,
+        unsigned timeout_millisecs) {
+    auto p = static_cast<char const *>(bytes);
+    auto deadline = std::chrono::steady_clock::now()
+            + std::chrono::milliseconds(timeout_millisecs);
+    while (n) {
+        bool was_waiting;
+        {
+            unique_lock<mutex> lock(mtx);
+            precondition(!closed);
+            if (!room_signal.wait_until(lock, deadline,
+                    [this] { return finished || count < ring.size(); })) {
+                return false;
+            }
+            if (finished) {
+                return false;
+            }
+            // Fill the free space, which may wrap around the end.
+            auto tail = (head + count) % ring.size();
+            auto len = std::min(n, std::min(ring.size() - count, ring.size() - tail));
+            memcpy(ring.data() + tail, p, len);
+            count += len;
+            p += len;
+            n -= len;
+            was_waiting = waiting;
+            waiting = false;
+        }
+        if (was_waiting) {
+            resume();
+        }
+    }
+    return true;
+}
+
+
+void producer_body_source::close() {
+    bool was_waiting;
+    {
+        lock_guard<mutex> lock(mtx);
+        closed = true;
+        was_waiting = waiting;
+        waiting = false;
+    }
+    if (was_waiting) {
+        resume();
+    }
+}
+
+
+stream_state producer_body_source::read(char * buffer, size_t capacity, size_t & n) {
+    {
+        lock_guard<mutex> lock(mtx);
+        n = 0;
+        while (n < capacity && count) {
+            auto len = std::min(capacity - n, std::min(count, ring.size() - head));
+            memcpy(buffer + n, ring.data() + head, len);
+            head = (head + len) % ring.size();
+            count -= len;
+            n += len;
+        }
+        if (closed && !count) {
+            return stream_state::finished;
+        }
+        if (!n) {
+            waiting = true;
+            return stream_state::more;
+        }
+    }
+    room_signal.notify_all();
+    return stream_state::more;
+}
+
+
+void producer_body_source::finish(bool succeeded) {
+    {
+        lock_guard<mutex> lock(mtx);
+        finished = true;
+        ok = succeeded;
+    }
+    room_signal.notify_all();
+}
+
+
+bool producer_body_source::is_finished() const {
+    lock_guard<mutex> lock(mtx);
+    return finished;
+}
+
+
+bool producer_body_source::succeeded() const {
+    lock_guard<mutex> lock(mtx);
+    return finished && ok;
+}
+
+
+}}}} // end namespace
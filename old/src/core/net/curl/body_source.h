@@ -0,0 +1,226 @@
+#ifndef _b3f0e5c1a8d94e0f9c6b27d4a51e83f2
+#define _b3f0e5c1a8d94e0f9c6b27d4a51e83f2
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "core/filesystem.h"
+#include "core/io/mapped_file.h"
+#include "core/marks/concurrency_marks.h"
+#include "core/net/curl/callbacks.h"
+#include "core/net/curl/fwd.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * Where a request body comes from, for bodies too big to hold in a string
+ * (multi-GB artifacts), or that aren't all there when the request is sent.
+ * Curl asks for the body a buffer at a time, as fast as the connection takes
+ * it, and the source fills curl's upload buffer directly; nothing is staged
+ * in between, so each byte is copied once in user space.
+ *
+ *     mapped_file_body_source src(path);
+ *     auto req = s.reset();
+ *     req.set_url(url);
+ *     req.set_verb("put");
+ *     req.set_body_source(&src);
+ *     s.send().wait();
+ *
+ * A source that knows its size is sent with Content-Length; any other is
+ * sent with chunked transfer encoding.
+ *
+ * read(), rewind() and finish() are called on the event loop that runs the
+ * transfer, so they should be quick; a source waiting on a slower producer
+ * should say it has nothing yet rather than block, and resume() when it has
+ * more. They must not call back into the session.
+ */
+class body_source {
+    friend class session;
+
+    std::mutex resume_mtx;
+    std::function<void()> resumer; // +<guarded_by(resume_mtx)
+
+public:
+    static constexpr uint64_t unknown_size = UINT64_MAX;
+
+    body_source();
+    virtual ~body_source();
+
+    /** How many bytes read() gives in all, or unknown_size (the default). */
+    virtual uint64_t get_size() const;
+
+    /**
+     * Put the next bytes of the body in buffer.
+     *
+     * @param byte_count (OUT) How many bytes were put there; at most capacity.
+     * @return stream_state::more if there may be more after these. If
+     *     byte_count is 0, the transfer pauses until the source calls
+     *     resume(), and then asks again. stream_state::finished if these are
+     *     the last bytes (perhaps none); stream_state::premature_close to
+     *     abandon the transfer.
+     */
+    virtual stream_state read(char * buffer, size_t capacity, size_t & byte_count) = 0;
+
+    /**
+     * Go back to the first byte, so the body can be sent again: by a retry,
+     * or by curl after a redirect or a dead reused connection. The default
+     * can't; such a transfer fails instead of starting over.
+     */
+    virtual bool rewind();
+
+    /**
+     * Called once when the transfer is over.
+     *
+     * @param ok false if the transfer failed or was abandoned, perhaps before
+     *     the whole body was read.
+     */
+    virtual void finish(bool ok);
+
+protected:
+    /**
+     * Continue a transfer that read() paused by giving no bytes. Safe to call
+     * from any thread at any time; it does nothing if no transfer is paused.
+     */
+    void resume();
+};
+
+
+/**
+ * Send bytes that are already in memory, without copying them into a string.
+ * The memory is not owned, and must last until the transfer is over.
+ */
+class span_body_source : public body_source {
+public:
+    span_body_source(void const * data, size_t size);
+
+    virtual uint64_t get_size() const;
+    virtual stream_state read(char * buffer, size_t capacity, size_t & byte_count);
+    virtual bool rewind();
+
+protected:
+    char const * data;
+    size_t size;
+    size_t offset;
+
+    span_body_source();
+};
+
+
+/**
+ * Send a whole file, through a read-only mapping. The page cache is the only
+ * buffer, and pages are read ahead and dropped behind as the body goes out,
+ * so files much bigger than memory are fine.
+ */
+class mapped_file_body_source : public span_body_source {
+    io::mapped_file file;
+
+public:
+    /**
+     * @throw std::runtime_error if the file can't be opened or mapped.
+     */
+    explicit mapped_file_body_source(filesystem::path const & fpath);
+};
+
+
+/**
+ * Send what a file descriptor reads, from its current offset to its end. The
+ * descriptor is not owned.
+ *
+ * Reads happen on the event loop, so this is meant for files. A pipe or
+ * socket that may block would stall every transfer on the loop; feed those
+ * through a producer_body_source from a thread of their own instead. (Curl
+ * writes to its sockets itself, so sendfile() isn't an option; the one copy
+ * is from the kernel straight into curl's upload buffer.)
+ */
+class fd_body_source : public body_source {
+    int fd;
+    int64_t start; // -1 if the descriptor can't seek
+    uint64_t size;
+    uint64_t byte_count;
+    int error;
+
+public:
+    explicit fd_body_source(int fd);
+
+    virtual uint64_t get_size() const;
+    virtual stream_state read(char * buffer, size_t capacity, size_t & byte_count);
+    virtual bool rewind();
+
+    /** How many bytes have been read so far. */
+    uint64_t get_byte_count() const { return byte_count; }
+
+    /** The errno value that stopped the transfer, or 0. */
+    int get_error() const { return error; }
+};
+
+
+/**
+ * Send a body that another thread produces as the transfer goes, through a
+ * bounded buffer; it goes out chunked:
+ *
+ *     producer_body_source src;
+ *     req.set_body_source(&src);
+ *     auto resp = s.send();
+ *     while (more_to_come()) {
+ *         if (!src.write(next.data(), next.size())) break;
+ *     }
+ *     src.close();
+ *     resp.wait();
+ *
+ * Each side waits for the other: write() blocks while the buffer is full,
+ * and the transfer pauses while it is empty. The body can't be rewound, so
+ * the transfer isn't retried.
+ */
+mark(+, threadsafe)
+class producer_body_source : public body_source {
+public:
+    /** @param capacity How many bytes may wait in the buffer. */
+    explicit producer_body_source(size_t capacity = 1024 * 1024);
+
+    /**
+     * Add bytes to the body, waiting for room as needed.
+     *
+     * @return false if the transfer is over (so the bytes can never be
+     *     sent), or on timeout. Some of the bytes may have been taken.
+     */
+    bool write(void const * bytes, size_t byte_count,
+            unsigned timeout_millisecs = 60000);
+
+    /** The body is complete. */
+    void close();
+
+    /** Has the transfer ended? */
+    bool is_finished() const;
+
+    /** Did the transfer end well? Only meaningful once finished. */
+    bool succeeded() const;
+
+    virtual stream_state read(char * buffer, size_t capacity, size_t & byte_count);
+    virtual void finish(bool ok);
+
+private:
+    mutable std::mutex mtx;
+    std::condition_variable room_signal;
+    std::vector<char> ring; // +<guarded_by(mtx)
+    size_t head; // +<guarded_by(mtx)
+    size_t count; // +<guarded_by(mtx)
+    bool closed; // +<guarded_by(mtx)
+    bool waiting; // +<guarded_by(mtx)
+    bool finished; // +<guarded_by(mtx)
+    bool ok; // +<guarded_by(mtx)
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
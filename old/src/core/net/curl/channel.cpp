@@ -1,29 +1,22 @@
 #include <atomic>
+#include <cstring>
 #include <map>
 #include <mutex>
 #include <thread>
 
-#include "core/net/curl/.private/libcurl_callbacks.h"
 #include "core/net/curl/.private/channel-impl.h"
+#include "core/net/curl/.private/event_loop.h"
 #include "core/net/curl/.private/session-impl.h"
-#include "core/net/curl/.private/multi.h"
+#include "core/net/curl/.private/share.h"
+#include "core/net/curl/.private/trace_points.h"
 #include "core/net/curl/channel.h"
 #include "core/net/curl/session.h"
+#include "core/net/curl/state_error.h"
 #include "core/util/monotonic_id.h"
 
 
-using asio::deadline_timer;
-using asio::io_service;
-using asio::error_code;
-
-using std::atomic;
 using std::lock_guard;
-using std::map;
 using std::mutex;
-using std::string;
-using std::thread;
-
-using namespace std::placeholders;
 
 
 namespace intent {
@@ -31,12 +24,6 @@ namespace core {
 namespace net {
 namespace curl {
 
-char const * get_socket_state_descrip(int state);
-
-
-typedef asio::ip::tcp::socket asio_socket_t;
-typedef map<curl_socket_t, asio_socket_t *> socket_map_t;
-typedef std::pair<curl_socket_t, asio_socket_t *> socket_pair_t;
 
 // Curl needs to be initialized once per process, globally, and cleaned up after
 // main() exits. Define an object that does init and cleanup in its ctor and dtor;
@@ -61,50 +48,131 @@ static uint32_t get_next_id() {
 }
 
 
-channel::impl_t::impl_t() : id(get_next_id()), multi(), still_running(1),
-        io_service(), timeout(io_service), socket_map(), service_runner(),
-        // Add some abstract "work" so that a call to io_service.run() will
-        // never exit because it always sees something pending...
-        work(io_service), sessions(), mtx() {
+static unsigned get_default_loop_count() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
 
-    curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, libcurl_callbacks::on_socket_update);
-    curl_multi_setopt(multi, CURLMOPT_SOCKETDATA, this);
 
-    curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, libcurl_callbacks::on_adjust_timeout);
-    curl_multi_setopt(multi, CURLMOPT_TIMERDATA, this);
+channel::impl_t::impl_t(unsigned loop_count) : id(get_next_id()), loops(),
+        admission(), dns(), meters(), next_loop(0), open(false), default_shared_state(), mtx(),
+        sessions(), pool(),
+        policy_mtx(), connections(), breaker_mtx(), breakers_enabled(false),
+        breaker_config(), breakers(), cache_mtx(), cache() {
+    if (!loop_count) {
+        loop_count = get_default_loop_count();
+    }
+    for (unsigned i = 0; i < loop_count; ++i) {
+        loops.emplace_back(new event_loop(i));
+    }
+    admission.reset(new scheduler(loops[0]->io_service));
+    dns.reset(new resolver(loops[0]->io_service));
+    meters.reset(new metrics(loops[0]->io_service));
 }
 
 
 channel::impl_t::~impl_t() {
-    lock_guard<mutex> lock(mtx);
-    if (!io_service.stopped()) {
-        io_service.stop();
-    }
-    if (is_open()) {
-        still_running = 0;
-        while (!sessions.empty()) {
-            auto x = sessions.begin();
-            auto session = x->second;
-            if (session) {
-                // Avoid deadlock by breaking backref.
-                session->impl->channel = nullptr;
+    stop_loops();
+    sessions.for_each([](session * s) {
+        // Break backrefs, so sessions that outlive us don't try to detach
+        // from us (or recycle into our pool) later.
+        s->impl->channel = nullptr;
+        s->impl->loop = nullptr;
+    });
+}
+
+
+void channel::impl_t::stop_loops() {
+    admission->close();
+    for (auto & x : loops) {
+        auto loop = x.get();
+        // Queued transfers are taken on their own loop's thread, so a session
+        // being destroyed (which syncs with its loop) can't slip away midway.
+        loop->run_sync([this, loop] {
+            for (auto simpl : admission->take_waiting(loop)) {
+                if (!simpl->error[0]) {
+                    strcpy(simpl->error, "Channel closed before transfer started.");
+                }
+                simpl->cleanup_after_transfer(CURLE_ABORTED_BY_CALLBACK);
             }
-            // Here's where we do auto-deregistration. This also calls the
-            // dtor of the shared_ptr, which in turn calls the dtor of the
-            // session, which (since it's been detached from us) *won't*
-            // turn around and tell us to remove it from our list.
-            sessions.erase(x);
+        });
+        loop->stop();
+    }
+}
+
+
+channel::event_loop * channel::impl_t::choose_loop() {
+    auto n = loops.size();
+    auto start = next_loop++;
+    event_loop * best = nullptr;
+    for (size_t i = 0; i < n; ++i) {
+        auto loop = loops[(start + i) % n].get();
+        if (!best || loop->session_count.load() < best->session_count.load()) {
+            best = loop;
         }
     }
+    return best;
 }
 
 
-channel::channel(): impl(new impl_t()) {
+channel::event_loop * channel::impl_t::choose_loop(shared_state::impl_t * shimpl) {
+    if (!shimpl || (shimpl->what & sharing::connections) == sharing::none) {
+        return choose_loop();
+    }
+    lock_guard<mutex> lock(shimpl->home_mtx);
+    if (!shimpl->has_home) {
+        auto loop = choose_loop();
+        shimpl->has_home = true;
+        shimpl->home_channel_id = id;
+        shimpl->home_loop_index = loop->index;
+        return loop;
+    }
+    if (shimpl->home_channel_id != id) {
+        throw state_error("Sessions that share connections must belong to the same channel.");
+    }
+    return loops[shimpl->home_loop_index].get();
+}
+
+
+void channel::impl_t::move_to_loop(session * s, event_loop * loop) {
+    auto old = s->impl->loop;
+    if (old == loop) {
+        return;
+    }
+    if (old) {
+        --old->session_count;
+    }
+    s->impl->loop = loop;
+    ++loop->session_count;
+}
+
+
+std::shared_ptr<err::circuit_breaker> channel::impl_t::get_breaker(
+        std::string const & host) {
+    lock_guard<mutex> lock(breaker_mtx);
+    if (!breakers_enabled) {
+        return nullptr;
+    }
+    auto & b = breakers[host];
+    if (!b) {
+        b = std::make_shared<err::circuit_breaker>(breaker_config);
+    }
+    return b;
+}
+
+
+std::shared_ptr<http_cache::impl_t> channel::impl_t::get_cache() {
+    lock_guard<mutex> lock(cache_mtx);
+    return cache;
+}
+
+
+channel::channel(unsigned loop_count): impl(new impl_t(loop_count)) {
 }
 
 
 channel::~channel() {
-    fprintf(stderr, "channel %u dtor\n", get_id());
+    trace_event(trace::channel_gone, get_id());
     delete impl;
 }
 
@@ -120,190 +188,198 @@ uint32_t channel::get_id() const {
 }
 
 
-static const std::thread::id inert_thread_id;
+unsigned channel::get_loop_count() const {
+    return static_cast<unsigned>(impl->loops.size());
+}
 
 
 void channel::open() {
-
     lock_guard<mutex> lock(impl->mtx);
+    if (!impl->open) {
+        for (auto & loop : impl->loops) {
+            loop->start();
+        }
+        impl->open = true;
+        impl->admission->open();
+    }
+}
 
-    if (!impl->is_open()) {
-        auto & svc = impl->io_service;
 
-        impl->service_runner = thread([&svc]() {
-            asio::io_service::work never_done(svc);
-            svc.run();
-        });
+bool channel::is_open() const {
+    lock_guard<mutex> lock(impl->mtx);
+    return impl->open;
+}
 
-        impl->service_runner.detach();
+
+void channel::close() {
+    {
+        lock_guard<mutex> lock(impl->mtx);
+        if (!impl->open) {
+            return;
+        }
+        impl->open = false;
     }
+    // Stop the loops without holding our mutex. A loop thread may need a
+    // session's mutex to finish aborting a transfer, and a thread that holds
+    // that mutex may be waiting in open().
+    impl->stop_loops();
 }
 
 
-bool channel::impl_t::is_open() const {
-    return service_runner.get_id() != inert_thread_id;
+void channel::set_admission_limits(admission_limits const & limits) {
+    impl->admission->set_channel_limits(limits);
 }
 
 
-bool channel::is_open() const {
-    lock_guard<mutex> lock(impl->mtx);
-
-    return impl->is_open();
+void channel::set_host_admission_limits(admission_limits const & limits) {
+    impl->admission->set_default_host_limits(limits);
 }
 
 
-void channel::attach(session * s) {
-    if (s) {
-        lock_guard<mutex> lock(impl->mtx);
-        impl->sessions[s->get_id()] = s;
-    }
+void channel::set_host_admission_limits(char const * host,
+        admission_limits const & limits) {
+    impl->admission->set_host_limits(scheduler::get_host_key(host), limits);
 }
 
 
-void channel::detach(unsigned session_id) {
-    lock_guard<mutex> lock(impl->mtx);
-    auto & sessions = impl->sessions;
-    auto x = sessions.find(session_id);
-    if (x != sessions.end()) {
-        // This calls the dtor of the smart ptr, which (since ref count
-        // reaches 0) will also call the dtor of the session.
-        sessions.erase(x);
-    }
+admission_stats channel::get_admission_stats() const {
+    return impl->admission->get_channel_stats();
 }
 
 
-/* Check for completed transfers, and remove their easy handles */
-void channel::impl_t::handle_done_transfers() {
-
-    CURLMsg *msg;
-    int msgs_left;
-    session::impl_t * simpl;
+admission_stats channel::get_host_admission_stats(char const * host) const {
+    return impl->admission->get_host_stats(scheduler::get_host_key(host));
+}
 
-    while ((msg = curl_multi_info_read(multi, &msgs_left)) != nullptr) {
 
-        // It is common to get a CURLMSG_DONE when we are done--but it is not
-        // guaranteed in cases where the remote server closes a socket without
-        // warning. Testing also shows that we don't necessarily receive this
-        // message at the end of chunked transfer encoding with persistent
-        // connections. Therefore, this block is not the only place where we call
-        // cleanup_after_transfer().
-        if (msg->msg == CURLMSG_DONE) {
-            auto easy = msg->easy_handle;
-            curl_easy_getinfo(easy, CURLINFO_PRIVATE, &simpl);
-            simpl->cleanup_after_transfer();
-        }
-    }
+void channel::enable_circuit_breakers(err::circuit_breaker::config const & cfg) {
+    lock_guard<mutex> lock(impl->breaker_mtx);
+    impl->breakers_enabled = true;
+    impl->breaker_config = cfg;
+    // Existing breakers keep their history, and their old configuration.
 }
 
 
-static inline bool socket_state_implies_pending_transfer(int state) {
-    switch (state) {
-    case CURL_POLL_IN:
-    case CURL_POLL_OUT:
-    case CURL_POLL_INOUT:
-        return true;
-    default:
-        return false;
-    }
+std::shared_ptr<err::circuit_breaker> channel::get_circuit_breaker(char const * host) {
+    return impl->get_breaker(scheduler::get_host_key(host));
 }
 
 
-/**
- * Called by asio when there is an event that changes status of a socket. Since
- * recent asio versions are edge-triggered, we should assume we only get one
- * shot at noticing a state transition.
- */
-void channel::impl_t::on_socket_event(asio_socket_t *tcp_socket, int event, int * socket_state)
-{
-    int start_state = *socket_state;
+void channel::set_http_cache(http_cache const & c) {
+    lock_guard<mutex> lock(impl->cache_mtx);
+    impl->cache = c.impl;
+}
 
-    auto rc = curl_multi_socket_action(multi, tcp_socket->native_handle(),
-            event, &still_running);
 
-    mcode_or_die("on_socket_event: multi_socket_action", rc);
+void channel::disable_http_cache() {
+    lock_guard<mutex> lock(impl->cache_mtx);
+    impl->cache.reset();
+}
 
-    // If the read/write that just finished wasn't enough to satisfy curl
-    // (a state we recognize by seeing if curl left the desired socket state
-    // unchanged when we called curl_multi_socket_action), then schedule another
-    // read/write to happen as soon as the socket is ready again.
-    if (*socket_state == start_state && socket_state_implies_pending_transfer(start_state)) {
-        queue_callback_when_socket_is_ready(socket_state, tcp_socket);
+
+void channel::set_connection_policy(connection_policy const & policy) {
+    lock_guard<mutex> lock(impl->policy_mtx);
+    impl->connections = policy;
+    for (auto & x : impl->loops) {
+        auto loop = x.get();
+        loop->run_sync([loop, &policy] { loop->set_connection_policy(policy); });
     }
+}
 
-    handle_done_transfers();
 
-    if (still_running <= 0) {
-        timeout.cancel();
-    }
+connection_policy channel::get_connection_policy() const {
+    lock_guard<mutex> lock(impl->policy_mtx);
+    return impl->connections;
 }
 
 
-/* Called by asio when our timeout expires */
-void channel::impl_t::on_timeout(error_code const & error)
-{
-    if (!error) {
-        auto rc = curl_multi_socket_action(multi, CURL_SOCKET_TIMEOUT, 0, &still_running);
-        mcode_or_die("on_timeout: multi_socket_action", rc);
-        handle_done_transfers();
+connection_stats channel::get_connection_stats() const {
+    connection_stats stats = {};
+    for (auto & loop : impl->loops) {
+        stats.transfers += loop->finished_transfers.load();
+        stats.connections_opened += loop->connections_opened.load();
+        stats.reused += loop->reused_transfers.load();
+        stats.http2 += loop->http2_transfers.load();
     }
+    return stats;
 }
 
 
-/* Clean up any data */
-void channel::impl_t::remove_socket(int * socket_state) {
-    *socket_state = CURL_POLL_NONE;
+void channel::set_resolve_policy(resolve_policy const & policy) {
+    impl->dns->set_policy(policy);
 }
 
 
-void channel::impl_t::queue_callback_when_socket_is_ready(int * socket_state, asio_socket_t * tcp_socket) {
-    int desired_state = *socket_state;
-    #define handler std::bind(&impl_t::on_socket_event, this, tcp_socket, desired_state, socket_state)
-    if (desired_state == CURL_POLL_IN)
-    {
-        tcp_socket->async_read_some(asio::null_buffers(), handler);
+resolve_policy channel::get_resolve_policy() const {
+    return impl->dns->get_policy();
+}
 
-    } else if (desired_state == CURL_POLL_OUT) {
-        tcp_socket->async_write_some(asio::null_buffers(), handler);
 
-    } else if (desired_state == CURL_POLL_INOUT) {
-        tcp_socket->async_read_some(asio::null_buffers(), handler);
-        tcp_socket->async_write_some(asio::null_buffers(), handler);
+resolve_stats channel::get_resolve_stats() const {
+    return impl->dns->get_stats();
+}
+
 
-    } else {
-        fprintf(stderr, "desired_state = %d (unknown)\n", desired_state);
+void channel::set_resolve_override(char const * host, unsigned port,
+        char const * addresses) {
+    if (!host || !*host || !port) {
+        throw state_error("A resolve override needs a host and a port.");
     }
-    #undef handler
+    impl->dns->set_override(host, port, addresses ? addresses : "");
 }
 
 
-void channel::impl_t::change_socket_state(int * socket_state, curl_socket_t sock, CURL * easy, int desired_state)
-{
-    auto it = socket_map.find(sock);
+transfer_metrics channel::get_transfer_metrics() const {
+    return impl->meters->get_totals();
+}
+
+
+transfer_metrics channel::get_host_transfer_metrics(char const * host) const {
+    return impl->meters->get_host_totals(scheduler::get_host_key(host));
+}
 
-    if (it == socket_map.end()) {
-        fprintf(stderr, "socket %d is a c-ares socket, ignoring\n", sock);
-        return;
-    }
 
-    asio_socket_t * tcp_socket = it->second;
+transfer_metrics_report channel::get_transfer_metrics_report() const {
+    return impl->meters->get_report();
+}
 
-    *socket_state = desired_state;
 
-    queue_callback_when_socket_is_ready(socket_state, tcp_socket);
+void channel::set_metrics_dump(unsigned interval_secs, metrics_callback fn) {
+    impl->meters->set_dump(this, interval_secs, fn);
 }
 
 
-void channel::impl_t::add_socket(curl_socket_t sock, CURL * easy, int desired_state)
-{
-    char * x;
-    curl_easy_getinfo(easy, CURLINFO_PRIVATE, &x);
-    session::impl_t * simpl = reinterpret_cast<session::impl_t *>(x);
+void channel::set_shared_state(shared_state const & s) {
+    lock_guard<mutex> lock(impl->mtx);
+    impl->default_shared_state = s;
+}
 
-    // Tell curl to give us this pointer any time we interact with the socket.
-    curl_multi_assign(multi, sock, simpl);
 
-    // Now invoke the logic that happens when curl tells us to change our state.
-    change_socket_state(&simpl->curl_socket_state, sock, easy, desired_state);
+shared_state channel::get_shared_state() const {
+    lock_guard<mutex> lock(impl->mtx);
+    return impl->default_shared_state;
+}
+
+
+void channel::attach(session * s) {
+    if (s) {
+        auto loop = impl->choose_loop(s->impl->shared.impl);
+        s->impl->slot = impl->sessions.insert(s);
+        s->impl->loop = loop;
+        ++loop->session_count;
+    }
+}
+
+
+void channel::detach(session * s) {
+    auto & slot = s->impl->slot;
+    if (slot != util::slot_table<session>::none) {
+        impl->sessions.erase(slot);
+        slot = util::slot_table<session>::none;
+        if (s->impl->loop) {
+            --s->impl->loop->session_count;
+        }
+    }
 }
 
 
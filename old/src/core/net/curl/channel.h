@@ -3,8 +3,15 @@
 
 #include <memory>
 
+#include "core/err/circuit_breaker.h"
 #include "core/marks/concurrency_marks.h"
+#include "core/net/curl/admission.h"
+#include "core/net/curl/connection_policy.h"
 #include "core/net/curl/fwd.h"
+#include "core/net/curl/http_cache.h"
+#include "core/net/curl/resolve_policy.h"
+#include "core/net/curl/shared_state.h"
+#include "core/net/curl/transfer_metrics.h"
 
 namespace intent {
 namespace core {
@@ -22,16 +29,19 @@ namespace curl {
  * automatically, allowing channels to be ignored in simple use cases.
  *
  * Each channel owns a separate DNS cache that optimizes host lookups across
- * all the sessions that use it. A channel may also provide default, overridable
- * configuration (e.g., headers, credentials, callbacks, ...) to its sessions.
+ * all the sessions that use it (see set_resolve_policy()). A channel may also
+ * provide default, overridable configuration (e.g., headers, credentials,
+ * callbacks, ...) to its sessions.
  *
- * Each channel has a background event/reactor thread to efficiently dispatch
+ * Each channel has one or more background event loops to efficiently dispatch
  * callbacks as data is ready to read or write on any of its associated sockets.
- * Since the thread is essentially an event pump, it is rarely blocked, and can
- * scale easily; it is implemented with a best-of-breed eventing mechanism on
- * each platform, such as epoll on linux. A good rule of thumb is that one
- * channel can efficiently handle, say, up to a few thousand open connections
- * at a time.
+ * Each loop is a thread pumping events from a best-of-breed eventing mechanism
+ * on each platform (such as epoll on linux), with its own libcurl multi handle
+ * and connection cache. Since a loop is rarely blocked, one can handle, say,
+ * up to a few thousand open connections at a time; beyond that, or when a
+ * single thread can't keep up with the network, give the channel more loops.
+ * Sessions are spread across the loops when they are created, and stay on the
+ * same loop for life, so their connections can be reused.
  *
  * Channels are thread-safe; instances can be shared safely on multiple threads
  * without additional synchronization.
@@ -46,14 +56,26 @@ class channel {
 	friend class response;
 	friend class session;
 
+	struct event_loop;
+	class metrics;
+	class resolver;
+	class scheduler;
+	class session_pool;
+
 	void open();
 	void attach(session *);
-	void detach(unsigned session_id);
+	void detach(session *);
 
 public:
-	channel();
+	/**
+	 * @param loop_count How many event loops (threads) to run. 0 means one per
+	 *     hardware core.
+	 */
+	explicit channel(unsigned loop_count = 1);
 	~channel();
 
+	unsigned get_loop_count() const;
+
 	/**
 	 * Uniquely identify a channel. IDs are auto-assigned, monotonically
 	 * incrementing numbers that begin with 0. The default channel may or may
@@ -63,11 +85,143 @@ public:
 
 	/**
 	 * A channel is initially closed. It opens automatically the first time
-	 * a consumer needs it to do real work, and remains open from then on. Use
+	 * a consumer needs it to do real work, and remains open until close(). Use
 	 * this function to test its state. (Primarily for internal use.)
 	 */
 	bool is_open() const;
 
+	/**
+	 * Set the pool of shared state that sessions created on this channel start
+	 * with. Sessions already created keep what they have. Use the same pool on
+	 * several channels to share across them. By default, nothing is shared
+	 * beyond what each event loop shares on its own. See @ref shared_state.
+	 */
+	void set_shared_state(shared_state const &);
+	shared_state get_shared_state() const;
+
+	/**
+	 * Limit the transfers the channel runs as a whole. Transfers beyond the
+	 * limits wait in a queue, highest priority first (see
+	 * request::set_priority()), and start as slots and tokens free up. By
+	 * default there are no limits, and every transfer starts as soon as it is
+	 * sent.
+	 */
+	void set_admission_limits(admission_limits const &);
+
+	/**
+	 * Limit the transfers to each host separately, so no single origin is
+	 * overloaded. While one host is held back, others keep going; hosts
+	 * with work waiting take turns.
+	 */
+	void set_host_admission_limits(admission_limits const &);
+
+	/**
+	 * Limit the transfers to one host differently from the rest.
+	 *
+	 * @param host A host name, with the port if a url would name one (for
+	 *     example, "localhost:8080").
+	 */
+	void set_host_admission_limits(char const * host, admission_limits const &);
+
+	admission_stats get_admission_stats() const;
+	admission_stats get_host_admission_stats(char const * host) const;
+
+	/**
+	 * Decide how transfers share connections: HTTP/2 multiplexing, how many
+	 * connections each loop may open, and how long idle ones are kept. Takes
+	 * effect for transfers that start afterwards. See @ref connection_policy.
+	 */
+	void set_connection_policy(connection_policy const &);
+	connection_policy get_connection_policy() const;
+
+	/** Count how many transfers found a connection already open. */
+	connection_stats get_connection_stats() const;
+
+	/**
+	 * Decide how host names are looked up, and how long answers are kept.
+	 * Takes effect for transfers that start afterwards. See @ref
+	 * resolve_policy.
+	 */
+	void set_resolve_policy(resolve_policy const &);
+	resolve_policy get_resolve_policy() const;
+	resolve_stats get_resolve_stats() const;
+
+	/**
+	 * Send transfers to a host and port to fixed addresses, without looking
+	 * the host up, as curl's CURLOPT_RESOLVE does. Applies to every session
+	 * on the channel, from their next transfer.
+	 *
+	 *     ch.set_resolve_override("api.example.com", 443, "10.0.0.7,10.0.0.8");
+	 *
+	 * @param addresses Comma-separated; IPv6 addresses go in brackets. Empty
+	 *     or null removes the override, though curl may keep using the
+	 *     addresses for as long as it keeps any answer (a minute, by default).
+	 * @throw state_error if host is empty, or port is 0.
+	 */
+	void set_resolve_override(char const * host, unsigned port,
+			char const * addresses);
+
+	/**
+	 * Report how the channel's transfers have performed: how many there were,
+	 * the bytes they moved, and how long each phase (looking up the host,
+	 * connecting, the TLS handshake, the first byte, the whole) took. See
+	 * @ref transfer_metrics.
+	 */
+	transfer_metrics get_transfer_metrics() const;
+
+	/**
+	 * The same, for the transfers sent to one host (named as for
+	 * set_host_admission_limits()). All zeros for a host not seen yet.
+	 */
+	transfer_metrics get_host_transfer_metrics(char const * host) const;
+
+	/** The channel's metrics, and each host's, at once. */
+	transfer_metrics_report get_transfer_metrics_report() const;
+
+	/**
+	 * Hand the channel's metrics report to fn every interval_secs, on one of
+	 * the channel's event loops, while the channel is open. fn must not block.
+	 * A null fn, or an interval of 0, stops the dumps.
+	 *
+	 *     ch.set_metrics_dump(60, [](channel &, transfer_metrics_report const & r) {
+	 *         fputs(r.get_summary().c_str(), stderr);
+	 *     });
+	 */
+	void set_metrics_dump(unsigned interval_secs, metrics_callback fn);
+
+	/**
+	 * Guard each host with its own circuit breaker. Every transfer's outcome
+	 * is reported to its host's breaker (a connection failure, a 5xx, or a
+	 * 429 count as failures); once too many fail, requests to that host fail
+	 * at once, without touching the network, until the breaker lets a few
+	 * through to retest it. Retries and hedges stop while a breaker is open.
+	 * Off by default.
+	 */
+	void enable_circuit_breakers(err::circuit_breaker::config const & =
+			err::circuit_breaker::config());
+
+	/**
+	 * The breaker for a host (named as for set_host_admission_limits()), or
+	 * nullptr if breakers aren't enabled.
+	 */
+	std::shared_ptr<err::circuit_breaker> get_circuit_breaker(char const * host);
+
+	/**
+	 * Answer GETs from a cache where the server allows it, and let identical
+	 * GETs that are underway at once share one transfer. Affects requests sent
+	 * afterwards. Off by default. See @ref http_cache.
+	 */
+	void set_http_cache(http_cache const &);
+	void disable_http_cache();
+
+	/**
+	 * Abandon any transfers still underway or queued (their waiters wake up
+	 * with an error), stop the event loops, and wait for their threads to exit. The
+	 * channel reopens if it is used again. Called automatically by the
+	 * destructor.
+	 */
+	void close();
+
 	/**
 	 * Simple apps can ignore the channel construct entirely--in which case,
 	 * the default channel is always used. This channel is created on demand,
@@ -0,0 +1,214 @@
+#include <chrono>
+
+#include "core/net/curl/.private/completion_queue-impl.h"
+#include "core/net/curl/.private/session-impl.h"
+#include "core/net/curl/completion_queue.h"
+#include "core/net/curl/request.h"
+#include "core/net/curl/session.h"
+
+
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+completion_queue::impl_t::impl_t(class channel * ch) : channel(ch), mtx(),
+        ready_signal(), ready(), pending(0), closed(false), owned(), spare() {
+}
+
+
+void completion_queue::impl_t::complete(session * s, response::impl_t * r,
+        completion_handler handler) {
+    response resp(r);
+    bool dropped;
+    {
+        lock_guard<mutex> lock(mtx);
+        dropped = closed;
+    }
+    if (handler && !dropped) {
+        try {
+            handler(resp);
+        } catch (...) {
+            // Don't let it take down the event loop.
+        }
+    }
+    lock_guard<mutex> lock(mtx);
+    --pending;
+    if (!closed) {
+        if (!handler) {
+            ready.push_back(std::move(resp));
+        }
+        if (owned.count(s)) {
+            spare.push_back(s);
+        }
+    }
+    ready_signal.notify_all();
+}
+
+
+void completion_queue::impl_t::abandon() {
+    lock_guard<mutex> lock(mtx);
+    --pending;
+    ready_signal.notify_all();
+}
+
+
+completion_queue::completion_queue(class channel & ch) :
+        impl(std::make_shared<impl_t>(&ch)) {
+}
+
+
+completion_queue::~completion_queue() {
+    std::deque<response> leftovers;
+    std::set<session *> owned;
+    {
+        lock_guard<mutex> lock(impl->mtx);
+        impl->closed = true;
+        leftovers.swap(impl->ready);
+        owned.swap(impl->owned);
+        impl->spare.clear();
+    }
+    // Abandons whatever they are still doing.
+    for (auto s : owned) {
+        delete s;
+    }
+}
+
+
+response completion_queue::send(session & s, completion_handler handler) {
+    {
+        lock_guard<mutex> lock(impl->mtx);
+        ++impl->pending;
+    }
+    auto simpl = s.impl;
+    response::impl_t * resp;
+    completion_handler early_handler;
+    bool ended_early = false;
+    {
+        lock_guard<mutex> lock(simpl->mtx);
+        simpl->completions = impl;
+        simpl->on_complete = std::move(handler);
+        try {
+            s.send_prelocked();
+        } catch (...) {
+            simpl->completions.reset();
+            simpl->on_complete = nullptr;
+            impl->abandon();
+            throw;
+        }
+        resp = simpl->current_response;
+        resp->add_ref();
+        // If the loop (or the transfer we follow) had finished, it would have
+        // taken the queue back; so the send ended before it started: it
+        // failed fast, or the http cache answered it.
+        if (simpl->completions && simpl->state.load() == session_state::idle) {
+            simpl->completions.reset();
+            early_handler = std::move(simpl->on_complete);
+            simpl->on_complete = nullptr;
+            ended_early = true;
+        }
+    }
+    response r(resp);
+    resp->release_ref();
+    if (ended_early) {
+        impl->complete(&s, resp, std::move(early_handler));
+    }
+    return r;
+}
+
+
+response completion_queue::submit(session & s) {
+    return send(s, nullptr);
+}
+
+
+response completion_queue::submit(session & s, completion_handler handler) {
+    return send(s, std::move(handler));
+}
+
+
+std::future<response> completion_queue::submit_future(session & s) {
+    auto promise = std::make_shared<std::promise<response>>();
+    auto f = promise->get_future();
+    send(s, [promise](response & r) { promise->set_value(r); });
+    return f;
+}
+
+
+response completion_queue::submit(char const * url) {
+    session * s = nullptr;
+    {
+        lock_guard<mutex> lock(impl->mtx);
+        if (!impl->spare.empty()) {
+            s = impl->spare.back();
+            impl->spare.pop_back();
+        }
+    }
+    if (!s) {
+        s = new session(*impl->channel);
+        lock_guard<mutex> lock(impl->mtx);
+        impl->owned.insert(s);
+    }
+    try {
+        auto req = s->reset();
+        req.set_url(url);
+        req.set_verb("get");
+        return send(*s, nullptr);
+    } catch (...) {
+        lock_guard<mutex> lock(impl->mtx);
+        impl->spare.push_back(s);
+        throw;
+    }
+}
+
+
+size_t completion_queue::get_pending_count() const {
+    lock_guard<mutex> lock(impl->mtx);
+    return impl->pending;
+}
+
+
+size_t completion_queue::get_ready_count() const {
+    lock_guard<mutex> lock(impl->mtx);
+    return impl->ready.size();
+}
+
+
+static void take_ready(std::deque<response> & ready, std::vector<response> & out) {
+    for (auto & r : ready) {
+        out.push_back(std::move(r));
+    }
+    ready.clear();
+}
+
+
+bool completion_queue::wait_any(std::vector<response> & out,
+        unsigned timeout_millisecs) {
+    unique_lock<mutex> lock(impl->mtx);
+    impl->ready_signal.wait_for(lock, std::chrono::milliseconds(timeout_millisecs),
+            [this] { return !impl->ready.empty() || !impl->pending; });
+    if (impl->ready.empty()) {
+        return false;
+    }
+    take_ready(impl->ready, out);
+    return true;
+}
+
+
+bool completion_queue::wait_all(std::vector<response> & out,
+        unsigned timeout_millisecs) {
+    unique_lock<mutex> lock(impl->mtx);
+    impl->ready_signal.wait_for(lock, std::chrono::milliseconds(timeout_millisecs),
+            [this] { return !impl->pending; });
+    take_ready(impl->ready, out);
+    return !impl->pending;
+}
+
+
+}}}} // end namespace
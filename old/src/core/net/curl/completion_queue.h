@@ -0,0 +1,120 @@
+#ifndef _6f1d3c0a2b8e4c57a9e4d6b1f07c3a92
+#define _6f1d3c0a2b8e4c57a9e4d6b1f07c3a92
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "core/marks/concurrency_marks.h"
+#include "core/net/curl/channel.h"
+#include "core/net/curl/response.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * Gather the responses of many transfers, in the order they finish.
+ *
+ * Waiting on each response in turn needs a thread per transfer, or polling.
+ * Instead, submit sessions here, and take their responses as they are ready:
+ *
+ *     completion_queue q(ch);
+ *     for (auto & url : urls) {
+ *         q.submit(url.c_str());
+ *     }
+ *     std::vector<response> done;
+ *     while (q.wait_any(done)) {
+ *         for (auto & r : done) { ... }
+ *         done.clear();
+ *     }
+ *
+ * A response comes out exactly once, whether its transfer succeeded, failed,
+ * or was abandoned because the channel closed. If a session is destroyed
+ * while its transfer is underway, nothing comes out for it, and it no longer
+ * counts as pending.
+ *
+ * A queue may be destroyed before the transfers it started finish; their
+ * results are then dropped.
+ */
+mark(+, threadsafe)
+class completion_queue {
+public:
+    struct impl_t;
+
+    /**
+     * Called once a transfer finishes, instead of queueing its response.
+     * Handlers run on the event loop's thread (or, if the request fails
+     * before it starts, on the thread that submitted it), so they should be
+     * quick, and must not wait on responses. They may reset and send the
+     * session again. Exceptions they throw are swallowed.
+     */
+    typedef std::function<void(response &)> completion_handler;
+
+    explicit completion_queue(channel & = channel::get_default());
+    ~completion_queue();
+
+    completion_queue(completion_queue const &) = delete;
+    completion_queue & operator =(completion_queue const &) = delete;
+
+    /**
+     * Send a configured session. Its response comes out of this queue when
+     * the transfer is done.
+     *
+     * @throw state_error as for session::send().
+     */
+    response submit(session &);
+
+    /** Send a configured session, and hand its response to handler. */
+    response submit(session &, completion_handler handler);
+
+    /**
+     * Send a configured session; the future is ready when it is done. If the
+     * session is destroyed first, the future holds a broken_promise error.
+     */
+    std::future<response> submit_future(session &);
+
+    /**
+     * GET a url with a session that the queue owns and reuses. Once its
+     * response has come out of the queue, the session may be carrying some
+     * other transfer, so don't wait() on that response, or use its session.
+     */
+    response submit(char const * url);
+
+    /** Transfers submitted and not done yet. */
+    size_t get_pending_count() const;
+
+    /** Responses done, and waiting to be taken. */
+    size_t get_ready_count() const;
+
+    /**
+     * Wait until at least one response is ready, and append all that are to
+     * out, in the order they finished.
+     *
+     * @return false if nothing was ready in time, or if nothing is pending.
+     */
+    bool wait_any(std::vector<response> & out, unsigned timeout_millisecs = 60000);
+
+    /**
+     * Wait until all pending transfers are done, or until the timeout. Either
+     * way, append the responses that are ready to out.
+     *
+     * @return true if nothing is pending any more.
+     */
+    bool wait_all(std::vector<response> & out, unsigned timeout_millisecs = 60000);
+
+private:
+    std::shared_ptr<impl_t> impl;
+
+    response send(session &, completion_handler);
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
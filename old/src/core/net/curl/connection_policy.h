@@ -0,0 +1,83 @@
+#ifndef _6f1d0c2b8e7a4c39a5b41e0d93f27c58
+#define _6f1d0c2b8e7a4c39a5b41e0d93f27c58
+
+#include <cstdint>
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * How a channel opens, shares, and keeps connections. Limits apply to each
+ * event loop separately, since each loop has its own connection cache; a zero
+ * means no limit.
+ *
+ * The defaults suit many small calls to a few hosts: HTTP/2 is used wherever
+ * a server offers it over TLS, and concurrent requests to one host become
+ * streams on a single connection, rather than a connection each.
+ *
+ *     connection_policy policy;
+ *     policy.max_host_connections = 4;
+ *     ch.set_connection_policy(policy);
+ */
+struct connection_policy {
+    /**
+     * Ask for HTTP/2 over TLS, and run concurrent transfers to a host as
+     * streams on one connection. Plain http stays on HTTP/1.1.
+     */
+    bool multiplex;
+    /**
+     * When a new transfer could either open a connection now, or wait to
+     * learn whether one being opened can multiplex it, wait. Only matters
+     * with multiplex on.
+     */
+    bool wait_for_multiplex;
+    /** Streams to run at once on one multiplexed connection. */
+    unsigned max_streams_per_connection;
+    /** Connections open at once to one host; more transfers wait for one. */
+    unsigned max_host_connections;
+    /** Connections open at once, to all hosts. */
+    unsigned max_total_connections;
+    /** Idle connections to keep for reuse. 0 lets curl pick. */
+    unsigned max_idle_connections;
+    /** Don't reuse a connection that has been idle this long. 0 lets curl pick. */
+    unsigned max_idle_secs;
+    /**
+     * Send TCP keep-alive probes once a connection has been quiet this long,
+     * so a dead peer or a dropped NAT entry is noticed. 0 turns probes off.
+     */
+    unsigned keepalive_idle_secs;
+    /** Time between probes. 0 means the same as keepalive_idle_secs. */
+    unsigned keepalive_interval_secs;
+
+    connection_policy() : multiplex(true), wait_for_multiplex(true),
+            max_streams_per_connection(0), max_host_connections(0),
+            max_total_connections(0), max_idle_connections(0),
+            max_idle_secs(0), keepalive_idle_secs(60),
+            keepalive_interval_secs(0) {
+    }
+};
+
+
+/**
+ * How well a channel has been reusing its connections.
+ */
+struct connection_stats {
+    /** Transfers finished (each retry or hedge counts). */
+    uint64_t transfers;
+    /** Connections opened for them. */
+    uint64_t connections_opened;
+    /** Transfers that ran on a connection that was already open. */
+    uint64_t reused;
+    /** Transfers that ran over HTTP/2. */
+    uint64_t http2;
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
@@ -0,0 +1,439 @@
+#include <cstring>
+#include <future>
+#include <strings.h>
+
+#include "core/net/curl/.private/channel-impl.h"
+#include "core/net/curl/.private/event_loop.h"
+#include "core/net/curl/.private/libcurl_callbacks.h"
+#include "core/net/curl/.private/session-impl.h"
+#include "core/net/curl/.private/trace_points.h"
+
+
+using asio::error_code;
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+channel::event_loop::watched_socket::watched_socket(asio::io_service & svc,
+        uint64_t n) : descriptor(svc), serial(n), wanted(CURL_POLL_NONE),
+        reading(false), writing(false) {
+}
+
+
+channel::event_loop::watched_socket::~watched_socket() {
+    // Curl owns the descriptor; don't let asio close it.
+    if (descriptor.is_open()) {
+        descriptor.release();
+    }
+}
+
+
+channel::event_loop::event_loop(unsigned n) : index(n), io_service(),
+        work(), timeout(io_service), sockets(), next_socket_serial(1),
+        transfers(), timers(), resolving(), next_resolve_ticket(1), multi(), policy(), still_running(0), runner(),
+        session_count(0), finished_transfers(0), connections_opened(0),
+        reused_transfers(0), http2_transfers(0) {
+
+    curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, libcurl_callbacks::on_socket_update);
+    curl_multi_setopt(multi, CURLMOPT_SOCKETDATA, this);
+
+    curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, libcurl_callbacks::on_adjust_timeout);
+    curl_multi_setopt(multi, CURLMOPT_TIMERDATA, this);
+
+    set_connection_policy(policy);
+}
+
+
+channel::event_loop::~event_loop() {
+    stop();
+}
+
+
+void channel::event_loop::start() {
+    if (runner.joinable()) {
+        return;
+    }
+    io_service.reset();
+    // Give the io_service some abstract "work", so run() doesn't return just
+    // because no socket happens to be busy.
+    work.reset(new asio::io_service::work(io_service));
+    runner = std::thread([this] { io_service.run(); });
+}
+
+
+void channel::event_loop::stop() {
+    if (!runner.joinable()) {
+        return;
+    }
+    run_sync([this] { abort_transfers(); });
+    work.reset();
+    io_service.stop();
+    runner.join();
+}
+
+
+bool channel::event_loop::is_running() const {
+    return runner.joinable();
+}
+
+
+bool channel::event_loop::is_current_thread() const {
+    return runner.get_id() == std::this_thread::get_id();
+}
+
+
+void channel::event_loop::run_sync(std::function<void()> const & fn) {
+    if (!is_running() || is_current_thread()) {
+        fn();
+        return;
+    }
+    std::promise<void> done;
+    io_service.post([&fn, &done] {
+        try {
+            fn();
+            done.set_value();
+        } catch (...) {
+            done.set_exception(std::current_exception());
+        }
+    });
+    done.get_future().get();
+}
+
+
+void channel::event_loop::add_transfer(session::impl_t * simpl) {
+    io_service.post([this, simpl] {
+        transfers.insert(simpl);
+        resolve_then_start(simpl, true);
+    });
+}
+
+
+/**
+ * Hand the transfer to curl once the channel's resolver knows its host, so
+ * curl never has to look it up on this thread.
+ */
+void channel::event_loop::resolve_then_start(session::impl_t * simpl,
+        bool may_wait) {
+    std::function<void()> ready;
+    uint64_t ticket = 0;
+    if (may_wait) {
+        ticket = next_resolve_ticket++;
+        ready = [this, simpl, ticket] {
+            io_service.post([this, simpl, ticket] {
+                auto it = resolving.find(simpl);
+                if (it != resolving.end() && it->second == ticket) {
+                    resolving.erase(it);
+                    resolve_then_start(simpl, false);
+                }
+            });
+        };
+    }
+    if (simpl->channel && !simpl->channel->impl->dns->prepare(
+            simpl->current_request->url, simpl->resolve_list, std::move(ready))) {
+        resolving[simpl] = ticket;
+        return;
+    }
+    start_transfer(simpl);
+}
+
+
+void channel::event_loop::start_transfer(session::impl_t * simpl) {
+    // Curl reads the list when the transfer starts, and every time it starts
+    // over; the session keeps it until the next transfer.
+    curl_easy_setopt(simpl->easy, CURLOPT_RESOLVE, simpl->resolve_list);
+    apply_connection_policy(simpl->easy, simpl->current_request->url);
+    auto rc = curl_multi_add_handle(multi, simpl->easy);
+    mcode_or_die("add_transfer: multi_add_handle", rc);
+    if (simpl->hedge_after_millisecs) {
+        run_later(simpl, simpl->hedge_after_millisecs, [simpl] { simpl->start_hedge(); });
+    }
+    // The add sets a zero timeout; on_timeout() kicks off the transfer.
+}
+
+
+void channel::event_loop::set_connection_policy(connection_policy const & p) {
+    policy = p;
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING,
+            p.multiplex ? CURLPIPE_MULTIPLEX : CURLPIPE_NOTHING);
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+            static_cast<long>(p.max_host_connections));
+    curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS,
+            static_cast<long>(p.max_total_connections));
+    if (p.max_idle_connections) {
+        curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS,
+                static_cast<long>(p.max_idle_connections));
+    }
+    // curl's own default is 100 streams.
+    curl_multi_setopt(multi, CURLMOPT_MAX_CONCURRENT_STREAMS,
+            static_cast<long>(p.max_streams_per_connection ?
+                    p.max_streams_per_connection : 100));
+}
+
+
+/**
+ * Connection options come from the loop rather than the session, so a policy
+ * change reaches every transfer that starts after it.
+ */
+void channel::event_loop::apply_connection_policy(CURL * easy, char const * url) {
+    curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, policy.multiplex ?
+            CURL_HTTP_VERSION_2TLS : CURL_HTTP_VERSION_1_1);
+    // Only https can multiplex, so plain http has nothing to wait for; a
+    // hedge would otherwise queue up behind the very transfer it races.
+    bool tls = url && strncasecmp(url, "https:", 6) == 0;
+    curl_easy_setopt(easy, CURLOPT_PIPEWAIT,
+            policy.multiplex && policy.wait_for_multiplex && tls ? 1L : 0L);
+    auto idle = policy.keepalive_idle_secs;
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, idle ? 1L : 0L);
+    if (idle) {
+        auto interval = policy.keepalive_interval_secs;
+        curl_easy_setopt(easy, CURLOPT_TCP_KEEPIDLE, static_cast<long>(idle));
+        curl_easy_setopt(easy, CURLOPT_TCP_KEEPINTVL,
+                static_cast<long>(interval ? interval : idle));
+    }
+    if (policy.max_idle_secs) {
+        curl_easy_setopt(easy, CURLOPT_MAXAGE_CONN, static_cast<long>(policy.max_idle_secs));
+    }
+}
+
+
+void channel::event_loop::remove_transfer(session::impl_t * simpl) {
+    auto range = timers.equal_range(simpl);
+    for (auto it = range.first; it != range.second; ++it) {
+        it->second->cancel();
+    }
+    timers.erase(range.first, range.second);
+    resolving.erase(simpl);
+    if (transfers.erase(simpl)) {
+        curl_multi_remove_handle(multi, simpl->easy);
+        // Let the next transfer in line have the slot.
+        if (simpl->channel) {
+            simpl->channel->impl->admission->release(simpl);
+        }
+    }
+}
+
+
+void channel::event_loop::resume_transfer(session::impl_t * simpl, uint32_t id) {
+    io_service.post([this, simpl, id] {
+        // By now the transfer may have finished, and the session may even be
+        // gone; only a transfer we still run, and that is still paused,
+        // continues.
+        if (transfers.count(simpl) && simpl->id == id && simpl->paused) {
+            simpl->paused = false;
+            curl_easy_pause(simpl->easy, CURLPAUSE_CONT);
+        }
+    });
+}
+
+
+void channel::event_loop::suspend_transfer(session::impl_t * simpl) {
+    // Harmless if the handle isn't in the multi handle.
+    curl_multi_remove_handle(multi, simpl->easy);
+}
+
+
+void channel::event_loop::retry_transfer(session::impl_t * simpl,
+        unsigned delay_millisecs) {
+    suspend_transfer(simpl);
+    run_later(simpl, delay_millisecs, [this, simpl] {
+        auto rc = curl_multi_add_handle(multi, simpl->easy);
+        mcode_or_die("retry_transfer: multi_add_handle", rc);
+    });
+}
+
+
+void channel::event_loop::run_later(session::impl_t * simpl,
+        unsigned delay_millisecs, std::function<void()> fn) {
+    auto timer = std::make_shared<asio::deadline_timer>(io_service);
+    timers.emplace(simpl, timer);
+    timer->expires_from_now(boost::posix_time::millisec(delay_millisecs));
+    // The handler holds the timer, so a cancelled wait can still complete.
+    timer->async_wait([this, simpl, timer, fn](error_code const & ec) {
+        if (ec) {
+            return;
+        }
+        auto range = timers.equal_range(simpl);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == timer) {
+                timers.erase(it);
+                break;
+            }
+        }
+        fn();
+    });
+}
+
+
+void channel::event_loop::abort_transfers() {
+    while (!transfers.empty()) {
+        auto simpl = *transfers.begin();
+        if (!simpl->error[0]) {
+            strcpy(simpl->error, "Channel closed before transfer finished.");
+        }
+        // Wakes anyone waiting on the session.
+        simpl->cleanup_after_transfer(CURLE_ABORTED_BY_CALLBACK);
+        remove_transfer(simpl);
+    }
+}
+
+
+bool channel::event_loop::watch_socket(curl_socket_t fd, int what,
+        watched_socket * ws) {
+    if (!ws) {
+        auto & slot = sockets[fd];
+        // A leftover entry means curl reused the number without telling us
+        // it closed the old socket. Unregister before registering again.
+        slot.reset();
+        slot.reset(new watched_socket(io_service, next_socket_serial++));
+        error_code ec;
+        slot->descriptor.assign(fd, ec);
+        if (ec) {
+            trace_event(trace::unwatchable, index, static_cast<uint64_t>(fd),
+                    static_cast<uint64_t>(ec.value()));
+            sockets.erase(fd);
+            return false;
+        }
+        ws = slot.get();
+        // Tell curl to give us this pointer any time it updates the socket.
+        curl_multi_assign(multi, fd, ws);
+    }
+    ws->wanted = what;
+    arm(fd, *ws);
+    return true;
+}
+
+
+void channel::event_loop::forget_socket(curl_socket_t fd) {
+    // Any outstanding wait completes with operation_aborted, and finds
+    // nothing when it looks the socket up.
+    sockets.erase(fd);
+}
+
+
+void channel::event_loop::arm(curl_socket_t fd, watched_socket & ws) {
+    auto serial = ws.serial;
+    if ((ws.wanted & CURL_POLL_IN) && !ws.reading) {
+        ws.reading = true;
+        ws.descriptor.async_read_some(asio::null_buffers(),
+                [this, fd, serial](error_code const & ec, size_t) {
+                    on_socket_ready(fd, serial, CURL_CSELECT_IN, ec);
+                });
+    }
+    if ((ws.wanted & CURL_POLL_OUT) && !ws.writing) {
+        ws.writing = true;
+        ws.descriptor.async_write_some(asio::null_buffers(),
+                [this, fd, serial](error_code const & ec, size_t) {
+                    on_socket_ready(fd, serial, CURL_CSELECT_OUT, ec);
+                });
+    }
+}
+
+
+/**
+ * Called by asio when a socket is readable or writable. Asio's reactor is
+ * edge-triggered, so each wait is one-shot; we re-arm after curl has had its
+ * turn, for as long as curl still wants the socket.
+ */
+void channel::event_loop::on_socket_ready(curl_socket_t fd, uint64_t serial,
+        int flag, error_code const & ec) {
+
+    auto it = sockets.find(fd);
+    if (it == sockets.end() || it->second->serial != serial) {
+        // curl stopped watching this socket while the wait was pending.
+        return;
+    }
+    auto & ws = *it->second;
+    bool & outstanding = (flag == CURL_CSELECT_IN) ? ws.reading : ws.writing;
+    outstanding = false;
+    if (ec == asio::error::operation_aborted) {
+        return;
+    }
+    int wanted_bit = (flag == CURL_CSELECT_IN) ? CURL_POLL_IN : CURL_POLL_OUT;
+    if (!(ws.wanted & wanted_bit)) {
+        // curl changed its mind after we started waiting.
+        return;
+    }
+
+    act(fd, ec ? CURL_CSELECT_ERR : flag);
+
+    it = sockets.find(fd);
+    if (it != sockets.end() && it->second->serial == serial) {
+        arm(fd, *it->second);
+    }
+}
+
+
+void channel::event_loop::on_timeout(error_code const & error) {
+    if (!error) {
+        act(CURL_SOCKET_TIMEOUT, 0);
+    }
+}
+
+
+void channel::event_loop::set_timeout(long timeout_ms) {
+    // Stop any pending countdown.
+    timeout.cancel();
+
+    // -1 means curl needs no timer. Zero means "as soon as possible"; we
+    // still go through the timer, because curl doesn't allow
+    // curl_multi_socket_action() to be called from inside its own callbacks.
+    if (timeout_ms >= 0) {
+        timeout.expires_from_now(boost::posix_time::millisec(timeout_ms));
+        timeout.async_wait([this](error_code const & ec) { on_timeout(ec); });
+    }
+}
+
+
+void channel::event_loop::act(curl_socket_t fd, int flags) {
+    auto rc = curl_multi_socket_action(multi, fd, flags, &still_running);
+    mcode_or_die("event_loop: multi_socket_action", rc);
+
+    handle_done_transfers();
+
+    if (still_running <= 0) {
+        timeout.cancel();
+    }
+}
+
+
+void channel::event_loop::count_connections(CURL * easy) {
+    long opened = 0;
+    long status = 0;
+    long version = 0;
+    curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &opened);
+    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_getinfo(easy, CURLINFO_HTTP_VERSION, &version);
+    ++finished_transfers;
+    connections_opened += static_cast<uint64_t>(opened);
+    // A transfer that never reached a server didn't reuse anything, either.
+    if (!opened && status) {
+        ++reused_transfers;
+    }
+    if (version == CURL_HTTP_VERSION_2_0) {
+        ++http2_transfers;
+    }
+}
+
+
+/* Check for completed transfers, and remove their easy handles */
+void channel::event_loop::handle_done_transfers() {
+
+    CURLMsg *msg;
+    int msgs_left;
+    session::impl_t * simpl;
+
+    while ((msg = curl_multi_info_read(multi, &msgs_left)) != nullptr) {
+        if (msg->msg == CURLMSG_DONE) {
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &simpl);
+            count_connections(msg->easy_handle);
+            simpl->finish_attempt(msg->data.result);
+        }
+    }
+}
+
+
+}}}} // end namespace
@@ -12,6 +12,9 @@ class channel;
 class session;
 class request;
 class response;
+class body_sink;
+class body_source;
+class http_cache;
 
 
 }}}} // end namespace
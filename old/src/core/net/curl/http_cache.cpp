@@ -0,0 +1,758 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "core/net/curl/.private/http_cache-impl.h"
+#include "core/net/curl/.private/session-impl.h"
+#include "core/net/curl/.private/trace_points.h"
+#include "core/net/curl/state_error.h"
+#include "core/text/interp.h"
+#include "core/util/sha256.h"
+
+
+using std::lock_guard;
+using std::mutex;
+using std::string;
+
+using intent::core::text::interp;
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+namespace {
+
+// Headers about the connection, not the content; not worth keeping.
+bool is_hop_by_hop(char const * name) {
+    static char const * const names[] = {"Connection", "Keep-Alive",
+            "Transfer-Encoding", "Proxy-Connection", "Upgrade"};
+    for (auto x : names) {
+        if (strcasecmp(name, x) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+struct cache_control {
+    bool no_store;
+    bool no_cache;
+    long max_age; // -1 if not given
+
+    explicit cache_control(char const * value) : no_store(false),
+            no_cache(false), max_age(-1) {
+        if (!value) {
+            return;
+        }
+        auto p = value;
+        while (*p) {
+            while (*p == ' ' || *p == ',' || *p == '\t') {
+                ++p;
+            }
+            auto begin = p;
+            while (*p && *p != ',' && *p != '=') {
+                ++p;
+            }
+            string name(begin, p);
+            while (!name.empty() && isspace(static_cast<unsigned char>(name.back()))) {
+                name.pop_back();
+            }
+            string arg;
+            if (*p == '=') {
+                begin = ++p;
+                while (*p && *p != ',') {
+                    ++p;
+                }
+                arg.assign(begin, p);
+            }
+            if (strcasecmp(name.c_str(), "no-store") == 0) {
+                no_store = true;
+            } else if (strcasecmp(name.c_str(), "no-cache") == 0) {
+                no_cache = true;
+            } else if (strcasecmp(name.c_str(), "max-age") == 0) {
+                max_age = isdigit(static_cast<unsigned char>(arg.c_str()[0])) ?
+                        strtol(arg.c_str(), nullptr, 10) : 0;
+            }
+        }
+    }
+};
+
+
+char const * get_header(cached_response const & r, char const * name) {
+    for (auto & line : r.header_lines) {
+        if (strcasecmp(line.first.c_str(), name) == 0) {
+            return line.second.c_str();
+        }
+    }
+    return nullptr;
+}
+
+
+time_t parse_date(char const * value) {
+    return value ? curl_getdate(value, nullptr) : -1;
+}
+
+
+// How long after now the response stays fresh (RFC 7234, 4.2.1). Only what
+// the server says explicitly; we don't guess from Last-Modified.
+void set_freshness(cached_response & r, time_t now) {
+    r.stored_at = now;
+    r.fresh_until = now;
+    cache_control cc(get_header(r, "Cache-Control"));
+    if (cc.no_cache) {
+        return;
+    }
+    long lifetime = 0;
+    if (cc.max_age >= 0) {
+        lifetime = cc.max_age;
+    } else {
+        auto expires = parse_date(get_header(r, "Expires"));
+        if (expires > 0) {
+            auto date = parse_date(get_header(r, "Date"));
+            lifetime = static_cast<long>(expires - (date > 0 ? date : now));
+        }
+    }
+    auto age = get_header(r, "Age");
+    if (age && isdigit(static_cast<unsigned char>(*age))) {
+        lifetime -= strtol(age, nullptr, 10);
+    }
+    if (lifetime > 0) {
+        r.fresh_until = now + lifetime;
+    }
+}
+
+
+void set_validators(cached_response & r) {
+    auto etag = get_header(r, "ETag");
+    r.etag = etag ? etag : "";
+    auto modified = get_header(r, "Last-Modified");
+    r.last_modified = modified ? modified : "";
+}
+
+
+} // end anonymous namespace
+
+
+void http_cache::impl_t::copy_headers(response::impl_t & resp, cached_response & r) {
+    auto & h = resp.headers;
+    for (unsigned i = 0, n = h.get_header_count(); i < n; ++i) {
+        auto name = h.get_header_by_index(i);
+        if (name && !is_hop_by_hop(name)) {
+            auto value = h.get(name);
+            r.header_lines.emplace_back(name, value ? value : "");
+        }
+    }
+}
+
+
+namespace {
+
+
+// SHA-256, as hex. Bodies on disk are named, and shared, by this digest, so
+// it must be one a server can't forge a collision for: otherwise one url's
+// entry could be made to serve another's body.
+string hash_hex(string const & s) {
+    return util::sha256_hex(s);
+}
+
+
+// Write a whole file, so that readers never see half of it.
+bool write_file(filesystem::path const & path, string const & content) {
+    auto tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp.string(), std::ios::binary | std::ios::trunc);
+        out.write(content.data(), content.size());
+        if (!out) {
+            return false;
+        }
+    }
+    boost::system::error_code ec;
+    filesystem::rename(tmp, path, ec);
+    return !ec;
+}
+
+
+bool read_file(filesystem::path const & path, string & content) {
+    std::ifstream in(path.string(), std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::ostringstream buf;
+    buf << in.rdbuf();
+    content = buf.str();
+    return true;
+}
+
+
+/*
+ * Index files look like this; the key is length-prefixed, since it spans
+ * lines.
+ *
+ *     intent-http-cache 2
+ *     key 31
+ *     http://example.com/a
+ *     Accept: x
+ *     status 200
+ *     stored 1700000000
+ *     fresh 1700000060
+ *     body 5f1c...e2 1234
+ *     header ETag: "abc"
+ */
+// Version 1 named files by a weaker hash; its indexes fail to parse, so they
+// are dropped (with their bodies) when the store opens.
+static constexpr char const * index_magic = "intent-http-cache 2";
+
+string format_index(string const & key, cached_response const & r, string const & blob) {
+    std::ostringstream out;
+    out << index_magic << '\n'
+            << "key " << key.size() << '\n' << key << '\n'
+            << "url " << r.url << '\n'
+            << "status " << r.status_code << '\n'
+            << "stored " << static_cast<long long>(r.stored_at) << '\n'
+            << "fresh " << static_cast<long long>(r.fresh_until) << '\n'
+            << "body " << blob << ' ' << r.body.size() << '\n';
+    for (auto & line : r.header_lines) {
+        out << "header " << line.first << ": " << line.second << '\n';
+    }
+    return out.str();
+}
+
+
+// Returns false if the file is damaged. On success, the body is still empty.
+bool parse_index(string const & txt, string & key, cached_response & r,
+        string & blob, uint64_t & body_size) {
+    std::istringstream in(txt);
+    string line;
+    if (!std::getline(in, line) || line != index_magic) {
+        return false;
+    }
+    size_t key_size = 0;
+    if (!std::getline(in, line) || sscanf(line.c_str(), "key %zu", &key_size) != 1) {
+        return false;
+    }
+    // A damaged size mustn't send us off to allocate more than the file holds.
+    auto pos = in.tellg();
+    if (pos < 0 || key_size > txt.size() - static_cast<size_t>(pos)) {
+        return false;
+    }
+    key.resize(key_size);
+    if (!in.read(&key[0], key_size) || in.get() != '\n') {
+        return false;
+    }
+    bool have_body = false;
+    while (std::getline(in, line)) {
+        auto space = line.find(' ');
+        if (space == string::npos) {
+            return false;
+        }
+        auto field = line.substr(0, space);
+        auto value = line.substr(space + 1);
+        if (field == "url") {
+            r.url = value;
+        } else if (field == "status") {
+            r.status_code = static_cast<uint16_t>(strtoul(value.c_str(), nullptr, 10));
+        } else if (field == "stored") {
+            r.stored_at = static_cast<time_t>(strtoll(value.c_str(), nullptr, 10));
+        } else if (field == "fresh") {
+            r.fresh_until = static_cast<time_t>(strtoll(value.c_str(), nullptr, 10));
+        } else if (field == "body") {
+            char hex[80];
+            unsigned long long n = 0;
+            if (sscanf(value.c_str(), "%79s %llu", hex, &n) != 2) {
+                return false;
+            }
+            blob = hex;
+            body_size = n;
+            have_body = true;
+        } else if (field == "header") {
+            auto colon = value.find(": ");
+            if (colon == string::npos) {
+                return false;
+            }
+            r.header_lines.emplace_back(value.substr(0, colon), value.substr(colon + 2));
+        }
+    }
+    set_validators(r);
+    return have_body;
+}
+
+} // end anonymous namespace
+
+
+size_t cached_response::get_size() const {
+    auto n = sizeof(*this) + body.size() + url.size();
+    for (auto & line : header_lines) {
+        n += line.first.size() + line.second.size() + 2 * sizeof(string);
+    }
+    return n;
+}
+
+
+net::headers cached_response::make_headers() const {
+    net::headers h;
+    for (auto & line : header_lines) {
+        h.set(line.first, line.second);
+    }
+    return h;
+}
+
+
+content_store::content_store(filesystem::path const & folder, uint64_t budget) :
+        index_folder(folder / "index"), blob_folder(folder / "blobs"),
+        budget(budget), mtx(), entries(), blobs(), bytes(0), clock(0) {
+    boost::system::error_code ec;
+    filesystem::create_directories(index_folder, ec);
+    if (!ec) {
+        filesystem::create_directories(blob_folder, ec);
+    }
+    if (ec) {
+        throw state_error(interp("Can't use '{1}' for an http cache: {2}.",
+                {folder.string(), ec.message()}));
+    }
+
+    // Find out what an earlier run left us. Oldest first, so the clock
+    // roughly follows the order they were last written.
+    std::vector<std::pair<std::time_t, filesystem::path>> found;
+    for (filesystem::directory_iterator i(index_folder, ec), end; !ec && i != end; i.increment(ec)) {
+        auto & path = i->path();
+        if (path.extension() == ".tmp") {
+            filesystem::remove(path, ec);
+            continue;
+        }
+        found.emplace_back(filesystem::last_write_time(path, ec), path);
+    }
+    std::sort(found.begin(), found.end());
+    for (auto & x : found) {
+        string txt, key, blob;
+        cached_response r;
+        uint64_t size = 0;
+        if (!read_file(x.second, txt) || !parse_index(txt, key, r, blob, size)
+                || !filesystem::exists(blob_folder / blob, ec)) {
+            filesystem::remove(x.second, ec);
+            continue;
+        }
+        entries[x.second.filename().string()] = entry{blob, ++clock};
+        auto & b = blobs[blob];
+        if (!b.refs++) {
+            b.size = size;
+            bytes += size;
+        }
+    }
+    // Bodies nobody refers to anymore.
+    for (filesystem::directory_iterator i(blob_folder, ec), end; !ec && i != end; i.increment(ec)) {
+        if (!blobs.count(i->path().filename().string())) {
+            filesystem::remove(i->path(), ec);
+        }
+    }
+    shrink();
+}
+
+
+cached_response_ptr content_store::load(string const & key) {
+    auto key_hash = hash_hex(key);
+    lock_guard<mutex> lock(mtx);
+    auto it = entries.find(key_hash);
+    if (it == entries.end()) {
+        return nullptr;
+    }
+    string txt, stored_key, blob;
+    auto r = std::make_shared<cached_response>();
+    uint64_t size = 0;
+    if (!read_file(index_folder / key_hash, txt)
+            || !parse_index(txt, stored_key, *r, blob, size)
+            || stored_key != key || blob != it->second.blob
+            || !read_file(blob_folder / blob, r->body) || r->body.size() != size
+            || hash_hex(r->body) != blob) {
+        forget(key_hash);
+        return nullptr;
+    }
+    it->second.used = ++clock;
+    return r;
+}
+
+
+void content_store::save(string const & key, cached_response const & r) {
+    auto key_hash = hash_hex(key);
+    auto blob = hash_hex(r.body);
+    lock_guard<mutex> lock(mtx);
+    if (r.body.size() > budget) {
+        forget(key_hash);
+        return;
+    }
+    auto b = blobs.find(blob);
+    if (b == blobs.end() || b->second.size != r.body.size()) {
+        if (!write_file(blob_folder / blob, r.body)) {
+            return;
+        }
+    }
+    if (!write_file(index_folder / key_hash, format_index(key, r, blob))) {
+        return;
+    }
+    auto it = entries.find(key_hash);
+    if (it != entries.end() && it->second.blob == blob) {
+        it->second.used = ++clock;
+        return;
+    }
+    if (it != entries.end()) {
+        // Keep the new index file; only let go of the old body.
+        auto old = blobs.find(it->second.blob);
+        if (old != blobs.end() && !--old->second.refs) {
+            bytes -= old->second.size;
+            boost::system::error_code ec;
+            filesystem::remove(blob_folder / old->first, ec);
+            blobs.erase(old);
+        }
+    }
+    entries[key_hash] = entry{blob, ++clock};
+    auto & info = blobs[blob];
+    if (!info.refs++) {
+        info.size = r.body.size();
+        bytes += info.size;
+    }
+    shrink();
+}
+
+
+void content_store::forget(string const & key_hash) {
+    boost::system::error_code ec;
+    auto it = entries.find(key_hash);
+    filesystem::remove(index_folder / key_hash, ec);
+    if (it == entries.end()) {
+        return;
+    }
+    auto b = blobs.find(it->second.blob);
+    if (b != blobs.end() && !--b->second.refs) {
+        bytes -= b->second.size;
+        filesystem::remove(blob_folder / b->first, ec);
+        blobs.erase(b);
+    }
+    entries.erase(it);
+}
+
+
+void content_store::shrink() {
+    while (bytes > budget && !entries.empty()) {
+        auto oldest = entries.begin();
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->second.used < oldest->second.used) {
+                oldest = it;
+            }
+        }
+        forget(oldest->first);
+    }
+}
+
+
+void content_store::clear() {
+    lock_guard<mutex> lock(mtx);
+    while (!entries.empty()) {
+        forget(entries.begin()->first);
+    }
+}
+
+
+size_t content_store::get_entry_count() const {
+    lock_guard<mutex> lock(mtx);
+    return entries.size();
+}
+
+
+uint64_t content_store::get_byte_count() const {
+    lock_guard<mutex> lock(mtx);
+    return bytes;
+}
+
+
+http_cache::impl_t::impl_t(config const & c) : cfg(c), disk(), mtx(), lru(),
+        by_key(), memory_bytes(0), in_flight(), answering(), answered(), hits(0), revalidated(0),
+        misses(0), coalesced(0), stored(0) {
+    if (!cfg.folder.empty()) {
+        disk.reset(new content_store(cfg.folder, cfg.disk_bytes));
+    }
+}
+
+
+http_cache::impl_t::plan http_cache::impl_t::consider(string const & key,
+        session::impl_t * s, cached_response_ptr & entry, time_t now) {
+    if (auto found = recall(key)) {
+        entry = found;
+    }
+    if (entry && entry->is_fresh(now)) {
+        ++hits;
+        return plan::serve;
+    }
+    auto it = in_flight.find(key);
+    if (it != in_flight.end()) {
+        it->second.push_back(s);
+        ++coalesced;
+        return plan::follow;
+    }
+    return plan::fetch;
+}
+
+
+http_cache::impl_t::plan http_cache::impl_t::begin(string const & key,
+        session::impl_t * s, cached_response_ptr & entry) {
+    auto now = std::time(nullptr);
+    {
+        lock_guard<mutex> lock(mtx);
+        auto p = consider(key, s, entry, now);
+        if (p != plan::fetch || entry || !disk) {
+            if (p == plan::fetch) {
+                in_flight[key];
+            }
+            return p;
+        }
+    }
+    // Memory has nothing; try the disk, without holding the lock. By the time
+    // we're back, someone else may have stored or started the same GET.
+    entry = disk->load(key);
+    lock_guard<mutex> lock(mtx);
+    if (entry && !recall(key)) {
+        remember(key, entry);
+    }
+    auto p = consider(key, s, entry, now);
+    if (p == plan::fetch) {
+        in_flight[key];
+    }
+    return p;
+}
+
+
+http_cache::impl_t::followers http_cache::impl_t::finish(string const & key,
+        cached_response_ptr keep) {
+    followers waiting;
+    {
+        lock_guard<mutex> lock(mtx);
+        if (keep) {
+            remember(key, keep);
+            ++stored;
+        }
+        auto it = in_flight.find(key);
+        if (it != in_flight.end()) {
+            waiting.swap(it->second);
+            in_flight.erase(it);
+            answering.insert(waiting.begin(), waiting.end());
+        }
+    }
+    if (keep && disk) {
+        disk->save(key, *keep);
+    }
+    return waiting;
+}
+
+
+void http_cache::impl_t::answer(followers const & waiting,
+        cached_response const & outcome) {
+    if (waiting.empty()) {
+        return;
+    }
+    // Sessions lock before the cache does, so we can't hold our lock here.
+    // A follower being destroyed meanwhile waits in withdraw() instead.
+    std::vector<session::impl_t::delivery> owed(waiting.size());
+    for (size_t i = 0; i < waiting.size(); ++i) {
+        auto f = waiting[i];
+        lock_guard<mutex> lock(f->mtx);
+        f->cache.reset();
+        f->cache_key.clear();
+        f->answer_from(outcome, cache_outcome::coalesced);
+        f->take_completion(owed[i]);
+    }
+    {
+        lock_guard<mutex> lock(mtx);
+        for (auto f : waiting) {
+            answering.erase(answering.find(f));
+        }
+        answered.notify_all();
+    }
+    for (auto & d : owed) {
+        d.deliver();
+    }
+}
+
+
+void http_cache::impl_t::withdraw(string const & key, session::impl_t * s) {
+    std::unique_lock<mutex> lock(mtx);
+    auto it = in_flight.find(key);
+    if (it != in_flight.end()) {
+        auto & v = it->second;
+        v.erase(std::remove(v.begin(), v.end(), s), v.end());
+    }
+    answered.wait(lock, [this, s] { return !answering.count(s); });
+}
+
+
+cached_response_ptr http_cache::impl_t::recall(string const & key) {
+    auto it = by_key.find(key);
+    if (it == by_key.end()) {
+        return nullptr;
+    }
+    lru.splice(lru.begin(), lru, it->second);
+    return it->second->second;
+}
+
+
+void http_cache::impl_t::remember(string const & key, cached_response_ptr r) {
+    auto it = by_key.find(key);
+    if (it != by_key.end()) {
+        evict(it->second);
+    }
+    auto size = r->get_size();
+    if (size > cfg.memory_bytes) {
+        return;
+    }
+    lru.emplace_front(key, std::move(r));
+    by_key[key] = lru.begin();
+    memory_bytes += size;
+    while (memory_bytes > cfg.memory_bytes) {
+        evict(std::prev(lru.end()));
+    }
+}
+
+
+void http_cache::impl_t::evict(lru_list::iterator it) {
+    memory_bytes -= it->second->get_size();
+    by_key.erase(it->first);
+    lru.erase(it);
+}
+
+
+void http_cache::impl_t::clear() {
+    {
+        lock_guard<mutex> lock(mtx);
+        lru.clear();
+        by_key.clear();
+        memory_bytes = 0;
+    }
+    if (disk) {
+        disk->clear();
+    }
+}
+
+
+string http_cache::impl_t::get_key(request::impl_t & req) {
+    string key = req.url ? req.url : "";
+    auto & h = req.headers;
+    for (unsigned i = 0, n = h.get_header_count(); i < n; ++i) {
+        auto name = h.get_header_by_index(i);
+        auto value = h.get(name);
+        key += '\n';
+        key += name;
+        key += ": ";
+        key += value ? value : "";
+    }
+    if (!req.decode) {
+        // Bodies we keep are decoded; this one wants what was sent.
+        key += "\n(encoded)";
+    }
+    return key;
+}
+
+
+cached_response_ptr http_cache::impl_t::make_cacheable(response::impl_t & resp,
+        char const * url, size_t max_bytes, time_t now) {
+    if (resp.status_code != 200 || resp.received_bytes.size() > max_bytes) {
+        return nullptr;
+    }
+    // We key only by url and our own request headers, so we can't keep
+    // answers that depend on others.
+    auto vary = resp.headers.get("Vary");
+    if (vary && *vary) {
+        return nullptr;
+    }
+    auto r = std::make_shared<cached_response>();
+    r->status_code = resp.status_code;
+    copy_headers(resp, *r);
+    cache_control cc(get_header(*r, "Cache-Control"));
+    if (cc.no_store) {
+        return nullptr;
+    }
+    set_freshness(*r, now);
+    set_validators(*r);
+    if (!r->is_fresh(now) && !r->has_validator()) {
+        // We could never use it.
+        return nullptr;
+    }
+    r->body = resp.received_bytes;
+    r->url = resp.effective_url ? resp.effective_url : url;
+    return r;
+}
+
+
+cached_response_ptr http_cache::impl_t::make_snapshot(response::impl_t & resp,
+        char const * error) {
+    auto r = std::make_shared<cached_response>();
+    r->status_code = resp.status_code;
+    copy_headers(resp, *r);
+    r->body = resp.received_bytes;
+    r->url = resp.effective_url ? resp.effective_url : "";
+    r->error = error ? error : "";
+    return r;
+}
+
+
+cached_response_ptr http_cache::impl_t::refresh(cached_response const & stale,
+        response::impl_t & not_modified, time_t now) {
+    auto r = std::make_shared<cached_response>(stale);
+    cached_response update;
+    copy_headers(not_modified, update);
+    for (auto & line : update.header_lines) {
+        // A 304 has no body, so its framing says nothing about ours.
+        if (strcasecmp(line.first.c_str(), "Content-Length") == 0) {
+            continue;
+        }
+        auto & lines = r->header_lines;
+        auto same = std::find_if(lines.begin(), lines.end(),
+                [&line](std::pair<string, string> const & x) {
+                    return strcasecmp(x.first.c_str(), line.first.c_str()) == 0;
+                });
+        if (same != lines.end()) {
+            same->second = line.second;
+        } else {
+            lines.push_back(line);
+        }
+    }
+    set_freshness(*r, now);
+    set_validators(*r);
+    return r;
+}
+
+
+http_cache::http_cache(config const & cfg) :
+        impl(std::make_shared<impl_t>(cfg)) {
+}
+
+
+http_cache_stats http_cache::get_stats() const {
+    http_cache_stats stats;
+    stats.hits = impl->hits.load();
+    stats.revalidated = impl->revalidated.load();
+    stats.misses = impl->misses.load();
+    stats.coalesced = impl->coalesced.load();
+    stats.stored = impl->stored.load();
+    {
+        lock_guard<mutex> lock(impl->mtx);
+        stats.memory_entries = impl->lru.size();
+        stats.memory_bytes = impl->memory_bytes;
+    }
+    stats.disk_entries = impl->disk ? impl->disk->get_entry_count() : 0;
+    stats.disk_bytes = impl->disk ? impl->disk->get_byte_count() : 0;
+    return stats;
+}
+
+
+void http_cache::clear() {
+    impl->clear();
+}
+
+
+}}}} // end namespace
@@ -0,0 +1,127 @@
+#ifndef _0b7e4c9d2a5f4e61b8d3c7a19f60e2d4
+#define _0b7e4c9d2a5f4e61b8d3c7a19f60e2d4
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "core/marks/concurrency_marks.h"
+#include "core/net/curl/fwd.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * How a response came to be, as far as the cache is concerned.
+ */
+enum class cache_outcome : uint8_t {
+    /** The cache wasn't involved. */
+    none,
+    /** The cache had nothing usable; the response came from the server. */
+    miss,
+    /** A fresh copy was served from the cache, without touching the network. */
+    hit,
+    /** A stale copy was confirmed by the server (304), and served. */
+    revalidated,
+    /**
+     * An identical GET was already underway, so this one waited for it and
+     * shares its response.
+     */
+    coalesced
+};
+
+
+/**
+ * A snapshot of how a cache has been doing.
+ */
+struct http_cache_stats {
+    uint64_t hits;
+    uint64_t revalidated;
+    uint64_t misses;
+    uint64_t coalesced;
+    /** Responses written to the cache. */
+    uint64_t stored;
+    size_t memory_entries;
+    size_t memory_bytes;
+    size_t disk_entries;
+    /** Bodies on disk; responses with the same body share one file. */
+    uint64_t disk_bytes;
+};
+
+
+/**
+ * Keep responses to GET requests, and answer repeats locally.
+ *
+ * Responses are kept as the server's Cache-Control, Expires, ETag, and
+ * Last-Modified headers allow. While a copy is fresh, requests for it are
+ * answered without touching the network. Once it goes stale, the next request
+ * asks the server whether it changed (If-None-Match or If-Modified-Since), and
+ * a 304 answer serves the copy again. Responses marked no-store, or that vary
+ * by request header, aren't kept. This is a private cache, in the sense of
+ * RFC 7234: it belongs to one client, so "private" responses are kept too.
+ *
+ * Recently used responses stay in memory, up to a byte budget; the least
+ * recently used give way first. With a folder configured, responses are also
+ * written there, so they survive a restart. Bodies on disk are named by a
+ * hash of their content, and stored once no matter how many urls return them.
+ *
+ * While a GET is underway, identical GETs (same url, same request headers)
+ * sent on any session wait for it, rather than starting transfers of their
+ * own; they all get its response, whether or not it can be kept.
+ *
+ *     http_cache::config cfg;
+ *     cfg.folder = "/var/cache/myapp/http";
+ *     ch.set_http_cache(http_cache(cfg));
+ *
+ * Handles are ref-counted; copies refer to the same cache, which may be used
+ * by several channels at once.
+ */
+mark(+, threadsafe)
+class http_cache {
+    struct impl_t;
+    std::shared_ptr<impl_t> impl;
+
+    friend class channel;
+    friend class session;
+
+public:
+    struct config {
+        /** Bytes of responses to keep in memory. */
+        size_t memory_bytes;
+        /** Larger responses aren't cached at all. */
+        size_t max_entry_bytes;
+        /** Where to keep responses on disk. Empty (the default) means don't. */
+        std::string folder;
+        /** Bytes of bodies to keep on disk. */
+        uint64_t disk_bytes;
+
+        config() : memory_bytes(64 * 1024 * 1024),
+                max_entry_bytes(8 * 1024 * 1024), folder(),
+                disk_bytes(1024ull * 1024 * 1024) {
+        }
+    };
+
+    /**
+     * @throw state_error if a folder is configured, and it can't be created.
+     */
+    explicit http_cache(config const & = config());
+
+    http_cache_stats get_stats() const;
+
+    /** Forget everything, in memory and on disk. */
+    void clear();
+
+    bool operator ==(http_cache const & other) const { return impl == other.impl; }
+    bool operator !=(http_cache const & other) const { return impl != other.impl; }
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
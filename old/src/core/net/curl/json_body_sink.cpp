@@ -0,0 +1,172 @@
+#include "core/net/curl/json_body_sink.h"
+#include "core/util/dbc.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+static constexpr size_t npos = std::string::npos;
+
+// One element bigger than this is more than a streaming consumer bargained
+// for; the response's own buffer stops at the same size.
+static constexpr size_t max_element_size = 16 * 1024 * 1024;
+
+
+static inline bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+
+json_body_sink::json_body_sink(element_handler h) : handler(h), reader(),
+        carry(), scanned(0), element_begin(npos), where(phase::start),
+        depth(0), in_string(false), escaped(false), element_count(0),
+        error() {
+    precondition(handler);
+    json::char_reader_builder builder;
+    builder["collect_comments"] = false;
+    reader.reset(builder.new_char_reader());
+}
+
+
+json_body_sink::~json_body_sink() {
+}
+
+
+bool json_body_sink::emit(size_t begin, size_t end) {
+    json::value v;
+    char const * txt = carry.data();
+    if (!reader->parse(txt + begin, txt + end, &v, &error)) {
+        return false;
+    }
+    ++element_count;
+    element_begin = npos;
+    if (!handler(v)) {
+        error = "Element handler stopped the transfer.";
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * Find element boundaries by tracking brackets and strings; the JSON reader
+ * does the real parsing once an element is whole. Scalars end at the first
+ * separator, closing bracket, or space after them.
+ */
+sink_result json_body_sink::accept(char const * bytes, size_t byte_count) {
+    if (!error.empty()) {
+        return sink_result::failed;
+    }
+    carry.append(bytes, byte_count);
+
+    for (auto i = scanned; i < carry.size(); ++i) {
+        char c = carry[i];
+        if (in_string) {
+            if (escaped) {
+                escaped = false;
+            } else if (c == '\\') {
+                escaped = true;
+            } else if (c == '"') {
+                in_string = false;
+                if (depth == 0 && !emit(element_begin, i + 1)) {
+                    return sink_result::failed;
+                }
+            }
+            continue;
+        }
+        if (where == phase::start) {
+            if (is_space(c)) {
+                continue;
+            }
+            if (c == '[') {
+                where = phase::in_array;
+                continue;
+            }
+            where = phase::in_stream;
+        }
+        if (where == phase::done) {
+            continue;
+        }
+        if (element_begin == npos) {
+            if (is_space(c) || (c == ',' && where == phase::in_array)) {
+                continue;
+            }
+            if (c == ']' && where == phase::in_array) {
+                where = phase::done;
+                continue;
+            }
+            element_begin = i;
+        }
+        switch (c) {
+        case '"':
+            in_string = true;
+            break;
+        case '{':
+        case '[':
+            ++depth;
+            break;
+        case '}':
+        case ']':
+            if (depth == 0) {
+                // Closes the top-level array, right after a scalar.
+                if (!emit(element_begin, i)) {
+                    return sink_result::failed;
+                }
+                where = phase::done;
+            } else if (--depth == 0 && !emit(element_begin, i + 1)) {
+                return sink_result::failed;
+            }
+            break;
+        case ',':
+        case ' ':
+        case '\t':
+        case '\r':
+        case '\n':
+            if (depth == 0 && !emit(element_begin, i)) {
+                return sink_result::failed;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Keep only the unfinished element.
+    if (element_begin == npos) {
+        carry.clear();
+    } else if (element_begin) {
+        carry.erase(0, element_begin);
+        element_begin = 0;
+    }
+    scanned = carry.size();
+    if (carry.size() > max_element_size) {
+        error = "Element exceeds maximum size.";
+        return sink_result::failed;
+    }
+    return sink_result::accepted;
+}
+
+
+void json_body_sink::finish(bool ok) {
+    if (ok && error.empty()) {
+        if (element_begin != npos) {
+            // A scalar at the very end of a stream has nothing after it.
+            if (where == phase::in_stream && depth == 0 && !in_string) {
+                emit(element_begin, carry.size());
+            } else {
+                error = "Body ended inside an element.";
+            }
+        } else if (where == phase::in_array) {
+            error = "Body ended inside the top-level array.";
+        }
+    }
+    carry.clear();
+    scanned = 0;
+    element_begin = npos;
+}
+
+
+}}}} // end namespace
@@ -0,0 +1,66 @@
+#ifndef _087ecaca98934917b1d97e2ac6b67e0c
+#define _087ecaca98934917b1d97e2ac6b67e0c
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "core/data/json/json.h"
+#include "core/net/curl/body_sink.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * Parse a JSON body as it arrives, one element at a time. If the body is a
+ * top-level array, each element goes to the callback as soon as it is
+ * complete; otherwise the body is taken as a stream of values (for example,
+ * newline-delimited JSON), and each value goes to the callback. Only the
+ * element being received is held in memory, so a huge array of small records
+ * costs no more than one record.
+ *
+ * The callback runs on the transfer's event loop. Returning false stops the
+ * transfer.
+ */
+class json_body_sink : public body_sink {
+public:
+    typedef std::function<bool(json::value &)> element_handler;
+
+    explicit json_body_sink(element_handler handler);
+    ~json_body_sink();
+
+    virtual sink_result accept(char const * bytes, size_t byte_count);
+    virtual void finish(bool ok);
+
+    uint64_t get_element_count() const { return element_count; }
+
+    /** Why parsing stopped early, or an empty string. */
+    std::string const & get_error() const { return error; }
+
+private:
+    enum class phase { start, in_array, in_stream, done };
+
+    bool emit(size_t begin, size_t end);
+
+    element_handler handler;
+    std::unique_ptr<json::char_reader> reader;
+    std::string carry; // the element being received, and anything after it
+    size_t scanned; // how much of carry the scanner has seen
+    size_t element_begin; // offset in carry, or npos between elements
+    phase where;
+    unsigned depth; // brackets open inside the current element
+    bool in_string;
+    bool escaped;
+    uint64_t element_count;
+    std::string error;
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
@@ -1,12 +1,9 @@
-#include <functional>
-
-#include "core/net/curl/.private/channel-impl.h"
+#include "core/net/curl/.private/event_loop.h"
 #include "core/net/curl/.private/libcurl_callbacks.h"
 #include "core/net/curl/.private/session-impl.h"
 #include "core/net/curl/.private/response-impl.h"
-
-
-using namespace std::placeholders;
+#include "core/net/curl/.private/share.h"
+#include "core/net/curl/.private/trace_points.h"
 
 
 namespace intent {
@@ -19,82 +16,51 @@ namespace curl {
  * Update the event timer based on new knowledge from libcurl about next
  * time something should happen.
  */
-int libcurl_callbacks::on_adjust_timeout(CURLM *multi, long timeout_ms, void * _chimpl)
+int libcurl_callbacks::on_adjust_timeout(CURLM *multi, long timeout_ms, void * _loop)
 {
-    auto & chimpl = *reinterpret_cast<channel::impl_t *>(_chimpl);
-
-    // Stop any pending countdown.
-    chimpl.timeout.cancel();
-
-    if (timeout_ms > 0) {
-
-        // Setup a new countdown.
-        chimpl.timeout.expires_from_now(boost::posix_time::millisec(timeout_ms));
-        chimpl.timeout.async_wait(std::bind(&channel::impl_t::on_timeout, &chimpl, _1));
-
-    } else if (timeout_ms == 0){
-        // Curl needs us to call curl_multi_socket_action asap, so here goes...
-        // Usually this is because a transfer is complete (succeeded or aborted).
-        asio::error_code error; // success
-        chimpl.on_timeout(error);
-
-    } else {
-        // Stop any pending countdown.
-        chimpl.timeout.cancel();
-        // timer no longer needed. Leave it cancelled.
-    }
-
+    reinterpret_cast<channel::event_loop *>(_loop)->set_timeout(timeout_ms);
     return 0;
 }
 
 
-char const * get_socket_state_descrip(int state) {
-    static const char * const whatstr[] = { "none", "IN", "OUT", "INOUT", "REMOVE"};
-    return state > 0 && state <= 4 ? whatstr[state]: whatstr[0];
-}
-
-
 /**
  * CURLMOPT_SOCKETFUNCTION
  *
  * Called by curl to inform us that curl wants the status of a socket to change.
+ * This covers every socket curl uses--including ones for asynchronous DNS--
+ * since the loop watches raw descriptors rather than sockets it opened itself.
  */
 int libcurl_callbacks::on_socket_update(CURL * easy, curl_socket_t sock,
-        int desired_state, void * _chimpl, void * _socket_state)
+        int desired_state, void * _loop, void * _watched)
 {
-    auto chimpl = reinterpret_cast<channel::impl_t *>(_chimpl);
-    int * socket_state = reinterpret_cast<int *>(_socket_state);
+    auto loop = reinterpret_cast<channel::event_loop *>(_loop);
 
     if (desired_state == CURL_POLL_REMOVE) {
-        // Normally, the remote server does a graceful shutdown, and curl gives
-        // us a CURLMSG_DONE telling us that our session is finished. We detect
-        // that in channel::impl_t::handle_done_transfers(), and call the session's
-        // cleanup_after_transfer() method. However, it is possible for a remote server to
-        // close the socket prematurely, short-circuiting that code path. If
-        // that happens, we can detect it here...
-        session::impl_t * simpl;
-        curl_easy_getinfo(easy, CURLINFO_PRIVATE, &simpl);
-        if (simpl->state.load() != session_state::idle) {
-            // Schedule a callback in the (very) near future to make sure we
-            // end the transfer gracefully. We don't do the work right now,
-            // because we would have an infinite recursion:
-            // cleanup_after_transfer() -->
-            //     curl_multi_remove_handle() (if we haven't removed handle) -->
-            //         on_socket_update() with what==CURL_POLL_REMOVE...
-            // See http://j.mp/1HMpQhz.
-            chimpl->io_service.post([simpl]{ simpl->cleanup_after_transfer(); });
-            chimpl->remove_socket(socket_state);
-        }
+        // Completion is reported separately, through CURLMSG_DONE; a socket
+        // can go away mid-transfer (e.g., on a redirect to another host).
+        loop->forget_socket(sock);
+        return 0;
+    }
+    auto watched = reinterpret_cast<channel::event_loop::watched_socket *>(_watched);
+    return loop->watch_socket(sock, desired_state, watched) ? 0 : -1;
+}
 
-    } else if (!socket_state) {
-        fprintf(stderr, "Adding socket: %s\n", get_socket_state_descrip(desired_state));
-        chimpl->add_socket(sock, easy, desired_state);
 
-    } else {
-        chimpl->change_socket_state(socket_state, sock, easy, desired_state);
-    }
+/* CURLSHOPT_LOCKFUNC */
+void libcurl_callbacks::on_share_lock(CURL * easy, curl_lock_data data,
+        curl_lock_access access, void * _shimpl)
+{
+    // Shared and exclusive access are treated alike; the critical sections
+    // are short.
+    reinterpret_cast<shared_state::impl_t *>(_shimpl)->locks[data].lock();
+}
 
-    return 0;
+
+/* CURLSHOPT_UNLOCKFUNC */
+void libcurl_callbacks::on_share_unlock(CURL * easy, curl_lock_data data,
+        void * _shimpl)
+{
+    reinterpret_cast<shared_state::impl_t *>(_shimpl)->locks[data].unlock();
 }
 
 
@@ -110,6 +76,26 @@ size_t libcurl_callbacks::on_receive_data(void * data, size_t size_per_record, s
 }
 
 
+/* CURLOPT_READFUNCTION */
+size_t libcurl_callbacks::on_send_data(char * buffer, size_t size_per_record, size_t num_records, void * _simpl)
+{
+    auto simpl = reinterpret_cast<session::impl_t *>(_simpl);
+    return simpl->read_body(buffer, size_per_record * num_records);
+}
+
+
+/* CURLOPT_SEEKFUNCTION */
+int libcurl_callbacks::on_seek(void * _simpl, curl_off_t offset, int origin)
+{
+    // Curl only ever seeks a body back to its start.
+    auto simpl = reinterpret_cast<session::impl_t *>(_simpl);
+    if (offset == 0 && origin == SEEK_SET && simpl->rewind_body()) {
+        return CURL_SEEKFUNC_OK;
+    }
+    return CURL_SEEKFUNC_CANTSEEK;
+}
+
+
 /* CURLOPT_WRITEHEADER */
 size_t libcurl_callbacks::on_receive_header(void * data, size_t size_per_record, size_t num_records, void * _rimpl)
 {
@@ -132,8 +118,8 @@ int libcurl_callbacks::on_progress(void * _rimpl, uint64_t expected_receive_tota
         auto rimpl = reinterpret_cast<response::impl_t *>(_rimpl);
         if (rimpl->update_progress(expected_receive_total, received_so_far,
                  expected_send_total, sent_so_far)) {
-            fprintf(stderr, "progress update: expected=%d, received=%d\n",
-                    (int)expected_receive_total, (int)received_so_far);
+            trace_event(trace::progress, rimpl->id, expected_receive_total,
+                    received_so_far, sent_so_far);
         }
 
 #if 0
@@ -178,61 +164,6 @@ int libcurl_callbacks::on_progress(void * _rimpl, uint64_t expected_receive_tota
 }
 
 
-/* CURLOPT_OPENSOCKETFUNCTION */
-curl_socket_t libcurl_callbacks::on_open_socket(void * _chimpl, curlsocktype purpose,
-                                curl_sockaddr *address)
-{
-    curl_socket_t sockfd = CURL_SOCKET_BAD;
-
-    if (_chimpl) {
-        auto & chimpl = *reinterpret_cast<channel::impl_t *>(_chimpl);
-
-        if (purpose == CURLSOCKTYPE_IPCXN && address->family == AF_INET) {
-            /* create a tcp socket object */
-            asio_socket_t *tcp_socket = new asio_socket_t(chimpl.io_service);
-
-            /* open it and get the native handle*/
-            asio::error_code ec;
-            tcp_socket->open(asio::ip::tcp::v4(), ec);
-
-            if (ec) {
-                fprintf(stderr, "ERROR %d: %s. Returning CURL_SOCKET_BAD to signal error.\n", ec.value(), ec.message().c_str());
-            } else {
-                sockfd = tcp_socket->native_handle();
-                fprintf(stderr, "Opened socket %d\n", sockfd);
-
-                /* save it for monitoring */
-                chimpl.socket_map.insert(socket_pair_t(sockfd, tcp_socket));
-            }
-        }
-    } else {
-        fprintf(stderr, "no chimpl\n");
-    }
-
-    return sockfd;
-}
-
-
-
-/* CURLOPT_CLOSESOCKETFUNCTION */
-int libcurl_callbacks::on_close_socket(void * _chimpl, curl_socket_t item)
-{
-    if (_chimpl) {
-        auto & socket_map = reinterpret_cast<channel::impl_t *>(_chimpl)->socket_map;
-        auto it = socket_map.find(item);
-
-        if (it != socket_map.end()) {
-            delete it->second;
-            socket_map.erase(it);
-        }
-    } else {
-        fprintf(stderr, "no chimpl\n");
-    }
-
-    return 0;
-}
-
-
 /* Die if we get a bad CURLMcode somewhere */
 void mcode_or_die(const char *where, CURLMcode code)
 {
@@ -267,11 +198,13 @@ void mcode_or_die(const char *where, CURLMcode code)
       break;
     case CURLM_BAD_SOCKET:
       sock = "CURLM_BAD_SOCKET";
-      fprintf(stderr, "ERROR: %s returns %s\n", where, sock);
+      trace_event(trace::multi_error, 0, static_cast<uint64_t>(code));
       /* ignore this error */
       return;
     }
 
+    trace_event(trace::multi_error, 0, static_cast<uint64_t>(code));
+    // We're about to exit; say why, where someone will see it.
     fprintf(stderr, "ERROR: %s returns %s\n", where, sock);
 
     exit(code);
@@ -0,0 +1,252 @@
+#include "core/net/curl/.private/metrics.h"
+
+
+using std::lock_guard;
+using std::mutex;
+using std::string;
+
+using asio::error_code;
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+namespace {
+
+// curl reports each phase as time since the attempt began, so a phase's own
+// length is the difference from the one before. -1 means curl doesn't know.
+int64_t get_time(CURL * easy, CURLINFO what) {
+    curl_off_t usecs = -1;
+    if (curl_easy_getinfo(easy, what, &usecs) != CURLE_OK) {
+        return -1;
+    }
+    return static_cast<int64_t>(usecs);
+}
+
+uint64_t get_size(CURL * easy, CURLINFO what) {
+    curl_off_t bytes = 0;
+    curl_easy_getinfo(easy, what, &bytes);
+    return bytes > 0 ? static_cast<uint64_t>(bytes) : 0;
+}
+
+} // end anonymous namespace
+
+
+channel::metrics::histogram::histogram() : sum_usecs(0), max_usecs(0) {
+    for (auto & b : buckets) {
+        b.store(0);
+    }
+}
+
+
+void channel::metrics::histogram::add(uint64_t usecs) {
+    unsigned i = 0;
+    while (i + 1 < latency_histogram::bucket_count && (usecs >> i)) {
+        ++i;
+    }
+    ++buckets[i];
+    sum_usecs += usecs;
+    auto old = max_usecs.load();
+    while (old < usecs && !max_usecs.compare_exchange_weak(old, usecs)) {
+    }
+}
+
+
+latency_histogram channel::metrics::histogram::snapshot() const {
+    latency_histogram h;
+    h.count = 0;
+    for (unsigned i = 0; i < latency_histogram::bucket_count; ++i) {
+        h.buckets[i] = buckets[i].load();
+        h.count += h.buckets[i];
+    }
+    h.sum_usecs = sum_usecs.load();
+    h.max_usecs = max_usecs.load();
+    return h;
+}
+
+
+channel::metrics::recorder::recorder() : transfers(0), failures(0), retries(0),
+        bytes_received(0), bytes_sent(0), dns(), connect(), tls(), first_byte(),
+        total() {
+}
+
+
+transfer_metrics channel::metrics::recorder::snapshot() const {
+    transfer_metrics m;
+    m.transfers = transfers.load();
+    m.failures = failures.load();
+    m.retries = retries.load();
+    m.bytes_received = bytes_received.load();
+    m.bytes_sent = bytes_sent.load();
+    m.dns = dns.snapshot();
+    m.connect = connect.snapshot();
+    m.tls = tls.snapshot();
+    m.first_byte = first_byte.snapshot();
+    m.total = total.snapshot();
+    return m;
+}
+
+
+channel::metrics::metrics(asio::io_service & svc) : io_service(svc),
+        timer(svc), totals(), mtx(), hosts(), owner(nullptr),
+        dump_interval_secs(0), on_dump(nullptr) {
+}
+
+
+channel::metrics::~metrics() {
+    timer.cancel();
+}
+
+
+std::shared_ptr<channel::metrics::recorder> channel::metrics::get_host(
+        string const & host) {
+    lock_guard<mutex> lock(mtx);
+    auto it = hosts.find(host);
+    if (it != hosts.end()) {
+        return it->second;
+    }
+    if (hosts.size() >= max_hosts) {
+        return nullptr;
+    }
+    auto r = std::make_shared<recorder>();
+    hosts[host] = r;
+    return r;
+}
+
+
+void channel::metrics::record_attempt(recorder * host, CURL * easy,
+        CURLcode result) {
+    long opened = 0;
+    curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &opened);
+    auto dns = get_time(easy, CURLINFO_NAMELOOKUP_TIME_T);
+    auto connect = get_time(easy, CURLINFO_CONNECT_TIME_T);
+    auto tls = get_time(easy, CURLINFO_APPCONNECT_TIME_T);
+    auto first_byte = get_time(easy, CURLINFO_STARTTRANSFER_TIME_T);
+    auto total = get_time(easy, CURLINFO_TOTAL_TIME_T);
+    auto received = get_size(easy, CURLINFO_SIZE_DOWNLOAD_T);
+    auto sent = get_size(easy, CURLINFO_SIZE_UPLOAD_T);
+
+    for (auto r : {&totals, host}) {
+        if (!r) {
+            continue;
+        }
+        ++r->transfers;
+        if (result != CURLE_OK) {
+            ++r->failures;
+        }
+        r->bytes_received += received;
+        r->bytes_sent += sent;
+        // A reused connection cost nothing to set up; don't let its zeros
+        // drag the setup phases down.
+        if (opened > 0) {
+            if (dns >= 0) {
+                r->dns.add(static_cast<uint64_t>(dns));
+            }
+            if (connect >= dns && dns >= 0) {
+                r->connect.add(static_cast<uint64_t>(connect - dns));
+            }
+            // 0 if there was no handshake.
+            if (tls > 0 && tls >= connect) {
+                r->tls.add(static_cast<uint64_t>(tls - connect));
+            }
+        }
+        // 0 if no response came at all.
+        if (first_byte > 0) {
+            r->first_byte.add(static_cast<uint64_t>(first_byte));
+        }
+        if (total >= 0) {
+            r->total.add(static_cast<uint64_t>(total));
+        }
+    }
+}
+
+
+void channel::metrics::record_retry(recorder * host) {
+    ++totals.retries;
+    if (host) {
+        ++host->retries;
+    }
+}
+
+
+transfer_metrics channel::metrics::get_totals() const {
+    return totals.snapshot();
+}
+
+
+transfer_metrics channel::metrics::get_host_totals(string const & host) const {
+    std::shared_ptr<recorder> r;
+    {
+        lock_guard<mutex> lock(mtx);
+        auto it = hosts.find(host);
+        if (it != hosts.end()) {
+            r = it->second;
+        }
+    }
+    return r ? r->snapshot() : recorder().snapshot();
+}
+
+
+transfer_metrics_report channel::metrics::get_report() const {
+    transfer_metrics_report report;
+    report.channel = totals.snapshot();
+    lock_guard<mutex> lock(mtx);
+    for (auto & x : hosts) {
+        report.hosts[x.first] = x.second->snapshot();
+    }
+    return report;
+}
+
+
+void channel::metrics::set_dump(channel * ch, unsigned interval_secs,
+        metrics_callback fn) {
+    {
+        lock_guard<mutex> lock(mtx);
+        owner = ch;
+        dump_interval_secs = fn ? interval_secs : 0;
+        on_dump = fn;
+    }
+    io_service.post([this] { arm_dump(); });
+}
+
+
+void channel::metrics::arm_dump() {
+    // At most one wait is outstanding: a wait that was already due when we
+    // cancelled it still dumps, but then re-arms through here.
+    timer.cancel();
+    unsigned secs;
+    {
+        lock_guard<mutex> lock(mtx);
+        secs = dump_interval_secs;
+    }
+    if (!secs) {
+        return;
+    }
+    timer.expires_from_now(boost::posix_time::seconds(secs));
+    timer.async_wait([this](error_code const & ec) {
+        if (!ec) {
+            dump();
+            arm_dump();
+        }
+    });
+}
+
+
+void channel::metrics::dump() {
+    channel * ch;
+    metrics_callback fn;
+    {
+        lock_guard<mutex> lock(mtx);
+        ch = owner;
+        fn = on_dump;
+    }
+    if (fn && ch) {
+        fn(*ch, get_report());
+    }
+}
+
+
+}}}} // end namespace
@@ -116,6 +116,97 @@ headers & request::get_headers() {
 }
 
 
+void request::set_body(std::string body) {
+    impl->body = std::move(body);
+}
+
+
+std::string const & request::get_body() const {
+    return impl->body;
+}
+
+
+void request::set_body_compression(size_t min_bytes) {
+    impl->compress_over = min_bytes;
+}
+
+
+size_t request::get_body_compression() const {
+    return impl->compress_over;
+}
+
+
+void request::set_accept_encoding(char const * encodings) {
+    impl->decode = encodings != nullptr;
+    impl->encodings = encodings ? encodings : "";
+}
+
+
+char const * request::get_accept_encoding() const {
+    return impl->decode ? impl->encodings.c_str() : nullptr;
+}
+
+
+void request::set_body_source(body_source * source) {
+    impl->source = source;
+}
+
+
+body_source * request::get_body_source() const {
+    return impl->source;
+}
+
+
+void request::set_body_sink(body_sink * sink) {
+    impl->sink = sink;
+}
+
+
+body_sink * request::get_body_sink() const {
+    return impl->sink;
+}
+
+
+void request::set_priority(int priority) {
+    impl->priority = priority;
+}
+
+
+int request::get_priority() const {
+    return impl->priority;
+}
+
+
+void request::set_retry_policy(retry_policy const & policy) {
+    impl->retries = policy;
+}
+
+
+retry_policy const & request::get_retry_policy() const {
+    return impl->retries;
+}
+
+
+void request::set_hedge_after(unsigned millisecs) {
+    impl->hedge_after_millisecs = millisecs;
+}
+
+
+unsigned request::get_hedge_after() const {
+    return impl->hedge_after_millisecs;
+}
+
+
+void request::set_use_cache(bool value) {
+    impl->use_cache = value;
+}
+
+
+bool request::get_use_cache() const {
+    return impl->use_cache;
+}
+
+
 response request::start_get(std::string const & url) {
     return start_get(url.c_str());
 }
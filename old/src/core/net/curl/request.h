@@ -1,12 +1,14 @@
 #ifndef _4bee73c5a8e642a38e1fbb4791446ab5
 #define _4bee73c5a8e642a38e1fbb4791446ab5
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 
 #include "core/net/headers.h"
 #include "core/net/curl/callbacks.h"
 #include "core/net/curl/channel.h"
+#include "core/net/curl/retry_policy.h"
 #include "core/net/curl/session.h"
 #include "core/net/http_method.h"
 
@@ -27,6 +29,7 @@ class request {
     struct impl_t;
     impl_t * impl;
 
+    friend class http_cache;
     friend class response;
     friend class session;
 
@@ -55,6 +58,90 @@ public:
     headers const & get_headers() const;
     headers & get_headers();
 
+    /**
+     * Send a body with the request. With "post", or any verb other than
+     * "get" or "head", a non-empty body goes out as is; set Content-Type in
+     * the headers to describe it.
+     */
+    void set_body(std::string);
+    std::string const & get_body() const;
+
+    /**
+     * Gzip bodies at least this large before sending them, and say so with
+     * Content-Encoding. Payloads such as json often shrink 5 to 10 times.
+     * Only for servers that accept compressed requests; 0 (the default)
+     * never compresses.
+     */
+    void set_body_compression(size_t min_bytes);
+    size_t get_body_compression() const;
+
+    /**
+     * Stream the body from a source instead of a string, the way big uploads
+     * should go; see body_source. The verb works as with set_body(), which
+     * must be left empty. Bodies from a source go out as is (never
+     * compressed), and their requests aren't hedged or cached. The source is
+     * not owned, and must outlive the transfer. Pass nullptr to stop.
+     */
+    void set_body_source(body_source *);
+    body_source * get_body_source() const;
+
+    /**
+     * Ask the server to compress the response, and decode it as it arrives:
+     * get_body() and body sinks only ever see plain bytes, and the compressed
+     * form is never collected. The response headers still describe the body
+     * as it was sent (Content-Encoding, Content-Length).
+     *
+     * @param encodings A list, as for Accept-Encoding (e.g., "gzip, br"); or
+     *     "" (the default) for whatever this build of libcurl can decode:
+     *     gzip and deflate, plus br and zstd where they are compiled in.
+     *     nullptr asks for nothing, and decodes nothing.
+     */
+    void set_accept_encoding(char const * encodings);
+    char const * get_accept_encoding() const;
+
+    /**
+     * Stream the response body to a sink instead of collecting it in the
+     * response (whose get_body() then stays empty). The sink is not owned,
+     * and must outlive the transfer. Pass nullptr to collect again.
+     */
+    void set_body_sink(body_sink *);
+    body_sink * get_body_sink() const;
+
+    /**
+     * When the channel's admission limits hold transfers back, those with
+     * higher priority start first; equal priorities start in the order sent.
+     * The default is 0.
+     */
+    void set_priority(int);
+    int get_priority() const;
+
+    /** Retry transient failures. By default, a request is tried once. */
+    void set_retry_policy(retry_policy const &);
+    retry_policy const & get_retry_policy() const;
+
+    /**
+     * Send a duplicate of this request if it hasn't finished after a while,
+     * and keep whichever answer arrives first; the slower one is cancelled.
+     * This trims the tail latency that a few slow backends add to fan-out
+     * calls, at the cost of a little extra load. Hedges start as soon as
+     * their time comes, ahead of the channel's admission limits. Requests with
+     * a body sink or a body source aren't hedged. Nor are requests that aren't
+     * idempotent (such as POST or PATCH, or a verb curl doesn't know), unless
+     * the retry policy allows repeating them (see
+     * retry_policy::retry_unsafe_verbs).
+     *
+     * @param millisecs 0 (the default) means never.
+     */
+    void set_hedge_after(unsigned millisecs);
+    unsigned get_hedge_after() const;
+
+    /**
+     * Let the channel's http cache, if it has one, answer this request. On by
+     * default; only GETs without a body, or a body sink, are ever cached.
+     */
+    void set_use_cache(bool);
+    bool get_use_cache() const;
+
     // Convenience methods for extremely simple use cases where we can use the
     // default channel, and a temporary, throwaway session.
     static response get(char const * url);
@@ -0,0 +1,85 @@
+#ifndef _c83e5a1f0d7b4e2a9f6b14d2e8a07c35
+#define _c83e5a1f0d7b4e2a9f6b14d2e8a07c35
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * How a channel looks up host names.
+ *
+ * By default, curl resolves each host itself, on a helper thread, and keeps
+ * the answer for a minute no matter what the DNS record says. With the cache
+ * on, the channel resolves hosts ahead of curl instead: lookups are sent with
+ * c-ares from the channel's first event loop (no thread per lookup, and no
+ * loop ever blocks on one), and their answers are kept as long as the records'
+ * TTLs allow, within the bounds below. A transfer to a host not in the cache
+ * waits, without holding up anything else, until its lookup is answered;
+ * transfers to the same host that come meanwhile share the lookup.
+ *
+ * An entry that is used close to the end of its TTL is refreshed in the
+ * background, so a host in steady use never makes a transfer wait for DNS.
+ *
+ *     resolve_policy policy;
+ *     policy.cache = true;
+ *     ch.set_resolve_policy(policy);
+ *
+ * Overrides (see channel::set_resolve_override()) apply whether or not the
+ * cache is on.
+ */
+struct resolve_policy {
+    /** Resolve hosts ahead of curl, and keep the answers for their TTL. */
+    bool cache;
+    /** Keep answers at least this long, even if their TTL is shorter. */
+    unsigned min_ttl_secs;
+    /** Look a host up again after this long, even if its TTL is longer. */
+    unsigned max_ttl_secs;
+    /**
+     * Remember that a host couldn't be resolved for this long; meanwhile its
+     * transfers go straight to curl, which reports the failure. 0 means don't
+     * remember.
+     */
+    unsigned failure_ttl_secs;
+    /**
+     * Refresh an entry in the background when it is used with less than this
+     * much (percent) of its TTL left. 0 turns prefetch off.
+     */
+    unsigned prefetch_percent;
+    /** Hosts to remember; when full, those closest to expiring give way. */
+    size_t max_entries;
+
+    resolve_policy() : cache(false), min_ttl_secs(5), max_ttl_secs(300),
+            failure_ttl_secs(5), prefetch_percent(10), max_entries(1000) {
+    }
+};
+
+
+/**
+ * How a channel's resolve cache has been doing.
+ */
+struct resolve_stats {
+    /** Transfers whose host was answered from the cache. */
+    uint64_t hits;
+    /** Transfers that waited for a lookup. */
+    uint64_t misses;
+    /** Lookups started early, to refresh an entry still in use. */
+    uint64_t prefetches;
+    /** Lookups that found no address. */
+    uint64_t failures;
+    /** Hosts in the cache. */
+    size_t entries;
+    /** Host and port pairs with an override. */
+    size_t overrides;
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
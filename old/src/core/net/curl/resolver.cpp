@@ -0,0 +1,410 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "core/net/curl/.private/resolver.h"
+
+
+using std::chrono::steady_clock;
+using std::lock_guard;
+using std::mutex;
+using std::string;
+
+using asio::error_code;
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+namespace {
+
+string to_lower(char const * p) {
+    string s;
+    for (; *p; ++p) {
+        s += static_cast<char>(tolower(static_cast<unsigned char>(*p)));
+    }
+    return s;
+}
+
+// Pull the host and port (the scheme's, if the url doesn't name one) out of
+// a url.
+bool get_host_and_port(char const * url, string & host, unsigned & port) {
+    auto u = curl_url();
+    char * h = nullptr;
+    char * p = nullptr;
+    bool ok = u && curl_url_set(u, CURLUPART_URL, url, CURLU_GUESS_SCHEME) == CURLUE_OK
+            && curl_url_get(u, CURLUPART_HOST, &h, 0) == CURLUE_OK
+            && curl_url_get(u, CURLUPART_PORT, &p, CURLU_DEFAULT_PORT) == CURLUE_OK;
+    if (ok) {
+        host = to_lower(h);
+        port = static_cast<unsigned>(strtoul(p, nullptr, 10));
+    }
+    curl_free(h);
+    curl_free(p);
+    curl_url_cleanup(u);
+    return ok;
+}
+
+// Addresses need no lookup. Curl puts IPv6 ones in brackets.
+bool is_address(string const & host) {
+    in_addr ignored;
+    return host[0] == '[' || inet_pton(AF_INET, host.c_str(), &ignored) == 1;
+}
+
+// c-ares wants initializing once per process, before any channel is made.
+void init_ares() {
+    static int const rc = ares_library_init(ARES_LIB_INIT_ALL);
+    (void)rc;
+}
+
+} // end anonymous namespace
+
+
+struct channel::resolver::query {
+    resolver * owner;
+    string host;
+};
+
+
+channel::resolver::watched_socket::watched_socket(asio::io_service & svc,
+        uint64_t n) : descriptor(svc), serial(n), want_read(false),
+        want_write(false), reading(false), writing(false) {
+}
+
+
+channel::resolver::watched_socket::~watched_socket() {
+    // c-ares owns the descriptor; don't let asio close it.
+    if (descriptor.is_open()) {
+        descriptor.release();
+    }
+}
+
+
+channel::resolver::resolver(asio::io_service & svc) : io_service(svc),
+        timer(svc), sockets(), next_socket_serial(1), ares(), ares_ready(false),
+        mtx(), policy(), cache(), pending(), overrides(), stats() {
+    init_ares();
+}
+
+
+channel::resolver::~resolver() {
+    // Any lookup still underway ends with ARES_EDESTRUCTION, which wakes its
+    // waiters; they fall back on curl's own resolver.
+    if (ares_ready) {
+        ares_destroy(ares);
+    }
+    timer.cancel();
+    sockets.clear();
+}
+
+
+void channel::resolver::set_policy(resolve_policy const & p) {
+    lock_guard<mutex> lock(mtx);
+    policy = p;
+    if (!policy.cache) {
+        cache.clear();
+    }
+}
+
+
+resolve_policy channel::resolver::get_policy() const {
+    lock_guard<mutex> lock(mtx);
+    return policy;
+}
+
+
+resolve_stats channel::resolver::get_stats() const {
+    lock_guard<mutex> lock(mtx);
+    auto s = stats;
+    s.entries = cache.size();
+    s.overrides = overrides.size();
+    return s;
+}
+
+
+void channel::resolver::set_override(string const & host, unsigned port,
+        string const & addresses) {
+    auto key = to_lower(host.c_str()) + ":" + std::to_string(port);
+    lock_guard<mutex> lock(mtx);
+    if (addresses.empty()) {
+        overrides.erase(key);
+    } else {
+        overrides[key] = addresses;
+    }
+}
+
+
+bool channel::resolver::prepare(char const * url, curl_slist *& entries,
+        std::function<void()> ready) {
+    curl_slist_free_all(entries);
+    entries = nullptr;
+    {
+        lock_guard<mutex> lock(mtx);
+        if (!policy.cache && overrides.empty()) {
+            return true;
+        }
+    }
+    string host;
+    unsigned port;
+    if (!url || !get_host_and_port(url, host, port)) {
+        return true;
+    }
+    auto host_port = host + ":" + std::to_string(port);
+
+    lock_guard<mutex> lock(mtx);
+    // All of them, not just this host's, in case the transfer is redirected.
+    for (auto & x : overrides) {
+        entries = curl_slist_append(entries, ("+" + x.first + ":" + x.second).c_str());
+    }
+    if (!policy.cache || overrides.count(host_port) || is_address(host)) {
+        return true;
+    }
+
+    auto now = steady_clock::now();
+    auto it = cache.find(host);
+    if (it != cache.end() && it->second.expires > now) {
+        auto & e = it->second;
+        // Only a transfer that waited comes back without a callback, and it
+        // was counted as a miss then.
+        if (ready) {
+            ++stats.hits;
+        }
+        if (!e.addresses.empty()) {
+            entries = curl_slist_append(entries,
+                    ("+" + host_port + ":" + e.addresses).c_str());
+        }
+        if (policy.prefetch_percent && !pending.count(host)
+                && (e.expires - now) * 100 < (e.expires - e.resolved) * policy.prefetch_percent) {
+            ++stats.prefetches;
+            start_lookup(host);
+        }
+        return true;
+    }
+
+    if (!pending.count(host)) {
+        start_lookup(host);
+    }
+    if (!ready) {
+        return true;
+    }
+    ++stats.misses;
+    pending[host].push_back(std::move(ready));
+    return false;
+}
+
+
+void channel::resolver::start_lookup(string const & host) {
+    pending[host];
+    io_service.post([this, host] { lookup(host); });
+}
+
+
+void channel::resolver::evict(steady_time now) {
+    for (auto it = cache.begin(); it != cache.end();) {
+        if (it->second.expires <= now) {
+            it = cache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    while (!cache.empty() && cache.size() >= policy.max_entries) {
+        auto soonest = std::min_element(cache.begin(), cache.end(),
+                [](std::pair<string const, entry> const & a,
+                        std::pair<string const, entry> const & b) {
+                    return a.second.expires < b.second.expires;
+                });
+        cache.erase(soonest);
+    }
+}
+
+
+void channel::resolver::lookup(string const & host) {
+    if (!ares_ready) {
+        ares_options opts;
+        memset(&opts, 0, sizeof(opts));
+        opts.sock_state_cb = on_socket_state;
+        opts.sock_state_cb_data = this;
+        if (ares_init_options(&ares, &opts, ARES_OPT_SOCK_STATE_CB) != ARES_SUCCESS) {
+            on_answer(host, ARES_ENOTINITIALIZED, nullptr);
+            return;
+        }
+        ares_ready = true;
+    }
+    ares_addrinfo_hints hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    // Curl races IPv6 against IPv4 itself, so sorting (which probes each
+    // address with a socket) buys nothing.
+    hints.ai_flags = ARES_AI_NOSORT;
+    // Answers from /etc/hosts come back before this returns.
+    ares_getaddrinfo(ares, host.c_str(), nullptr, &hints, on_addrinfo,
+            new query{this, host});
+    reset_timer();
+}
+
+
+void channel::resolver::on_addrinfo(void * arg, int status, int,
+        ares_addrinfo * result) {
+    std::unique_ptr<query> q(static_cast<query *>(arg));
+    q->owner->on_answer(q->host, status, result);
+    if (result) {
+        ares_freeaddrinfo(result);
+    }
+}
+
+
+void channel::resolver::on_answer(string const & host, int status,
+        ares_addrinfo * result) {
+    string addresses;
+    int ttl = -1;
+    if (status == ARES_SUCCESS && result) {
+        for (auto node = result->nodes; node; node = node->ai_next) {
+            char text[INET6_ADDRSTRLEN];
+            void const * raw;
+            if (node->ai_family == AF_INET) {
+                raw = &reinterpret_cast<sockaddr_in const *>(node->ai_addr)->sin_addr;
+            } else if (node->ai_family == AF_INET6) {
+                raw = &reinterpret_cast<sockaddr_in6 const *>(node->ai_addr)->sin6_addr;
+            } else {
+                continue;
+            }
+            if (!inet_ntop(node->ai_family, raw, text, sizeof(text))) {
+                continue;
+            }
+            string address = node->ai_family == AF_INET6 ?
+                    "[" + string(text) + "]" : string(text);
+            if (("," + addresses + ",").find("," + address + ",") != string::npos) {
+                continue;
+            }
+            if (!addresses.empty()) {
+                addresses += ',';
+            }
+            addresses += address;
+            ttl = ttl < 0 ? node->ai_ttl : std::min(ttl, node->ai_ttl);
+        }
+    }
+
+    std::vector<std::function<void()>> waiters;
+    {
+        lock_guard<mutex> lock(mtx);
+        // A lookup cut short by us says nothing about the host.
+        bool cut_short = status == ARES_EDESTRUCTION || status == ARES_ECANCELLED;
+        if (addresses.empty() && !cut_short) {
+            ++stats.failures;
+        }
+        unsigned secs = addresses.empty() ? policy.failure_ttl_secs :
+                std::min(policy.max_ttl_secs, std::max(policy.min_ttl_secs,
+                        static_cast<unsigned>(std::max(ttl, 0))));
+        if (policy.cache && !cut_short && secs && policy.max_entries) {
+            auto now = steady_clock::now();
+            if (!cache.count(host) && cache.size() >= policy.max_entries) {
+                evict(now);
+            }
+            auto & e = cache[host];
+            e.addresses = addresses;
+            e.resolved = now;
+            e.expires = now + std::chrono::seconds(secs);
+        }
+        auto it = pending.find(host);
+        if (it != pending.end()) {
+            waiters.swap(it->second);
+            pending.erase(it);
+        }
+    }
+    for (auto & fn : waiters) {
+        fn();
+    }
+}
+
+
+void channel::resolver::on_socket_state(void * data, ares_socket_t fd,
+        int readable, int writable) {
+    auto self = static_cast<resolver *>(data);
+    if (!readable && !writable) {
+        // c-ares is about to close it.
+        self->sockets.erase(fd);
+        return;
+    }
+    auto & slot = self->sockets[fd];
+    if (!slot) {
+        slot.reset(new watched_socket(self->io_service, self->next_socket_serial++));
+        error_code ec;
+        slot->descriptor.assign(fd, ec);
+        if (ec) {
+            // The query will time out, and fail.
+            self->sockets.erase(fd);
+            return;
+        }
+    }
+    slot->want_read = readable != 0;
+    slot->want_write = writable != 0;
+    self->arm(fd, *slot);
+}
+
+
+void channel::resolver::arm(ares_socket_t fd, watched_socket & ws) {
+    auto serial = ws.serial;
+    if (ws.want_read && !ws.reading) {
+        ws.reading = true;
+        ws.descriptor.async_read_some(asio::null_buffers(),
+                [this, fd, serial](error_code const & ec, size_t) {
+                    on_socket_ready(fd, serial, true, ec);
+                });
+    }
+    if (ws.want_write && !ws.writing) {
+        ws.writing = true;
+        ws.descriptor.async_write_some(asio::null_buffers(),
+                [this, fd, serial](error_code const & ec, size_t) {
+                    on_socket_ready(fd, serial, false, ec);
+                });
+    }
+}
+
+
+void channel::resolver::on_socket_ready(ares_socket_t fd, uint64_t serial,
+        bool read, error_code const & ec) {
+    auto it = sockets.find(fd);
+    if (it == sockets.end() || it->second->serial != serial) {
+        return;
+    }
+    auto & ws = *it->second;
+    (read ? ws.reading : ws.writing) = false;
+    if (ec == asio::error::operation_aborted || !(read ? ws.want_read : ws.want_write)) {
+        return;
+    }
+    ares_process_fd(ares, read ? fd : ARES_SOCKET_BAD, read ? ARES_SOCKET_BAD : fd);
+    it = sockets.find(fd);
+    if (it != sockets.end() && it->second->serial == serial) {
+        arm(fd, *it->second);
+    }
+    reset_timer();
+}
+
+
+void channel::resolver::reset_timer() {
+    timeval tv;
+    if (!ares_ready || !ares_timeout(ares, nullptr, &tv)) {
+        timer.cancel();
+        return;
+    }
+    timer.expires_from_now(boost::posix_time::seconds(tv.tv_sec)
+            + boost::posix_time::microseconds(tv.tv_usec));
+    timer.async_wait([this](error_code const & ec) {
+        if (!ec) {
+            // Resends, or gives up on, whatever has waited too long.
+            ares_process_fd(ares, ARES_SOCKET_BAD, ARES_SOCKET_BAD);
+            reset_timer();
+        }
+    });
+}
+
+
+}}}} // end namespace
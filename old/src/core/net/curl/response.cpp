@@ -1,6 +1,9 @@
+#include <functional>
 #include <thread>
 
 #include "core/net/curl/.private/response-impl.h"
+#include "core/net/curl/.private/trace_points.h"
+#include "core/net/curl/body_sink.h"
 #include "core/net/curl/response.h"
 #include "core/util/monotonic_id.h"
 
@@ -61,6 +64,11 @@ uint16_t response::get_status_code() const {
 }
 
 
+cache_outcome response::get_cache_outcome() const {
+    return impl->cache;
+}
+
+
 bool response::wait(unsigned timeout_millisecs) {
     // It's easier to implement wait() correctly in session impl, so delegate...
     return impl->session->impl->wait(timeout_millisecs);
@@ -113,6 +121,21 @@ uint64_t response::impl_t::store_bytes(void * bytes, uint64_t byte_count) {
             simpl->state = session_state::accepting_response;
         }
     }
+    if (sink) {
+        switch (sink->accept(reinterpret_cast<char const *>(bytes), byte_count)) {
+        case sink_result::accepted:
+            session->impl->body_delivered = true;
+            return byte_count;
+        case sink_result::full:
+            // Curl holds on to the bytes, and offers them again once the
+            // sink resumes the transfer.
+            session->impl->paused = true;
+            return CURL_WRITEFUNC_PAUSE;
+        default:
+            return 0;
+        }
+    }
+
     if (byte_count) {
 
         auto received_byte_count = received_bytes.size();
@@ -164,21 +187,42 @@ uint64_t response::impl_t::store_header(void * bytes, uint64_t byte_count) {
         }
         headers.add(text::str_view(txt, captured_byte_count));
     } else {
-        fprintf(stderr, "got zero-byte header\n");
+        trace_event(trace::empty_header, id);
     }
 
     return byte_count;
 }
 
 
+void response::impl_t::clear_for_retry() {
+    headers = net::headers();
+    received_bytes.clear();
+    expected_receive_total = 0;
+    received_byte_count = 0;
+    sent_byte_count = 0;
+    expected_send_total = 0;
+    status_code = 0;
+}
+
+
+void response::impl_t::adopt_body(impl_t & other) {
+    headers = other.headers;
+    received_bytes.swap(other.received_bytes);
+    expected_receive_total = other.expected_receive_total;
+    received_byte_count = other.received_byte_count;
+    sent_byte_count = other.sent_byte_count;
+    expected_send_total = other.expected_send_total;
+}
+
+
 bool response::impl_t::update_progress(uint64_t _expected_receive_total,
-        uint64_t _received_so_far, uint64_t _expected_send_total,
+        uint64_t _received_byte_count, uint64_t _expected_send_total,
         uint64_t _sent_byte_count) {
 
     bool change_detected = false;
     #define update_item(x) if (_##x != x) { change_detected = true; x = _##x; }
     update_item(expected_receive_total);
-    update_item(expected_receive_total);
+    update_item(received_byte_count);
     update_item(expected_send_total);
     update_item(sent_byte_count);
     #undef update_item
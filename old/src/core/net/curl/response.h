@@ -7,6 +7,7 @@
 #include "core/net/headers.h"
 #include "core/net/curl/callbacks.h"
 #include "core/net/curl/channel.h"
+#include "core/net/curl/http_cache.h"
 #include "core/net/curl/session.h"
 #include "core/net/http_method.h"
 
@@ -28,6 +29,8 @@ class response {
     impl_t * impl;
 
     friend struct libcurl_callbacks;
+    friend class completion_queue;
+    friend class http_cache;
     friend class request;
     friend class session;
 
@@ -55,6 +58,9 @@ public:
 
     uint16_t get_status_code() const;
 
+    /** Whether the channel's http cache answered, and how. */
+    cache_outcome get_cache_outcome() const;
+
     /**
      * Wait until response is ready or timeout occurs. When this method returns,
      * we are guaranteed that a session's state will not change again unless/
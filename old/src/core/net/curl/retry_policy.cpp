@@ -0,0 +1,34 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "core/net/curl/retry_policy.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+retry_policy::retry_policy(unsigned n, unsigned initial, unsigned most,
+        double multiplier) : max_attempts(std::max(1u, n)),
+        initial_backoff_millisecs(initial), max_backoff_millisecs(most),
+        backoff_multiplier(multiplier), retry_unsafe_verbs(false) {
+}
+
+
+unsigned retry_policy::get_backoff(unsigned retry_number,
+        unsigned retry_after_millisecs) const {
+    double ms = initial_backoff_millisecs *
+            std::pow(std::max(1.0, backoff_multiplier), retry_number ? retry_number - 1 : 0);
+    ms = std::min(ms, static_cast<double>(max_backoff_millisecs));
+    // Wait somewhere between half and all of the nominal time.
+    static thread_local std::minstd_rand rng(std::random_device{}());
+    ms *= std::uniform_real_distribution<double>(0.5, 1.0)(rng);
+    ms = std::max(ms, static_cast<double>(std::min(retry_after_millisecs, max_backoff_millisecs)));
+    return static_cast<unsigned>(ms);
+}
+
+
+}}}} // end namespace
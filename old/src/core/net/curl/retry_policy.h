@@ -0,0 +1,51 @@
+#ifndef _2e166e050fd04021b5ae6c4b0cc7b75f
+#define _2e166e050fd04021b5ae6c4b0cc7b75f
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * When and how often to try a request again.
+ *
+ * A transfer is retried if it fails in a way that may well go away by itself:
+ * the connection couldn't be made, timed out, or dropped, or the server
+ * answered 408, 429, 500, 502, 503, or 504. Waits between attempts grow
+ * exponentially, with random jitter so clients that failed together don't
+ * retry together; a Retry-After header from the server stretches the wait.
+ *
+ * No request is retried after any of its body was given to a body sink, and
+ * requests that aren't idempotent (such as POST) are only retried if
+ * retry_unsafe_verbs is set.
+ */
+struct retry_policy {
+    /** Attempts in all, counting the first. 1 means never retry. */
+    unsigned max_attempts;
+    unsigned initial_backoff_millisecs;
+    unsigned max_backoff_millisecs;
+    double backoff_multiplier;
+    bool retry_unsafe_verbs;
+
+    retry_policy(unsigned max_attempts = 1,
+            unsigned initial_backoff_millisecs = 100,
+            unsigned max_backoff_millisecs = 10000,
+            double backoff_multiplier = 2);
+
+    /**
+     * How long to wait before the next attempt.
+     *
+     * @param retry_number 1 before the second attempt, 2 before the third...
+     * @param retry_after_millisecs What the server asked for, or 0.
+     */
+    unsigned get_backoff(unsigned retry_number,
+            unsigned retry_after_millisecs = 0) const;
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
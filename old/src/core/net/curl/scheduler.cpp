@@ -0,0 +1,407 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "core/net/curl/.private/event_loop.h"
+#include "core/net/curl/.private/scheduler.h"
+#include "core/net/curl/.private/session-impl.h"
+
+
+using std::chrono::steady_clock;
+using std::lock_guard;
+using std::mutex;
+using std::string;
+
+using asio::error_code;
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+token_bucket::token_bucket() : rate(0), capacity(1), tokens(1), last() {
+}
+
+
+void token_bucket::configure(admission_limits const & limits, steady_time now) {
+    rate = std::max(0.0, limits.requests_per_second);
+    capacity = limits.burst ? limits.burst : std::max(1.0, rate);
+    tokens = capacity;
+    last = now;
+}
+
+
+bool token_bucket::ready(steady_time now) {
+    if (rate <= 0) {
+        return true;
+    }
+    if (now > last) {
+        std::chrono::duration<double> elapsed = now - last;
+        tokens = std::min(capacity, tokens + elapsed.count() * rate);
+        last = now;
+    }
+    return tokens >= 1;
+}
+
+
+void token_bucket::spend() {
+    if (rate > 0) {
+        tokens -= 1;
+    }
+}
+
+
+bool token_bucket::is_full() const {
+    return rate <= 0 || tokens >= capacity;
+}
+
+
+std::chrono::microseconds token_bucket::time_to_next() const {
+    auto secs = (1 - tokens) / rate;
+    return std::chrono::microseconds(static_cast<int64_t>(secs * 1e6) + 1);
+}
+
+
+bool channel::scheduler::pending::operator <(pending const & other) const {
+    if (priority != other.priority) {
+        return priority > other.priority;
+    }
+    return serial < other.serial;
+}
+
+
+channel::scheduler::scheduler(asio::io_service & svc) : mtx(), closed(false),
+        channel_limits(), default_host_limits(), channel_bucket(),
+        in_flight(0), queued(0), admitted(0), delayed(0), next_serial(0),
+        hosts(), cursor(), waiting(), running(), timer(svc),
+        timer_armed(false), timer_due() {
+}
+
+
+channel::scheduler::~scheduler() {
+}
+
+
+string channel::scheduler::get_host_key(char const * url) {
+    string key;
+    if (!url) {
+        return key;
+    }
+    auto p = strstr(url, "://");
+    p = p ? p + 3 : url;
+    auto end = p + strcspn(p, "/?#");
+    // Credentials don't make a different host.
+    for (auto q = end; q > p; --q) {
+        if (q[-1] == '@') {
+            p = q;
+            break;
+        }
+    }
+    key.reserve(end - p);
+    for (; p < end; ++p) {
+        key += static_cast<char>(tolower(static_cast<unsigned char>(*p)));
+    }
+    return key;
+}
+
+
+channel::scheduler::host_state & channel::scheduler::get_host(
+        string const & host, steady_time now) {
+    auto it = hosts.find(host);
+    if (it == hosts.end()) {
+        it = hosts.emplace(host, host_state()).first;
+        auto & h = it->second;
+        h.limits = default_host_limits;
+        h.has_own_limits = false;
+        h.bucket.configure(default_host_limits, now);
+        h.in_flight = 0;
+        h.admitted = 0;
+        h.delayed = 0;
+    }
+    return it->second;
+}
+
+
+void channel::scheduler::set_channel_limits(admission_limits const & limits) {
+    lock_guard<mutex> lock(mtx);
+    channel_limits = limits;
+    channel_bucket.configure(limits, steady_clock::now());
+    pump();
+}
+
+
+void channel::scheduler::set_default_host_limits(admission_limits const & limits) {
+    lock_guard<mutex> lock(mtx);
+    default_host_limits = limits;
+    auto now = steady_clock::now();
+    for (auto & x : hosts) {
+        if (!x.second.has_own_limits) {
+            x.second.limits = limits;
+            x.second.bucket.configure(limits, now);
+        }
+    }
+    pump();
+}
+
+
+void channel::scheduler::set_host_limits(string const & host,
+        admission_limits const & limits) {
+    lock_guard<mutex> lock(mtx);
+    auto & h = get_host(host, steady_clock::now());
+    h.limits = limits;
+    h.has_own_limits = true;
+    h.bucket.configure(limits, steady_clock::now());
+    pump();
+}
+
+
+admission_stats channel::scheduler::get_channel_stats() const {
+    lock_guard<mutex> lock(mtx);
+    admission_stats stats{queued, in_flight, admitted, delayed, 0};
+    for (auto & x : hosts) {
+        if (!x.second.queue.empty()) {
+            ++stats.waiting_hosts;
+        }
+    }
+    return stats;
+}
+
+
+admission_stats channel::scheduler::get_host_stats(string const & host) const {
+    lock_guard<mutex> lock(mtx);
+    auto it = hosts.find(host);
+    if (it == hosts.end()) {
+        return admission_stats{0, 0, 0, 0, 0};
+    }
+    auto & h = it->second;
+    return admission_stats{h.queue.size(), h.in_flight, h.admitted, h.delayed, 0};
+}
+
+
+void channel::scheduler::submit(session::impl_t * simpl, char const * url,
+        int priority) {
+    auto key = get_host_key(url);
+    lock_guard<mutex> lock(mtx);
+    auto now = steady_clock::now();
+
+    // Hosts are forgotten when they go idle, but only once their bucket is
+    // full again; sweep up the ones that filled up since.
+    if (hosts.size() > 64 + 2 * (waiting.size() + running.size())) {
+        for (auto it = hosts.begin(); it != hosts.end();) {
+            auto next = std::next(it);
+            it->second.bucket.ready(now);
+            forget_if_idle(it);
+            it = next;
+        }
+    }
+
+    auto & h = get_host(key, now);
+    auto it = hosts.find(key);
+    if (!closed && !queued && may_start(h, now)) {
+        // Nobody is ahead of us; skip the queue.
+        h.bucket.spend();
+        channel_bucket.spend();
+        ++h.in_flight;
+        ++in_flight;
+        ++h.admitted;
+        ++admitted;
+        running[simpl] = it;
+        simpl->loop->add_transfer(simpl);
+        return;
+    }
+    h.queue.insert(pending{priority, next_serial++, simpl});
+    waiting[simpl] = it;
+    ++queued;
+    pump();
+}
+
+
+void channel::scheduler::release(session::impl_t * simpl) {
+    lock_guard<mutex> lock(mtx);
+    auto found = running.find(simpl);
+    if (found == running.end()) {
+        return;
+    }
+    auto it = found->second;
+    running.erase(found);
+    --it->second.in_flight;
+    --in_flight;
+    it->second.bucket.ready(steady_clock::now());
+    forget_if_idle(it);
+    pump();
+}
+
+
+bool channel::scheduler::withdraw(session::impl_t * simpl) {
+    lock_guard<mutex> lock(mtx);
+    auto found = waiting.find(simpl);
+    if (found == waiting.end()) {
+        return false;
+    }
+    auto it = found->second;
+    waiting.erase(found);
+    auto & q = it->second.queue;
+    for (auto p = q.begin(); p != q.end(); ++p) {
+        if (p->simpl == simpl) {
+            q.erase(p);
+            --queued;
+            break;
+        }
+    }
+    forget_if_idle(it);
+    return true;
+}
+
+
+void channel::scheduler::open() {
+    lock_guard<mutex> lock(mtx);
+    closed = false;
+    pump();
+}
+
+
+void channel::scheduler::close() {
+    lock_guard<mutex> lock(mtx);
+    closed = true;
+    timer.cancel();
+    timer_armed = false;
+}
+
+
+std::vector<session::impl_t *> channel::scheduler::take_waiting(event_loop * loop) {
+    std::vector<session::impl_t *> taken;
+    lock_guard<mutex> lock(mtx);
+    for (auto & x : hosts) {
+        auto & q = x.second.queue;
+        for (auto p = q.begin(); p != q.end();) {
+            if (p->simpl->loop == loop) {
+                taken.push_back(p->simpl);
+                waiting.erase(p->simpl);
+                p = q.erase(p);
+                --queued;
+            } else {
+                ++p;
+            }
+        }
+    }
+    return taken;
+}
+
+
+bool channel::scheduler::may_start(host_state & h, steady_time now) {
+    if (channel_limits.max_in_flight && in_flight >= channel_limits.max_in_flight) {
+        return false;
+    }
+    if (h.limits.max_in_flight && h.in_flight >= h.limits.max_in_flight) {
+        return false;
+    }
+    return channel_bucket.ready(now) && h.bucket.ready(now);
+}
+
+
+void channel::scheduler::forget_if_idle(host_map_t::iterator it) {
+    auto & h = it->second;
+    if (h.is_idle() && !h.has_own_limits && h.bucket.is_full()) {
+        hosts.erase(it);
+    }
+}
+
+
+/**
+ * Start as many waiting transfers as the limits allow. If only a token is
+ * missing, come back when the first one comes due; a missing slot frees up
+ * in release(), which calls us again.
+ */
+void channel::scheduler::pump() {
+    if (closed) {
+        return;
+    }
+    auto now = steady_clock::now();
+    auto due = steady_time::max();
+    while (queued) {
+        if (channel_limits.max_in_flight && in_flight >= channel_limits.max_in_flight) {
+            break;
+        }
+        if (!channel_bucket.ready(now)) {
+            due = std::min(due, now + channel_bucket.time_to_next());
+            break;
+        }
+
+        // Visit each host once, starting after the one served last, and pick
+        // the first of the highest priority.
+        auto best = hosts.end();
+        auto it = hosts.upper_bound(cursor);
+        for (size_t i = 0, n = hosts.size(); i < n; ++i, ++it) {
+            if (it == hosts.end()) {
+                it = hosts.begin();
+            }
+            auto & h = it->second;
+            if (h.queue.empty()) {
+                continue;
+            }
+            if (h.limits.max_in_flight && h.in_flight >= h.limits.max_in_flight) {
+                continue;
+            }
+            if (!h.bucket.ready(now)) {
+                due = std::min(due, now + h.bucket.time_to_next());
+                continue;
+            }
+            if (best == hosts.end() ||
+                    h.queue.begin()->priority > best->second.queue.begin()->priority) {
+                best = it;
+            }
+        }
+        if (best == hosts.end()) {
+            break;
+        }
+
+        auto & h = best->second;
+        auto simpl = h.queue.begin()->simpl;
+        h.queue.erase(h.queue.begin());
+        --queued;
+        waiting.erase(simpl);
+        running[simpl] = best;
+        h.bucket.spend();
+        channel_bucket.spend();
+        ++h.in_flight;
+        ++in_flight;
+        ++h.admitted;
+        ++h.delayed;
+        ++admitted;
+        ++delayed;
+        cursor = best->first;
+        simpl->loop->add_transfer(simpl);
+    }
+    if (queued && due != steady_time::max()) {
+        arm_timer(due);
+    }
+}
+
+
+void channel::scheduler::arm_timer(steady_time due) {
+    if (timer_armed && timer_due <= due) {
+        return;
+    }
+    timer_armed = true;
+    timer_due = due;
+    auto wait = std::chrono::duration_cast<std::chrono::microseconds>(
+            due - steady_clock::now()).count();
+    timer.expires_from_now(boost::posix_time::microseconds(std::max<int64_t>(0, wait)));
+    timer.async_wait([this](error_code const & ec) { on_timer(ec); });
+}
+
+
+void channel::scheduler::on_timer(error_code const & ec) {
+    if (ec == asio::error::operation_aborted) {
+        // Re-armed for an earlier time, or closed.
+        return;
+    }
+    lock_guard<mutex> lock(mtx);
+    timer_armed = false;
+    pump();
+}
+
+
+}}}} // end namespace
@@ -1,17 +1,28 @@
+#include <algorithm>
 #include <atomic>
+#include <cctype>
 #include <chrono>
+#include <cstdlib>
 #include <map>
 #include <mutex>
 
 
-#include "core/net/curl/.private/libcurl_callbacks.h"
 #include "core/net/curl/.private/channel-impl.h"
+#include "core/net/curl/.private/completion_queue-impl.h"
+#include "core/net/curl/.private/http_cache-impl.h"
+#include "core/net/curl/.private/libcurl_callbacks.h"
+#include "core/net/curl/.private/event_loop.h"
 #include "core/net/curl/.private/request-impl.h"
 #include "core/net/curl/.private/session-impl.h"
+#include "core/net/curl/.private/share.h"
+#include "core/net/curl/.private/trace_points.h"
+#include "core/net/curl/body_sink.h"
+#include "core/net/curl/body_source.h"
 #include "core/net/curl/channel.h"
 #include "core/net/curl/request.h"
 #include "core/net/curl/response.h"
 #include "core/net/curl/state_error.h"
+#include "core/io/gzip.h"
 #include "core/net/http_method.h"
 #include "core/util/monotonic_id.h"
 #include "core/text/interp.h"
@@ -20,6 +31,7 @@ using std::atomic;
 using std::lock_guard;
 using std::map;
 using std::mutex;
+using std::string;
 using std::unique_lock;
 
 using intent::core::text::interp;
@@ -40,8 +52,13 @@ uint32_t get_next_session_id() {
 
 
 session::impl_t::~impl_t() {
+    trace_event(trace::session_gone, id);
+    retire();
+}
+
+
+void session::impl_t::retire() {
 
-    fprintf(stderr, "session::impl_t dtor 1\n");
     // We don't need to lock in this method, because if we get here, then
     // nobody can possibly have a pointer or reference to the object. We know
     // this, because all access to session objects goes through ref-counted
@@ -55,12 +72,64 @@ session::impl_t::~impl_t() {
     // its destructor will have broken our backref, and will be removing us
     // from its list already, so all we do is our own cleanup.
     if (channel) {
-        channel->detach(id);
+        // If a transfer is still underway, take it off the loop before the
+        // easy handle goes away.
+        if (loop && is_busy(state.load())) {
+            channel->impl->admission->withdraw(this);
+            loop->run_sync([this] {
+                loop->remove_transfer(this);
+                if (hedge) {
+                    loop->remove_transfer(hedge->impl);
+                }
+            });
+            release_body_sink(false);
+            release_body_source(false);
+        }
+        channel->detach(wrapper);
+        channel = nullptr;
+    }
+
+    // Nobody else will end the cache's part of our GET, so we must: a leader
+    // answers its followers, and a follower stops waiting.
+    std::shared_ptr<http_cache::impl_t> c;
+    string key;
+    bool leading;
+    {
+        lock_guard<mutex> lock(mtx);
+        c = std::move(cache);
+        key.swap(cache_key);
+        leading = cache_leading;
+        cache_leading = false;
+    }
+    if (c && leading) {
+        auto waiting = c->finish(key, nullptr);
+        c->answer(waiting, *http_cache::impl_t::make_snapshot(*current_response,
+                "Transfer was abandoned; its session was destroyed."));
+    } else if (c) {
+        c->withdraw(key, this);
+    }
+
+    // The loop thread may still be inside cleanup_after_transfer(), having
+    // published our idle state; let it finish with our mutex.
+    { lock_guard<mutex> lock(mtx); }
+
+    // A transfer that will never finish shouldn't leave its queue waiting.
+    if (completions) {
+        completions->abandon();
+        completions.reset();
     }
 
+    // A hedge belongs to us, but is attached to the channel like any session.
+    delete hedge;
+    hedge = nullptr;
+
+    curl_slist_free_all(header_list);
+    header_list = nullptr;
+    curl_slist_free_all(resolve_list);
+    resolve_list = nullptr;
+
     // Release smart pointer to request.
     if (current_request) {
-        fprintf(stderr, "session::impl_t dtor 2\n");
         // If we have a current request, break its link to us, so that when we
         // fire its destructor soon, it won't try to contact us to break our link.
         current_request->session = nullptr;
@@ -74,19 +143,25 @@ session::impl_t::~impl_t() {
 
     // Now do a similar release for response.
     if (current_response) {
-        fprintf(stderr, "session::impl_t dtor 3\n");
         current_response->session = nullptr;
         current_response->release_ref();
-        current_request = nullptr;
+        current_response = nullptr;
     }
 }
 
 
 session::session(class channel & ch) :
-        impl(new impl_t(this, &ch)) {
+        impl(ch.impl->pool.make(this, &ch)) {
     // We have to do this in the body of the ctor, because only this outer
     // class, not the impl, has the right "this" pointer.
-    ch.attach(this);
+    try {
+        impl->use_shared_state(ch.get_shared_state());
+        ch.attach(this);
+    } catch (...) {
+        impl->channel = nullptr;
+        delete impl;
+        throw;
+    }
 }
 
 
@@ -118,30 +193,103 @@ void session::set_error(std::string const & txt) {
 }
 
 
-static void set_curl_verb(CURL * easy, char const * verb) {
-    static constexpr uint8_t EMPTY_DATA[] = {0};
+// The handle keeps options from one transfer to the next, so set everything
+// an earlier verb may have changed. Curl doesn't copy the body; it must last
+// until the transfer is over. A body source is read through our callback
+// instead.
+static void set_curl_verb(CURL * easy, char const * verb, std::string const * body,
+        body_source * source) {
+    auto method = get_http_method_by_name(verb);
+    curl_easy_setopt(easy, CURLOPT_CUSTOMREQUEST, nullptr);
+    if (method && method->id == http_head) {
+        curl_easy_setopt(easy, CURLOPT_NOBODY, 1L);
+        return;
+    }
+    bool post = method && method->id == http_post;
+    if (source) {
+        // Without a size, curl sends the body chunked.
+        auto size = source->get_size();
+        curl_easy_setopt(easy, CURLOPT_POST, 1L);
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDS, nullptr);
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE,
+                size == body_source::unknown_size ? curl_off_t(-1) : static_cast<curl_off_t>(size));
+    } else if (post || body) {
+        // CURLOPT_HTTPPOST wants a multipart form; a plain body (perhaps
+        // empty) is what we mean.
+        curl_easy_setopt(easy, CURLOPT_POST, 1L);
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE,
+                static_cast<curl_off_t>(body ? body->size() : 0));
+        curl_easy_setopt(easy, CURLOPT_POSTFIELDS, body ? body->data() : "");
+    } else {
+        curl_easy_setopt(easy, CURLOPT_HTTPGET, 1L);
+    }
+    if (verb && !post && !(method && method->id == http_get)) {
+        // Known methods go out in their standard (upper) case.
+        curl_easy_setopt(easy, CURLOPT_CUSTOMREQUEST, method ? method->verb : verb);
+    }
+}
 
+
+// Whether sending a request twice has the same effect as sending it once
+// (RFC 7231, 4.2.2). No verb means GET, as in set_curl_verb(); a verb we don't
+// know might do anything.
+static bool is_idempotent(char const * verb) {
+    if (!verb) {
+        return true;
+    }
     auto method = get_http_method_by_name(verb);
+    if (!method) {
+        return false;
+    }
     switch (method->id) {
     case http_get:
-        curl_easy_setopt(easy, CURLOPT_HTTPGET, 1L);
-        return;
-    case http_post:
-        curl_easy_setopt(easy, CURLOPT_HTTPPOST, &EMPTY_DATA);
-        curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, 0L);
-        return;
-    case http_put:
     case http_head:
+    case http_put:
     case http_delete:
     case http_options:
+    case http_trace:
+    case webdav_propfind:
+    case webdav_mkcol:
+    case webdav_copy:
+    case webdav_move:
+    case webdav_unlock:
+        return true;
     default:
-        break;
+        return false;
+    }
+}
+
+
+// Might trying again help?
+static bool is_transient(CURLcode result, long status_code) {
+    switch (result) {
+    case CURLE_OK:
+        switch (status_code) {
+        case 408: case 429: case 500: case 502: case 503: case 504:
+            return true;
+        default:
+            return false;
+        }
+    case CURLE_COULDNT_RESOLVE_HOST:
+    case CURLE_COULDNT_CONNECT:
+    case CURLE_OPERATION_TIMEDOUT:
+    case CURLE_GOT_NOTHING:
+    case CURLE_SEND_ERROR:
+    case CURLE_RECV_ERROR:
+    case CURLE_PARTIAL_FILE:
+    case CURLE_SSL_CONNECT_ERROR:
+    case CURLE_HTTP2:
+    case CURLE_HTTP2_STREAM:
+        return true;
+    default:
+        return false;
     }
 }
 
 
 response session::send() {
     lock_guard<mutex> lock(impl->mtx);
+    impl->completions.reset();
     send_prelocked();
     return impl->current_response;
 }
@@ -149,9 +297,7 @@ response session::send() {
 
 void session::send_prelocked() {
 
-    fprintf(stderr, "sending\n");
-    auto ch = impl->channel ? impl->channel->impl : nullptr;
-    if (!ch) {
+    if (!impl->channel || !impl->loop) {
         throw state_error("Session is detached from channel.");
     }
 
@@ -165,51 +311,278 @@ void session::send_prelocked() {
     if (!url || !*url) {
         throw state_error("No url has been configured in the request.");
     }
+    if (req->source && !req->body.empty()) {
+        throw state_error("A request can have a body or a body source, not both.");
+    }
 
-    CURL * easy = impl->easy;
+    impl->configure_transfer(req);
+    impl->retries = req->retries;
+    impl->idempotent = is_idempotent(req->verb);
+    impl->attempt = 1;
+    impl->body_delivered = false;
+    impl->awaiting_hedge = false;
+    // A hedge sends the request again, so it follows the same rule as a retry.
+    bool may_repeat = impl->idempotent || req->retries.retry_unsafe_verbs;
+    impl->hedge_after_millisecs = req->sink || req->source || !may_repeat ? 0 :
+            req->hedge_after_millisecs;
 
-    curl_easy_setopt(easy, CURLOPT_URL, url);
+    trace_event(trace::send, impl->id, static_cast<uint64_t>(req->priority));
 
-    set_curl_verb(easy, req->verb);
+    if (impl->consult_cache(req)) {
+        return;
+    }
+
+    // A host whose breaker is open fails at once.
+    auto host = channel::scheduler::get_host_key(url);
+    impl->breaker = impl->channel->impl->get_breaker(host);
+    impl->host_meter = impl->channel->impl->meters->get_host(host);
+    if (impl->breaker && !impl->breaker->allow()) {
+        trace_event(trace::failed_fast, impl->id);
+        impl->fail_fast(interp("Circuit breaker for '{1}' is open.", {host}).c_str());
+        return;
+    }
+
+    // Make sure our channel is ready to do business.
+    impl->channel->open();
+
+    // The channel's scheduler starts the transfer once the admission limits
+    // allow; the loop then adds the easy handle to its multi handle on its
+    // own thread.
+    impl->state = session_state::requesting;
+    impl->channel->impl->admission->submit(impl, url, req->priority);
+}
+
+
+void session::impl_t::configure_transfer(request::impl_t * req) {
+
+    curl_easy_setopt(easy, CURLOPT_URL, req->url);
+
+    auto body = req->body.empty() ? nullptr : &req->body;
+    req->packed_body.clear();
+    if (body && req->compress_over && body->size() >= req->compress_over) {
+        req->packed_body = io::gzip(*body);
+        body = &req->packed_body;
+    }
+    set_curl_verb(easy, req->verb, body, req->source);
+
+    // Curl decodes a compressed response before our write callback sees it,
+    // a buffer at a time.
+    curl_easy_setopt(easy, CURLOPT_ACCEPT_ENCODING,
+            req->decode ? req->encodings.c_str() : nullptr);
+
+    // Curl doesn't copy the list; we keep it until the next transfer. A header
+    // with no value is sent empty, which curl spells "Name;".
+    curl_slist_free_all(header_list);
+    header_list = nullptr;
+    if (body == &req->packed_body) {
+        header_list = curl_slist_append(header_list, "Content-Encoding: gzip");
+    }
+    auto & h = req->headers;
+    for (unsigned i = 0, n = h.get_header_count(); i < n; ++i) {
+        auto name = h.get_header_by_index(i);
+        auto value = h.get(name);
+        string line(name);
+        if (value && *value) {
+            line.append(": ").append(value);
+        } else {
+            line += ';';
+        }
+        header_list = curl_slist_append(header_list, line.c_str());
+    }
+    curl_easy_setopt(easy, CURLOPT_HTTPHEADER, header_list);
+
+    // A body sink takes the body instead of the response. Its resumer may
+    // fire on any thread; it hands the work to the loop, which checks that
+    // this same transfer is still the paused one before continuing it.
+    auto resp = current_response;
+    resp->sink = req->sink;
+    paused = false;
+    if (auto sink = req->sink) {
+        auto loop = this->loop;
+        auto simpl = this;
+        auto id = this->id;
+        lock_guard<mutex> sink_lock(sink->resume_mtx);
+        sink->resumer = [loop, simpl, id] { loop->resume_transfer(simpl, id); };
+    }
+
+    // Likewise for a body source, whose transfer pauses while it has nothing.
+    source = req->source;
+    source_ended = false;
+    if (source) {
+        auto loop = this->loop;
+        auto simpl = this;
+        auto id = this->id;
+        lock_guard<mutex> source_lock(source->resume_mtx);
+        source->resumer = [loop, simpl, id] { loop->resume_transfer(simpl, id); };
+    }
+    curl_easy_setopt(easy, CURLOPT_READFUNCTION, libcurl_callbacks::on_send_data);
+    curl_easy_setopt(easy, CURLOPT_READDATA, this);
+    curl_easy_setopt(easy, CURLOPT_SEEKFUNCTION, libcurl_callbacks::on_seek);
+    curl_easy_setopt(easy, CURLOPT_SEEKDATA, this);
 
     curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, libcurl_callbacks::on_receive_data);
-    curl_easy_setopt(easy, CURLOPT_WRITEDATA, impl->current_response);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, current_response);
 
     curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, libcurl_callbacks::on_receive_header);
-    curl_easy_setopt(easy, CURLOPT_WRITEHEADER, impl->current_response);
+    curl_easy_setopt(easy, CURLOPT_WRITEHEADER, current_response);
 
-    curl_easy_setopt(easy, CURLOPT_VERBOSE, 1L);
+    curl_easy_setopt(easy, CURLOPT_VERBOSE, verbose ? 1L : 0L);
 
-    curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, impl->error);
+    curl_easy_setopt(easy, CURLOPT_ERRORBUFFER, error);
 
-    curl_easy_setopt(easy, CURLOPT_PRIVATE, impl);
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, this);
 
     curl_easy_setopt(easy, CURLOPT_NOPROGRESS, 0L);
     curl_easy_setopt(easy, CURLOPT_XFERINFOFUNCTION, libcurl_callbacks::on_progress);
-    curl_easy_setopt(easy, CURLOPT_XFERINFODATA, impl->current_response);
+    curl_easy_setopt(easy, CURLOPT_XFERINFODATA, current_response);
 
     #ifdef DO_TIMEOUT
     curl_easy_setopt(easy, CURLOPT_LOW_SPEED_TIME, 3L);
     curl_easy_setopt(easy, CURLOPT_LOW_SPEED_LIMIT, 10L);
     #endif
+}
 
-    /* call this function to get a socket */
-    curl_easy_setopt(easy, CURLOPT_OPENSOCKETFUNCTION, libcurl_callbacks::on_open_socket);
-    curl_easy_setopt(easy, CURLOPT_OPENSOCKETDATA, ch);
 
-    /* call this function to close a socket */
-    curl_easy_setopt(easy, CURLOPT_CLOSESOCKETFUNCTION, libcurl_callbacks::on_close_socket);
-    curl_easy_setopt(easy, CURLOPT_CLOSESOCKETDATA, ch);
+void session::impl_t::fail_fast(char const * why) {
+    copy_error(error, why, strlen(why));
+    release_body_sink(false);
+    release_body_source(false);
+    if (cache_leading) {
+        // Those waiting for us fail the same way.
+        auto c = std::move(cache);
+        string key;
+        key.swap(cache_key);
+        cache_leading = false;
+        stale.reset();
+        // Our caller holds our lock, so completion handlers run under it;
+        // but a handler owed to a follower has no business with its leader.
+        auto waiting = c->finish(key, nullptr);
+        c->answer(waiting, *http_cache::impl_t::make_snapshot(*current_response, error));
+    }
+    state.store(session_state::idle);
+    state_signal.notify_all();
+}
 
-    // Make sure our channel is ready to do business.
-    impl->channel->open();
 
-    impl->state = session_state::requesting;
-    auto rc = curl_multi_add_handle(ch->multi, easy);
-    mcode_or_die("new_conn: multi_add_handle", rc);
+bool session::impl_t::consult_cache(request::impl_t * req) {
+    // Only a plain GET; a sink takes the body as it arrives, so there'd be
+    // nothing to keep or to share.
+    auto method = req->verb ? get_http_method_by_name(req->verb) : nullptr;
+    if (!method || method->id != http_get || req->sink || !req->use_cache
+            || !req->body.empty() || req->source) {
+        return false;
+    }
+    auto c = channel->impl->get_cache();
+    if (!c) {
+        return false;
+    }
+    auto key = http_cache::impl_t::get_key(*req);
+    cached_response_ptr entry;
+    switch (c->begin(key, this, entry)) {
+    case http_cache::impl_t::plan::serve:
+        answer_from(*entry, cache_outcome::hit);
+        return true;
+    case http_cache::impl_t::plan::follow:
+        cache = std::move(c);
+        cache_key.swap(key);
+        cache_leading = false;
+        state = session_state::waiting_for_response;
+        return true;
+    default:
+        break;
+    }
+    cache = std::move(c);
+    cache_key.swap(key);
+    cache_leading = true;
+    current_response->cache = cache_outcome::miss;
+    if (entry && entry->has_validator()) {
+        // Ask whether our copy is still good; a 304 says it is.
+        stale = entry;
+        if (!entry->etag.empty()) {
+            header_list = curl_slist_append(header_list,
+                    ("If-None-Match: " + entry->etag).c_str());
+        }
+        if (!entry->last_modified.empty()) {
+            header_list = curl_slist_append(header_list,
+                    ("If-Modified-Since: " + entry->last_modified).c_str());
+        }
+        curl_easy_setopt(easy, CURLOPT_HTTPHEADER, header_list);
+    }
+    return false;
+}
+
+
+void session::impl_t::answer_from(cached_response const & r, cache_outcome how) {
+    auto resp = current_response;
+    resp->status_code = r.status_code;
+    resp->headers = r.make_headers();
+    resp->received_bytes = r.body;
+    if (resp->effective_url) {
+        free(resp->effective_url);
+    }
+    resp->effective_url = r.url.empty() ? nullptr : strdup(r.url.c_str());
+    resp->cache = how;
+    copy_error(error, r.error.c_str(), r.error.size());
+    trace_event(trace::cache, id, static_cast<uint64_t>(how));
+    state.store(session_state::idle);
+    state_signal.notify_all();
+}
+
+
+cached_response_ptr session::impl_t::settle_cache(CURLcode result,
+        cached_response_ptr & outcome) {
+    auto now = std::time(nullptr);
+    cached_response_ptr keep;
+    if (result == CURLE_OK && current_response->status_code == 304 && stale) {
+        keep = http_cache::impl_t::refresh(*stale, *current_response, now);
+        outcome = keep;
+        // Our caller publishes the state; just fill in the response.
+        auto resp = current_response;
+        resp->status_code = keep->status_code;
+        resp->headers = keep->make_headers();
+        resp->received_bytes = keep->body;
+        resp->cache = cache_outcome::revalidated;
+        ++cache->revalidated;
+    } else {
+        if (result == CURLE_OK) {
+            keep = http_cache::impl_t::make_cacheable(*current_response,
+                    current_request->url, cache->cfg.max_entry_bytes, now);
+        }
+        outcome = keep ? keep : http_cache::impl_t::make_snapshot(
+                *current_response, result == CURLE_OK ? nullptr : error);
+        ++cache->misses;
+    }
+    trace_event(trace::cache, id, static_cast<uint64_t>(current_response->cache));
+    return keep;
+}
+
 
-    /* note that the add_handle() will set a time-out to trigger very soon so
-       that the necessary socket_action() call will be called by this app */
+bool session::impl_t::take_completion(delivery & d) {
+    if (!completions) {
+        return false;
+    }
+    d.queue = std::move(completions);
+    d.handler = std::move(on_complete);
+    on_complete = nullptr;
+    d.from = wrapper;
+    d.done = current_response;
+    d.done->add_ref();
+    return true;
+}
+
+
+void session::impl_t::delivery::deliver() {
+    if (queue) {
+        queue->complete(from, done, std::move(handler));
+        done->release_ref();
+        queue.reset();
+    }
+}
+
+
+void session::set_verbose(bool value) {
+    lock_guard<mutex> lock(impl->mtx);
+    impl->verbose = value;
 }
 
 
@@ -226,19 +599,22 @@ response session::get_current_response() {
 
 
 session::~session() {
-    fprintf(stderr, "session %u dtor\n", get_id());
-    delete impl;
+    auto ch = impl->channel;
+    if (ch) {
+        ch->impl->pool.recycle(impl);
+    } else {
+        delete impl;
+    }
 }
 
 
 bool session::impl_t::wait(unsigned timeout_millisecs) {
-    fprintf(stderr, "waiting for response %u to finish\n", id);
-    switch (state.load()) {
+    auto current = state.load();
+    trace_event(trace::wait, id, static_cast<uint64_t>(current), timeout_millisecs);
+    switch (current) {
     case session_state::configuring:
-        fprintf(stderr, "premature wait; still configuring\n");
         return false;
     case session_state::idle:
-        fprintf(stderr, "already idle\n");
         return true;
     default:
         break;
@@ -248,12 +624,9 @@ bool session::impl_t::wait(unsigned timeout_millisecs) {
         bool truly_done = !is_busy(this->state.load());
         return truly_done;
     };
-    fflush(stderr);
-    bool is_idle = state_signal.wait_for(lock,
+    return state_signal.wait_for(lock,
             std::chrono::milliseconds(std::max(100u, timeout_millisecs)),
             spurious_wakeup_filter);
-    fflush(stderr);
-    return is_idle;
 }
 
 
@@ -262,29 +635,279 @@ session_state session::get_state() const {
 }
 
 
-void session::impl_t::cleanup_after_transfer() {
+void session::impl_t::finish_attempt(CURLcode result) {
+    long status_code = 0;
+    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status_code);
+    bool ok = result == CURLE_OK && status_code < 500 && status_code != 429;
+    auto meters = channel->impl->meters.get();
+    meters->record_attempt(host_meter.get(), easy, result);
+    if (breaker) {
+        breaker->update(ok);
+    }
+
+    if (hedge_of) {
+        hedge_of->on_hedge_done(this, ok, result);
+        return;
+    }
+
+    if (!ok && attempt < retries.max_attempts && is_transient(result, status_code)
+            && (idempotent || retries.retry_unsafe_verbs) && !body_delivered
+            // Ask the breaker last: in half-open it hands out a probe, which a
+            // body we can't rewind would waste.
+            && rewind_body() && (!breaker || breaker->allow())) {
+        unsigned retry_after_millisecs = 0;
+        {
+            lock_guard<mutex> lock(mtx);
+            // Only the delay-seconds form of Retry-After; a date is rare
+            // enough that our own backoff will do.
+            auto retry_after = current_response->headers.get("Retry-After");
+            if (retry_after && isdigit(*retry_after)) {
+                retry_after_millisecs = static_cast<unsigned>(
+                        std::min(3600000ul, strtoul(retry_after, nullptr, 10) * 1000));
+            }
+            current_response->clear_for_retry();
+            error[0] = 0;
+        }
+        auto delay = retries.get_backoff(attempt++, retry_after_millisecs);
+        trace_event(trace::retry, id, attempt, delay, static_cast<uint64_t>(result));
+        meters->record_retry(host_meter.get());
+        loop->retry_transfer(this, delay);
+        return;
+    }
+
+    if (!ok && hedge && is_busy(hedge->impl->state.load())) {
+        // Our duplicate may still come through.
+        awaiting_hedge = true;
+        parked_result = result;
+        loop->suspend_transfer(this);
+        return;
+    }
+
+    cancel_hedge();
+    cleanup_after_transfer(result);
+}
+
+
+void session::impl_t::start_hedge() {
+    if (!is_busy(state.load()) || (breaker && !breaker->allow())) {
+        return;
+    }
+    if (!hedge) {
+        hedge = new session(*channel);
+        // Same loop, so both transfers are only ever touched on its thread.
+        channel->impl->move_to_loop(hedge, loop);
+    }
+    auto h = hedge->impl;
+    trace_event(trace::hedge, h->id, id);
+    lock_guard<mutex> lock(h->mtx);
+    hedge->reset_prelocked();
+    h->current_request->set_url(current_request->url);
+    h->current_request->set_verb(current_request->verb);
+    h->current_request->headers = current_request->headers;
+    h->current_request->body = current_request->body;
+    h->current_request->compress_over = current_request->compress_over;
+    h->current_request->decode = current_request->decode;
+    h->current_request->encodings = current_request->encodings;
+    h->hedge_of = this;
+    h->breaker = breaker;
+    h->host_meter = host_meter;
+    h->retries = retry_policy();
+    h->attempt = 1;
+    h->hedge_after_millisecs = 0;
+    h->verbose = verbose;
+    h->configure_transfer(h->current_request);
+    // A hedge doesn't wait for admission; the slot it races for is ours.
+    h->state = session_state::requesting;
+    loop->add_transfer(h);
+}
+
+
+void session::impl_t::on_hedge_done(impl_t * h, bool ok, CURLcode result) {
+    if (!ok) {
+        h->cleanup_after_transfer(result);
+        if (awaiting_hedge) {
+            cleanup_after_transfer(parked_result);
+        }
+        return;
+    }
+    // The hedge won. Stop our own transfer, and take its results.
+    loop->suspend_transfer(this);
+    {
+        lock_guard<mutex> lock(mtx);
+        current_response->adopt_body(*h->current_response);
+        error[0] = 0;
+    }
+    h->cleanup_after_transfer(result);
+    // Last, because whoever waits on us may destroy us, and our hedge.
+    cleanup_after_transfer(CURLE_OK, h);
+}
+
+
+void session::impl_t::cancel_hedge() {
+    if (hedge && is_busy(hedge->impl->state.load())) {
+        strcpy(hedge->impl->error, "Lost the race to a faster duplicate.");
+        hedge->impl->cleanup_after_transfer(CURLE_ABORTED_BY_CALLBACK);
+    }
+}
+
+
+void session::impl_t::cleanup_after_transfer(CURLcode result, impl_t * source) {
     if (state.load() == session_state::idle) {
         return;
     }
 
-    fprintf(stderr, "trying to cleanup_after_transfer; state is %d\n", (int)state.load());
-    fflush(stderr);
+    delivery done_delivery;
+    std::shared_ptr<http_cache::impl_t> led;
+    http_cache::impl_t::followers waiting;
+    cached_response_ptr outcome;
     {
         lock_guard<mutex> lock(mtx);
         if (state.load() != session_state::idle) {
-            fprintf(stderr, "change state from %d to %d\n", (int)state.load(), (int)session_state::idle);
-            fflush(stderr);
-            state.store(session_state::idle);
-            curl_easy_getinfo(easy, CURLINFO_EFFECTIVE_URL, &current_response->effective_url);
+            // Curl owns the string it gives us; the response frees its own copy.
+            CURL * from = (source ? source : this)->easy;
+            char * url = nullptr;
+            curl_easy_getinfo(from, CURLINFO_EFFECTIVE_URL, &url);
+            current_response->effective_url = url ? strdup(url) : nullptr;
             long n;
-            curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &n);
+            curl_easy_getinfo(from, CURLINFO_RESPONSE_CODE, &n);
             current_response->status_code = static_cast<uint16_t>(n);
-            curl_multi_remove_handle(channel->impl->multi, easy);
+            trace_event(trace::done, id, static_cast<uint64_t>(result), static_cast<uint64_t>(n));
+            if (loop) {
+                loop->remove_transfer(this);
+            }
+            release_body_sink(result == CURLE_OK);
+            release_body_source(result == CURLE_OK);
+            if (cache_leading) {
+                auto keep = settle_cache(result, outcome);
+                led = std::move(cache);
+                waiting = led->finish(cache_key, keep);
+                cache_key.clear();
+                cache_leading = false;
+                stale.reset();
+            }
+            take_completion(done_delivery);
+            // Publish idle only once the results are in place; wait() reads them
+            // without the lock as soon as it sees this state.
+            state.store(session_state::idle);
         }
-    } // release lock before calling notify; see pessimization note at http://j.mp/1bdV0kZ.
-    fprintf(stderr, "signalling; state is %d\n", (int)state.load());
-    fflush(stderr);
-    state_signal.notify_all();
+        // Notify while still holding the lock. A waiter that wakes up may destroy
+        // the session right away, taking the condition variable with it.
+        state_signal.notify_all();
+    }
+    // By now we may be gone; touch only what we hold.
+    if (led) {
+        led->answer(waiting, *outcome);
+    }
+    done_delivery.deliver();
+}
+
+
+void session::impl_t::release_body_sink(bool ok) {
+    auto sink = current_response ? current_response->sink : nullptr;
+    if (!sink) {
+        return;
+    }
+    current_response->sink = nullptr;
+    {
+        lock_guard<mutex> lock(sink->resume_mtx);
+        sink->resumer = nullptr;
+    }
+    sink->finish(ok);
+}
+
+
+size_t session::impl_t::read_body(char * buffer, size_t capacity) {
+    if (!source || source_ended) {
+        return 0;
+    }
+    size_t n = 0;
+    switch (source->read(buffer, capacity, n)) {
+    case stream_state::more:
+        if (!n) {
+            // Curl asks again once the source resumes the transfer.
+            paused = true;
+            return CURL_READFUNC_PAUSE;
+        }
+        return n;
+    case stream_state::finished:
+        // Curl takes a read of 0 to mean the end, so remember it's coming.
+        source_ended = true;
+        return n;
+    default:
+        return CURL_READFUNC_ABORT;
+    }
+}
+
+
+bool session::impl_t::rewind_body() {
+    if (!source) {
+        return true;
+    }
+    if (!source->rewind()) {
+        return false;
+    }
+    source_ended = false;
+    return true;
+}
+
+
+void session::impl_t::release_body_source(bool ok) {
+    auto src = source;
+    if (!src) {
+        return;
+    }
+    source = nullptr;
+    {
+        lock_guard<mutex> lock(src->resume_mtx);
+        src->resumer = nullptr;
+    }
+    src->finish(ok);
+}
+
+
+void session::impl_t::use_shared_state(shared_state const & s) {
+    auto shimpl = s.impl;
+    // Switch the handle over before letting go of the old pool; curl won't
+    // clean up a pool that a handle still uses.
+    curl_easy_setopt(easy, CURLOPT_SHARE, shimpl ? static_cast<CURLSH *>(shimpl->share) : nullptr);
+    if (shimpl && (shimpl->what & sharing::cookies) != sharing::none) {
+        // An empty file name turns on curl's cookie engine without reading
+        // anything.
+        curl_easy_setopt(easy, CURLOPT_COOKIEFILE, "");
+    }
+    shared = s;
+}
+
+
+void session::set_shared_state(shared_state const & s) {
+    lock_guard<mutex> lock(impl->mtx);
+    auto state = impl->state.load();
+    if (is_busy(state)) {
+        throw state_error(interp("Session state is '{1}'; shared state can't change until the response is done.",
+                {get_name_for_session_state(state)}));
+    }
+    auto ch = impl->channel;
+    if (!ch) {
+        impl->use_shared_state(s);
+        return;
+    }
+    // Sharing connections may move us to another loop, so attach again.
+    auto old = impl->shared;
+    ch->detach(this);
+    impl->use_shared_state(s);
+    try {
+        ch->attach(this);
+    } catch (...) {
+        impl->use_shared_state(old);
+        ch->attach(this);
+        throw;
+    }
+}
+
+
+shared_state session::get_shared_state() const {
+    lock_guard<mutex> lock(impl->mtx);
+    return impl->shared;
 }
 
 
@@ -309,6 +932,7 @@ response session::start_get(char const * url) {
     reset_prelocked();
     impl->current_request->set_url(url);
     impl->current_request->set_verb("get");
+    impl->completions.reset();
     send_prelocked();
     return impl->current_response;
 }
@@ -316,15 +940,38 @@ response session::start_get(char const * url) {
 
 void session::reset_prelocked() {
     auto & r = impl->current_request;
-    if (impl->state != session_state::configuring) {
+    auto state = impl->state.load();
+    if (is_busy(state)) {
+        throw state_error(interp("Session state is '{1}'; it cannot be reset until the response is done.",
+                {get_name_for_session_state(state)}));
+    }
+    if (state == session_state::idle) {
+        // Start over with a fresh request and response. Anyone still holding
+        // the old ones keeps them.
         r->release_ref();
         r = new request::impl_t(this);
+        auto & resp = impl->current_response;
+        resp->release_ref();
+        resp = new response::impl_t(this);
+        impl->error[0] = 0;
+        impl->state = session_state::configuring;
     } else {
         if (r->url) {
             free(r->url);
             r->url = nullptr;
         }
         r->free_verb();
+        r->sink = nullptr;
+        r->source = nullptr;
+        r->priority = 0;
+        r->retries = retry_policy();
+        r->hedge_after_millisecs = 0;
+        r->use_cache = true;
+        r->body.clear();
+        r->compress_over = 0;
+        r->packed_body.clear();
+        r->decode = true;
+        r->encodings.clear();
     }
 }
 
@@ -9,6 +9,7 @@
 #include "core/net/curl/callbacks.h"
 #include "core/net/curl/fwd.h"
 #include "core/net/curl/session_state.h"
+#include "core/net/curl/shared_state.h"
 
 
 namespace intent {
@@ -61,6 +62,8 @@ class session {
     impl_t * impl;
 
     friend class channel;
+    friend class completion_queue;
+    friend class http_cache;
     friend struct libcurl_callbacks;
     friend class request;
     friend class response;
@@ -104,7 +107,23 @@ public:
      */
     request reset();
 
+    /**
+     * Have curl describe each transfer on stderr. Off by default; the
+     * synchronous writes are slow. For cheap, always-on diagnostics, see
+     * dev::tracer.
+     */
     void set_verbose(bool);
+
+    /**
+     * Opt in to sharing DNS answers, TLS sessions, connections and/or cookies
+     * with other sessions that use the same pool. New sessions start with
+     * their channel's pool (see channel::set_shared_state()).
+     *
+     * @throw state_error if a transfer is underway, or if the pool shares
+     *     connections with sessions on another channel.
+     */
+    void set_shared_state(shared_state const &);
+    shared_state get_shared_state() const;
 };
 
 
@@ -0,0 +1,80 @@
+#include <new>
+
+#include "core/net/curl/.private/session-impl.h"
+#include "core/net/curl/.private/session_pool.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+channel::session_pool::session_pool() : full(), empty(), spare_count(0) {
+    links next{spares};
+    for (uint32_t i = capacity; i-- > 0;) {
+        spares[i].memory = nullptr;
+        spares[i].easy = nullptr;
+        empty.push(i, next);
+    }
+}
+
+
+channel::session_pool::~session_pool() {
+    links next{spares};
+    for (auto i = full.pop(next); i != util::index_stack::none; i = full.pop(next)) {
+        curl_easy_cleanup(spares[i].easy);
+        ::operator delete(spares[i].memory);
+    }
+}
+
+
+session::impl_t * channel::session_pool::make(session * wrapper, channel * ch) {
+    links next{spares};
+    auto i = full.pop(next);
+    if (i == util::index_stack::none) {
+        return new session::impl_t(wrapper, ch);
+    }
+    --spare_count;
+    auto memory = spares[i].memory;
+    auto easy = spares[i].easy;
+    empty.push(i, next);
+    try {
+        return new (memory) session::impl_t(wrapper, ch, easy);
+    } catch (...) {
+        // Placement new frees nothing, so the memory is ours to free.
+        ::operator delete(memory);
+        throw;
+    }
+}
+
+
+void channel::session_pool::recycle(session::impl_t * simpl) {
+    links next{spares};
+    simpl->retire();
+    auto i = empty.pop(next);
+    if (i == util::index_stack::none) {
+        delete simpl;
+        return;
+    }
+    // Let go of any shared pool now; a reset leaves the handle attached.
+    simpl->use_shared_state(shared_state());
+    auto easy = simpl->easy.release();
+    // Reset leaves the list of cookie files behind, and leaks it once a later
+    // setopt starts a new one; clear it first.
+    curl_easy_setopt(easy, CURLOPT_COOKIEFILE, static_cast<char const *>(nullptr));
+    curl_easy_reset(easy);
+    simpl->~impl_t();
+    spares[i].memory = simpl;
+    spares[i].easy = easy;
+    full.push(i, next);
+    ++spare_count;
+}
+
+
+size_t channel::session_pool::get_spare_count() const {
+    return spare_count.load();
+}
+
+
+}}}} // end namespace
@@ -1,6 +1,8 @@
 #ifndef _ce83cbbb01474b3894f410ab043e67b7
 #define _ce83cbbb01474b3894f410ab043e67b7
 
+#include "core/net/curl/shared_state.h"
+
 
 namespace intent {
 namespace core {
@@ -8,7 +10,13 @@ namespace net {
 namespace curl {
 
 
-class shared_cookies {
+/**
+ * A cookie jar shared by every session that uses it, e.g., so that a login
+ * done by one session is honored on requests made by others.
+ */
+class shared_cookies : public shared_state {
+public:
+    shared_cookies() : shared_state(sharing::cookies) {}
 };
 
 
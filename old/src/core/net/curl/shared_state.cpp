@@ -0,0 +1,97 @@
+#include "core/net/curl/.private/libcurl_callbacks.h"
+#include "core/net/curl/.private/share.h"
+#include "core/net/curl/shared_state.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+static inline bool includes(sharing what, sharing item) {
+    return (what & item) != sharing::none;
+}
+
+
+shared_state::impl_t::impl_t(sharing w) : what(w), home_mtx(),
+        has_home(false), home_channel_id(0), home_loop_index(0), ref_count(1),
+        share() {
+
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, libcurl_callbacks::on_share_lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, libcurl_callbacks::on_share_unlock);
+    curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+
+    if (includes(what, sharing::dns)) {
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    }
+    if (includes(what, sharing::tls_sessions)) {
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
+    if (includes(what, sharing::connections)) {
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    }
+    if (includes(what, sharing::cookies)) {
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_COOKIE);
+    }
+}
+
+
+shared_state::shared_state() : impl(nullptr) {
+}
+
+
+shared_state::shared_state(sharing what) :
+        impl(what == sharing::none ? nullptr : new impl_t(what)) {
+}
+
+
+shared_state::shared_state(shared_state const & other) : impl(other.impl) {
+    if (impl) {
+        impl->add_ref();
+    }
+}
+
+
+shared_state::shared_state(shared_state && other) : impl(other.impl) {
+    other.impl = nullptr;
+}
+
+
+shared_state & shared_state::operator =(shared_state const & other) {
+    if (other.impl) {
+        other.impl->add_ref();
+    }
+    if (impl) {
+        impl->release_ref();
+    }
+    impl = other.impl;
+    return *this;
+}
+
+
+shared_state & shared_state::operator =(shared_state && other) {
+    if (this != &other) {
+        if (impl) {
+            impl->release_ref();
+        }
+        impl = other.impl;
+        other.impl = nullptr;
+    }
+    return *this;
+}
+
+
+shared_state::~shared_state() {
+    if (impl) {
+        impl->release_ref();
+    }
+}
+
+
+sharing shared_state::get_sharing() const {
+    return impl ? impl->what : sharing::none;
+}
+
+
+}}}} // end namespace
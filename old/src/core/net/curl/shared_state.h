@@ -0,0 +1,99 @@
+#ifndef _6a516ad50bd14c83a2aa1cbb7c02ffe3
+#define _6a516ad50bd14c83a2aa1cbb7c02ffe3
+
+#include "core/marks/concurrency_marks.h"
+#include "core/net/curl/fwd.h"
+#include "core/util/enum_operators.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * The kinds of state that sessions can share. Supports bitmasking.
+ */
+enum class sharing : unsigned {
+    none = 0,
+    /** Resolved host addresses, so only the first session pays for a lookup. */
+    dns = 1,
+    /**
+     * TLS session IDs and tickets, so a new connection to a host resumes an
+     * earlier session instead of doing a full handshake.
+     */
+    tls_sessions = 2,
+    /**
+     * Open connections, so a session can reuse a connection another one
+     * opened, skipping the TCP and TLS handshakes entirely. Connections can't
+     * be used from two threads at once; sessions that share them must belong
+     * to the same channel, where they are all run by the same event loop.
+     */
+    connections = 4,
+    /** Cookies set by any session are sent by all of them. */
+    cookies = 8,
+};
+
+
+}}}} // end namespace
+
+define_bitwise_operators_for_enum(intent::core::net::curl::sharing);
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * A pool of state that sessions opt in to sharing, even across channels.
+ *
+ * By default, every session keeps its own cookies, and sessions only share
+ * the DNS cache and connections of the event loop that runs them. Sharing
+ * more means a short request to a host that another session has already
+ * talked to can skip the DNS lookup, and resume or reuse a TLS session
+ * instead of repeating the handshake.
+ *
+ *     shared_state pool(sharing::dns | sharing::tls_sessions);
+ *     session a(ch1), b(ch2);
+ *     a.set_shared_state(pool);
+ *     b.set_shared_state(pool);
+ *
+ * Handles are ref-counted; copies refer to the same pool, which lives until
+ * the last session using it is gone. Access to the pool is serialized with a
+ * lock per kind of data, so sessions on different threads can share it.
+ *
+ * See @ref shared_cookies and @ref shared_tls_handshake for the common cases.
+ */
+mark(+, threadsafe)
+class shared_state {
+    struct impl_t;
+    impl_t * impl;
+
+    friend class channel;
+    friend class session;
+    friend struct libcurl_callbacks;
+
+public:
+    /** Share nothing. */
+    shared_state();
+    explicit shared_state(sharing what);
+    shared_state(shared_state const &);
+    shared_state(shared_state &&);
+    shared_state & operator =(shared_state const &);
+    shared_state & operator =(shared_state &&);
+    ~shared_state();
+
+    sharing get_sharing() const;
+
+    /** Do two handles refer to the same pool? */
+    bool operator ==(shared_state const & other) const { return impl == other.impl; }
+    bool operator !=(shared_state const & other) const { return impl != other.impl; }
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
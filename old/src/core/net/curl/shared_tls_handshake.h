@@ -1,6 +1,8 @@
 #ifndef _dd69702f597d488d8129f072ac248c7c
 #define _dd69702f597d488d8129f072ac248c7c
 
+#include "core/net/curl/shared_state.h"
+
 
 namespace intent {
 namespace core {
@@ -8,7 +10,19 @@ namespace net {
 namespace curl {
 
 
-class shared_tls_handshake {
+/**
+ * Share what it takes to set up a secure connection--DNS answers and TLS
+ * sessions--so that only the first session to reach a host pays full price.
+ *
+ * @param share_connections Also share open connections. This saves the most,
+ *     but confines the sessions to one channel; see sharing::connections.
+ */
+class shared_tls_handshake : public shared_state {
+public:
+    explicit shared_tls_handshake(bool share_connections = false) :
+            shared_state(sharing::dns | sharing::tls_sessions
+                    | (share_connections ? sharing::connections : sharing::none)) {
+    }
 };
 
 
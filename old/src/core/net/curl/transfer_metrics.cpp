@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "core/net/curl/transfer_metrics.h"
+
+
+using std::string;
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+namespace {
+
+void write_phase(std::ostream & out, char const * name, latency_histogram const & h) {
+    if (!h.count) {
+        return;
+    }
+    out << ", " << name << ' ' << h.get_percentile_usecs(50) / 1000.0
+            << '/' << h.get_percentile_usecs(99) / 1000.0 << " ms";
+}
+
+} // end anonymous namespace
+
+
+uint64_t latency_histogram::get_mean_usecs() const {
+    return count ? sum_usecs / count : 0;
+}
+
+
+uint64_t latency_histogram::get_percentile_usecs(double percent) const {
+    if (!count) {
+        return 0;
+    }
+    auto wanted = static_cast<uint64_t>(std::ceil(count * std::min(100.0, percent) / 100.0));
+    wanted = std::max<uint64_t>(1, wanted);
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < bucket_count; ++i) {
+        seen += buckets[i];
+        if (seen >= wanted) {
+            if (i == 0) {
+                return 0;
+            }
+            return i + 1 == bucket_count ? max_usecs :
+                    std::min(max_usecs, uint64_t(1) << i);
+        }
+    }
+    return max_usecs;
+}
+
+
+string transfer_metrics::get_summary() const {
+    std::ostringstream out;
+    out << "transfers " << transfers << ", failures " << failures
+            << ", retries " << retries << ", received " << bytes_received
+            << " B, sent " << bytes_sent << " B";
+    // Median and 99th percentile.
+    write_phase(out, "dns", dns);
+    write_phase(out, "connect", connect);
+    write_phase(out, "tls", tls);
+    write_phase(out, "first byte", first_byte);
+    write_phase(out, "total", total);
+    return out.str();
+}
+
+
+string transfer_metrics_report::get_summary() const {
+    string s = "channel: " + channel.get_summary() + "\n";
+    for (auto & x : hosts) {
+        s += x.first + ": " + x.second.get_summary() + "\n";
+    }
+    return s;
+}
+
+
+}}}} // end namespace
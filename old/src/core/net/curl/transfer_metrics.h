@@ -0,0 +1,103 @@
+#ifndef _6f1d8c3a2b7e4e05a94c0d5f3e81b27a
+#define _6f1d8c3a2b7e4e05a94c0d5f3e81b27a
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "core/net/curl/fwd.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * How long one phase of a channel's transfers took, as a histogram with a
+ * bucket per power of two microseconds: bucket 0 counts samples of 0, and
+ * bucket i (i > 0) those from 2^(i-1) up to 2^i microseconds. The last bucket
+ * also takes anything longer.
+ */
+struct latency_histogram {
+    enum { bucket_count = 32 };
+
+    uint64_t buckets[bucket_count];
+    uint64_t count;
+    uint64_t sum_usecs;
+    uint64_t max_usecs;
+
+    uint64_t get_mean_usecs() const;
+
+    /**
+     * An upper bound on the given percentile (for example, 99), good to a
+     * factor of two: the top of the bucket it falls in, or the largest
+     * sample if that is smaller. 0 if there are no samples.
+     */
+    uint64_t get_percentile_usecs(double percent) const;
+};
+
+
+/**
+ * What a channel's transfers (or those to one host) have done since the
+ * channel was made. Every attempt counts, including retries and hedges, as
+ * in connection_stats.
+ *
+ * Times come from curl's own clock for each attempt (CURLINFO_*_TIME_T).
+ * Looking up the host, connecting, and the TLS handshake are only sampled
+ * when an attempt opened a connection; one that reused a connection spent
+ * no time on them. A transfer that was redirected counts under the host it
+ * was sent to.
+ */
+struct transfer_metrics {
+    /** Attempts finished. */
+    uint64_t transfers;
+    /** Attempts that ended in a curl error (not an error status). */
+    uint64_t failures;
+    /** Attempts that were started over after failing. */
+    uint64_t retries;
+    /** Body bytes, as they crossed the wire. */
+    uint64_t bytes_received;
+    uint64_t bytes_sent;
+
+    latency_histogram dns;
+    latency_histogram connect;
+    /** Only for connections that were encrypted. */
+    latency_histogram tls;
+    /** From the start of the attempt to the first byte of the response. */
+    latency_histogram first_byte;
+    latency_histogram total;
+
+    /**
+     * One line, for logs: counts, and the median and 99th percentile of
+     * each phase, in milliseconds.
+     */
+    std::string get_summary() const;
+};
+
+
+/**
+ * A channel's metrics, and those of each host it has sent transfers to
+ * (keyed as for channel::set_host_admission_limits()).
+ */
+struct transfer_metrics_report {
+    transfer_metrics channel;
+    std::map<std::string, transfer_metrics> hosts;
+
+    /** The channel's summary, then one line per host. */
+    std::string get_summary() const;
+};
+
+
+/**
+ * A function that is given a channel's metrics periodically. See
+ * channel::set_metrics_dump().
+ */
+typedef void (*metrics_callback)(channel &, transfer_metrics_report const &);
+
+
+}}}} // end namespace
+
+
+#endif // sentry
@@ -0,0 +1,93 @@
+#include <stdexcept>
+
+#include "core/net/curl/xsv_body_sink.h"
+#include "core/util/dbc.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+// A record this long with no end in sight means the body isn't the xsv we
+// expected; the reader has the same limit.
+static constexpr size_t max_record_size = 1024 * 1024;
+
+
+xsv_body_sink::xsv_body_sink(char d, record_handler h) : delim(d),
+        handler(h), carry(), scanned(0), in_quotes(false), record_count(0),
+        error(nullptr) {
+    precondition(handler);
+}
+
+
+sink_result xsv_body_sink::accept(char const * bytes, size_t byte_count) {
+    if (error) {
+        return sink_result::failed;
+    }
+    carry.append(bytes, byte_count);
+
+    // Find the last line break that isn't inside quotes. Doubled quotes
+    // toggle twice, so they need no special case.
+    size_t cut = std::string::npos;
+    for (auto i = scanned; i < carry.size(); ++i) {
+        char c = carry[i];
+        if (c == '"') {
+            in_quotes = !in_quotes;
+        } else if (c == '\n' && !in_quotes) {
+            cut = i + 1;
+        }
+    }
+    scanned = carry.size();
+
+    if (cut == std::string::npos) {
+        if (carry.size() > max_record_size) {
+            error = "Record exceeds maximum size.";
+            return sink_result::failed;
+        }
+        return sink_result::accepted;
+    }
+
+    // Parse the complete records where they lie, and keep only the
+    // unfinished one.
+    std::string records;
+    records.swap(carry);
+    carry.assign(records, cut, std::string::npos);
+    records.resize(cut);
+    scanned = carry.size();
+    return parse(records) ? sink_result::accepted : sink_result::failed;
+}
+
+
+void xsv_body_sink::finish(bool ok) {
+    if (ok && !error && !carry.empty()) {
+        // The last record needn't end with a line break.
+        parse(carry);
+    }
+    carry.clear();
+    scanned = 0;
+    in_quotes = false;
+}
+
+
+bool xsv_body_sink::parse(std::string & records) {
+    // Exceptions must not unwind through curl.
+    try {
+        data::xsv_reader reader(records, delim);
+        while (reader.next_record()) {
+            ++record_count;
+            if (!handler(reader)) {
+                error = "Record handler stopped the transfer.";
+                return false;
+            }
+        }
+    } catch (std::exception const &) {
+        error = "Unable to parse records.";
+        return false;
+    }
+    return true;
+}
+
+
+}}}} // end namespace
@@ -0,0 +1,61 @@
+#ifndef _31a63d03f3df413faa91bfc6d5e36c1f
+#define _31a63d03f3df413faa91bfc6d5e36c1f
+
+#include <functional>
+#include <string>
+
+#include "core/data/xsv.h"
+#include "core/net/curl/body_sink.h"
+
+
+namespace intent {
+namespace core {
+namespace net {
+namespace curl {
+
+
+/**
+ * Parse a comma-, tab-, or *-separated-values body as it arrives, handing each
+ * record to a callback. Only the tail of the body that doesn't end a record
+ * yet is kept between chunks; records are parsed in place, in batches of
+ * whatever arrived.
+ *
+ *     xsv_body_sink sink(',', [&](data::xsv_reader & r) {
+ *         total += atoi(r.get_field_by_index(2));
+ *         return true;
+ *     });
+ *
+ * The callback runs on the transfer's event loop. Returning false stops the
+ * transfer.
+ */
+class xsv_body_sink : public body_sink {
+public:
+    typedef std::function<bool(data::xsv_reader &)> record_handler;
+
+    xsv_body_sink(char delim, record_handler handler);
+
+    virtual sink_result accept(char const * bytes, size_t byte_count);
+    virtual void finish(bool ok);
+
+    uint64_t get_record_count() const { return record_count; }
+
+    /** Why parsing stopped early, or nullptr. */
+    char const * get_error() const { return error; }
+
+private:
+    bool parse(std::string & records);
+
+    char delim;
+    record_handler handler;
+    std::string carry; // the start of a record that hasn't ended yet
+    size_t scanned; // how much of carry has been checked for line breaks
+    bool in_quotes; // as of carry[scanned]
+    uint64_t record_count;
+    char const * error;
+};
+
+
+}}}} // end namespace
+
+
+#endif // sentry
@@ -10,6 +10,8 @@ using std::string;
 using intent::core::text::str_view;
 using intent::core::text::compare_str_ascii_case_insensitive;
 using intent::core::text::find_char;
+using intent::core::text::ltrim;
+using intent::core::text::rtrim;
 
 
 namespace intent {
@@ -142,7 +144,10 @@ headers & headers::operator =(headers const & other) {
 
 
 headers::~headers() {
-    impl->release_ref();
+    // A headers object that was moved from has nothing left to release.
+    if (impl) {
+        impl->release_ref();
+    }
 }
 
 
@@ -168,9 +173,15 @@ char const * headers::get(str_view header) {
 
 void headers::add(str_view line) {
     if (line) {
-        auto i = find_char(line.begin, ':', line.end());
-        if (i != nullptr) {
-            set(str_view(line.begin, i), str_view(i, line.end()));
+        auto end = line.end();
+        auto i = find_char(line.begin, ':', end);
+        // A line with no colon (such as an http status line) isn't a header.
+        if (i != end) {
+            // Neither the colon nor the whitespace around the value belongs
+            // to it.
+            auto value = ltrim(i + 1, end);
+            set(str_view(line.begin, rtrim(line.begin, i)),
+                    str_view(value, rtrim(value, end)));
         }
     }
 }
@@ -234,7 +245,7 @@ char const * headers::get_header_by_index(unsigned i) const {
         for (auto iter = ancestor->map.begin(); iter != end; ++iter) {
             if (!impl->is_masked(iter->first, ancestor)) {
                 if (j++ == i) {
-                    return iter->second.c_str();
+                    return iter->first.c_str();
                 }
             }
         }
@@ -0,0 +1,124 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "core/text/format_numbers.h"
+
+namespace intent {
+namespace core {
+namespace text {
+
+static char const DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// Powers of ten that are exact in a double.
+static double const EXACT_POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+    1e13, 1e14, 1e15,
+};
+
+static constexpr unsigned MAX_FAST_FRACTION_DIGITS = 15;
+
+// Integers below this are exact in a double.
+static constexpr double MAX_EXACT_INTEGER = 9007199254740992.0; // 2^53
+
+char * format_uint64(uint64_t n, char * out) {
+    char tmp[20];
+    char * p = tmp + sizeof(tmp);
+    while (n >= 100) {
+        unsigned pair = static_cast<unsigned>(n % 100) * 2;
+        n /= 100;
+        p -= 2;
+        p[0] = DIGIT_PAIRS[pair];
+        p[1] = DIGIT_PAIRS[pair + 1];
+    }
+    if (n >= 10) {
+        unsigned pair = static_cast<unsigned>(n) * 2;
+        p -= 2;
+        p[0] = DIGIT_PAIRS[pair];
+        p[1] = DIGIT_PAIRS[pair + 1];
+    } else {
+        *--p = static_cast<char>('0' + n);
+    }
+    size_t len = tmp + sizeof(tmp) - p;
+    memcpy(out, p, len);
+    return out + len;
+}
+
+char * format_int64(int64_t n, char * out) {
+    uint64_t magnitude = static_cast<uint64_t>(n);
+    if (n < 0) {
+        *out++ = '-';
+        // Negate in unsigned arithmetic, so INT64_MIN works.
+        magnitude = 0 - magnitude;
+    }
+    return format_uint64(magnitude, out);
+}
+
+char * format_double(double d, char * out) {
+    if (std::isnan(d)) {
+        memcpy(out, "nan", 3);
+        return out + 3;
+    }
+    if (std::isinf(d)) {
+        if (d < 0) {
+            *out++ = '-';
+        }
+        memcpy(out, "inf", 3);
+        return out + 3;
+    }
+
+    // Find the fewest fractional digits k such that d * 10^k is a whole
+    // number n with n / 10^k == d. Because n and 10^k are exact, and IEEE
+    // division rounds correctly, the decimal n * 10^-k then parses back to
+    // exactly d.
+    double magnitude = std::fabs(d);
+    for (unsigned k = 0; k <= MAX_FAST_FRACTION_DIGITS; ++k) {
+        double scaled = magnitude * EXACT_POWERS_OF_TEN[k];
+        if (scaled >= MAX_EXACT_INTEGER) {
+            break;
+        }
+        double whole = std::floor(scaled + 0.5);
+        if (whole / EXACT_POWERS_OF_TEN[k] != magnitude) {
+            continue;
+        }
+        uint64_t n = static_cast<uint64_t>(whole);
+        if (std::signbit(d) && n) {
+            *out++ = '-';
+        }
+        if (k == 0) {
+            return format_uint64(n, out);
+        }
+        char digits[20];
+        char * end = format_uint64(n, digits);
+        unsigned len = static_cast<unsigned>(end - digits);
+        if (len <= k) {
+            // 0.00ddd: pad with zeros after the radix.
+            *out++ = '0';
+            *out++ = '.';
+            memset(out, '0', k - len);
+            out += k - len;
+            memcpy(out, digits, len);
+            return out + len;
+        }
+        memcpy(out, digits, len - k);
+        out += len - k;
+        *out++ = '.';
+        memcpy(out, end - k, k);
+        return out + k;
+    }
+
+    int len = snprintf(out, MAX_FORMATTED_NUMBER_LEN, "%.17g", d);
+    return out + len;
+}
+
+}}} // end namespace
@@ -0,0 +1,40 @@
+#ifndef _1f713ecead7e4bbea94149ab7a4c9413
+#define _1f713ecead7e4bbea94149ab7a4c9413
+
+#include <cstdint>
+
+namespace intent {
+namespace core {
+namespace text {
+
+/**
+ * Enough room for any number written by the functions below.
+ */
+static constexpr unsigned MAX_FORMATTED_NUMBER_LEN = 32;
+
+/**
+ * Write n in decimal, two digits at a time from a lookup table.
+ * @return ptr to first char beyond the number. No null is written.
+ */
+char * format_uint64(uint64_t n, char * out);
+
+/**
+ * Like format_uint64(), with a leading '-' for negative numbers.
+ */
+char * format_int64(int64_t n, char * out);
+
+/**
+ * Write d as the shortest decimal that reads back as exactly d, when that
+ * decimal has no more than 15 fractional digits and fits without an
+ * exponent. This covers the great majority of real-world data (prices,
+ * measurements, ratios), and is several times faster than printf. Other
+ * values fall back to printf's "%.17g", which also round-trips. NaN and the
+ * infinities are written as "nan", "inf", and "-inf".
+ *
+ * @return ptr to first char beyond the number. No null is written.
+ */
+char * format_double(double d, char * out);
+
+}}} // end namespace
+
+#endif // sentry
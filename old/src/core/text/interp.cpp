@@ -1,4 +1,5 @@
 #include <cstring>
+#include "core/io/buffered_writer.h"
 #include "core/text/interp.h"
 #include "core/text/scan_numbers.h"
 #include "core/text/strutil.h"
@@ -128,6 +129,16 @@ void interp_into(string & txt, char const * format, initializer_list<arg> args)
     }
 }
 
+void interp_into(io::buffered_writer & out, char const * format,
+        initializer_list<arg> args) {
+    // Reuse one scratch string per thread, so steady-state calls don't allocate
+    // for the text itself.
+    static thread_local string txt;
+    txt.clear();
+    interp_into(txt, format, args);
+    out.write(txt.data(), txt.size());
+}
+
 std::string interp(char const * format, std::initializer_list<arg> args) {
     std::string txt;
     interp_into(txt, format, args);
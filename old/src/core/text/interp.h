@@ -5,6 +5,8 @@
 
 #include "core/text/arg.h"
 
+namespace intent { namespace core { namespace io { class buffered_writer; }}}
+
 namespace intent {
 namespace core {
 namespace text {
@@ -76,6 +78,12 @@ std::string interp(char const * format);
  */
 void interp_into(std::string &, char const * format, std::initializer_list<arg>);
 
+/**
+ * Like interp_into() for a string, except that the result goes to a writer, so
+ * repeated calls can produce large output without holding it all in memory.
+ */
+void interp_into(io::buffered_writer &, char const * format, std::initializer_list<arg>);
+
 }}} // end namespace
 
 #endif // sentry
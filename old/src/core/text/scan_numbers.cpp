@@ -157,18 +157,17 @@ char const * scan_number(char const * text, char const * end, numeric_formats
 
     double significand, value;
 
-    if (!floating_point && p < end && *p == '.') {
+    // The radix may be the first char (e.g., ".5"), or follow whole digits.
+    if (p < end && *p == '.') {
         floating_point = true;
         p = scan_decimal_digits_post_radix(++p, end, significand);
     } else {
         significand = 0.0;
     }
 
-    // Now we've read everything except possibly an exponent. Make sure we've
-    // combined values to left and right of radix, if appropriate.
-    if (floating_point) {
-        significand += info.whole_number;
-    }
+    // Now we've read everything except possibly an exponent. Combine values
+    // to left and right of radix; an exponent may follow either (e.g., "1e5").
+    significand += info.whole_number;
 
     // Check for exponent.
     if (p + 1 < end && (*p == 'e' || *p == 'E')) {
@@ -183,14 +182,14 @@ char const * scan_number(char const * text, char const * end, numeric_formats
         }
         // TODO: what if exponent is too big? What if there's nothing after "e"?
         value = significand * pow(10, exp);
-        if (info.negative) {
-            value *= -1;
-        }
     } else if (floating_point) {
         value = significand;
     }
 
     if (floating_point) {
+        if (info.negative) {
+            value *= -1;
+        }
         info.format = numeric_formats::floating_point_only;
         info.floating_point = value;
     } else {
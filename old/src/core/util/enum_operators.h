@@ -28,14 +28,14 @@ struct enum_has_numeric_operators {
 // This macro must be invoked from the global namespace
 #define define_bitwise_operators_for_enum(e) \
     template <> \
-    struct ::intent::core::util::enum_has_bitwise_operators<e> { \
+    struct intent::core::util::enum_has_bitwise_operators<e> { \
         static constexpr bool value = true; \
     }
 
 // This macro must be invoked from the global namespace
 #define define_numeric_operators_for_enum(e) \
     template <> \
-    struct ::intent::core::util::enum_has_numeric_operators<e> { \
+    struct intent::core::util::enum_has_numeric_operators<e> { \
         static constexpr bool value = true; \
     }
 
@@ -0,0 +1,27 @@
+#ifndef _a0afa8e08e0f4e7d979af7535faddb41
+#define _a0afa8e08e0f4e7d979af7535faddb41
+
+#include <cstddef>
+#include <string>
+
+namespace intent {
+namespace core {
+namespace util {
+
+
+/**
+ * The SHA-256 digest (FIPS 180-4) of n bytes at p, as 64 lowercase hex digits.
+ * For naming content by what it holds, where a collision must be infeasible
+ * to forge; it's not built for hashing large volumes fast.
+ */
+std::string sha256_hex(char const * p, size_t n);
+
+inline std::string sha256_hex(std::string const & s) {
+    return sha256_hex(s.data(), s.size());
+}
+
+
+}}} // end namespace
+
+
+#endif // sentry
@@ -0,0 +1,190 @@
+#ifndef _5b0e9c71d4a24f3f8e26a9d1c7f03b84
+#define _5b0e9c71d4a24f3f8e26a9d1c7f03b84
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+namespace intent {
+namespace core {
+namespace util {
+
+
+/**
+ * A lock-free LIFO of small numbers, such as indexes into an array.
+ *
+ * The stack keeps no storage of its own: while it holds a number, it links it
+ * to the next one through a std::atomic<uint32_t> that the caller provides
+ * (links(n) returns a reference to it). The head carries a counter that
+ * changes on every push and pop, so a thread that was descheduled midway
+ * can't mistake a recycled head for the one it saw (the ABA problem).
+ */
+class index_stack {
+    std::atomic<uint64_t> head; // counter << 32 | index
+
+    static uint64_t bump(uint64_t h, uint32_t index) {
+        return ((h >> 32) + 1) << 32 | index;
+    }
+
+public:
+    // An enum, so it can be passed by reference without a definition.
+    enum : uint32_t { none = UINT32_MAX };
+
+    index_stack() : head(none) {}
+    index_stack(index_stack const &) = delete;
+    index_stack & operator =(index_stack const &) = delete;
+
+    template <typename LINKS>
+    void push(uint32_t index, LINKS links) {
+        auto h = head.load();
+        do {
+            links(index).store(static_cast<uint32_t>(h));
+        } while (!head.compare_exchange_weak(h, bump(h, index)));
+    }
+
+    /** @return none if the stack is empty. */
+    template <typename LINKS>
+    uint32_t pop(LINKS links) {
+        auto h = head.load();
+        for (;;) {
+            auto index = static_cast<uint32_t>(h);
+            if (index == none) {
+                return none;
+            }
+            // If another thread pops index first, this read may be stale;
+            // the counter makes the exchange fail, and we try again.
+            if (head.compare_exchange_weak(h, bump(h, links(index).load()))) {
+                return index;
+            }
+        }
+    }
+};
+
+
+/**
+ * Give pointers small numbers (slots) that stay theirs until erased, without
+ * locking. Slots are reused, most recently freed first, so the numbers stay
+ * dense. Storage grows in chunks that are never moved or freed until the
+ * table is, so a lookup is two loads.
+ *
+ * Insert, erase, get, and for_each are safe from any thread at once. A slot
+ * belongs to whoever inserted it; erasing a slot twice, or erasing one while
+ * another thread still uses it, is the caller's bug.
+ */
+template <typename T>
+class slot_table {
+    static constexpr unsigned chunk_bits = 10;
+    static constexpr uint32_t chunk_size = 1u << chunk_bits;
+    static constexpr uint32_t max_chunks = 1024;
+
+    struct slot {
+        std::atomic<T *> item;
+        std::atomic<uint32_t> next_free;
+    };
+
+    std::atomic<slot *> chunks[max_chunks];
+    std::atomic<uint32_t> used; // slots ever handed out
+    std::atomic<size_t> count;
+    index_stack free_slots;
+
+    slot & at(uint32_t n) const {
+        return chunks[n >> chunk_bits].load()[n & (chunk_size - 1)];
+    }
+
+    slot & get_or_grow(uint32_t n) {
+        auto & chunk = chunks[n >> chunk_bits];
+        auto p = chunk.load();
+        if (!p) {
+            auto fresh = new slot[chunk_size]();
+            if (chunk.compare_exchange_strong(p, fresh)) {
+                p = fresh;
+            } else {
+                delete [] fresh;
+            }
+        }
+        return p[n & (chunk_size - 1)];
+    }
+
+public:
+    enum : uint32_t { none = index_stack::none };
+
+    slot_table() : used(0), count(0), free_slots() {
+        for (auto & chunk : chunks) {
+            chunk.store(nullptr);
+        }
+    }
+
+    ~slot_table() {
+        for (auto & chunk : chunks) {
+            delete [] chunk.load();
+        }
+    }
+
+    slot_table(slot_table const &) = delete;
+    slot_table & operator =(slot_table const &) = delete;
+
+    /**
+     * @return the item's slot.
+     * @throw std::length_error if every slot is taken.
+     */
+    uint32_t insert(T * item) {
+        auto links = [this](uint32_t n) -> std::atomic<uint32_t> & {
+            return at(n).next_free;
+        };
+        auto n = free_slots.pop(links);
+        if (n == none) {
+            n = used.fetch_add(1);
+            if (n >= max_chunks * chunk_size) {
+                used.fetch_sub(1);
+                throw std::length_error("slot_table is full.");
+            }
+            get_or_grow(n).item.store(item);
+        } else {
+            at(n).item.store(item);
+        }
+        ++count;
+        return n;
+    }
+
+    void erase(uint32_t n) {
+        at(n).item.store(nullptr);
+        --count;
+        free_slots.push(n, [this](uint32_t i) -> std::atomic<uint32_t> & {
+            return at(i).next_free;
+        });
+    }
+
+    /** @return nullptr if the slot is empty. */
+    T * get(uint32_t n) const {
+        if (n >= used.load()) {
+            return nullptr;
+        }
+        auto chunk = chunks[n >> chunk_bits].load();
+        return chunk ? chunk[n & (chunk_size - 1)].item.load() : nullptr;
+    }
+
+    /**
+     * Call fn(T *) for each item. Items inserted or erased meanwhile may or
+     * may not be visited.
+     */
+    template <typename FN>
+    void for_each(FN fn) const {
+        auto n = used.load();
+        for (uint32_t i = 0; i < n; ++i) {
+            if (auto item = get(i)) {
+                fn(item);
+            }
+        }
+    }
+
+    size_t size() const {
+        return count.load();
+    }
+};
+
+
+}}} // end namespace
+
+
+#endif // sentry
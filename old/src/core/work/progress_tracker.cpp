@@ -95,4 +95,22 @@ void progress_tracker::skip_work(work_type wt, double amount) {
 }
 
 
+static double lookup(work_map const & m, work_type wt) {
+    auto i = m.find(wt);
+    return i == m.end() ? 0.0 : i->second;
+}
+
+
+double progress_tracker::get_expected_work(work_type wt) const {
+    lock_guard<mutex> lock(impl->mutex);
+    return lookup(impl->expected_work_map, wt);
+}
+
+
+double progress_tracker::get_completed_work(work_type wt) const {
+    lock_guard<mutex> lock(impl->mutex);
+    return lookup(impl->done_work_map, wt);
+}
+
+
 }}} // end namespace
@@ -43,6 +43,12 @@ public:
      * @param amount
      */
     void skip_work(work_type, double amount);
+
+    /** How much of a type of work is expected, in total. */
+    double get_expected_work(work_type) const;
+
+    /** How much of a type of work has been reported done. */
+    double get_completed_work(work_type) const;
 };
 
 
@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include "core/text/strutil.h"
+#include "perftest/curlbench/blob_server.h"
+
+using std::string;
+
+using intent::core::text::compare_str_ascii_case_insensitive;
+
+
+namespace {
+
+// Bodies are sent out of this, as many times over as they need.
+char const blob[64 * 1024] = {};
+
+bool send_all(int fd, char const * p, size_t n) {
+    while (n) {
+        auto sent = send(fd, p, n, 0);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += sent;
+        n -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+// Send a reply's headers and the start of its body in one call, so a small
+// reply is a single packet.
+bool send_reply(int fd, uint64_t size) {
+    char head[128];
+    auto head_len = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\n"
+            "Content-Type: application/octet-stream\r\n"
+            "Content-Length: %llu\r\n\r\n", static_cast<unsigned long long>(size));
+    auto first = std::min<uint64_t>(size, sizeof(blob));
+    iovec parts[2] = {
+        {head, static_cast<size_t>(head_len)},
+        {const_cast<char *>(blob), static_cast<size_t>(first)},
+    };
+    while (parts[0].iov_len || parts[1].iov_len) {
+        auto sent = writev(fd, parts, 2);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        for (auto & part : parts) {
+            auto n = std::min<size_t>(static_cast<size_t>(sent), part.iov_len);
+            part.iov_base = static_cast<char *>(part.iov_base) + n;
+            part.iov_len -= n;
+            sent -= n;
+        }
+    }
+    for (size -= first; size; ) {
+        auto n = std::min<uint64_t>(size, sizeof(blob));
+        if (!send_all(fd, blob, n)) {
+            return false;
+        }
+        size -= n;
+    }
+    return true;
+}
+
+// Find a header's value in a header block, or return nullptr.
+char const * find_header(string const & head, char const * name) {
+    auto name_len = strlen(name);
+    for (size_t line = head.find("\r\n"); line != string::npos;
+            line = head.find("\r\n", line + 2)) {
+        auto p = head.c_str() + line + 2;
+        if (head.size() - (line + 2) > name_len && p[name_len] == ':'
+                && compare_str_ascii_case_insensitive(string(p, name_len).c_str(), name) == 0) {
+            p += name_len + 1;
+            while (*p == ' ') {
+                ++p;
+            }
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+// The number a request's path ends with, if any.
+uint64_t get_reply_size(string const & head) {
+    auto path_end = head.find(' ', head.find(' ') + 1);
+    if (path_end == string::npos) {
+        return 0;
+    }
+    auto p = path_end;
+    while (p && isdigit(head[p - 1])) {
+        --p;
+    }
+    return strtoull(head.c_str() + p, nullptr, 10);
+}
+
+void serve_connection(int fd) {
+    string buf;
+    char chunk[64 * 1024];
+    for (;;) {
+        size_t head_end;
+        while ((head_end = buf.find("\r\n\r\n")) == string::npos) {
+            auto n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                close(fd);
+                return;
+            }
+            buf.append(chunk, static_cast<size_t>(n));
+        }
+        string head = buf.substr(0, head_end + 2);
+        buf.erase(0, head_end + 4);
+
+        if (find_header(head, "Transfer-Encoding")) {
+            // The benchmark always says how long its bodies are.
+            static char const refusal[] = "HTTP/1.1 411 Length Required\r\n"
+                    "Content-Length: 0\r\nConnection: close\r\n\r\n";
+            send_all(fd, refusal, sizeof(refusal) - 1);
+            close(fd);
+            return;
+        }
+        auto expect = find_header(head, "Expect");
+        if (expect && strncmp(expect, "100", 3) == 0) {
+            static char const go_on[] = "HTTP/1.1 100 Continue\r\n\r\n";
+            send_all(fd, go_on, sizeof(go_on) - 1);
+        }
+        auto length = find_header(head, "Content-Length");
+        uint64_t body_left = length ? strtoull(length, nullptr, 10) : 0;
+        auto buffered = std::min<uint64_t>(body_left, buf.size());
+        buf.erase(0, static_cast<size_t>(buffered));
+        body_left -= buffered;
+        while (body_left) {
+            auto n = recv(fd, chunk, std::min<uint64_t>(body_left, sizeof(chunk)), 0);
+            if (n <= 0) {
+                close(fd);
+                return;
+            }
+            body_left -= static_cast<uint64_t>(n);
+        }
+
+        if (!send_reply(fd, get_reply_size(head))) {
+            close(fd);
+            return;
+        }
+    }
+}
+
+void serve(int listener) {
+    for (;;) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            _exit(1);
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        std::thread(serve_connection, fd).detach();
+    }
+}
+
+} // end anonymous namespace
+
+
+blob_server::blob_server() : pid(-1), port(0) {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw std::runtime_error(string("Can't open a socket: ") + strerror(errno));
+    }
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    // Port 0 lets the OS pick one that's free.
+    if (bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0
+            || listen(listener, SOMAXCONN) != 0
+            || getsockname(listener, reinterpret_cast<sockaddr *>(&addr), &addr_len) != 0) {
+        auto err = errno;
+        close(listener);
+        throw std::runtime_error(string("Can't listen on localhost: ") + strerror(err));
+    }
+    port = ntohs(addr.sin_port);
+
+    pid = fork();
+    if (pid < 0) {
+        auto err = errno;
+        close(listener);
+        throw std::runtime_error(string("Can't fork the server: ") + strerror(err));
+    }
+    if (pid == 0) {
+#ifdef __linux__
+        // Don't outlive a client that dies without cleaning up.
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+        // A client that hangs up mid-reply only ends its connection.
+        signal(SIGPIPE, SIG_IGN);
+        serve(listener);
+    }
+    // The child has its own copy; connections go to it.
+    close(listener);
+}
+
+
+blob_server::~blob_server() {
+    if (pid > 0) {
+        kill(pid, SIGTERM);
+        waitpid(pid, nullptr, 0);
+    }
+}
+
+
+string blob_server::get_base_url() const {
+    return "http://127.0.0.1:" + std::to_string(port) + "/";
+}
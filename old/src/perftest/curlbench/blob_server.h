@@ -0,0 +1,45 @@
+#ifndef _4e8d1f7a2c0b4b96a3e5d8c71f2b6a09
+#define _4e8d1f7a2c0b4b96a3e5d8c71f2b6a09
+
+#include <cstdint>
+#include <string>
+
+#include <sys/types.h>
+
+#include "core/util/value_semantics.h"
+
+
+/**
+ * A throwaway HTTP/1.1 server on localhost, fast enough that a load test
+ * measures the client rather than the server (which uhttpd.py can't be).
+ *
+ * Any request whose path ends in a number n gets n bytes back; other paths
+ * get an empty body. Request bodies are read and dropped. Connections are
+ * kept alive, each served by a thread of its own.
+ *
+ * The server runs in a child process, so its CPU time never shows up in the
+ * client's. Construct it before starting any threads; fork() only takes the
+ * calling thread along.
+ */
+class blob_server {
+    pid_t pid;
+    uint16_t port;
+
+public:
+    /** @throw std::runtime_error if the server can't be started. */
+    blob_server();
+
+    /** Stops the server. */
+    ~blob_server();
+
+    NOT_COPYABLE(blob_server);
+    NOT_MOVEABLE(blob_server);
+
+    uint16_t get_port() const { return port; }
+
+    /** "http://127.0.0.1:<port>/" */
+    std::string get_base_url() const;
+};
+
+
+#endif // sentry
@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <sys/resource.h>
+
+#include "core/net/curl/body_source.h"
+#include "core/net/curl/channel.h"
+#include "core/net/curl/completion_queue.h"
+#include "core/net/curl/request.h"
+#include "core/net/curl/response.h"
+#include "core/net/curl/session.h"
+#include "perftest/curlbench/load_generator.h"
+
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+using std::unique_ptr;
+
+using namespace intent::core::net::curl;
+
+typedef std::chrono::steady_clock clock_type;
+
+
+namespace {
+
+double to_secs(timeval const & tv) {
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// One session's share of the load. Its handler runs on one loop thread at a
+// time, so nothing here needs a lock.
+struct worker {
+    unique_ptr<session> s;
+    unique_ptr<span_body_source> upload;
+    clock_type::time_point sent;
+    uint64_t requests;
+    uint64_t errors;
+    uint64_t bytes;
+    std::vector<uint32_t> latencies_usecs;
+
+    worker() : s(), upload(), sent(), requests(0), errors(0), bytes(0),
+            latencies_usecs() {
+    }
+};
+
+class driver {
+    load_config const & cfg;
+    std::string payload;
+    channel ch;
+    completion_queue q;
+    std::vector<worker> workers;
+    clock_type::time_point measure_from;
+    clock_type::time_point measure_until;
+    mutex mtx;
+    std::condition_variable idle_signal;
+    unsigned active; // +<guarded_by(mtx)
+
+public:
+    explicit driver(load_config const & c) : cfg(c), payload(c.upload_bytes, 'x'),
+            ch(c.loops), q(ch), workers(c.sessions), measure_from(),
+            measure_until(), mtx(), idle_signal(), active(0) {
+        for (auto & w : workers) {
+            w.s.reset(new session(ch));
+            if (cfg.upload_bytes) {
+                w.upload.reset(new span_body_source(payload.data(), payload.size()));
+            }
+        }
+    }
+
+    load_results run() {
+        auto start = clock_type::now();
+        measure_from = start + std::chrono::microseconds(
+                static_cast<int64_t>(cfg.warmup_secs * 1e6));
+        measure_until = measure_from + std::chrono::microseconds(
+                static_cast<int64_t>(cfg.secs * 1e6));
+        {
+            lock_guard<mutex> lock(mtx);
+            active = static_cast<unsigned>(workers.size());
+        }
+        for (auto & w : workers) {
+            send(w);
+        }
+
+        rusage before, after;
+        std::this_thread::sleep_until(measure_from);
+        getrusage(RUSAGE_SELF, &before);
+        std::this_thread::sleep_until(measure_until);
+        getrusage(RUSAGE_SELF, &after);
+
+        // Let the transfers still underway finish, then stop the loops, so
+        // no handler is running when the workers go away.
+        {
+            unique_lock<mutex> lock(mtx);
+            idle_signal.wait_for(lock, std::chrono::seconds(30),
+                    [this] { return active == 0; });
+        }
+        ch.close();
+
+        load_results results;
+        results.secs = cfg.secs;
+        results.cpu_user_secs = to_secs(after.ru_utime) - to_secs(before.ru_utime);
+        results.cpu_system_secs = to_secs(after.ru_stime) - to_secs(before.ru_stime);
+        for (auto & w : workers) {
+            results.requests += w.requests;
+            results.errors += w.errors;
+            results.bytes += w.bytes;
+            results.latencies_usecs.insert(results.latencies_usecs.end(),
+                    w.latencies_usecs.begin(), w.latencies_usecs.end());
+        }
+        std::sort(results.latencies_usecs.begin(), results.latencies_usecs.end());
+        return results;
+    }
+
+private:
+    void send(worker & w) {
+        auto req = w.s->reset();
+        req.set_url(cfg.url.c_str());
+        if (w.upload) {
+            w.upload->rewind();
+            req.set_verb("post");
+            req.set_body_source(w.upload.get());
+        } else {
+            req.set_verb("get");
+        }
+        w.sent = clock_type::now();
+        try {
+            q.submit(*w.s, [this, &w](response & r) { on_done(w, r); });
+        } catch (...) {
+            ++w.errors;
+            stop();
+        }
+    }
+
+    void on_done(worker & w, response & r) {
+        auto now = clock_type::now();
+        if (now >= measure_from && now < measure_until) {
+            auto status = r.get_status_code();
+            if (status >= 200 && status < 300) {
+                ++w.requests;
+                w.bytes += r.get_body().size() + cfg.upload_bytes;
+                w.latencies_usecs.push_back(static_cast<uint32_t>(
+                        std::chrono::duration_cast<std::chrono::microseconds>(
+                        now - w.sent).count()));
+            } else {
+                ++w.errors;
+            }
+        }
+        if (now >= measure_until) {
+            stop();
+        } else {
+            send(w);
+        }
+    }
+
+    void stop() {
+        lock_guard<mutex> lock(mtx);
+        if (--active == 0) {
+            idle_signal.notify_all();
+        }
+    }
+};
+
+} // end anonymous namespace
+
+
+uint32_t load_results::get_percentile_usecs(double fraction) const {
+    if (latencies_usecs.empty()) {
+        return 0;
+    }
+    auto i = static_cast<size_t>(fraction * latencies_usecs.size());
+    return latencies_usecs[std::min(i, latencies_usecs.size() - 1)];
+}
+
+
+double load_results::get_mean_usecs() const {
+    if (latencies_usecs.empty()) {
+        return 0;
+    }
+    double total = 0;
+    for (auto n : latencies_usecs) {
+        total += n;
+    }
+    return total / latencies_usecs.size();
+}
+
+
+load_results run_load(load_config const & cfg) {
+    driver d(cfg);
+    return d.run();
+}
@@ -0,0 +1,64 @@
+#ifndef _a71c5e02d93f4f4b8e6b0d2c94f1e357
+#define _a71c5e02d93f4f4b8e6b0d2c94f1e357
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/**
+ * How hard to push, and for how long.
+ */
+struct load_config {
+    /** Every request goes here. */
+    std::string url;
+    /** Sessions with a request in flight at all times. */
+    unsigned sessions;
+    /** Event loops (threads) in the channel. */
+    unsigned loops;
+    /** Run this long before measuring, to open connections and warm caches. */
+    double warmup_secs;
+    /** Measure for this long. */
+    double secs;
+    /** POST a body this big with each request; 0 means GET. */
+    size_t upload_bytes;
+
+    load_config() : url(), sessions(16), loops(1), warmup_secs(1), secs(5),
+            upload_bytes(0) {
+    }
+};
+
+
+/**
+ * What happened while measuring. Only transfers that finished in the window
+ * count.
+ */
+struct load_results {
+    uint64_t requests; // that succeeded
+    uint64_t errors; // transfers that failed, or got anything but 2xx
+    uint64_t bytes; // body bytes, both ways
+    double secs;
+    double cpu_user_secs; // the whole process's
+    double cpu_system_secs;
+    std::vector<uint32_t> latencies_usecs; // sorted
+
+    load_results() : requests(0), errors(0), bytes(0), secs(0),
+            cpu_user_secs(0), cpu_system_secs(0), latencies_usecs() {
+    }
+
+    /** @param fraction e.g., 0.99 for p99. */
+    uint32_t get_percentile_usecs(double fraction) const;
+    double get_mean_usecs() const;
+};
+
+
+/**
+ * Drive a channel's sessions against cfg.url as fast as the server answers:
+ * each session sends its next request as soon as the last one is done (a
+ * closed loop), through a completion_queue, so no thread waits on a
+ * response.
+ */
+load_results run_load(load_config const & cfg);
+
+
+#endif // sentry
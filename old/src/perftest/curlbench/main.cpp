@@ -0,0 +1,128 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+
+#include "perftest/curlbench/blob_server.h"
+#include "perftest/curlbench/load_generator.h"
+
+static char const * const usage =
+    "curlbench: measure core/net/curl against a local (or given) HTTP server.\n"
+    "\n"
+    "  --url URL       Load this server instead of starting a local one.\n"
+    "  --size BYTES    Body size the local server replies with (default 1024).\n"
+    "  --upload BYTES  POST a body this big with each request (default 0, GET).\n"
+    "  --sessions N    Requests in flight at once (default 16).\n"
+    "  --loops N       Event loop threads in the channel (default 1).\n"
+    "  --secs S        How long to measure (default 5).\n"
+    "  --warmup S      How long to run first, unmeasured (default 1).\n"
+    "  --json          Print one line of json instead of a report.\n"
+    "\n"
+    "CPU time is the client's alone; the local server runs in a child process.\n";
+
+static void print_report(load_config const & cfg, load_results const & r) {
+    double cpu = r.cpu_user_secs + r.cpu_system_secs;
+    double per_request = r.requests ? 1e6 / r.requests : 0;
+    printf("%s with %u sessions on %u loop(s), %.1f secs after %.1f secs of warmup\n",
+            cfg.url.c_str(), cfg.sessions, cfg.loops, r.secs, cfg.warmup_secs);
+    printf("    requests   %llu (%.0f/sec), %llu errors\n",
+            static_cast<unsigned long long>(r.requests), r.requests / r.secs,
+            static_cast<unsigned long long>(r.errors));
+    printf("    latency    p50 %u, p99 %u, p999 %u, max %u, mean %.0f usecs\n",
+            r.get_percentile_usecs(0.5), r.get_percentile_usecs(0.99),
+            r.get_percentile_usecs(0.999), r.get_percentile_usecs(1),
+            r.get_mean_usecs());
+    printf("    bytes      %.1f MB/sec\n", r.bytes / r.secs / 1e6);
+    printf("    cpu        %.1f usecs/request (user %.1f, system %.1f); %.0f%% of a core\n",
+            cpu * per_request, r.cpu_user_secs * per_request,
+            r.cpu_system_secs * per_request, 100 * cpu / r.secs);
+}
+
+static void print_json(load_config const & cfg, load_results const & r) {
+    double cpu = r.cpu_user_secs + r.cpu_system_secs;
+    double per_request = r.requests ? 1e6 / r.requests : 0;
+    // Urls we make never need escaping; one given with --url is the caller's
+    // business.
+    printf("{\"url\": \"%s\", \"sessions\": %u, \"loops\": %u, \"upload_bytes\": %zu, "
+            "\"secs\": %.3f, \"requests\": %llu, \"errors\": %llu, "
+            "\"requests_per_sec\": %.1f, \"bytes\": %llu, \"bytes_per_sec\": %.1f, "
+            "\"latency_usecs\": {\"p50\": %u, \"p99\": %u, \"p999\": %u, "
+            "\"max\": %u, \"mean\": %.1f}, "
+            "\"cpu_usecs_per_request\": %.2f, \"cpu_user_secs\": %.3f, "
+            "\"cpu_system_secs\": %.3f}\n",
+            cfg.url.c_str(), cfg.sessions, cfg.loops, cfg.upload_bytes, r.secs,
+            static_cast<unsigned long long>(r.requests),
+            static_cast<unsigned long long>(r.errors), r.requests / r.secs,
+            static_cast<unsigned long long>(r.bytes), r.bytes / r.secs,
+            r.get_percentile_usecs(0.5), r.get_percentile_usecs(0.99),
+            r.get_percentile_usecs(0.999), r.get_percentile_usecs(1),
+            r.get_mean_usecs(), cpu * per_request, r.cpu_user_secs,
+            r.cpu_system_secs);
+}
+
+int main(int argc, char ** argv) {
+
+    try {
+
+        load_config cfg;
+        unsigned long long size = 1024;
+        bool json = false;
+        for (int i = 1; i < argc; ++i) {
+            auto arg = argv[i];
+            auto value = i + 1 < argc ? argv[i + 1] : nullptr;
+            if (strcmp(arg, "--json") == 0) {
+                json = true;
+                continue;
+            }
+            if (!value || strncmp(arg, "--", 2) != 0) {
+                fprintf(stderr, "%s", usage);
+                return 1;
+            }
+            ++i;
+            if (strcmp(arg, "--url") == 0) {
+                cfg.url = value;
+            } else if (strcmp(arg, "--size") == 0) {
+                size = strtoull(value, nullptr, 10);
+            } else if (strcmp(arg, "--upload") == 0) {
+                cfg.upload_bytes = strtoull(value, nullptr, 10);
+            } else if (strcmp(arg, "--sessions") == 0) {
+                cfg.sessions = static_cast<unsigned>(strtoul(value, nullptr, 10));
+            } else if (strcmp(arg, "--loops") == 0) {
+                cfg.loops = static_cast<unsigned>(strtoul(value, nullptr, 10));
+            } else if (strcmp(arg, "--secs") == 0) {
+                cfg.secs = atof(value);
+            } else if (strcmp(arg, "--warmup") == 0) {
+                cfg.warmup_secs = atof(value);
+            } else {
+                fprintf(stderr, "%s", usage);
+                return 1;
+            }
+        }
+        if (!cfg.sessions || cfg.secs <= 0 || cfg.warmup_secs < 0) {
+            fprintf(stderr, "%s", usage);
+            return 1;
+        }
+
+        // Start the server first; it forks, and nothing else may be running
+        // threads yet.
+        std::unique_ptr<blob_server> server;
+        if (cfg.url.empty()) {
+            server.reset(new blob_server());
+            cfg.url = server->get_base_url() + std::to_string(size);
+        }
+
+        auto results = run_load(cfg);
+        if (json) {
+            print_json(cfg, results);
+        } else {
+            print_report(cfg, results);
+        }
+        return results.requests ? 0 : 1;
+
+    } catch (std::exception const & e) {
+        fprintf(stderr, "Fatal error: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,135 @@
+#include <sstream>
+
+#include "core/data/json/json.h"
+
+#include "gtest/gtest.h"
+
+using namespace json;
+
+static value parse_text(char const * txt) {
+    value root;
+    reader r;
+    r.parse(txt, txt + strlen(txt), root, false);
+    return root;
+}
+
+static char const * const sample_json =
+    "{\"name\": \"intent\", \"count\": 3, \"big\": 4000000000, \"neg\": -17,"
+    " \"ratio\": 0.1, \"half\": 0.5, \"ok\": true, \"nothing\": null,"
+    " \"list\": [1, [2, 3], {\"x\": \"y\"}, []], \"empty\": {}}";
+
+TEST(cbor_test, round_trip_matches_text_parse) {
+    value root = parse_text(sample_json);
+    std::string encoded = write_cbor(root);
+    value decoded;
+    std::string errs;
+    auto end = read_cbor(encoded.data(), encoded.data() + encoded.size(), &decoded, &errs);
+    ASSERT_EQ(encoded.data() + encoded.size(), end) << errs;
+    ASSERT_TRUE(root == decoded);
+    ASSERT_EQ(vt_uint, decoded["big"].type());
+    ASSERT_EQ(vt_int, decoded["neg"].type());
+}
+
+TEST(cbor_test, smaller_than_text) {
+    value root = parse_text(sample_json);
+    ASSERT_LT(write_cbor(root).size(), strlen(sample_json));
+}
+
+TEST(cbor_test, known_encodings) {
+    // Vectors from RFC 7049, appendix A.
+    ASSERT_EQ(std::string("\x00", 1), write_cbor(value(0)));
+    ASSERT_EQ("\x18\x18", write_cbor(value(24)));
+    ASSERT_EQ("\x38\x63", write_cbor(value(-100)));
+    ASSERT_EQ(std::string("\xfa\x47\xc3\x50\x00", 5), write_cbor(value(100000.0)));
+    ASSERT_EQ("\xfb\x3f\xf1\x99\x99\x99\x99\x99\x9a", write_cbor(value(1.1)));
+    ASSERT_EQ("\x64\x49\x45\x54\x46", write_cbor(value("IETF")));
+    ASSERT_EQ("\xf6", write_cbor(value()));
+}
+
+TEST(cbor_test, embedded_nulls_survive) {
+    std::string s("a\0b", 3);
+    value root(vt_object);
+    root[s] = value(s);
+    value decoded;
+    std::string encoded = write_cbor(root);
+    ASSERT_TRUE(read_cbor(encoded.data(), encoded.data() + encoded.size(), &decoded, nullptr));
+    ASSERT_EQ(s, decoded[s].as_string());
+}
+
+TEST(cbor_test, indefinite_lengths_from_other_encoders) {
+    // {_ "a": [_ 1, 2], "b": (_ "c", "d")}
+    static char const bytes[] = "\xbf\x61\x61\x9f\x01\x02\xff\x61\x62\x7f\x61\x63\x61\x64\xff\xff";
+    value decoded;
+    std::string errs;
+    ASSERT_TRUE(read_cbor(bytes, bytes + sizeof(bytes) - 1, &decoded, &errs)) << errs;
+    ASSERT_EQ(2U, decoded["a"].size());
+    ASSERT_EQ("cd", decoded["b"].as_string());
+    ASSERT_EQ(bytes + sizeof(bytes) - 1, cbor_skip(bytes, bytes + sizeof(bytes) - 1));
+}
+
+TEST(cbor_test, skip_subtree) {
+    value root(vt_array);
+    root.append(parse_text(sample_json));
+    root.append(value("after"));
+    std::string encoded = write_cbor(root);
+    char const * p = encoded.data() + 1; // step past array head
+    char const * end = encoded.data() + encoded.size();
+    p = cbor_skip(p, end);
+    ASSERT_TRUE(p != nullptr);
+    value second;
+    ASSERT_EQ(end, read_cbor(p, end, &second, nullptr));
+    ASSERT_EQ("after", second.as_string());
+}
+
+TEST(cbor_test, streams_both_ways) {
+    value root = parse_text(sample_json);
+    std::stringstream ss;
+    {
+        cbor_writer w(&ss);
+        w.write(root);
+        w.begin_array(2);
+        w.write_int(-1);
+        w.write_string("x", "x" + 1);
+    }
+    value first, second;
+    std::string errs;
+    ASSERT_TRUE(read_cbor(ss, &first, &errs)) << errs;
+    ASSERT_TRUE(read_cbor(ss, &second, &errs)) << errs;
+    ASSERT_TRUE(root == first);
+    ASSERT_EQ(-1, second[0].as_int());
+    ASSERT_EQ("x", second[1].as_string());
+}
+
+TEST(cbor_test, truncated_input_fails_cleanly) {
+    std::string encoded = write_cbor(parse_text(sample_json));
+    for (size_t len = 0; len < encoded.size(); ++len) {
+        value decoded;
+        std::string errs;
+        ASSERT_EQ(nullptr, read_cbor(encoded.data(), encoded.data() + len, &decoded, &errs));
+        ASSERT_FALSE(errs.empty());
+        ASSERT_EQ(nullptr, cbor_skip(encoded.data(), encoded.data() + len));
+    }
+}
+
+TEST(cbor_test, hostile_lengths_rejected) {
+    // Array claiming 2^32-1 elements, with none present.
+    static char const bytes[] = "\x9a\xff\xff\xff\xff";
+    value decoded;
+    ASSERT_EQ(nullptr, read_cbor(bytes, bytes + sizeof(bytes) - 1, &decoded, nullptr));
+}
+
+TEST(cbor_test, long_tag_chains_rejected_without_recursing) {
+    // Tags don't count as nesting, so a decoder that recursed on each one
+    // would run out of stack long before the input did.
+    std::string bytes(2 * 1024 * 1024, '\xc0');
+    value decoded;
+    ASSERT_EQ(nullptr, read_cbor(bytes.data(), bytes.data() + bytes.size(), &decoded, nullptr));
+    ASSERT_EQ(nullptr, cbor_skip(bytes.data(), bytes.data() + bytes.size()));
+
+    // With an item at the end, the tags are simply ignored.
+    bytes += '\x07';
+    auto end = read_cbor(bytes.data(), bytes.data() + bytes.size(), &decoded, nullptr);
+    ASSERT_EQ(bytes.data() + bytes.size(), end);
+    ASSERT_EQ(7, decoded.as_int());
+    ASSERT_EQ(bytes.data() + bytes.size(), cbor_skip(bytes.data(), bytes.data() + bytes.size()));
+}
@@ -0,0 +1,79 @@
+#include "core/data/json/json.h"
+
+#include "gtest/gtest.h"
+
+using namespace json;
+
+static char const * const sample_json =
+    "// leading comment\n"
+    "{\"name\": \"in\\\"tent\", \"count\": 3,\n"
+    " \"nested\": {\"a\": [1, 2, {\"b\": \"]}\"}], /* tricky */ \"c\": null},\n"
+    " \"esc\\u0041ped\": true, \"list\": [10, 20, 30], \"count\": 4}";
+
+TEST(lazy_document_test, indexes_top_level_only) {
+    lazy_document doc;
+    std::string errs;
+    ASSERT_TRUE(doc.load(sample_json, &errs)) << errs;
+    ASSERT_EQ(vt_object, doc.type());
+    ASSERT_EQ(5U, doc.size());
+    ASSERT_TRUE(doc.is_member("nested"));
+    ASSERT_TRUE(doc.is_member("escAped"));
+    ASSERT_FALSE(doc.is_member("missing"));
+}
+
+TEST(lazy_document_test, access_parses_and_caches) {
+    lazy_document doc;
+    ASSERT_TRUE(doc.load(sample_json, nullptr));
+    value const & nested = doc["nested"];
+    ASSERT_EQ("]}", nested["a"][2]["b"].as_string());
+    // Same object is returned on second access; nothing is reparsed.
+    ASSERT_EQ(&nested, &doc["nested"]);
+    ASSERT_EQ("in\"tent", doc["name"].as_string());
+    // Last duplicate wins, as with reader.
+    ASSERT_EQ(4, doc["count"].as_int());
+    ASSERT_TRUE(doc["missing"].is_null());
+    ASSERT_EQ(7, doc.get("missing", value(7)).as_int());
+}
+
+TEST(lazy_document_test, matches_full_parse) {
+    lazy_document doc;
+    ASSERT_TRUE(doc.load(sample_json, nullptr));
+    value full;
+    reader r;
+    ASSERT_TRUE(r.parse(sample_json, sample_json + strlen(sample_json), full, false));
+    ASSERT_TRUE(full == doc.to_value());
+}
+
+TEST(lazy_document_test, arrays_and_scalars) {
+    lazy_document doc;
+    ASSERT_TRUE(doc.load("[1, \"two\", [3], {}]", nullptr));
+    ASSERT_EQ(vt_array, doc.type());
+    ASSERT_EQ(4U, doc.size());
+    ASSERT_EQ(1, doc[0].as_int());
+    ASSERT_EQ("two", doc[1].as_string());
+    ASSERT_TRUE(doc[9].is_null());
+    ASSERT_TRUE(doc[-1].is_null());
+
+    ASSERT_TRUE(doc.load("  42 ", nullptr));
+    ASSERT_EQ(vt_int, doc.type());
+    ASSERT_EQ(42, doc.to_value().as_int());
+
+    ASSERT_TRUE(doc.load("{}", nullptr));
+    ASSERT_EQ(0U, doc.size());
+}
+
+TEST(lazy_document_test, malformed_top_level_rejected) {
+    lazy_document doc;
+    std::string errs;
+    ASSERT_FALSE(doc.load("{\"a\": 1 \"b\": 2}", &errs));
+    ASSERT_FALSE(errs.empty());
+    ASSERT_FALSE(doc.load("[1, 2", &errs));
+    ASSERT_FALSE(doc.load("{\"a\": \"unterminated}", &errs));
+}
+
+TEST(lazy_document_test, errors_in_deferred_subtree_surface_on_access) {
+    lazy_document doc;
+    ASSERT_TRUE(doc.load("{\"good\": 1, \"bad\": [1 2]}", nullptr));
+    ASSERT_EQ(1, doc["good"].as_int());
+    ASSERT_THROW(doc["bad"], std::exception);
+}
@@ -0,0 +1,109 @@
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "core/data/parallel_xsv.h"
+#include "core/data/xsv.h"
+#include "core/io/ioutil.h"
+
+#include "gtest/gtest.h"
+
+using namespace intent::core::data;
+using namespace intent::core::io;
+using intent::core::filesystem::path;
+using intent::core::text::str_view;
+
+typedef std::vector<std::vector<std::string>> records_t;
+
+static records_t read_sequentially(std::string txt, char delim) {
+    records_t records;
+    xsv_reader r(txt, delim);
+    while (r.next_record()) {
+        records.push_back(std::vector<std::string>());
+        for (size_t i = 0; i < r.get_field_count(); ++i) {
+            str_view v = r.get_field(i);
+            records.back().push_back(std::string(v.begin, v.length));
+        }
+    }
+    return records;
+}
+
+static records_t read_in_parallel(parallel_xsv_reader & r) {
+    records_t records;
+    while (r.next_record()) {
+        records.push_back(std::vector<std::string>());
+        for (size_t i = 0; i < r.get_field_count(); ++i) {
+            str_view v = r.get_field(i);
+            records.back().push_back(std::string(v.begin, v.length));
+        }
+    }
+    return records;
+}
+
+// Lots of quoted delimiters, quoted line breaks, and mixed line endings, so
+// that chunk boundaries land in every kind of awkward spot.
+static std::string make_tricky_csv(size_t approx_size) {
+    std::mt19937 rng(42);
+    char const * pieces[] = { "abc", ",", "\"x,y\"", "\"line\nbreak\"",
+        "\"esc\"\"aped\"", "\r\n", "\n", "\r", "12345", "\"\"", "\"a\r\nb\"" };
+    std::string txt;
+    while (txt.size() < approx_size) {
+        txt += pieces[rng() % (sizeof(pieces) / sizeof(pieces[0]))];
+    }
+    return txt;
+}
+
+TEST(parallel_xsv_test, matches_sequential_reader) {
+    std::string txt = make_tricky_csv(3 * 1024 * 1024);
+    records_t expected = read_sequentially(txt, ',');
+    for (unsigned threads : { 1u, 3u, 8u }) {
+        parallel_xsv_reader r(txt.data(), txt.data() + txt.size(), ',', threads);
+        records_t actual = read_in_parallel(r);
+        ASSERT_EQ(expected.size(), actual.size());
+        EXPECT_TRUE(expected == actual);
+    }
+}
+
+TEST(parallel_xsv_test, mapped_file) {
+    std::string txt;
+    for (int i = 0; i < 100000; ++i) {
+        txt += std::to_string(i) + "\t\"q\"\"" + std::to_string(i) + "\"\tz\n";
+    }
+    easy_temp_c_file f;
+    fwrite(txt.data(), 1, txt.size(), f);
+    fclose(f);
+    file_delete_on_exit fdoe(f.path);
+
+    parallel_xsv_reader r(f.path, '\t', 4);
+    int n = 0;
+    while (r.next_record()) {
+        ASSERT_EQ(3u, r.get_field_count());
+        ASSERT_STREQ(std::to_string(n).c_str(), r.get_field_by_index(0));
+        ASSERT_EQ("q\"" + std::to_string(n), std::string(r.get_field(1).begin, r.get_field(1).length));
+        ++n;
+    }
+    EXPECT_EQ(100000, n);
+    EXPECT_EQ(0u, r.get_field_count());
+    EXPECT_EQ(nullptr, r.get_field_by_index(0));
+}
+
+TEST(parallel_xsv_test, empty_and_tiny_input) {
+    char const * empty = "";
+    parallel_xsv_reader r1(empty, empty, ',');
+    EXPECT_FALSE(r1.next_record());
+
+    std::string txt = "a,b";
+    parallel_xsv_reader r2(txt.data(), txt.data() + txt.size(), ',');
+    ASSERT_TRUE(r2.next_record());
+    EXPECT_STREQ("b", r2.get_field_by_index(1));
+    EXPECT_FALSE(r2.next_record());
+}
+
+TEST(parallel_xsv_test, oversized_record_throws_in_order) {
+    std::string txt = "first\n" + std::string(2 * 1024 * 1024, 'x');
+    parallel_xsv_reader r(txt.data(), txt.data() + txt.size(), ',', 2);
+    ASSERT_TRUE(r.next_record());
+    EXPECT_STREQ("first", r.get_field_by_index(0));
+    EXPECT_THROW(r.next_record(), std::runtime_error);
+}
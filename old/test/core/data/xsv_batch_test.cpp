@@ -0,0 +1,97 @@
+#include <string>
+
+#include "core/data/parallel_xsv.h"
+#include "core/data/xsv.h"
+#include "core/data/xsv_batch.h"
+
+#include "gtest/gtest.h"
+
+using namespace intent::core::data;
+
+static std::string text(xsv_column const & col, size_t row) {
+    auto v = col.get_text(row);
+    return std::string(v.begin, v.length);
+}
+
+TEST(xsv_batch_test, infers_types_and_fills_columns) {
+    std::string txt =
+        "id,price,ok,zip,note\n"
+        "1,2.5,true,02134,a\n"
+        "-2,-.25,FALSE,90210,\"b,c\"\n"
+        "3,,True,10001,\n"
+        "4_000,1e2,false,00501,d\n";
+    xsv_reader r(txt, ',');
+    xsv_batch_reader br(r, true);
+    ASSERT_EQ(5u, br.get_column_count());
+    EXPECT_EQ("price", br.get_column_names()[1]);
+    EXPECT_EQ(xsv_column_type::int64, br.get_column_type(0));
+    EXPECT_EQ(xsv_column_type::float64, br.get_column_type(1));
+    EXPECT_EQ(xsv_column_type::boolean, br.get_column_type(2));
+    EXPECT_EQ(xsv_column_type::text, br.get_column_type(3));
+    EXPECT_EQ(xsv_column_type::text, br.get_column_type(4));
+
+    xsv_batch batch;
+    ASSERT_EQ(4u, br.next_batch(batch, 100));
+    auto const & ids = batch.columns[0];
+    EXPECT_EQ(-2, ids.ints[1]);
+    EXPECT_EQ(4000, ids.ints[3]);
+    auto const & prices = batch.columns[1];
+    EXPECT_DOUBLE_EQ(2.5, prices.reals[0]);
+    EXPECT_DOUBLE_EQ(-0.25, prices.reals[1]);
+    EXPECT_EQ(0u, prices.valid[2]);
+    EXPECT_DOUBLE_EQ(100.0, prices.reals[3]);
+    EXPECT_EQ(0u, prices.rejected);
+    EXPECT_EQ(1u, batch.columns[2].bools[2]);
+    EXPECT_EQ("02134", text(batch.columns[3], 0));
+    EXPECT_EQ("b,c", text(batch.columns[4], 1));
+    EXPECT_EQ("", text(batch.columns[4], 2));
+    EXPECT_EQ(0u, br.next_batch(batch, 100));
+}
+
+TEST(xsv_batch_test, batches_span_sample_and_rest) {
+    std::string txt;
+    for (int i = 0; i < 1000; ++i) {
+        txt += std::to_string(i) + "\t" + std::to_string(i) + ".5\n";
+    }
+    txt += "oops\tnope\textra\n";
+    xsv_reader r(txt, '\t');
+    xsv_batch_reader br(r, false, 10);
+    ASSERT_EQ(2u, br.get_column_count());
+    EXPECT_TRUE(br.get_column_names().empty());
+
+    xsv_batch batch;
+    int64_t sum = 0;
+    size_t rows = 0, rejected = 0;
+    while (size_t n = br.next_batch(batch, 64)) {
+        for (size_t i = 0; i < n; ++i) {
+            sum += batch.columns[0].ints[i];
+        }
+        rows += n;
+        rejected += batch.columns[0].rejected + batch.columns[1].rejected;
+        EXPECT_EQ(2u, batch.columns.size());
+    }
+    EXPECT_EQ(1001u, rows);
+    EXPECT_EQ(999 * 1000 / 2, sum);
+    EXPECT_EQ(2u, rejected);
+}
+
+TEST(xsv_batch_test, works_with_parallel_reader) {
+    std::string txt;
+    for (int i = 0; i < 200000; ++i) {
+        txt += std::to_string(i % 7) + ",x\n";
+    }
+    parallel_xsv_reader r(txt.data(), txt.data() + txt.size(), ',', 4);
+    xsv_batch_reader br(r);
+    xsv_batch batch;
+    int64_t sum = 0;
+    while (size_t n = br.next_batch(batch, 4096)) {
+        for (size_t i = 0; i < n; ++i) {
+            sum += batch.columns[0].ints[i];
+        }
+    }
+    int64_t expected = 0;
+    for (int i = 0; i < 200000; ++i) {
+        expected += i % 7;
+    }
+    EXPECT_EQ(expected, sum);
+}
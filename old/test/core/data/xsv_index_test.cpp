@@ -0,0 +1,128 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "core/data/xsv.h"
+#include "core/data/xsv_index.h"
+#include "core/io/ioutil.h"
+
+#include "gtest/gtest.h"
+
+using namespace intent::core::data;
+using namespace intent::core::io;
+using intent::core::filesystem::path;
+
+static path write_temp(std::string const & content) {
+    easy_temp_c_file f;
+    fwrite(content.data(), 1, content.size(), f);
+    return f.path;
+}
+
+// Records with quoted line breaks and mixed line endings; the first field of
+// each is its record number.
+static std::string make_rows(int count) {
+    std::string txt;
+    for (int i = 0; i < count; ++i) {
+        txt += std::to_string(i);
+        txt += (i % 5 == 0) ? ",\"multi\nline, \"\"quoted\"\"\"" : ",plain";
+        txt += (i % 3 == 0) ? "\r\n" : "\n";
+    }
+    return txt;
+}
+
+TEST(xsv_index_test, seeks_to_any_record) {
+    path tmp = write_temp(make_rows(300000));
+    file_delete_on_exit fdoe(tmp);
+    file_delete_on_exit fdoe_sidecar(xsv_index::get_sidecar_path(tmp));
+
+    xsv_index idx(tmp, ',', 100, 4);
+    EXPECT_FALSE(idx.was_loaded());
+    ASSERT_EQ(300000u, idx.get_record_count());
+    EXPECT_EQ(0u, idx.get_record_offset(0));
+
+    xsv_reader mapped(tmp, ',');
+    xsv_reader buffered(tmp, ',', xsv_file_access::buffered);
+    for (uint64_t n : { 0ull, 1ull, 99ull, 100ull, 101ull, 123457ull, 299999ull }) {
+        idx.seek(mapped, n);
+        ASSERT_TRUE(mapped.next_record());
+        EXPECT_EQ(std::to_string(n), mapped.get_field_by_index(0));
+        idx.seek(buffered, n);
+        ASSERT_TRUE(buffered.next_record());
+        EXPECT_EQ(std::to_string(n), buffered.get_field_by_index(0));
+    }
+    idx.seek(mapped, 300000);
+    EXPECT_FALSE(mapped.next_record());
+}
+
+TEST(xsv_index_test, sidecar_reused_until_file_changes) {
+    path tmp = write_temp(make_rows(1000));
+    file_delete_on_exit fdoe(tmp);
+    file_delete_on_exit fdoe_sidecar(xsv_index::get_sidecar_path(tmp));
+    {
+        xsv_index idx(tmp, ',');
+        EXPECT_FALSE(idx.was_loaded());
+    }
+    {
+        xsv_index idx(tmp, ',');
+        EXPECT_TRUE(idx.was_loaded());
+        EXPECT_EQ(1000u, idx.get_record_count());
+    }
+    {
+        // A different delimiter needs a different index.
+        xsv_index idx(tmp, '\t');
+        EXPECT_FALSE(idx.was_loaded());
+    }
+    {
+        c_file f(tmp, "a");
+        fputs("1000,appended", f);
+    }
+    xsv_index idx(tmp, ',');
+    EXPECT_FALSE(idx.was_loaded());
+    EXPECT_EQ(1001u, idx.get_record_count());
+}
+
+TEST(xsv_index_test, empty_file) {
+    path tmp = write_temp("");
+    file_delete_on_exit fdoe(tmp);
+    file_delete_on_exit fdoe_sidecar(xsv_index::get_sidecar_path(tmp));
+    xsv_index idx(tmp, ',');
+    EXPECT_EQ(0u, idx.get_record_count());
+    EXPECT_EQ(0u, idx.get_record_offset(0));
+}
+
+// Overwrite 8 bytes of a sidecar, in place.
+static void patch_sidecar(path const & sidecar, long where, uint64_t value) {
+    c_file f(sidecar, "r+b");
+    fseek(f, where, SEEK_SET);
+    fwrite(&value, sizeof(value), 1, f);
+}
+
+TEST(xsv_index_test, damaged_sidecar_is_rebuilt) {
+    path tmp = write_temp(make_rows(1000));
+    file_delete_on_exit fdoe(tmp);
+    auto sidecar = xsv_index::get_sidecar_path(tmp);
+    file_delete_on_exit fdoe_sidecar(sidecar);
+    xsv_reader reader(tmp, ',');
+    // The header is 56 bytes; the sample count is at 40. Each sample is a
+    // record number and an offset.
+    long const sample_count_at = 40, first_sample_at = 56;
+    struct damage { long where; uint64_t value; };
+    for (auto d : { damage{sample_count_at, 0}, // no samples at all
+            damage{first_sample_at, 5}, // doesn't start at record 0
+            damage{first_sample_at + 16, 0}, // records don't climb
+            damage{first_sample_at + 24, 0}, // offsets don't climb
+            damage{first_sample_at + 8, 1u << 30} }) { // past the end
+        {
+            xsv_index idx(tmp, ',', 10);
+        }
+        patch_sidecar(sidecar, d.where, d.value);
+        xsv_index idx(tmp, ',', 10);
+        EXPECT_FALSE(idx.was_loaded()) << d.where;
+        ASSERT_EQ(1000u, idx.get_record_count());
+        for (uint64_t n : { 0ull, 15ull, 999ull }) {
+            idx.seek(reader, n);
+            ASSERT_TRUE(reader.next_record());
+            EXPECT_EQ(std::to_string(n), reader.get_field_by_index(0));
+        }
+    }
+}
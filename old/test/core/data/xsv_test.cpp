@@ -0,0 +1,209 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "core/data/xsv.h"
+#include "core/io/buffered_writer.h"
+#include "core/io/ioutil.h"
+
+#include "gtest/gtest.h"
+
+using namespace intent::core::data;
+using namespace intent::core::io;
+using intent::core::filesystem::path;
+using intent::core::text::str_view;
+
+static std::string field(xsv_reader const & r, size_t i) {
+    str_view v = r.get_field(i);
+    return std::string(v.begin, v.length);
+}
+
+static path write_temp(std::string const & content) {
+    easy_temp_c_file f;
+    fwrite(content.data(), 1, content.size(), f);
+    return f.path;
+}
+
+TEST(xsv_test, in_place_string) {
+    std::string txt = "a,bb,\"c,\"\"d\"\"\"\r\n\nlast,one";
+    xsv_reader r(txt, ',');
+    ASSERT_TRUE(r.next_record());
+    ASSERT_EQ(3u, r.get_field_count());
+    EXPECT_STREQ("a", r.get_field_by_index(0));
+    EXPECT_STREQ("bb", r.get_field_by_index(1));
+    EXPECT_STREQ("c,\"d\"", r.get_field_by_index(2));
+    EXPECT_EQ(nullptr, r.get_field_by_index(3));
+    ASSERT_TRUE(r.next_record());
+    ASSERT_EQ(1u, r.get_field_count());
+    EXPECT_STREQ("", r.get_field_by_index(0));
+    ASSERT_TRUE(r.next_record());
+    ASSERT_EQ(2u, r.get_field_count());
+    EXPECT_EQ("one", field(r, 1));
+    EXPECT_FALSE(r.next_record());
+}
+
+TEST(xsv_test, quotes_span_blocks_and_lines) {
+    // Put a quoted line break and delimiters across a 64-byte block boundary.
+    std::string quoted(100, 'x');
+    quoted[60] = '\n';
+    quoted[63] = '\t';
+    quoted[64] = '\r';
+    std::string txt = "1\t\"" + quoted + "\"\t3\n4\t5\t6\n";
+    xsv_reader r(txt, '\t');
+    ASSERT_TRUE(r.next_record());
+    ASSERT_EQ(3u, r.get_field_count());
+    EXPECT_EQ(quoted, field(r, 1));
+    EXPECT_EQ("3", field(r, 2));
+    ASSERT_TRUE(r.next_record());
+    EXPECT_EQ("6", field(r, 2));
+    EXPECT_FALSE(r.next_record());
+}
+
+TEST(xsv_test, mapped_and_buffered_agree) {
+    std::string content;
+    for (int i = 0; i < 5000; ++i) {
+        content += std::to_string(i) + ",\"q" + std::to_string(i * 7) + "\"\"\",tail\r\n";
+    }
+    path tmp = write_temp(content);
+    file_delete_on_exit fdoe(tmp);
+
+    xsv_reader mapped(tmp, ',', xsv_file_access::memory_mapped);
+    xsv_reader buffered(tmp, ',', xsv_file_access::buffered);
+    int n = 0;
+    while (mapped.next_record()) {
+        ASSERT_TRUE(buffered.next_record());
+        ASSERT_EQ(3u, mapped.get_field_count());
+        ASSERT_EQ(3u, buffered.get_field_count());
+        EXPECT_EQ(std::to_string(n), field(mapped, 0));
+        EXPECT_EQ("q" + std::to_string(n * 7) + "\"", field(mapped, 1));
+        EXPECT_STREQ(buffered.get_field_by_index(1), mapped.get_field_by_index(1));
+        EXPECT_STREQ("tail", buffered.get_field_by_index(2));
+        ++n;
+    }
+    EXPECT_FALSE(buffered.next_record());
+    EXPECT_EQ(5000, n);
+}
+
+TEST(xsv_test, mapped_fields_are_views) {
+    path tmp = write_temp("abc|de\n");
+    file_delete_on_exit fdoe(tmp);
+    xsv_reader r(tmp, '|');
+    ASSERT_TRUE(r.next_record());
+    str_view a = r.get_field(0);
+    str_view b = r.get_field(1);
+    EXPECT_EQ(3u, a.length);
+    EXPECT_EQ(a.begin + 4, b.begin);
+    EXPECT_TRUE(r.get_field(2).is_null());
+    EXPECT_FALSE(r.next_record());
+}
+
+TEST(xsv_test, empty_file) {
+    path tmp = write_temp("");
+    file_delete_on_exit fdoe(tmp);
+    xsv_reader mapped(tmp, ',');
+    EXPECT_FALSE(mapped.next_record());
+    xsv_reader buffered(tmp, ',', xsv_file_access::buffered);
+    EXPECT_FALSE(buffered.next_record());
+}
+
+TEST(xsv_test, missing_file_throws) {
+    path tmp = easy_temp_file_path();
+    EXPECT_THROW(xsv_reader(tmp, ','), std::runtime_error);
+    EXPECT_THROW(xsv_reader(tmp, ',', xsv_file_access::buffered), std::runtime_error);
+}
+
+TEST(xsv_test, oversized_record_throws) {
+    std::string txt(2 * 1024 * 1024, 'x');
+    xsv_reader r(txt, ',');
+    EXPECT_THROW(r.next_record(), std::runtime_error);
+}
+
+TEST(xsv_test, writer_quotes_only_when_needed) {
+    std::string out;
+    {
+        xsv_writer w(out, ',');
+        w.write_field("plain");
+        w.write_field("has,comma");
+        w.write_field("say \"hi\"");
+        w.write_empty_field();
+        w.write_field(int64_t(-42));
+        w.write_field(uint64_t(18446744073709551615ull));
+        w.write_field(2.5);
+        w.end_record();
+        w.write_field(std::string(100, 'x') + "\n" + std::string(100, 'y'));
+        w.end_record();
+    }
+    std::string long_field = std::string(100, 'x') + "\n" + std::string(100, 'y');
+    EXPECT_EQ("plain,\"has,comma\",\"say \"\"hi\"\"\",,-42,18446744073709551615,2.5\n\""
+            + long_field + "\"\n", out);
+
+    xsv_reader r(out, ',');
+    ASSERT_TRUE(r.next_record());
+    ASSERT_EQ(7u, r.get_field_count());
+    EXPECT_STREQ("say \"hi\"", r.get_field_by_index(2));
+    ASSERT_TRUE(r.next_record());
+    EXPECT_EQ(long_field, field(r, 0));
+    EXPECT_FALSE(r.next_record());
+}
+
+TEST(xsv_test, writer_takes_every_integer_type) {
+    std::string out;
+    {
+        xsv_writer w(out, ',');
+        w.write_field(short(-1));
+        w.write_field(-2);
+        w.write_field(3u);
+        w.write_field(-4l);
+        w.write_field(5ul);
+        w.write_field(-6ll);
+        w.write_field(7ull);
+        w.write_field(size_t(8));
+        w.write_field(int64_t(-9));
+        w.write_field(uint64_t(10));
+        w.end_record();
+    }
+    EXPECT_EQ("-1,-2,3,-4,5,-6,7,8,-9,10\n", out);
+}
+
+TEST(xsv_test, writer_round_trips_through_file) {
+    path tmp = easy_temp_file_path();
+    file_delete_on_exit fdoe(tmp);
+    {
+        xsv_writer w(c_file(tmp, "w"), '\t');
+        for (int i = 0; i < 100000; ++i) {
+            w.write_field(i);
+            w.write_field(i * 0.25);
+            w.write_field(i % 3 ? "a\tb" : "c");
+            w.end_record();
+        }
+        w.flush();
+    }
+    xsv_reader r(tmp, '\t');
+    int n = 0;
+    while (r.next_record()) {
+        ASSERT_EQ(std::to_string(n), r.get_field_by_index(0));
+        ASSERT_EQ(n * 0.25, strtod(r.get_field_by_index(1), nullptr));
+        ASSERT_STREQ(n % 3 ? "a\tb" : "c", r.get_field_by_index(2));
+        ++n;
+    }
+    EXPECT_EQ(100000, n);
+}
+
+TEST(xsv_test, writer_shares_buffered_writer) {
+    path tmp = easy_temp_file_path();
+    file_delete_on_exit fdoe(tmp);
+    {
+        buffered_writer out(tmp, 4096, true);
+        out.write("# generated\n", 12);
+        xsv_writer w(out, ',');
+        for (int i = 0; i < 10000; ++i) {
+            w.write_field(i);
+            w.write_field("x,y");
+            w.end_record();
+        }
+        w.flush();
+    }
+    auto txt = read_text_file(tmp, 1024 * 1024);
+    ASSERT_EQ(0u, txt.find("# generated\n0,\"x,y\"\n1,\"x,y\"\n"));
+    ASSERT_NE(std::string::npos, txt.find("\n9999,\"x,y\"\n"));
+}
@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <atomic>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "core/dev/trace.h"
+
+#include "gtest/gtest.h"
+
+using namespace intent::core::dev;
+
+namespace {
+
+constexpr trace_point fetched = {"test.fetched", "{1} bytes in {2} ms", trace_level::info};
+constexpr trace_point chatter = {"test.chatter", "", trace_level::debug};
+constexpr trace_point tick = {"test.tick", "{1}", trace_level::warn};
+
+std::vector<trace_record> records_of(trace_point const & point) {
+    std::vector<trace_record> found;
+    for (auto & rec : tracer::snapshot()) {
+        if (rec.point == &point) {
+            found.push_back(rec);
+        }
+    }
+    return found;
+}
+
+// Put the level back the way it was.
+struct level_guard {
+    trace_level saved;
+    level_guard() : saved(tracer::get_level()) {}
+    ~level_guard() { tracer::set_level(saved); }
+};
+
+int evaluated(int & count) {
+    return ++count;
+}
+
+} // end anonymous namespace
+
+TEST(trace_test, records_and_formats) {
+    tracer::clear();
+    trace_event(fetched, 7, 512, 3);
+    auto found = records_of(fetched);
+    ASSERT_EQ(1u, found.size());
+    ASSERT_EQ(7u, found[0].subject);
+    ASSERT_EQ("test.fetched #7: 512 bytes in 3 ms", found[0].to_string());
+    std::ostringstream out;
+    tracer::dump(out);
+    ASSERT_NE(std::string::npos, out.str().find("test.fetched #7: 512 bytes in 3 ms\n"));
+}
+
+TEST(trace_test, level_filters_and_skips_args) {
+    level_guard guard;
+    tracer::clear();
+    int count = 0;
+    tracer::set_level(trace_level::info);
+    trace_event(chatter, 1, evaluated(count));
+    ASSERT_EQ(0, count);
+    ASSERT_TRUE(records_of(chatter).empty());
+    tracer::set_level(trace_level::debug);
+    trace_event(chatter, 1, evaluated(count));
+    ASSERT_EQ(1, count);
+    ASSERT_EQ(1u, records_of(chatter).size());
+    tracer::set_level(trace_level::off);
+    trace_event(tick, 1, 1);
+    ASSERT_TRUE(records_of(tick).empty());
+}
+
+TEST(trace_test, ring_keeps_latest) {
+    tracer::clear();
+    for (unsigned i = 0; i < tracer::ring_size * 2 + 5; ++i) {
+        trace_event(tick, 0, i);
+    }
+    auto found = records_of(tick);
+    ASSERT_EQ(tracer::ring_size, found.size());
+    ASSERT_EQ(tracer::ring_size + 5, found.front().args[0]);
+    ASSERT_EQ(tracer::ring_size * 2 + 4, found.back().args[0]);
+    tracer::clear();
+    ASSERT_TRUE(records_of(tick).empty());
+}
+
+TEST(trace_test, threads_record_while_others_read) {
+    tracer::clear();
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> writers;
+    for (uint32_t t = 1; t <= 4; ++t) {
+        writers.emplace_back([t, &stop] {
+            uint64_t i = 0;
+            while (!stop.load()) {
+                trace_event(tick, t, i++);
+            }
+            trace_event(fetched, t, i, 0);
+        });
+    }
+    for (int i = 0; i < 20; ++i) {
+        for (auto & rec : tracer::snapshot()) {
+            ASSERT_TRUE(rec.point == &tick || rec.point == &fetched);
+        }
+    }
+    stop = true;
+    for (auto & w : writers) {
+        w.join();
+    }
+    // Rings outlive their threads.
+    auto found = records_of(fetched);
+    ASSERT_EQ(4u, found.size());
+    std::vector<uint32_t> threads;
+    for (auto & rec : found) {
+        threads.push_back(rec.thread);
+    }
+    std::sort(threads.begin(), threads.end());
+    ASSERT_EQ(threads.end(), std::unique(threads.begin(), threads.end()));
+}
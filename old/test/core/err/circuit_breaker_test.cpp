@@ -1,4 +1,7 @@
+#include <chrono>
+
 #include "core/err/circuit_breaker.h"
+#include "core/time/assignable_clock.h"
 
 #include "gtest/gtest.h"
 
@@ -30,3 +33,89 @@ TEST(circuit_breaker_test, simple) {
         cb.update(result);
     }
 }
+
+using intent::core::time::assignable_clock;
+
+namespace {
+
+circuit_breaker::config quick_config() {
+    circuit_breaker::config cfg;
+    cfg.window_millisecs = 1000;
+    cfg.window_slices = 10;
+    cfg.failure_ratio = 0.5;
+    cfg.min_calls = 4;
+    cfg.open_millisecs = 200;
+    cfg.retest_calls = 2;
+    return cfg;
+}
+
+} // end anonymous namespace
+
+TEST(circuit_breaker_test, trips_on_failure_ratio) {
+    assignable_clock::session fake_time;
+    circuit_breaker cb(quick_config());
+    // Too few calls to judge.
+    cb.update(false);
+    cb.update(false);
+    ASSERT_EQ(circuit_breaker::state::closed, cb.get_state());
+    cb.update(true);
+    cb.update(true);
+    cb.update(true);
+    ASSERT_EQ(circuit_breaker::state::closed, cb.get_state());
+    // 3 of 6 failed.
+    ASSERT_EQ(circuit_breaker::state::open, cb.update(false));
+    ASSERT_FALSE(cb.allow());
+}
+
+TEST(circuit_breaker_test, old_failures_expire) {
+    assignable_clock::session fake_time;
+    circuit_breaker cb(quick_config());
+    for (int i = 0; i < 3; ++i) {
+        cb.update(false);
+    }
+    assignable_clock::elapse(std::chrono::milliseconds(1500));
+    for (int i = 0; i < 3; ++i) {
+        cb.update(true);
+    }
+    ASSERT_EQ(circuit_breaker::state::closed, cb.update(false));
+}
+
+TEST(circuit_breaker_test, retest_closes_or_reopens) {
+    assignable_clock::session fake_time;
+    circuit_breaker cb(quick_config(), circuit_breaker::state::open);
+    ASSERT_FALSE(cb.allow());
+    assignable_clock::elapse(std::chrono::milliseconds(250));
+    ASSERT_EQ(circuit_breaker::state::needs_retest, cb.get_state());
+
+    // Only two callers get to test the circuit.
+    ASSERT_TRUE(cb.allow());
+    ASSERT_TRUE(cb.allow());
+    ASSERT_FALSE(cb.allow());
+    ASSERT_EQ(circuit_breaker::state::needs_retest, cb.update(true));
+    ASSERT_EQ(circuit_breaker::state::closed, cb.update(true));
+    ASSERT_TRUE(cb.allow());
+
+    cb.trip();
+    assignable_clock::elapse(std::chrono::milliseconds(250));
+    ASSERT_TRUE(cb.allow());
+    ASSERT_EQ(circuit_breaker::state::open, cb.update(false));
+    ASSERT_FALSE(cb.allow());
+
+    // Testers that never report back don't hold the circuit open forever.
+    assignable_clock::elapse(std::chrono::milliseconds(250));
+    ASSERT_TRUE(cb.allow());
+    ASSERT_TRUE(cb.allow());
+    ASSERT_FALSE(cb.allow());
+    assignable_clock::elapse(std::chrono::milliseconds(250));
+    ASSERT_TRUE(cb.allow());
+}
+
+TEST(circuit_breaker_test, choose_path_when_open) {
+    circuit_breaker cb(circuit_breaker::state::open);
+    unsigned call_count = 0;
+    unsigned normal_count = 0;
+    auto func = cb.choose_path(normal_path, fallback_path);
+    func(call_count, normal_count);
+    ASSERT_EQ(1u, call_count);
+    ASSERT_EQ(0u, normal_count);
+}
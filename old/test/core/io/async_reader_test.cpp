@@ -0,0 +1,185 @@
+#include <cerrno>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "core/io/async_reader.h"
+#include "core/io/ioutil.h"
+#include "core/work/progress_tracker.h"
+
+#include "gtest/gtest.h"
+
+using std::string;
+using std::vector;
+
+using namespace intent::core::io;
+using namespace intent::core::filesystem;
+using intent::core::work::progress_tracker;
+using intent::core::work::work_type;
+
+namespace {
+
+struct temp_files {
+    vector<path> paths;
+    vector<string> contents;
+
+    explicit temp_files(size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            string content;
+            for (size_t j = 0; j < i * 37 % 5000; ++j) {
+                content += static_cast<char>('a' + (i + j) % 26);
+            }
+            path p = easy_temp_file_path();
+            c_file f(p, "wb");
+            fwrite(content.data(), 1, content.size(), f);
+            paths.push_back(p);
+            contents.push_back(content);
+        }
+    }
+
+    ~temp_files() {
+        for (auto const & p : paths) {
+            boost::system::error_code ignored;
+            remove(p, ignored);
+        }
+    }
+};
+
+bool have_uring() {
+    try {
+        async_reader reader(8, read_engine::io_uring);
+        return true;
+    } catch (std::runtime_error const &) {
+        return false;
+    }
+}
+
+void read_many(read_engine engine) {
+    temp_files files(300);
+    progress_tracker progress("read");
+    // A small queue, so most reads wait in the backlog.
+    async_reader reader(16, engine, &progress);
+    ASSERT_NE(read_engine::automatic, reader.get_engine());
+    size_t total = 0;
+    for (size_t i = 0; i < files.paths.size(); ++i) {
+        reader.submit(files.paths[i], i);
+        total += files.contents[i].size();
+    }
+    reader.submit("/no/such/file", 9999);
+    ASSERT_EQ(301u, reader.get_pending_count());
+
+    std::map<uint64_t, string> got;
+    vector<read_completion> batch;
+    while (reader.get_pending_count()) {
+        batch.clear();
+        ASSERT_LT(0u, reader.wait(batch, 10, 50));
+        ASSERT_GE(50u, batch.size());
+        for (auto & c : batch) {
+            if (c.tag == 9999) {
+                ASSERT_EQ(ENOENT, c.error);
+            } else {
+                ASSERT_EQ(0, c.error);
+                ASSERT_EQ(0, *c.buffer.end());
+                got[c.tag] = string(c.buffer.begin(), c.buffer.size());
+            }
+        }
+    }
+    ASSERT_EQ(files.paths.size(), got.size());
+    for (size_t i = 0; i < files.paths.size(); ++i) {
+        ASSERT_EQ(files.contents[i], got[i]);
+    }
+    ASSERT_EQ(static_cast<double>(total), progress.get_expected_work(work_type::read_bytes));
+    ASSERT_EQ(static_cast<double>(total), progress.get_completed_work(work_type::read_bytes));
+    batch.clear();
+    ASSERT_EQ(0u, reader.wait(batch));
+}
+
+void read_ranges(read_engine engine) {
+    temp_files files(101);
+    path const & p = files.paths[100];
+    string const & content = files.contents[100];
+    ASSERT_LT(1000u, content.size());
+    async_reader reader(4, engine);
+    reader.submit(p, 1, 100, 50);
+    reader.submit(p, 2, content.size() - 10, 50);
+    reader.submit(p, 3, content.size() + 10, 50);
+    reader.submit(p, 4, 7);
+    vector<read_completion> batch;
+    reader.wait(batch, 4);
+    ASSERT_EQ(4u, batch.size());
+    for (auto & c : batch) {
+        ASSERT_EQ(0, c.error);
+        string s(c.buffer.begin(), c.buffer.size());
+        switch (c.tag) {
+        case 1: ASSERT_EQ(content.substr(100, 50), s); break;
+        case 2: ASSERT_EQ(content.substr(content.size() - 10), s); break;
+        case 3: ASSERT_EQ("", s); break;
+        case 4: ASSERT_EQ(content.substr(7), s); break;
+        default: FAIL();
+        }
+    }
+}
+
+} // end anonymous namespace
+
+TEST(async_reader_test, thread_pool_reads_many) {
+    read_many(read_engine::thread_pool);
+}
+
+TEST(async_reader_test, io_uring_reads_many) {
+    if (have_uring()) {
+        read_many(read_engine::io_uring);
+    }
+}
+
+TEST(async_reader_test, thread_pool_reads_ranges) {
+    read_ranges(read_engine::thread_pool);
+}
+
+TEST(async_reader_test, io_uring_reads_ranges) {
+    if (have_uring()) {
+        read_ranges(read_engine::io_uring);
+    }
+}
+
+TEST(async_reader_test, automatic_picks_an_engine) {
+    async_reader reader;
+    ASSERT_NE(read_engine::automatic, reader.get_engine());
+}
+
+TEST(async_reader_test, buffers_outlive_reader) {
+    temp_files files(20);
+    vector<read_completion> batch;
+    {
+        async_reader reader;
+        reader.submit(files.paths[19], 0);
+        reader.wait(batch);
+    }
+    ASSERT_EQ(files.contents[19], string(batch[0].buffer.begin(), batch[0].buffer.size()));
+    ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(batch[0].buffer.begin()) % 4096);
+}
+
+TEST(async_reader_test, stop_cancels_unstarted_reads) {
+    temp_files files(10);
+    progress_tracker progress("read");
+    progress.request_stop();
+    async_reader reader(2, read_engine::automatic, &progress);
+    for (size_t i = 0; i < files.paths.size(); ++i) {
+        reader.submit(files.paths[i], i);
+    }
+    vector<read_completion> batch;
+    reader.wait(batch, 10);
+    ASSERT_EQ(10u, batch.size());
+    for (auto & c : batch) {
+        ASSERT_EQ(ECANCELED, c.error);
+    }
+}
+
+TEST(async_reader_test, destroy_with_reads_pending) {
+    temp_files files(50);
+    async_reader reader(8);
+    for (size_t i = 0; i < files.paths.size(); ++i) {
+        reader.submit(files.paths[i], i);
+    }
+}
@@ -0,0 +1,142 @@
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "core/io/buffered_writer.h"
+#include "core/io/ioutil.h"
+
+#include "gtest/gtest.h"
+
+using std::string;
+
+using namespace intent::core::io;
+using namespace intent::core::filesystem;
+using intent::core::text::str_view;
+
+namespace {
+
+string expected_lines(int count) {
+    string txt;
+    for (int i = 0; i < count; ++i) {
+        txt += "line " + std::to_string(i) + "\n";
+    }
+    return txt;
+}
+
+void write_lines(buffered_writer & w, int count) {
+    for (int i = 0; i < count; ++i) {
+        w.write(str_view("line "));
+        auto n = std::to_string(i);
+        w.write(n.data(), n.size());
+        w.put('\n');
+    }
+}
+
+void check_many_small_writes(bool background) {
+    path tmp = easy_temp_file_path();
+    file_delete_on_exit fdoe(tmp);
+    {
+        buffered_writer w(tmp, 1000, background);
+        write_lines(w, 20000);
+        EXPECT_EQ(expected_lines(20000).size(), w.get_byte_count());
+    }
+    EXPECT_EQ(expected_lines(20000), read_text_file(tmp, 10 * 1024 * 1024));
+}
+
+} // end anonymous namespace
+
+TEST(buffered_writer_test, many_small_writes) {
+    check_many_small_writes(false);
+}
+
+TEST(buffered_writer_test, many_small_writes_background) {
+    check_many_small_writes(true);
+}
+
+TEST(buffered_writer_test, writev_keeps_order) {
+    path tmp = easy_temp_file_path();
+    file_delete_on_exit fdoe(tmp);
+    string big(5000, 'b');
+    {
+        buffered_writer w(tmp, 1024, true);
+        w.write("start:", 6);
+        str_view small[] = {str_view("<"), str_view(""), str_view(">")};
+        w.writev(small, 3);
+        // Bigger than the buffer, so it goes straight out behind "start:<>".
+        str_view fragments[] = {str_view("["), str_view(big.c_str()), str_view("]")};
+        w.writev(fragments, 3);
+        w.write(":end", 4);
+        w.flush();
+        EXPECT_EQ("start:<>[" + big + "]:end", read_text_file(tmp, 1024 * 1024));
+    }
+}
+
+TEST(buffered_writer_test, reserve_and_commit) {
+    path tmp = easy_temp_file_path();
+    file_delete_on_exit fdoe(tmp);
+    {
+        buffered_writer w(tmp, 16);
+        for (int i = 0; i < 10; ++i) {
+            char * p = w.reserve(10);
+            int n = snprintf(p, 10, "%d,", i * 11);
+            w.commit(static_cast<size_t>(n));
+        }
+    }
+    EXPECT_EQ("0,11,22,33,44,55,66,77,88,99,", read_text_file(tmp));
+}
+
+TEST(buffered_writer_test, nothing_reaches_fd_until_flush) {
+    path tmp = easy_temp_file_path();
+    file_delete_on_exit fdoe(tmp);
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_LE(0, fd);
+    {
+        buffered_writer w(fd);
+        w.write("abc", 3);
+        EXPECT_EQ("", read_text_file(tmp));
+        w.flush();
+        EXPECT_EQ("abc", read_text_file(tmp));
+    }
+    close(fd);
+}
+
+TEST(buffered_writer_test, c_file_is_flushed_first) {
+    path tmp = easy_temp_file_path();
+    file_delete_on_exit fdoe(tmp);
+    {
+        c_file f(tmp, "w");
+        fputs("from stdio;", f);
+        buffered_writer w(std::move(f));
+        w.write(str_view("from writer"));
+    }
+    EXPECT_EQ("from stdio;from writer", read_text_file(tmp));
+}
+
+TEST(buffered_writer_test, write_errors_throw) {
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    close(fds[0]);
+    signal(SIGPIPE, SIG_IGN);
+    buffered_writer w(fds[1], 16);
+    w.write("0123456789", 10);
+    EXPECT_THROW(w.flush(), std::runtime_error);
+    close(fds[1]);
+}
+
+TEST(buffered_writer_test, ostream) {
+    path tmp = easy_temp_file_path();
+    file_delete_on_exit fdoe(tmp);
+    {
+        buffered_writer w(tmp);
+        buffered_ostream os(w);
+        os << "pi=" << 3.5 << ' ' << 42 << std::endl;
+        EXPECT_EQ("pi=3.5 42\n", read_text_file(tmp));
+        os << "more";
+    }
+    EXPECT_EQ("pi=3.5 42\nmore", read_text_file(tmp));
+}
@@ -0,0 +1,72 @@
+#include <stdexcept>
+#include <string>
+
+#include <zlib.h>
+
+#include "core/io/gzip.h"
+
+#include "gtest/gtest.h"
+
+using std::string;
+
+using namespace intent::core::io;
+
+namespace {
+
+string gunzip(string const & packed) {
+    z_stream z = {};
+    EXPECT_EQ(Z_OK, inflateInit2(&z, 15 + 16));
+    z.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(packed.data()));
+    z.avail_in = static_cast<uInt>(packed.size());
+    string out;
+    char buf[4096];
+    int result;
+    do {
+        z.next_out = reinterpret_cast<Bytef *>(buf);
+        z.avail_out = sizeof(buf);
+        result = inflate(&z, Z_NO_FLUSH);
+        out.append(buf, sizeof(buf) - z.avail_out);
+    } while (result == Z_OK);
+    EXPECT_EQ(Z_STREAM_END, result);
+    inflateEnd(&z);
+    return out;
+}
+
+string json_like(int count) {
+    string txt = "[";
+    for (int i = 0; i < count; ++i) {
+        txt += "{\"id\": " + std::to_string(i) + ", \"name\": \"item\", \"ok\": true},";
+    }
+    txt.back() = ']';
+    return txt;
+}
+
+} // end anonymous namespace
+
+TEST(gzip_test, round_trips) {
+    auto txt = json_like(1000);
+    auto packed = gzip(txt);
+    ASSERT_LT(packed.size() * 5, txt.size());
+    ASSERT_EQ(txt, gunzip(packed));
+}
+
+TEST(gzip_test, empty_input) {
+    auto packed = gzip("");
+    ASSERT_FALSE(packed.empty());
+    ASSERT_EQ("", gunzip(packed));
+}
+
+TEST(gzip_test, streams_in_pieces) {
+    auto txt = json_like(5000);
+    gzip_encoder gz;
+    string out;
+    for (size_t i = 0; i < txt.size(); i += 777) {
+        gz.write(txt.data() + i, std::min<size_t>(777, txt.size() - i), out);
+    }
+    ASSERT_FALSE(gz.is_finished());
+    gz.finish(out);
+    ASSERT_TRUE(gz.is_finished());
+    ASSERT_EQ(txt.size(), gz.get_input_count());
+    ASSERT_EQ(txt, gunzip(out));
+    ASSERT_THROW(gz.write("x", 1, out), std::runtime_error);
+}
@@ -0,0 +1,117 @@
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "core/io/ioutil.h"
+#include "core/io/mapped_file.h"
+
+#include "gtest/gtest.h"
+
+using namespace intent::core::io;
+using namespace intent::core::filesystem;
+
+namespace {
+
+void write_file(path const & fpath, std::string const & content) {
+    c_file f(fpath, "wb");
+    fwrite(content.data(), 1, content.size(), f);
+}
+
+std::string read_file(path const & fpath) {
+    std::string content;
+    c_file f(fpath, "rb");
+    char buf[256];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        content.append(buf, n);
+    }
+    return content;
+}
+
+} // end anonymous namespace
+
+TEST(mapped_file_test, read_only) {
+    path tmp = easy_temp_file_path();
+    file_delete_on_exit fdoe(tmp);
+    write_file(tmp, "hello, mapping");
+    mapped_file mf(tmp);
+    ASSERT_EQ(14u, mf.size());
+    ASSERT_FALSE(mf.is_writable());
+    ASSERT_EQ(0, memcmp(mf.begin(), "hello, mapping", 14));
+    ASSERT_EQ(mf.begin() + 14, mf.end());
+    auto txt = mf.get_text();
+    ASSERT_EQ("hello, mapping", std::string(txt.begin, txt.length));
+}
+
+TEST(mapped_file_test, empty_file) {
+    path tmp = easy_temp_file_path();
+    file_delete_on_exit fdoe(tmp);
+    write_file(tmp, "");
+    mapped_file mf(tmp, mapped_file::access::read_only, map_hints::sequential);
+    ASSERT_EQ(0u, mf.size());
+    ASSERT_EQ(mf.begin(), mf.end());
+    ASSERT_TRUE(mf.get_text().is_empty());
+    ASSERT_TRUE(mf.advise(map_hints::willneed));
+}
+
+TEST(mapped_file_test, missing_file_throws) {
+    path tmp = easy_temp_file_path();
+    ASSERT_THROW(mapped_file mf(tmp), std::runtime_error);
+}
+
+TEST(mapped_file_test, read_write_reaches_file) {
+    path tmp = easy_temp_file_path();
+    file_delete_on_exit fdoe(tmp);
+    write_file(tmp, "abcdef");
+    {
+        mapped_file mf(tmp, mapped_file::access::read_write);
+        ASSERT_TRUE(mf.is_writable());
+        mf.data()[0] = 'X';
+        mf.sync();
+    }
+    ASSERT_EQ("Xbcdef", read_file(tmp));
+}
+
+TEST(mapped_file_test, create_with_size) {
+    path tmp = easy_temp_file_path();
+    file_delete_on_exit fdoe(tmp);
+    {
+        mapped_file mf(tmp, 4096);
+        ASSERT_EQ(4096u, mf.size());
+        ASSERT_EQ(0, mf.begin()[4095]);
+        memcpy(mf.data() + 100, "zz", 2);
+    }
+    auto content = read_file(tmp);
+    ASSERT_EQ(4096u, content.size());
+    ASSERT_EQ("zz", content.substr(100, 2));
+}
+
+TEST(mapped_file_test, hints) {
+    path tmp = easy_temp_file_path();
+    file_delete_on_exit fdoe(tmp);
+    // Big enough to try the huge-page alignment.
+    std::string content(3 * 1024 * 1024, 'q');
+    content[content.size() - 1] = 'e';
+    write_file(tmp, content);
+    mapped_file mf(tmp, mapped_file::access::read_only,
+            map_hints::sequential | map_hints::willneed | map_hints::huge_pages);
+    ASSERT_EQ(content.size(), mf.size());
+    ASSERT_EQ('q', *mf.begin());
+    ASSERT_EQ('e', mf.end()[-1]);
+    ASSERT_TRUE(mf.advise(map_hints::random));
+}
+
+TEST(mapped_file_test, move) {
+    path tmp = easy_temp_file_path();
+    file_delete_on_exit fdoe(tmp);
+    write_file(tmp, "moved");
+    mapped_file a(tmp);
+    char const * p = a.begin();
+    mapped_file b(std::move(a));
+    ASSERT_EQ(p, b.begin());
+    ASSERT_EQ(5u, b.size());
+    ASSERT_EQ(0u, a.size());
+    a = std::move(b);
+    ASSERT_EQ(p, a.begin());
+}
@@ -0,0 +1,169 @@
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "core/net/curl/body_sink.h"
+#include "core/net/curl/channel.h"
+#include "core/net/curl/request.h"
+#include "core/net/curl/response.h"
+#include "core/net/curl/session.h"
+
+#include "helpers/uhttpd.h"
+
+#include "gtest/gtest.h"
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+using namespace intent::core::net::curl;
+
+namespace {
+
+// Note the order in which transfers end.
+struct finish_log {
+    std::mutex mtx;
+    vector<string> names;
+};
+
+class named_sink : public body_sink {
+    finish_log & log;
+    string name;
+public:
+    named_sink(finish_log & l, string const & n) : log(l), name(n) {}
+    virtual sink_result accept(char const *, size_t) { return sink_result::accepted; }
+    virtual void finish(bool) {
+        std::lock_guard<std::mutex> lock(log.mtx);
+        log.names.push_back(name);
+    }
+};
+
+struct transfer {
+    unique_ptr<session> s;
+    unique_ptr<named_sink> sink;
+    response resp;
+
+    transfer(channel & c, string const & url, finish_log & log,
+            string const & name, int priority = 0) :
+            s(new session(c)), sink(new named_sink(log, name)), resp(send(url, priority)) {
+    }
+
+    response send(string const & url, int priority) {
+        auto req = s->reset();
+        req.set_url(url.c_str());
+        req.set_verb("get");
+        req.set_priority(priority);
+        req.set_body_sink(sink.get());
+        return s->send();
+    }
+};
+
+string host_of(uhttpd const & svr) {
+    return "localhost:" + std::to_string(svr.get_port());
+}
+
+} // end anonymous namespace
+
+TEST(admission_test, unlimited_by_default) {
+    channel c;
+    auto stats = c.get_admission_stats();
+    ASSERT_EQ(0u, stats.queued);
+    ASSERT_EQ(0u, stats.in_flight);
+    ASSERT_TRUE(admission_limits().is_unlimited());
+    ASSERT_FALSE(admission_limits(0, 0, 3).is_unlimited());
+}
+
+TEST(admission_test, host_in_flight_cap) {
+    uhttpd svr(false);
+    string url = string(svr.get_base_url()) + "200000.txt";
+    channel c(2);
+    c.set_host_admission_limits(admission_limits(0, 0, 2));
+    finish_log log;
+    vector<unique_ptr<transfer>> transfers;
+    for (int i = 0; i < 10; ++i) {
+        transfers.emplace_back(new transfer(c, url, log, std::to_string(i)));
+    }
+    auto stats = c.get_host_admission_stats(host_of(svr).c_str());
+    ASSERT_GE(2u, stats.in_flight);
+    ASSERT_EQ(10u, stats.queued + stats.admitted);
+    ASSERT_GE(1u, c.get_admission_stats().waiting_hosts);
+    for (auto & t : transfers) {
+        ASSERT_TRUE(t->resp.wait());
+        ASSERT_EQ(200, t->resp.get_status_code());
+        ASSERT_GE(2u, c.get_admission_stats().in_flight);
+    }
+    stats = c.get_admission_stats();
+    ASSERT_EQ(0u, stats.queued);
+    ASSERT_EQ(10u, stats.admitted);
+    ASSERT_LE(8u, stats.delayed);
+}
+
+TEST(admission_test, rate_limit) {
+    uhttpd svr(false);
+    string url = string(svr.get_base_url()) + "100.txt";
+    channel c;
+    // One right away, then one every 50 ms.
+    c.set_admission_limits(admission_limits(20, 1));
+    finish_log log;
+    auto start = std::chrono::steady_clock::now();
+    vector<unique_ptr<transfer>> transfers;
+    for (int i = 0; i < 6; ++i) {
+        transfers.emplace_back(new transfer(c, url, log, std::to_string(i)));
+    }
+    for (auto & t : transfers) {
+        ASSERT_TRUE(t->resp.wait(5000));
+        ASSERT_EQ(200, t->resp.get_status_code());
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    ASSERT_LE(240, std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+}
+
+TEST(admission_test, priority_and_fairness) {
+    uhttpd svr(false);
+    string port = std::to_string(svr.get_port());
+    // Two names for the same server count as two hosts.
+    string a = "http://localhost:" + port + "/";
+    string b = "http://127.0.0.1:" + port + "/";
+    channel c;
+    // Let one transfer through, and hold the rest back while they queue up.
+    c.set_admission_limits(admission_limits(0.001, 1));
+    finish_log log;
+    vector<unique_ptr<transfer>> transfers;
+    transfers.emplace_back(new transfer(c, a + "100.txt", log, "first"));
+    for (int i = 0; i < 4; ++i) {
+        transfers.emplace_back(new transfer(c, a + "100.txt", log, "a" + std::to_string(i)));
+    }
+    transfers.emplace_back(new transfer(c, b + "100.txt", log, "b0"));
+    transfers.emplace_back(new transfer(c, b + "100.txt", log, "b1"));
+    transfers.emplace_back(new transfer(c, a + "100.txt", log, "urgent", 10));
+    ASSERT_EQ(7u, c.get_admission_stats().queued);
+    ASSERT_EQ(2u, c.get_admission_stats().waiting_hosts);
+    // Now run them one at a time.
+    c.set_admission_limits(admission_limits(0, 0, 1));
+    for (auto & t : transfers) {
+        ASSERT_TRUE(t->resp.wait(5000));
+    }
+    vector<string> expected = {"first", "urgent", "b0", "a0", "b1", "a1", "a2", "a3"};
+    ASSERT_EQ(expected, log.names);
+}
+
+TEST(admission_test, close_wakes_queued_transfers) {
+    uhttpd svr(false);
+    string url = string(svr.get_base_url()) + "100.txt";
+    channel c;
+    c.set_admission_limits(admission_limits(0.5, 1));
+    finish_log log;
+    vector<unique_ptr<transfer>> transfers;
+    for (int i = 0; i < 3; ++i) {
+        transfers.emplace_back(new transfer(c, url, log, std::to_string(i)));
+    }
+    ASSERT_EQ(2u, c.get_admission_stats().queued);
+    c.close();
+    ASSERT_EQ(0u, c.get_admission_stats().queued);
+    for (auto & t : transfers) {
+        ASSERT_FALSE(is_busy(t->s->get_state()));
+    }
+    ASSERT_EQ(3u, log.names.size());
+}
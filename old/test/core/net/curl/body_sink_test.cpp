@@ -0,0 +1,226 @@
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "core/io/ioutil.h"
+#include "core/net/curl/body_sink.h"
+#include "core/net/curl/channel.h"
+#include "core/net/curl/json_body_sink.h"
+#include "core/net/curl/request.h"
+#include "core/net/curl/response.h"
+#include "core/net/curl/session.h"
+#include "core/net/curl/xsv_body_sink.h"
+
+#include "helpers/uhttpd.h"
+
+#include "gtest/gtest.h"
+
+using std::string;
+
+using namespace intent::core::net::curl;
+using namespace intent::core::filesystem;
+using intent::core::data::xsv_reader;
+using namespace intent::core::io;
+
+namespace {
+
+// Offer txt to a sink in pieces of n bytes, the way curl would.
+sink_result feed(body_sink & sink, string const & txt, size_t n) {
+    for (size_t i = 0; i < txt.size(); i += n) {
+        auto rc = sink.accept(txt.data() + i, std::min(n, txt.size() - i));
+        if (rc != sink_result::accepted) {
+            return rc;
+        }
+    }
+    return sink_result::accepted;
+}
+
+// What uhttpd serves for N.txt.
+string expected_body(size_t size) {
+    string line(99, ' ');
+    for (size_t i = 0; i < 99; ++i) {
+        line[i] = '0' + i % 10;
+    }
+    line += '\n';
+    string txt;
+    while (txt.size() < size) {
+        txt += line;
+    }
+    txt.resize(size);
+    return txt;
+}
+
+response get(session & s, string const & url, body_sink & sink) {
+    auto req = s.reset();
+    req.set_url(url.c_str());
+    req.set_verb("get");
+    req.set_body_sink(&sink);
+    return s.send();
+}
+
+} // end anonymous namespace
+
+TEST(body_sink_test, buffer_pool_fills_and_pauses) {
+    buffer_pool_body_sink sink;
+    char a[8], b[8];
+    sink.give(a, sizeof(a));
+    sink.give(b, sizeof(b));
+    ASSERT_EQ(sink_result::accepted, sink.accept("0123456789", 10));
+    ASSERT_EQ(sink_result::full, sink.accept("abcdefghij", 10));
+
+    buffer_pool_body_sink::chunk c;
+    ASSERT_TRUE(sink.take(c, 100));
+    ASSERT_EQ(a, c.data);
+    ASSERT_EQ("01234567", string(c.data, c.size));
+    sink.give(c.data, c.capacity);
+    ASSERT_EQ(sink_result::accepted, sink.accept("abcdefghij", 10));
+    sink.finish(true);
+
+    string rest;
+    while (sink.take(c, 100)) {
+        rest.append(c.data, c.size);
+    }
+    ASSERT_EQ("89abcdefghij", rest);
+    ASSERT_TRUE(sink.succeeded());
+}
+
+TEST(body_sink_test, fd_sink) {
+    path tmp = easy_temp_file_path();
+    file_delete_on_exit fdoe(tmp);
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_LE(0, fd);
+    fd_body_sink sink(fd);
+    auto txt = expected_body(100000);
+    ASSERT_EQ(sink_result::accepted, feed(sink, txt, 16384));
+    close(fd);
+    ASSERT_EQ(txt.size(), sink.get_byte_count());
+    ASSERT_EQ(txt, read_text_file(tmp, 1024 * 1024));
+}
+
+TEST(body_sink_test, xsv_records_span_chunks) {
+    std::vector<string> seen;
+    string txt = "a,1\n\"multi\nline\",2\n\"say \"\"hi\"\"\",3\nlast,4";
+    // Every piece size puts the cuts somewhere different.
+    for (size_t n = 1; n < txt.size(); n += 3) {
+        seen.clear();
+        xsv_body_sink sink(',', [&](xsv_reader & r) {
+            seen.push_back(string(r.get_field_by_index(0)) + "|" + r.get_field_by_index(1));
+            return true;
+        });
+        ASSERT_EQ(sink_result::accepted, feed(sink, txt, n));
+        sink.finish(true);
+        ASSERT_EQ(4u, seen.size()) << "piece size " << n;
+        ASSERT_EQ("a|1", seen[0]);
+        ASSERT_EQ("multi\nline|2", seen[1]);
+        ASSERT_EQ("say \"hi\"|3", seen[2]);
+        ASSERT_EQ("last|4", seen[3]);
+        ASSERT_EQ(4u, sink.get_record_count());
+    }
+
+    // A handler that says stop fails the transfer.
+    xsv_body_sink stopper(',', [](xsv_reader &) { return false; });
+    ASSERT_EQ(sink_result::failed, feed(stopper, txt, 5));
+    ASSERT_NE(nullptr, stopper.get_error());
+}
+
+TEST(body_sink_test, json_array_elements_span_chunks) {
+    string txt = " [ {\"a\": [1, 2], \"s\": \"x]}\\\"\"}, 42 ,\"str\", true, [[]], null ] ";
+    for (size_t n = 1; n < txt.size(); n += 2) {
+        std::vector<string> seen;
+        json_body_sink sink([&](json::value & v) {
+            seen.push_back(json::fast_writer().write(v));
+            return true;
+        });
+        ASSERT_EQ(sink_result::accepted, feed(sink, txt, n));
+        sink.finish(true);
+        ASSERT_EQ("", sink.get_error()) << "piece size " << n;
+        ASSERT_EQ(6u, sink.get_element_count());
+        ASSERT_NE(string::npos, seen[0].find("x]}\\\""));
+        ASSERT_EQ("42\n", seen[1]);
+        ASSERT_EQ("\"str\"\n", seen[2]);
+        ASSERT_EQ("null\n", seen[5]);
+    }
+}
+
+TEST(body_sink_test, json_value_stream) {
+    string txt = "{\"n\":1}\n{\"n\":2}\n\n{\"n\":3}\n7";
+    int total = 0;
+    json_body_sink sink([&](json::value & v) {
+        total += v.is_object() ? v["n"].as_int() : v.as_int();
+        return true;
+    });
+    ASSERT_EQ(sink_result::accepted, feed(sink, txt, 4));
+    sink.finish(true);
+    ASSERT_EQ(13, total);
+
+    json_body_sink truncated([](json::value &) { return true; });
+    ASSERT_EQ(sink_result::accepted, feed(truncated, "[1, {\"a\":", 3));
+    truncated.finish(true);
+    ASSERT_NE("", truncated.get_error());
+}
+
+TEST(body_sink_test, download_to_fd) {
+    uhttpd svr(false);
+    path tmp = easy_temp_file_path();
+    file_delete_on_exit fdoe(tmp);
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_LE(0, fd);
+    fd_body_sink sink(fd);
+    channel c;
+    session s(c);
+    auto resp = get(s, string(svr.get_base_url()) + "3000000.txt", sink);
+    ASSERT_TRUE(resp.wait());
+    close(fd);
+    ASSERT_EQ(200, resp.get_status_code());
+    // Nothing piled up in the response.
+    ASSERT_EQ(0u, resp.get_body().size());
+    ASSERT_EQ(3000000u, sink.get_byte_count());
+    ASSERT_EQ(expected_body(3000000), read_text_file(tmp, 4 * 1024 * 1024));
+}
+
+TEST(body_sink_test, slow_consumer_pauses_transfer) {
+    uhttpd svr(false);
+    // Two buffers of 16 KB: the transfer has to stop and wait for the
+    // consumer over and over.
+    static constexpr size_t buf_size = 16 * 1024;
+    std::vector<char> a(buf_size), b(buf_size);
+    buffer_pool_body_sink sink;
+    sink.give(a.data(), buf_size);
+    sink.give(b.data(), buf_size);
+    channel c;
+    session s(c);
+    auto resp = get(s, string(svr.get_base_url()) + "1000000.txt", sink);
+
+    string received;
+    buffer_pool_body_sink::chunk chunk;
+    while (sink.take(chunk, 5000)) {
+        received.append(chunk.data, chunk.size);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        sink.give(chunk.data, chunk.capacity);
+    }
+    ASSERT_TRUE(resp.wait());
+    ASSERT_TRUE(sink.succeeded());
+    ASSERT_EQ(expected_body(1000000), received);
+}
+
+TEST(body_sink_test, download_records) {
+    uhttpd svr(false);
+    uint64_t bytes = 0;
+    xsv_body_sink sink(',', [&](xsv_reader & r) {
+        bytes += strlen(r.get_field_by_index(0)) + 1;
+        return true;
+    });
+    channel c;
+    session s(c);
+    auto resp = get(s, string(svr.get_base_url()) + "1000050.txt", sink);
+    ASSERT_TRUE(resp.wait());
+    ASSERT_EQ(200, resp.get_status_code());
+    // 10000 full lines, plus a last line of 50 bytes with no line break.
+    ASSERT_EQ(10001u, sink.get_record_count());
+    ASSERT_EQ(1000051u, bytes);
+}
@@ -0,0 +1,180 @@
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+#include "core/filesystem.h"
+#include "core/net/curl/body_source.h"
+#include "core/net/curl/channel.h"
+#include "core/net/curl/request.h"
+#include "core/net/curl/response.h"
+#include "core/net/curl/retry_policy.h"
+#include "core/net/curl/session.h"
+#include "core/net/curl/state_error.h"
+
+#include "helpers/uhttpd.h"
+
+#include "gtest/gtest.h"
+
+using std::string;
+
+using namespace intent::core;
+using namespace intent::core::net::curl;
+
+namespace {
+
+// Bytes that don't repeat on any short cycle, so a misplaced block shows.
+string make_payload(size_t size) {
+    string txt(size, 0);
+    uint32_t x = 12345;
+    for (auto & c : txt) {
+        x = x * 1103515245 + 12345;
+        c = static_cast<char>(x >> 24);
+    }
+    return txt;
+}
+
+// What uhttpd says about a body it got at a digest/ url.
+string digest_of(string const & txt, char const * note = "") {
+    auto crc = crc32(0, reinterpret_cast<Bytef const *>(txt.data()),
+            static_cast<uInt>(txt.size()));
+    char buf[100];
+    snprintf(buf, sizeof(buf), "Received %zu bytes%s, crc32 %08lx", txt.size(),
+            note, static_cast<unsigned long>(crc));
+    return buf;
+}
+
+response send(session & s, string const & url, char const * verb,
+        body_source & source, retry_policy const & retries = retry_policy()) {
+    auto req = s.reset();
+    req.set_url(url.c_str());
+    req.set_verb(verb);
+    req.set_body_source(&source);
+    req.set_retry_policy(retries);
+    return s.send();
+}
+
+struct temp_file {
+    filesystem::path path;
+
+    explicit temp_file(string const & txt) :
+            path(filesystem::temp_directory_path() / filesystem::unique_path()) {
+        std::ofstream out(path.string(), std::ios::binary);
+        out.write(txt.data(), txt.size());
+    }
+
+    ~temp_file() {
+        filesystem::remove(path);
+    }
+};
+
+} // end anonymous namespace
+
+TEST(body_source_test, span_is_sent_with_a_length) {
+    uhttpd svr(false);
+    auto payload = make_payload(3 * 1024 * 1024 + 17);
+    span_body_source src(payload.data(), payload.size());
+    ASSERT_EQ(payload.size(), src.get_size());
+    channel c;
+    session s(c);
+    auto resp = send(s, string(svr.get_base_url()) + "digest/a", "post", src);
+    ASSERT_TRUE(resp.wait(10000));
+    ASSERT_EQ(200, resp.get_status_code());
+    ASSERT_NE(string::npos, resp.get_body().find(digest_of(payload)));
+}
+
+TEST(body_source_test, mapped_file_is_put) {
+    uhttpd svr(false);
+    auto payload = make_payload(5 * 1024 * 1024);
+    temp_file f(payload);
+    mapped_file_body_source src(f.path);
+    channel c;
+    session s(c);
+    auto resp = send(s, string(svr.get_base_url()) + "digest/b", "put", src);
+    ASSERT_TRUE(resp.wait(10000));
+    ASSERT_EQ(200, resp.get_status_code());
+    ASSERT_NE(string::npos, resp.get_body().find(digest_of(payload)));
+}
+
+TEST(body_source_test, fd_is_read_from_its_offset) {
+    uhttpd svr(false);
+    auto payload = make_payload(1024 * 1024);
+    temp_file f(payload);
+    int fd = open(f.path.c_str(), O_RDONLY);
+    ASSERT_LE(0, fd);
+    ASSERT_EQ(1000, lseek(fd, 1000, SEEK_SET));
+    fd_body_source src(fd);
+    ASSERT_EQ(payload.size() - 1000, src.get_size());
+    channel c;
+    session s(c);
+    auto resp = send(s, string(svr.get_base_url()) + "digest/c", "put", src);
+    ASSERT_TRUE(resp.wait(10000));
+    ASSERT_EQ(200, resp.get_status_code());
+    ASSERT_NE(string::npos, resp.get_body().find(digest_of(payload.substr(1000))));
+    ASSERT_EQ(payload.size() - 1000, src.get_byte_count());
+    close(fd);
+}
+
+TEST(body_source_test, retries_start_the_body_over) {
+    uhttpd svr(false);
+    auto payload = make_payload(200 * 1024);
+    span_body_source src(payload.data(), payload.size());
+    channel c;
+    session s(c);
+    auto resp = send(s, string(svr.get_base_url()) + "flaky/1/digest/d", "put",
+            src, retry_policy(3, 10, 50));
+    ASSERT_TRUE(resp.wait(10000));
+    ASSERT_EQ(200, resp.get_status_code());
+    ASSERT_NE(string::npos, resp.get_body().find(digest_of(payload)));
+}
+
+TEST(body_source_test, producer_is_sent_chunked) {
+    uhttpd svr(false);
+    auto payload = make_payload(2 * 1024 * 1024 + 5);
+    // Much smaller than the body, so each side has to wait for the other.
+    producer_body_source src(64 * 1024);
+    channel c;
+    session s(c);
+    auto resp = send(s, string(svr.get_base_url()) + "digest/e", "post", src);
+    std::thread producer([&] {
+        for (size_t i = 0; i < payload.size(); i += 10000) {
+            auto n = std::min<size_t>(10000, payload.size() - i);
+            ASSERT_TRUE(src.write(payload.data() + i, n));
+        }
+        src.close();
+    });
+    ASSERT_TRUE(resp.wait(10000));
+    producer.join();
+    ASSERT_EQ(200, resp.get_status_code());
+    ASSERT_NE(string::npos, resp.get_body().find(digest_of(payload, " (chunked)")));
+    ASSERT_TRUE(src.succeeded());
+}
+
+TEST(body_source_test, producer_learns_of_failure) {
+    producer_body_source src(1024);
+    channel c;
+    session s(c);
+    // Nothing listens there.
+    auto resp = send(s, "http://127.0.0.1:1/digest/f", "post", src);
+    ASSERT_TRUE(resp.wait(10000));
+    ASSERT_TRUE(src.is_finished());
+    ASSERT_FALSE(src.succeeded());
+    char bytes[4096] = {};
+    ASSERT_FALSE(src.write(bytes, sizeof(bytes), 1000));
+}
+
+TEST(body_source_test, body_and_source_conflict) {
+    span_body_source src("x", 1);
+    channel c;
+    session s(c);
+    auto req = s.reset();
+    req.set_url("http://127.0.0.1:1/");
+    req.set_verb("post");
+    req.set_body("y");
+    req.set_body_source(&src);
+    ASSERT_THROW(s.send(), state_error);
+}
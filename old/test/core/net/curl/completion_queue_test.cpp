@@ -0,0 +1,121 @@
+#include <atomic>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "core/net/curl/channel.h"
+#include "core/net/curl/completion_queue.h"
+#include "core/net/curl/request.h"
+#include "core/net/curl/response.h"
+#include "core/net/curl/session.h"
+
+#include "helpers/uhttpd.h"
+
+#include "gtest/gtest.h"
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+using namespace intent::core::net::curl;
+
+namespace {
+
+void configure(session & s, string const & url) {
+    auto req = s.reset();
+    req.set_url(url.c_str());
+    req.set_verb("get");
+}
+
+} // end anonymous namespace
+
+TEST(completion_queue_test, empty_queue_returns_at_once) {
+    channel c;
+    completion_queue q(c);
+    vector<response> done;
+    ASSERT_FALSE(q.wait_any(done, 5000));
+    ASSERT_TRUE(q.wait_all(done, 5000));
+    ASSERT_TRUE(done.empty());
+}
+
+TEST(completion_queue_test, responses_come_out_once_each) {
+    uhttpd svr(false);
+    string base = svr.get_base_url();
+    channel c;
+    completion_queue q(c);
+    std::set<size_t> sizes;
+    for (size_t n = 1; n <= 40; ++n) {
+        q.submit((base + std::to_string(n * 100) + ".txt").c_str());
+    }
+    vector<response> done;
+    while (q.wait_any(done, 5000)) {
+        for (auto & r : done) {
+            ASSERT_EQ(200, r.get_status_code());
+            ASSERT_TRUE(sizes.insert(r.get_body().size()).second);
+        }
+        done.clear();
+    }
+    ASSERT_EQ(40u, sizes.size());
+    ASSERT_EQ(0u, q.get_pending_count());
+    ASSERT_EQ(0u, q.get_ready_count());
+}
+
+TEST(completion_queue_test, wait_all_with_own_sessions) {
+    uhttpd svr(false);
+    string base = svr.get_base_url();
+    channel c;
+    completion_queue q(c);
+    vector<unique_ptr<session>> sessions;
+    for (int i = 0; i < 5; ++i) {
+        sessions.emplace_back(new session(c));
+        configure(*sessions.back(), base + "1000.txt");
+        q.submit(*sessions.back());
+    }
+    vector<response> done;
+    ASSERT_TRUE(q.wait_all(done, 10000));
+    ASSERT_EQ(5u, done.size());
+    for (auto & r : done) {
+        ASSERT_EQ(1000u, r.get_body().size());
+    }
+}
+
+TEST(completion_queue_test, handlers_and_futures) {
+    uhttpd svr(false);
+    string base = svr.get_base_url();
+    channel c;
+    completion_queue q(c);
+    session a(c), b(c);
+    std::atomic<int> handled(0);
+    configure(a, base + "200.txt");
+    // A handler can send its session again.
+    q.submit(a, [&](response & r) {
+        if (++handled == 1) {
+            configure(r.get_session(), base + "300.txt");
+            q.submit(r.get_session(), [&](response &) { ++handled; });
+        }
+    });
+    configure(b, base + "400.txt");
+    auto f = q.submit_future(b);
+    ASSERT_EQ(400u, f.get().get_body().size());
+    vector<response> done;
+    ASSERT_TRUE(q.wait_all(done, 10000));
+    ASSERT_EQ(2, handled.load());
+    ASSERT_TRUE(done.empty());
+}
+
+TEST(completion_queue_test, abandoned_transfers_stop_counting) {
+    uhttpd svr(false);
+    string base = svr.get_base_url();
+    channel c;
+    completion_queue q(c);
+    {
+        session s(c);
+        configure(s, base + "8000000.txt");
+        q.submit(s);
+        ASSERT_EQ(1u, q.get_pending_count());
+    }
+    vector<response> done;
+    ASSERT_TRUE(q.wait_all(done, 5000));
+    ASSERT_LE(done.size(), 1u);
+}
@@ -0,0 +1,136 @@
+#include <string>
+
+#include "core/net/curl/body_sink.h"
+#include "core/net/curl/channel.h"
+#include "core/net/curl/request.h"
+#include "core/net/curl/response.h"
+#include "core/net/curl/session.h"
+
+#include "helpers/uhttpd.h"
+
+#include "gtest/gtest.h"
+
+using std::string;
+
+using namespace intent::core::net::curl;
+
+namespace {
+
+// Collects what it is given, and how many pieces it came in.
+class string_sink : public body_sink {
+public:
+    string txt;
+    unsigned pieces;
+    bool finished_ok;
+
+    string_sink() : txt(), pieces(0), finished_ok(false) {}
+
+    virtual sink_result accept(char const * bytes, size_t byte_count) {
+        txt.append(bytes, byte_count);
+        ++pieces;
+        return sink_result::accepted;
+    }
+
+    virtual void finish(bool ok) {
+        finished_ok = ok;
+    }
+};
+
+string json_like(int count) {
+    string txt = "[";
+    for (int i = 0; i < count; ++i) {
+        txt += "{\"id\": " + std::to_string(i) + ", \"name\": \"item\", \"ok\": true},";
+    }
+    txt.back() = ']';
+    return txt;
+}
+
+} // end anonymous namespace
+
+TEST(compression_test, response_is_decoded) {
+    uhttpd svr(false);
+    string base = svr.get_base_url();
+    channel c;
+    session s(c);
+    auto req = s.reset();
+    req.set_url((base + "gzip/100000.txt").c_str());
+    req.set_verb("get");
+    auto resp = s.send();
+    ASSERT_TRUE(resp.wait(5000));
+    ASSERT_EQ(200, resp.get_status_code());
+    ASSERT_EQ(100000u, resp.get_body().size());
+    auto headers = resp.get_headers();
+    ASSERT_STREQ("gzip", headers.get("Content-Encoding"));
+    // What went over the wire was much smaller.
+    ASSERT_GT(20000, atoi(headers.get("Content-Length")));
+}
+
+TEST(compression_test, sink_gets_decoded_pieces) {
+    uhttpd svr(false);
+    string base = svr.get_base_url();
+    channel c;
+    session s(c);
+    string_sink sink;
+    auto req = s.reset();
+    req.set_url((base + "gzip/1000000.txt").c_str());
+    req.set_verb("get");
+    req.set_body_sink(&sink);
+    auto resp = s.send();
+    ASSERT_TRUE(resp.wait(5000));
+    ASSERT_EQ(200, resp.get_status_code());
+    ASSERT_TRUE(sink.finished_ok);
+    ASSERT_EQ(1000000u, sink.txt.size());
+    ASSERT_LT(1u, sink.pieces);
+    ASSERT_TRUE(resp.get_body().empty());
+}
+
+TEST(compression_test, encoding_can_be_left_in_place) {
+    uhttpd svr(false);
+    string base = svr.get_base_url();
+    channel c;
+    session s(c);
+    auto req = s.reset();
+    req.set_url((base + "gzip/1000.txt").c_str());
+    req.set_verb("get");
+    req.set_accept_encoding(nullptr);
+    ASSERT_EQ(nullptr, req.get_accept_encoding());
+    req.get_headers().set("Accept-Encoding", "gzip");
+    auto resp = s.send();
+    ASSERT_TRUE(resp.wait(5000));
+    auto & body = resp.get_body();
+    ASSERT_LT(2u, body.size());
+    ASSERT_EQ('\x1f', body[0]);
+    ASSERT_EQ('\x8b', body[1]);
+}
+
+TEST(compression_test, large_bodies_are_gzipped) {
+    uhttpd svr(false);
+    string url = string(svr.get_base_url()) + "upload";
+    auto json = json_like(2000);
+    channel c;
+    session s(c);
+    {
+        auto req = s.reset();
+        req.set_url(url.c_str());
+        req.set_verb("post");
+        req.set_body(json);
+        req.set_body_compression(1024);
+        auto resp = s.send();
+        ASSERT_TRUE(resp.wait(5000));
+        ASSERT_EQ(200, resp.get_status_code());
+        auto expected = "Received " + std::to_string(json.size()) + " bytes (gzip, ";
+        ASSERT_NE(string::npos, resp.get_body().find(expected));
+        ASSERT_NE(string::npos, resp.get_body().find(json));
+    }
+    // Small ones aren't worth it.
+    {
+        auto req = s.reset();
+        req.set_url(url.c_str());
+        req.set_verb("put");
+        req.set_body("{}");
+        req.set_body_compression(1024);
+        auto resp = s.send();
+        ASSERT_TRUE(resp.wait(5000));
+        ASSERT_NE(string::npos, resp.get_body().find("Received 2 bytes: \"{}\""));
+    }
+}
@@ -0,0 +1,75 @@
+#include <string>
+#include <vector>
+
+#include "core/net/curl/channel.h"
+#include "core/net/curl/completion_queue.h"
+#include "core/net/curl/request.h"
+#include "core/net/curl/response.h"
+#include "core/net/curl/session.h"
+
+#include "helpers/curl_helpers.h"
+#include "helpers/uhttpd.h"
+
+#include "gtest/gtest.h"
+
+using std::string;
+using std::vector;
+
+using namespace intent::core::net::curl;
+
+TEST(connection_test, policy_round_trips) {
+    channel c;
+    auto policy = c.get_connection_policy();
+    ASSERT_TRUE(policy.multiplex);
+    ASSERT_EQ(0u, policy.max_host_connections);
+    policy.multiplex = false;
+    policy.max_host_connections = 3;
+    policy.keepalive_idle_secs = 0;
+    c.set_connection_policy(policy);
+    policy = c.get_connection_policy();
+    ASSERT_FALSE(policy.multiplex);
+    ASSERT_EQ(3u, policy.max_host_connections);
+    ASSERT_EQ(0u, policy.keepalive_idle_secs);
+}
+
+TEST(connection_test, sequential_calls_reuse_a_connection) {
+    uhttpd svr(false);
+    string base = svr.get_base_url();
+    channel c;
+    session s(c);
+    for (int i = 0; i < 20; ++i) {
+        auto resp = send_get(s, base + "100.txt");
+        ASSERT_TRUE(resp.wait(5000));
+        ASSERT_EQ(200, resp.get_status_code());
+    }
+    auto stats = c.get_connection_stats();
+    ASSERT_EQ(20u, stats.transfers);
+    ASSERT_EQ(1u, stats.connections_opened);
+    ASSERT_EQ(19u, stats.reused);
+    ASSERT_EQ(0u, stats.http2);
+}
+
+TEST(connection_test, host_limit_caps_connections) {
+    uhttpd svr(false);
+    string base = svr.get_base_url();
+    channel c;
+    auto policy = c.get_connection_policy();
+    policy.max_host_connections = 2;
+    c.set_connection_policy(policy);
+    completion_queue q(c);
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 1; i <= 20; ++i) {
+            q.submit((base + std::to_string(i * 10) + ".txt").c_str());
+        }
+        vector<response> done;
+        ASSERT_TRUE(q.wait_all(done, 10000));
+        ASSERT_EQ(20u, done.size());
+        for (auto & r : done) {
+            ASSERT_EQ(200, r.get_status_code());
+        }
+    }
+    auto stats = c.get_connection_stats();
+    ASSERT_EQ(60u, stats.transfers);
+    ASSERT_GE(2u, stats.connections_opened);
+    ASSERT_EQ(60u - stats.connections_opened, stats.reused);
+}
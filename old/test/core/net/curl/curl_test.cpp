@@ -1,12 +1,22 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
+#include <algorithm>
 #include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include "core/net/curl/channel.h"
 #include "core/net/curl/session_state.h"
+#include "core/net/curl/shared_cookies.h"
+#include "core/net/curl/shared_tls_handshake.h"
+#include "core/net/curl/state_error.h"
 #include "core/net/curl/request.h"
 #include "core/net/curl/response.h"
 
+#include "helpers/curl_helpers.h"
 #include "helpers/uhttpd.h"
 
 #include "gtest/gtest.h"
@@ -80,3 +90,125 @@ TEST(curl_test, simplest_download) {
     ASSERT_TRUE(resp.get_body().size() > 0);
 }
 
+
+
+TEST(curl_test, channel_with_several_loops) {
+    channel c(4);
+    ASSERT_EQ(4u, c.get_loop_count());
+    ASSERT_FALSE(c.is_open());
+
+    channel per_core(0);
+    ASSERT_LE(1u, per_core.get_loop_count());
+    ASSERT_EQ(std::max(1u, std::thread::hardware_concurrency()), per_core.get_loop_count());
+}
+
+
+TEST(curl_test, parallel_downloads_across_loops) {
+    uhttpd svr(false);
+    std::string base(svr.get_base_url());
+    channel c(4);
+    std::vector<std::unique_ptr<session>> sessions;
+    std::vector<response> responses;
+    for (int i = 0; i < 40; ++i) {
+        sessions.emplace_back(new session(c));
+        auto req = sessions.back()->reset();
+        req.set_url((base + std::to_string(1000 + i) + ".txt").c_str());
+        req.set_verb("get");
+        responses.push_back(sessions.back()->send());
+    }
+    ASSERT_TRUE(c.is_open());
+    for (int i = 0; i < 40; ++i) {
+        ASSERT_TRUE(responses[i].wait());
+        ASSERT_EQ(200, responses[i].get_status_code());
+        ASSERT_EQ(1000u + i, responses[i].get_body().size());
+    }
+}
+
+
+TEST(curl_test, close_stops_loops_and_reopens) {
+    uhttpd svr(false);
+    std::string url = std::string(svr.get_base_url()) + "100.txt";
+    channel c(2);
+    session s(c);
+    for (int round = 0; round < 2; ++round) {
+        auto req = s.reset();
+        req.set_url(url.c_str());
+        req.set_verb("get");
+        auto resp = s.send();
+        ASSERT_TRUE(resp.wait());
+        ASSERT_EQ(200, resp.get_status_code());
+        c.close();
+        ASSERT_FALSE(c.is_open());
+    }
+}
+
+
+TEST(curl_test, session_can_outlive_busy_channel) {
+    uhttpd svr(false);
+    std::string url = std::string(svr.get_base_url()) + "100000.txt";
+    std::unique_ptr<session> s;
+    {
+        channel c(3);
+        s.reset(new session(c));
+        auto req = s->reset();
+        req.set_url(url.c_str());
+        req.set_verb("get");
+        s->send();
+    }
+    ASSERT_FALSE(is_busy(s->get_state()));
+}
+
+
+TEST(curl_test, shared_state_kinds) {
+    ASSERT_EQ(sharing::none, shared_state().get_sharing());
+    ASSERT_EQ(sharing::cookies, shared_cookies().get_sharing());
+    ASSERT_EQ(sharing::dns | sharing::tls_sessions, shared_tls_handshake().get_sharing());
+    ASSERT_EQ(sharing::dns | sharing::tls_sessions | sharing::connections,
+            shared_tls_handshake(true).get_sharing());
+
+    shared_cookies jar;
+    shared_state copy(jar);
+    ASSERT_TRUE(copy == jar);
+    ASSERT_TRUE(copy != shared_cookies());
+}
+
+
+TEST(curl_test, cookies_shared_across_channels) {
+    uhttpd svr(false);
+    std::string base(svr.get_base_url());
+    shared_cookies jar;
+    channel c1, c2;
+    session a(c1), b(c2), loner(c2);
+    a.set_shared_state(jar);
+    c2.set_shared_state(jar);
+    session c(c2);
+    ASSERT_TRUE(jar == c.get_shared_state());
+
+    ASSERT_EQ(200, fetch(a, base + "cookie/set/flavor=oatmeal").get_status_code());
+    b.set_shared_state(jar);
+    auto resp = fetch(b, base + "cookie/get");
+    ASSERT_EQ(200, resp.get_status_code());
+    ASSERT_NE(std::string::npos, resp.get_body().find("flavor=oatmeal"));
+    ASSERT_NE(std::string::npos, fetch(c, base + "cookie/get").get_body().find("flavor=oatmeal"));
+    ASSERT_EQ(std::string::npos, fetch(loner, base + "cookie/get").get_body().find("flavor=oatmeal"));
+}
+
+
+TEST(curl_test, shared_connections_stay_in_one_channel) {
+    uhttpd svr(false);
+    std::string url = std::string(svr.get_base_url()) + "100.txt";
+    shared_tls_handshake pool(true);
+    channel c1(4), c2;
+    std::vector<std::unique_ptr<session>> sessions;
+    for (int i = 0; i < 8; ++i) {
+        sessions.emplace_back(new session(c1));
+        sessions.back()->set_shared_state(pool);
+    }
+    for (auto & s : sessions) {
+        ASSERT_EQ(200, fetch(*s, url).get_status_code());
+    }
+    session outsider(c2);
+    ASSERT_THROW(outsider.set_shared_state(pool), state_error);
+    ASSERT_EQ(sharing::none, outsider.get_shared_state().get_sharing());
+    ASSERT_EQ(200, fetch(outsider, url).get_status_code());
+}
@@ -0,0 +1,252 @@
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/filesystem.h"
+#include "core/net/curl/channel.h"
+#include "core/net/curl/http_cache.h"
+#include "core/net/curl/request.h"
+#include "core/net/curl/response.h"
+#include "core/net/curl/session.h"
+
+#include "helpers/curl_helpers.h"
+#include "helpers/uhttpd.h"
+
+#include "gtest/gtest.h"
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+using namespace intent::core;
+using namespace intent::core::net::curl;
+
+TEST(http_cache_test, fresh_copy_needs_no_transfer) {
+    uhttpd svr(false);
+    string url = string(svr.get_base_url()) + "cache/max-age=60/a.html";
+    channel c;
+    http_cache cache;
+    c.set_http_cache(cache);
+    session s(c);
+    auto first = fetch(s, url);
+    ASSERT_EQ(200, first.get_status_code());
+    ASSERT_EQ(cache_outcome::miss, first.get_cache_outcome());
+    string body = first.get_body();
+    auto second = fetch(s, url);
+    ASSERT_EQ(200, second.get_status_code());
+    ASSERT_EQ(cache_outcome::hit, second.get_cache_outcome());
+    ASSERT_EQ(body, second.get_body());
+    auto headers = second.get_headers();
+    ASSERT_STREQ("max-age=60", headers.get("Cache-Control"));
+    ASSERT_EQ(1u, c.get_connection_stats().transfers);
+    auto stats = cache.get_stats();
+    ASSERT_EQ(1u, stats.hits);
+    ASSERT_EQ(1u, stats.misses);
+    ASSERT_EQ(1u, stats.stored);
+    ASSERT_EQ(1u, stats.memory_entries);
+}
+
+TEST(http_cache_test, stale_copy_is_revalidated) {
+    uhttpd svr(false);
+    string url = string(svr.get_base_url()) + "cache/no-cache/b.html";
+    channel c;
+    http_cache cache;
+    c.set_http_cache(cache);
+    session s(c);
+    string body = fetch(s, url).get_body();
+    auto again = fetch(s, url);
+    ASSERT_EQ(200, again.get_status_code());
+    ASSERT_EQ(cache_outcome::revalidated, again.get_cache_outcome());
+    ASSERT_EQ(body, again.get_body());
+    ASSERT_EQ(2u, c.get_connection_stats().transfers);
+    ASSERT_EQ(1u, cache.get_stats().revalidated);
+}
+
+TEST(http_cache_test, no_store_is_not_kept) {
+    uhttpd svr(false);
+    string url = string(svr.get_base_url()) + "cache/no-store/c.html";
+    channel c;
+    http_cache cache;
+    c.set_http_cache(cache);
+    session s(c);
+    fetch(s, url);
+    ASSERT_EQ(cache_outcome::miss, fetch(s, url).get_cache_outcome());
+    auto stats = cache.get_stats();
+    ASSERT_EQ(0u, stats.stored);
+    ASSERT_EQ(2u, stats.misses);
+}
+
+TEST(http_cache_test, requests_can_bypass_the_cache) {
+    uhttpd svr(false);
+    string url = string(svr.get_base_url()) + "cache/max-age=60/d.html";
+    channel c;
+    c.set_http_cache(http_cache());
+    session s(c);
+    fetch(s, url);
+    auto req = s.reset();
+    req.set_url(url.c_str());
+    req.set_verb("get");
+    req.set_use_cache(false);
+    auto resp = s.send();
+    ASSERT_TRUE(resp.wait(5000));
+    ASSERT_EQ(cache_outcome::none, resp.get_cache_outcome());
+    ASSERT_EQ(2u, c.get_connection_stats().transfers);
+}
+
+TEST(http_cache_test, identical_gets_share_one_transfer) {
+    uhttpd svr(false);
+    // Nothing here may be kept; the stall keeps the first transfer underway
+    // while the others are sent.
+    string url = string(svr.get_base_url()) + "slow-first/500/e.html";
+    channel c;
+    http_cache cache;
+    c.set_http_cache(cache);
+    vector<unique_ptr<session>> sessions;
+    vector<response> responses;
+    for (int i = 0; i < 5; ++i) {
+        sessions.emplace_back(new session(c));
+        responses.push_back(sessions.back()->start_get(url.c_str()));
+    }
+    unsigned coalesced = 0;
+    for (auto & r : responses) {
+        ASSERT_TRUE(r.wait(5000));
+        ASSERT_EQ(200, r.get_status_code());
+        ASSERT_EQ(responses[0].get_body(), r.get_body());
+        if (r.get_cache_outcome() == cache_outcome::coalesced) {
+            ++coalesced;
+        }
+    }
+    ASSERT_EQ(4u, coalesced);
+    ASSERT_EQ(1u, c.get_connection_stats().transfers);
+    ASSERT_EQ(0u, cache.get_stats().stored);
+}
+
+TEST(http_cache_test, memory_keeps_the_most_recently_used) {
+    uhttpd svr(false);
+    string base = string(svr.get_base_url()) + "cache/max-age=60/";
+    channel c;
+    http_cache::config cfg;
+    // Room for one of these, not two.
+    cfg.memory_bytes = 2500;
+    http_cache cache(cfg);
+    c.set_http_cache(cache);
+    session s(c);
+    fetch(s, base + "f/1000.txt");
+    fetch(s, base + "g/1000.txt");
+    ASSERT_EQ(cache_outcome::hit, fetch(s, base + "g/1000.txt").get_cache_outcome());
+    ASSERT_EQ(cache_outcome::miss, fetch(s, base + "f/1000.txt").get_cache_outcome());
+    ASSERT_EQ(1u, cache.get_stats().memory_entries);
+    ASSERT_EQ(3u, c.get_connection_stats().transfers);
+}
+
+TEST(http_cache_test, disk_copies_outlive_the_cache) {
+    uhttpd svr(false);
+    string base = string(svr.get_base_url()) + "cache/max-age=60/";
+    auto folder = filesystem::temp_directory_path() / filesystem::unique_path();
+    http_cache::config cfg;
+    cfg.folder = folder.string();
+    {
+        channel c;
+        http_cache cache(cfg);
+        c.set_http_cache(cache);
+        session s(c);
+        fetch(s, base + "h/100.txt");
+        fetch(s, base + "i/100.txt");
+        auto stats = cache.get_stats();
+        ASSERT_EQ(2u, stats.disk_entries);
+        // Same body, stored once.
+        ASSERT_EQ(100u, stats.disk_bytes);
+    }
+    {
+        channel c;
+        http_cache cache(cfg);
+        c.set_http_cache(cache);
+        session s(c);
+        auto resp = fetch(s, base + "i/100.txt");
+        ASSERT_EQ(cache_outcome::hit, resp.get_cache_outcome());
+        ASSERT_EQ(100u, resp.get_body().size());
+        ASSERT_EQ(0u, c.get_connection_stats().transfers);
+        cache.clear();
+        ASSERT_EQ(0u, cache.get_stats().disk_entries);
+    }
+    filesystem::remove_all(folder);
+}
+
+TEST(http_cache_test, disk_bodies_must_match_their_digest) {
+    uhttpd svr(false);
+    string url = string(svr.get_base_url()) + "cache/max-age=60/j/100.txt";
+    auto folder = filesystem::temp_directory_path() / filesystem::unique_path();
+    http_cache::config cfg;
+    cfg.folder = folder.string();
+    string body;
+    {
+        channel c;
+        http_cache cache(cfg);
+        c.set_http_cache(cache);
+        session s(c);
+        body = fetch(s, url).get_body();
+        ASSERT_EQ(100u, body.size());
+    }
+    // Swap the stored body for another of the same size, as a colliding
+    // name would.
+    filesystem::directory_iterator blob(folder / "blobs");
+    ASSERT_NE(filesystem::directory_iterator(), blob);
+    ASSERT_EQ(64u, blob->path().filename().string().size());
+    {
+        std::ofstream out(blob->path().string(), std::ios::binary);
+        out << string(100, 'x');
+    }
+    {
+        channel c;
+        http_cache cache(cfg);
+        c.set_http_cache(cache);
+        session s(c);
+        auto resp = fetch(s, url);
+        ASSERT_NE(cache_outcome::hit, resp.get_cache_outcome());
+        ASSERT_EQ(body, resp.get_body());
+    }
+    filesystem::remove_all(folder);
+}
+
+TEST(http_cache_test, damaged_index_is_dropped) {
+    uhttpd svr(false);
+    string url = string(svr.get_base_url()) + "cache/max-age=60/k/100.txt";
+    auto folder = filesystem::temp_directory_path() / filesystem::unique_path();
+    http_cache::config cfg;
+    cfg.folder = folder.string();
+    {
+        channel c;
+        http_cache cache(cfg);
+        c.set_http_cache(cache);
+        session s(c);
+        fetch(s, url);
+    }
+    // Claim a key far bigger than the file.
+    filesystem::directory_iterator index(folder / "index");
+    ASSERT_NE(filesystem::directory_iterator(), index);
+    string txt;
+    {
+        std::ifstream in(index->path().string(), std::ios::binary);
+        txt.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto key_line = txt.find("\nkey ");
+    ASSERT_NE(string::npos, key_line);
+    txt.replace(key_line, txt.find('\n', key_line + 1) - key_line, "\nkey 18446744073709551615");
+    {
+        std::ofstream out(index->path().string(), std::ios::binary);
+        out << txt;
+    }
+    {
+        channel c;
+        http_cache cache(cfg);
+        ASSERT_EQ(0u, cache.get_stats().disk_entries);
+        c.set_http_cache(cache);
+        session s(c);
+        auto resp = fetch(s, url);
+        ASSERT_NE(cache_outcome::hit, resp.get_cache_outcome());
+        ASSERT_EQ(100u, resp.get_body().size());
+    }
+    filesystem::remove_all(folder);
+}
@@ -0,0 +1,185 @@
+#include <chrono>
+#include <string>
+
+#include "core/net/curl/channel.h"
+#include "core/net/curl/request.h"
+#include "core/net/curl/response.h"
+#include "core/net/curl/retry_policy.h"
+#include "core/net/curl/session.h"
+
+#include "helpers/uhttpd.h"
+
+#include "gtest/gtest.h"
+
+using std::string;
+
+using namespace intent::core::err;
+using namespace intent::core::net::curl;
+
+namespace {
+
+response send(session & s, string const & url, char const * verb = "get",
+        retry_policy const & retries = retry_policy(), unsigned hedge_after = 0) {
+    auto req = s.reset();
+    req.set_url(url.c_str());
+    req.set_verb(verb);
+    req.set_retry_policy(retries);
+    req.set_hedge_after(hedge_after);
+    return s.send();
+}
+
+long millisecs_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+} // end anonymous namespace
+
+TEST(resilience_test, backoff_grows_to_a_cap) {
+    retry_policy p(5, 100, 300);
+    for (int i = 0; i < 20; ++i) {
+        auto first = p.get_backoff(1);
+        ASSERT_LE(50u, first);
+        ASSERT_GE(100u, first);
+        auto third = p.get_backoff(3);
+        ASSERT_LE(150u, third);
+        ASSERT_GE(300u, third);
+    }
+    // The server can ask for more, but not for more than the cap.
+    ASSERT_EQ(250u, p.get_backoff(1, 250));
+    ASSERT_EQ(300u, p.get_backoff(1, 5000));
+}
+
+TEST(resilience_test, retries_transient_failures) {
+    uhttpd svr(false);
+    channel c;
+    session s(c);
+    auto resp = send(s, string(svr.get_base_url()) + "flaky/2/a.html", "get",
+            retry_policy(3, 10, 50));
+    ASSERT_TRUE(resp.wait(5000));
+    ASSERT_EQ(200, resp.get_status_code());
+}
+
+TEST(resilience_test, gives_up_after_max_attempts) {
+    uhttpd svr(false);
+    channel c;
+    session s(c);
+    auto resp = send(s, string(svr.get_base_url()) + "flaky/5/b.html", "get",
+            retry_policy(3, 10, 50));
+    ASSERT_TRUE(resp.wait(5000));
+    ASSERT_EQ(503, resp.get_status_code());
+    // Two more failures, and the next try works.
+    auto again = send(s, string(svr.get_base_url()) + "flaky/5/b.html", "get",
+            retry_policy(3, 10, 50));
+    ASSERT_TRUE(again.wait(5000));
+    ASSERT_EQ(200, again.get_status_code());
+}
+
+TEST(resilience_test, post_is_not_retried_by_default) {
+    uhttpd svr(false);
+    channel c;
+    session s(c);
+    string url = string(svr.get_base_url()) + "flaky/1/c.html";
+    auto resp = send(s, url, "post", retry_policy(3, 10, 50));
+    ASSERT_TRUE(resp.wait(5000));
+    ASSERT_EQ(503, resp.get_status_code());
+    retry_policy unsafe(3, 10, 50);
+    unsafe.retry_unsafe_verbs = true;
+    url = string(svr.get_base_url()) + "flaky/1/d.html";
+    auto retried = send(s, url, "post", unsafe);
+    ASSERT_TRUE(retried.wait(5000));
+    ASSERT_EQ(200, retried.get_status_code());
+}
+
+TEST(resilience_test, no_verb_is_retried_as_get) {
+    uhttpd svr(false);
+    channel c;
+    session s(c);
+    auto req = s.reset();
+    req.set_url((string(svr.get_base_url()) + "flaky/1/h.html").c_str());
+    req.set_retry_policy(retry_policy(3, 10, 50));
+    auto resp = s.send();
+    ASSERT_TRUE(resp.wait(5000));
+    ASSERT_EQ(200, resp.get_status_code());
+}
+
+TEST(resilience_test, custom_verb_is_not_retried_by_default) {
+    uhttpd svr(false);
+    channel c;
+    session s(c);
+    // We can't know what PURGE does, so it gets the same care as POST.
+    auto resp = send(s, string(svr.get_base_url()) + "flaky/1/i.html", "PURGE",
+            retry_policy(3, 10, 50));
+    ASSERT_TRUE(resp.wait(5000));
+    ASSERT_EQ(503, resp.get_status_code());
+}
+
+TEST(resilience_test, open_breaker_fails_fast) {
+    uhttpd svr(false);
+    string host = "localhost:" + std::to_string(svr.get_port());
+    channel c;
+    ASSERT_EQ(nullptr, c.get_circuit_breaker(host.c_str()));
+    circuit_breaker::config cfg;
+    cfg.min_calls = 2;
+    cfg.open_millisecs = 60000;
+    c.enable_circuit_breakers(cfg);
+    session s(c);
+    for (int i = 0; i < 2; ++i) {
+        auto resp = send(s, string(svr.get_base_url()) + "flaky/9/e.html");
+        ASSERT_TRUE(resp.wait(5000));
+        ASSERT_EQ(503, resp.get_status_code());
+    }
+    auto breaker = c.get_circuit_breaker(host.c_str());
+    ASSERT_TRUE(breaker != nullptr);
+    ASSERT_EQ(circuit_breaker::state::open, breaker->get_state());
+    // Retries stop too.
+    auto resp = send(s, string(svr.get_base_url()) + "100.txt", "get",
+            retry_policy(3, 10, 50));
+    ASSERT_EQ(session_state::idle, s.get_state());
+    ASSERT_TRUE(resp.wait(100));
+    ASSERT_EQ(0, resp.get_status_code());
+    breaker->reset();
+    auto after = send(s, string(svr.get_base_url()) + "100.txt");
+    ASSERT_TRUE(after.wait(5000));
+    ASSERT_EQ(200, after.get_status_code());
+}
+
+TEST(resilience_test, hedge_beats_a_stalled_request) {
+    uhttpd svr(false);
+    channel c;
+    session s(c);
+    auto start = std::chrono::steady_clock::now();
+    auto resp = send(s, string(svr.get_base_url()) + "slow-first/3000/f.html",
+            "get", retry_policy(), 100);
+    ASSERT_TRUE(resp.wait(5000));
+    ASSERT_EQ(200, resp.get_status_code());
+    ASSERT_GT(2000, millisecs_since(start));
+    ASSERT_NE(string::npos, resp.get_body().find("f.html"));
+    // The session can go again, hedge and all.
+    auto again = send(s, string(svr.get_base_url()) + "slow-first/3000/g.html",
+            "get", retry_policy(), 100);
+    ASSERT_TRUE(again.wait(5000));
+    ASSERT_EQ(200, again.get_status_code());
+    ASSERT_GT(4000, millisecs_since(start));
+}
+
+TEST(resilience_test, post_is_not_hedged_by_default) {
+    uhttpd svr(false);
+    channel c;
+    session s(c);
+    // A hedge would answer well before the stalled first request does.
+    auto start = std::chrono::steady_clock::now();
+    auto resp = send(s, string(svr.get_base_url()) + "slow-first/1000/j.html",
+            "post", retry_policy(), 100);
+    ASSERT_TRUE(resp.wait(5000));
+    ASSERT_EQ(200, resp.get_status_code());
+    ASSERT_LE(1000, millisecs_since(start));
+    retry_policy unsafe;
+    unsafe.retry_unsafe_verbs = true;
+    start = std::chrono::steady_clock::now();
+    auto hedged = send(s, string(svr.get_base_url()) + "slow-first/3000/k.html",
+            "post", unsafe, 100);
+    ASSERT_TRUE(hedged.wait(5000));
+    ASSERT_EQ(200, hedged.get_status_code());
+    ASSERT_GT(2000, millisecs_since(start));
+}
@@ -0,0 +1,124 @@
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/net/curl/channel.h"
+#include "core/net/curl/completion_queue.h"
+#include "core/net/curl/request.h"
+#include "core/net/curl/response.h"
+#include "core/net/curl/session.h"
+#include "core/net/curl/state_error.h"
+
+#include "helpers/curl_helpers.h"
+#include "helpers/uhttpd.h"
+
+#include "gtest/gtest.h"
+
+using std::string;
+using std::vector;
+
+using namespace intent::core::net::curl;
+
+namespace {
+
+resolve_policy caching() {
+    resolve_policy policy;
+    policy.cache = true;
+    return policy;
+}
+
+} // end anonymous namespace
+
+TEST(resolve_test, policy_round_trips) {
+    channel c;
+    auto policy = c.get_resolve_policy();
+    ASSERT_FALSE(policy.cache);
+    policy.cache = true;
+    policy.max_ttl_secs = 30;
+    c.set_resolve_policy(policy);
+    policy = c.get_resolve_policy();
+    ASSERT_TRUE(policy.cache);
+    ASSERT_EQ(30u, policy.max_ttl_secs);
+}
+
+TEST(resolve_test, override_sends_a_made_up_host_to_the_server) {
+    uhttpd svr(false);
+    channel c;
+    c.set_resolve_override("Made-Up.invalid", svr.get_port(), "127.0.0.1");
+    ASSERT_EQ(1u, c.get_resolve_stats().overrides);
+    session s(c);
+    string url = "http://made-up.invalid:" + std::to_string(svr.get_port()) + "/100.txt";
+    ASSERT_EQ(200, get_status(s, url));
+
+    // Overrides win over the cache, too.
+    c.set_resolve_policy(caching());
+    ASSERT_EQ(200, get_status(s, url));
+    ASSERT_EQ(0u, c.get_resolve_stats().misses);
+
+    c.set_resolve_override("made-up.invalid", svr.get_port(), nullptr);
+    ASSERT_EQ(0u, c.get_resolve_stats().overrides);
+    ASSERT_THROW(c.set_resolve_override("", 80, "127.0.0.1"), state_error);
+}
+
+TEST(resolve_test, cache_answers_repeat_lookups) {
+    uhttpd svr(false);
+    string base = svr.get_base_url();
+    channel c;
+    c.set_resolve_policy(caching());
+    session s(c);
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_EQ(200, get_status(s, base + "100.txt"));
+    }
+    auto stats = c.get_resolve_stats();
+    ASSERT_EQ(1u, stats.misses);
+    ASSERT_EQ(4u, stats.hits);
+    ASSERT_EQ(1u, stats.entries);
+    ASSERT_EQ(0u, stats.failures);
+}
+
+TEST(resolve_test, transfers_share_a_lookup) {
+    uhttpd svr(false);
+    string base = svr.get_base_url();
+    channel c(2);
+    c.set_resolve_policy(caching());
+    completion_queue q(c);
+    for (int i = 1; i <= 10; ++i) {
+        q.submit((base + std::to_string(i * 10) + ".txt").c_str());
+    }
+    vector<response> done;
+    ASSERT_TRUE(q.wait_all(done, 10000));
+    ASSERT_EQ(10u, done.size());
+    for (auto & r : done) {
+        ASSERT_EQ(200, r.get_status_code());
+    }
+    auto stats = c.get_resolve_stats();
+    ASSERT_EQ(10u, stats.hits + stats.misses);
+    ASSERT_EQ(1u, stats.entries);
+}
+
+TEST(resolve_test, entries_near_expiry_are_refreshed_ahead) {
+    uhttpd svr(false);
+    string base = svr.get_base_url();
+    channel c;
+    auto policy = caching();
+    policy.min_ttl_secs = 2;
+    policy.max_ttl_secs = 2;
+    policy.prefetch_percent = 60;
+    c.set_resolve_policy(policy);
+    session s(c);
+    ASSERT_EQ(200, get_status(s, base + "100.txt"));
+    ASSERT_EQ(0u, c.get_resolve_stats().prefetches);
+
+    // With less than 60% of its TTL left, the entry is used and refreshed.
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    ASSERT_EQ(200, get_status(s, base + "100.txt"));
+    auto stats = c.get_resolve_stats();
+    ASSERT_EQ(1u, stats.prefetches);
+    ASSERT_EQ(1u, stats.misses);
+
+    // The refreshed entry serves the next transfer, past the old expiry.
+    std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+    ASSERT_EQ(200, get_status(s, base + "100.txt"));
+    ASSERT_EQ(1u, c.get_resolve_stats().misses);
+}
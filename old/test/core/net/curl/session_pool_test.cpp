@@ -0,0 +1,85 @@
+#include <atomic>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/net/curl/channel.h"
+#include "core/net/curl/request.h"
+#include "core/net/curl/response.h"
+#include "core/net/curl/session.h"
+
+#include "helpers/curl_helpers.h"
+#include "helpers/uhttpd.h"
+
+#include "gtest/gtest.h"
+
+using std::string;
+
+using namespace intent::core::net::curl;
+
+TEST(session_pool_test, recycled_sessions_get_new_ids) {
+    channel c;
+    std::set<uint64_t> ids;
+    for (int i = 0; i < 20; ++i) {
+        session s(c);
+        ASSERT_TRUE(ids.insert(s.get_id()).second);
+    }
+}
+
+TEST(session_pool_test, recycled_sessions_start_clean) {
+    uhttpd svr(false);
+    string base(svr.get_base_url());
+    channel c;
+    {
+        session s(c);
+        auto req = s.reset();
+        req.set_url((base + "100.txt").c_str());
+        req.set_verb("head");
+        auto resp = s.send();
+        ASSERT_TRUE(resp.wait(5000));
+        ASSERT_TRUE(resp.get_body().empty());
+    }
+    // A handle that kept CURLOPT_NOBODY would come back without a body.
+    session s(c);
+    auto req = s.reset();
+    req.set_url((base + "100.txt").c_str());
+    req.set_verb("get");
+    auto resp = s.send();
+    ASSERT_TRUE(resp.wait(5000));
+    ASSERT_EQ(200, resp.get_status_code());
+    ASSERT_FALSE(resp.get_body().empty());
+}
+
+TEST(session_pool_test, threads_churn_sessions) {
+    uhttpd svr(false);
+    string url = string(svr.get_base_url()) + "100.txt";
+    channel c;
+    std::atomic<int> failures(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&c, &url, &failures] {
+            for (int i = 0; i < 10; ++i) {
+                session s(c);
+                if (get_status(s, url) != 200) {
+                    ++failures;
+                }
+            }
+        });
+    }
+    for (auto & t : threads) {
+        t.join();
+    }
+    ASSERT_EQ(0, failures.load());
+}
+
+TEST(session_pool_test, sessions_outlive_their_channel) {
+    std::unique_ptr<session> s;
+    {
+        channel c;
+        session recycled(c);
+        s.reset(new session(c));
+    }
+    s.reset();
+}
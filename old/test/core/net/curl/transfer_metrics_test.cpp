@@ -0,0 +1,114 @@
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "core/net/curl/channel.h"
+#include "core/net/curl/request.h"
+#include "core/net/curl/response.h"
+#include "core/net/curl/retry_policy.h"
+#include "core/net/curl/session.h"
+#include "core/net/curl/transfer_metrics.h"
+
+#include "helpers/curl_helpers.h"
+#include "helpers/uhttpd.h"
+
+#include "gtest/gtest.h"
+
+using std::string;
+
+using namespace intent::core::net::curl;
+
+namespace {
+
+std::atomic<int> dumps(0);
+
+void count_dump(channel &, transfer_metrics_report const & report) {
+    if (report.channel.transfers) {
+        ++dumps;
+    }
+}
+
+} // end anonymous namespace
+
+TEST(transfer_metrics_test, percentiles_come_from_buckets) {
+    latency_histogram h = {};
+    ASSERT_EQ(0u, h.get_percentile_usecs(50));
+    // 90 samples of 3 usecs (bucket 2), and 10 of 1000 (bucket 10).
+    h.buckets[2] = 90;
+    h.buckets[10] = 10;
+    h.count = 100;
+    h.sum_usecs = 90 * 3 + 10 * 1000;
+    h.max_usecs = 1000;
+    ASSERT_EQ(4u, h.get_percentile_usecs(50));
+    ASSERT_EQ(4u, h.get_percentile_usecs(90));
+    // The top bucket's bound is 1024, but nothing was over 1000.
+    ASSERT_EQ(1000u, h.get_percentile_usecs(99));
+    ASSERT_EQ(102u, h.get_mean_usecs());
+}
+
+TEST(transfer_metrics_test, transfers_are_measured) {
+    uhttpd svr(false);
+    string base(svr.get_base_url());
+    channel c;
+    ASSERT_EQ(0u, c.get_transfer_metrics().transfers);
+    session s(c);
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(200, get_status(s, base + "100.txt"));
+    }
+    auto m = c.get_transfer_metrics();
+    ASSERT_EQ(3u, m.transfers);
+    ASSERT_EQ(0u, m.failures);
+    ASSERT_LE(300u, m.bytes_received);
+    ASSERT_EQ(3u, m.total.count);
+    ASSERT_EQ(3u, m.first_byte.count);
+    // Only attempts that opened a connection time its setup.
+    ASSERT_LE(1u, m.connect.count);
+    ASSERT_GE(3u, m.connect.count);
+    ASSERT_EQ(0u, m.tls.count);
+    ASSERT_LE(m.first_byte.max_usecs, m.total.max_usecs);
+
+    auto host = c.get_host_transfer_metrics(base.c_str());
+    ASSERT_EQ(3u, host.transfers);
+    ASSERT_EQ(0u, c.get_host_transfer_metrics("nowhere.invalid").transfers);
+    auto report = c.get_transfer_metrics_report();
+    ASSERT_EQ(1u, report.hosts.size());
+    ASSERT_NE(string::npos, report.get_summary().find("transfers 3"));
+}
+
+TEST(transfer_metrics_test, retries_and_failures_are_counted) {
+    uhttpd svr(false);
+    string base(svr.get_base_url());
+    channel c;
+    session s(c);
+    ASSERT_EQ(200, get_status(s, base + "flaky/2/metrics.html", retry_policy(3, 10, 50)));
+    auto m = c.get_transfer_metrics();
+    ASSERT_EQ(3u, m.transfers);
+    ASSERT_EQ(2u, m.retries);
+    // A 503 is a response, not a curl error.
+    ASSERT_EQ(0u, m.failures);
+
+    // Nothing listens on port 1.
+    ASSERT_EQ(0, get_status(s, "http://127.0.0.1:1/"));
+    m = c.get_transfer_metrics();
+    ASSERT_EQ(1u, m.failures);
+    ASSERT_EQ(1u, c.get_host_transfer_metrics("127.0.0.1:1").failures);
+}
+
+TEST(transfer_metrics_test, dumps_periodically) {
+    uhttpd svr(false);
+    channel c;
+    session s(c);
+    c.set_metrics_dump(1, count_dump);
+    ASSERT_EQ(200, get_status(s, string(svr.get_base_url()) + "100.txt"));
+    for (int i = 0; i < 40 && dumps.load() < 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    ASSERT_LE(2, dumps.load());
+    c.set_metrics_dump(0, nullptr);
+    // A dump that was already due may still land.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto seen = dumps.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    ASSERT_EQ(seen, dumps.load());
+}
@@ -17,6 +17,19 @@ TEST(headers_test, simple) {
 }
 
 
+TEST(headers_test, add_parses_lines) {
+    headers h;
+    h.add("ETag: \"abc\"");
+    h.add("Cache-Control:max-age=60 \r\n");
+    h.add("HTTP/1.1 200 OK");
+    EXPECT_EQ(2u, h.get_header_count());
+    EXPECT_STREQ("\"abc\"", h.get("etag"));
+    EXPECT_STREQ("max-age=60", h.get("Cache-Control"));
+    EXPECT_STREQ("Cache-Control", h.get_header_by_index(0));
+    EXPECT_STREQ("ETag", h.get_header_by_index(1));
+}
+
+
 TEST(headers_test, DISABLED_layers) {
     headers child;
     child.set("User-Agent", "firefox");
@@ -0,0 +1,55 @@
+#include <cstdlib>
+#include <limits>
+#include <string>
+
+#include "core/text/format_numbers.h"
+
+#include "gtest/gtest.h"
+
+using namespace intent::core::text;
+
+static std::string fmt_int(int64_t n) {
+    char buf[MAX_FORMATTED_NUMBER_LEN];
+    return std::string(buf, format_int64(n, buf));
+}
+
+static std::string fmt_double(double d) {
+    char buf[MAX_FORMATTED_NUMBER_LEN];
+    return std::string(buf, format_double(d, buf));
+}
+
+TEST(format_numbers_test, integers) {
+    EXPECT_EQ("0", fmt_int(0));
+    EXPECT_EQ("7", fmt_int(7));
+    EXPECT_EQ("10", fmt_int(10));
+    EXPECT_EQ("-123456789", fmt_int(-123456789));
+    EXPECT_EQ("9223372036854775807", fmt_int(std::numeric_limits<int64_t>::max()));
+    EXPECT_EQ("-9223372036854775808", fmt_int(std::numeric_limits<int64_t>::min()));
+    char buf[MAX_FORMATTED_NUMBER_LEN];
+    EXPECT_EQ("18446744073709551615", std::string(buf, format_uint64(UINT64_MAX, buf)));
+}
+
+TEST(format_numbers_test, doubles_are_short) {
+    EXPECT_EQ("0", fmt_double(0.0));
+    EXPECT_EQ("3", fmt_double(3.0));
+    EXPECT_EQ("-2.5", fmt_double(-2.5));
+    EXPECT_EQ("0.1", fmt_double(0.1));
+    EXPECT_EQ("0.001", fmt_double(0.001));
+    EXPECT_EQ("19.99", fmt_double(19.99));
+    EXPECT_EQ("-0.07", fmt_double(-0.07));
+    EXPECT_EQ("nan", fmt_double(std::numeric_limits<double>::quiet_NaN()));
+    EXPECT_EQ("-inf", fmt_double(-std::numeric_limits<double>::infinity()));
+}
+
+TEST(format_numbers_test, doubles_round_trip) {
+    double samples[] = { 1.0 / 3, 6.02214076e23, 1e-300, 123456.789012,
+        -9007199254740993.0, 0.30000000000000004, 5e-324 };
+    for (double d : samples) {
+        EXPECT_EQ(d, strtod(fmt_double(d).c_str(), nullptr)) << fmt_double(d);
+    }
+    srand(7);
+    for (int i = 0; i < 100000; ++i) {
+        double d = (rand() - RAND_MAX / 2) / 1000.0;
+        ASSERT_EQ(d, strtod(fmt_double(d).c_str(), nullptr)) << fmt_double(d);
+    }
+}
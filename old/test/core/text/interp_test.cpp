@@ -1,4 +1,5 @@
 #include "core/util/countof.h"
+#include "core/io/buffered_writer.h"
 #include "core/text/interp.h"
 
 #include "gtest/gtest.h"
@@ -66,3 +67,16 @@ TEST(interp_test, pluralize) {
         EXPECT_STREQ(expected[i], s.c_str());
     }
 }
+
+TEST(interp_test, into_buffered_writer) {
+    auto tmp = intent::core::io::easy_temp_file_path();
+    intent::core::io::file_delete_on_exit fdoe(tmp);
+    {
+        intent::core::io::buffered_writer out(tmp);
+        for (int i = 0; i < 3; ++i) {
+            interp_into(out, "line {1}\n", {i});
+        }
+    }
+    auto txt = intent::core::io::read_text_file(tmp);
+    EXPECT_STREQ("line 0\nline 1\nline 2\n", txt.c_str());
+}
@@ -0,0 +1,45 @@
+#include <cstring>
+
+#include "core/text/scan_numbers.h"
+
+#include "gtest/gtest.h"
+
+using namespace intent::core::text;
+
+// Scan all of txt; fail if anything is left over.
+static number_info scan(char const * txt) {
+    number_info info;
+    auto end = txt + strlen(txt);
+    EXPECT_EQ(end, scan_number(txt, end, numeric_formats::all, info)) << txt;
+    return info;
+}
+
+TEST(scan_numbers_test, whole_numbers) {
+    auto info = scan("42");
+    EXPECT_EQ(numeric_formats::decimal, info.format);
+    EXPECT_EQ(42u, info.whole_number);
+    EXPECT_FALSE(info.negative);
+    info = scan("-7");
+    EXPECT_EQ(7u, info.whole_number);
+    EXPECT_TRUE(info.negative);
+}
+
+TEST(scan_numbers_test, leading_radix) {
+    auto info = scan(".5");
+    EXPECT_EQ(numeric_formats::floating_point_only, info.format);
+    EXPECT_DOUBLE_EQ(0.5, info.floating_point);
+}
+
+TEST(scan_numbers_test, negative_float_without_exponent) {
+    auto info = scan("-1.5");
+    EXPECT_EQ(numeric_formats::floating_point_only, info.format);
+    EXPECT_DOUBLE_EQ(-1.5, info.floating_point);
+}
+
+TEST(scan_numbers_test, exponent_after_whole_digits) {
+    auto info = scan("1e5");
+    EXPECT_EQ(numeric_formats::floating_point_only, info.format);
+    EXPECT_DOUBLE_EQ(100000.0, info.floating_point);
+    info = scan("-2.5e2");
+    EXPECT_DOUBLE_EQ(-250.0, info.floating_point);
+}
@@ -0,0 +1,38 @@
+#include <string>
+
+#include "core/util/sha256.h"
+
+#include "gtest/gtest.h"
+
+using std::string;
+
+using intent::core::util::sha256_hex;
+
+
+// Vectors from NIST's examples for FIPS 180-4 (and its SHAVS short and long
+// messages).
+TEST(sha256_test, nist_vectors) {
+    ASSERT_EQ("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+            sha256_hex(""));
+    ASSERT_EQ("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+            sha256_hex("abc"));
+    ASSERT_EQ("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+            sha256_hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"));
+    ASSERT_EQ("cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1",
+            sha256_hex("abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+                    "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu"));
+    ASSERT_EQ("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+            sha256_hex(string(1000000, 'a')));
+}
+
+
+TEST(sha256_test, padding_edges) {
+    // Lengths where the padding just fits in the last block, just doesn't,
+    // and where the message fills whole blocks.
+    ASSERT_EQ("9f4390f8d30c2dd92ec9f095b65e2b9ae9b0a925a5258e241c9f1e910f734318",
+            sha256_hex(string(55, 'a')));
+    ASSERT_EQ("b35439a4ac6f0948b6d6f9e3c6af0f5f590ce20f1bde7090ef7970686ec6738a",
+            sha256_hex(string(56, 'a')));
+    ASSERT_EQ("ffe054fe7ae0cb6dc65c3af9b61d5209f439851db43d0ba5997337df154668eb",
+            sha256_hex(string(64, 'a')));
+}
@@ -0,0 +1,88 @@
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "core/util/slot_table.h"
+
+#include "gtest/gtest.h"
+
+using namespace intent::core::util;
+
+TEST(slot_table_test, insert_get_erase) {
+    slot_table<int> table;
+    int a = 1, b = 2;
+    auto na = table.insert(&a);
+    auto nb = table.insert(&b);
+    ASSERT_NE(na, nb);
+    ASSERT_EQ(2u, table.size());
+    ASSERT_EQ(&a, table.get(na));
+    ASSERT_EQ(&b, table.get(nb));
+    table.erase(na);
+    ASSERT_EQ(nullptr, table.get(na));
+    ASSERT_EQ(1u, table.size());
+    ASSERT_EQ(nullptr, table.get(12345));
+}
+
+TEST(slot_table_test, slots_are_reused) {
+    slot_table<int> table;
+    int items[3];
+    table.insert(&items[0]);
+    auto n = table.insert(&items[1]);
+    table.erase(n);
+    ASSERT_EQ(n, table.insert(&items[2]));
+    ASSERT_EQ(&items[2], table.get(n));
+}
+
+TEST(slot_table_test, grows_past_a_chunk) {
+    slot_table<int> table;
+    std::vector<int> items(3000);
+    std::set<uint32_t> slots;
+    for (auto & x : items) {
+        slots.insert(table.insert(&x));
+    }
+    ASSERT_EQ(items.size(), slots.size());
+    size_t visited = 0;
+    table.for_each([&visited](int *) { ++visited; });
+    ASSERT_EQ(items.size(), visited);
+}
+
+TEST(slot_table_test, threads_never_share_a_slot) {
+    slot_table<int> table;
+    std::atomic<bool> clash(false);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&table, &clash] {
+            int items[8];
+            for (int round = 0; round < 2000; ++round) {
+                uint32_t slots[8];
+                for (int i = 0; i < 8; ++i) {
+                    slots[i] = table.insert(&items[i]);
+                }
+                for (int i = 0; i < 8; ++i) {
+                    if (table.get(slots[i]) != &items[i]) {
+                        clash = true;
+                    }
+                    table.erase(slots[i]);
+                }
+            }
+        });
+    }
+    for (auto & t : threads) {
+        t.join();
+    }
+    ASSERT_FALSE(clash);
+    ASSERT_EQ(0u, table.size());
+}
+
+TEST(slot_table_test, index_stack_is_lifo) {
+    std::atomic<uint32_t> next[4];
+    auto links = [&next](uint32_t i) -> std::atomic<uint32_t> & { return next[i]; };
+    index_stack stack;
+    ASSERT_EQ(static_cast<uint32_t>(index_stack::none), stack.pop(links));
+    stack.push(1, links);
+    stack.push(3, links);
+    ASSERT_EQ(3u, stack.pop(links));
+    ASSERT_EQ(1u, stack.pop(links));
+    ASSERT_EQ(static_cast<uint32_t>(index_stack::none), stack.pop(links));
+}
@@ -0,0 +1,29 @@
+#include "core/net/curl/request.h"
+
+#include "helpers/curl_helpers.h"
+
+using std::string;
+
+using namespace intent::core::net::curl;
+
+
+response send_get(session & s, string const & url, retry_policy const & retries) {
+    auto req = s.reset();
+    req.set_url(url.c_str());
+    req.set_verb("get");
+    req.set_retry_policy(retries);
+    return s.send();
+}
+
+
+response fetch(session & s, string const & url, retry_policy const & retries) {
+    auto resp = send_get(s, url, retries);
+    resp.wait(5000);
+    return resp;
+}
+
+
+int get_status(session & s, string const & url, retry_policy const & retries) {
+    auto resp = send_get(s, url, retries);
+    return resp.wait(5000) ? resp.get_status_code() : -1;
+}
@@ -0,0 +1,34 @@
+#ifndef _57c763e88f914b27b14b205271faaa19
+#define _57c763e88f914b27b14b205271faaa19
+
+#include <string>
+
+#include "core/net/curl/response.h"
+#include "core/net/curl/retry_policy.h"
+#include "core/net/curl/session.h"
+
+/**
+ * Send a GET for url from a session, without waiting for it.
+ */
+intent::core::net::curl::response send_get(intent::core::net::curl::session &,
+        std::string const & url, intent::core::net::curl::retry_policy const & =
+        intent::core::net::curl::retry_policy());
+
+/**
+ * Send a GET, and wait up to 5 seconds for it to finish. On a timeout, the
+ * response is returned as is (with no status code).
+ */
+intent::core::net::curl::response fetch(intent::core::net::curl::session &,
+        std::string const & url, intent::core::net::curl::retry_policy const & =
+        intent::core::net::curl::retry_policy());
+
+/**
+ * Send a GET, and wait up to 5 seconds for its status code.
+ * @return -1 if the transfer didn't finish in time.
+ */
+int get_status(intent::core::net::curl::session &, std::string const & url,
+        intent::core::net::curl::retry_policy const & =
+        intent::core::net::curl::retry_policy());
+
+
+#endif // sentry
@@ -102,6 +102,11 @@ char const * uhttpd::get_base_url() const {
 }
 
 
+uint16_t uhttpd::get_port() const {
+    return impl->port;
+}
+
+
 size_t write_callback(char *ptr, size_t size, size_t nmemb, void *userdata) {
     bool debug = *((bool *)userdata);
     if (debug) {
@@ -1,38 +1,92 @@
 #!/usr/bin/python
-import argparse, BaseHTTPServer, re, sys, time, threading
+import argparse, BaseHTTPServer, re, SocketServer, sys, time, threading, zlib
 
 HOST_NAME = ''
 DEFAULT_PORT_NUMBER = 19746
 QUIT_URL = '/quit'
+SET_COOKIE_URL = '/cookie/set/'
+GET_COOKIE_URL = '/cookie/get'
 
 HTML_MSG = '<html><body><p>%s</p></body></html>'
 SIZE_PAT = re.compile(r'.*?(\d+)\.txt')
+FLAKY_PAT = re.compile(r'/flaky/(\d+)/')
+SLOW_FIRST_PAT = re.compile(r'/slow-first/(\d+)/')
+CACHE_PAT = re.compile(r'/cache/([^/]+)/')
+GZIP_URL_PART = '/gzip/'
+DIGEST_URL_PART = '/digest/'
 
 quit = False
+hits = {}
+hits_lock = threading.Lock()
+
+def count_hit(path):
+    hits_lock.acquire()
+    n = hits.get(path, 0) + 1
+    hits[path] = n
+    hits_lock.release()
+    return n
+
+def gzip_bytes(data):
+    z = zlib.compressobj(6, zlib.DEFLATED, 16 + zlib.MAX_WBITS)
+    return z.compress(data) + z.flush()
+
+class ThreadingHTTPServer(SocketServer.ThreadingMixIn, BaseHTTPServer.HTTPServer):
+    daemon_threads = True
 
 class MyHandler(BaseHTTPServer.BaseHTTPRequestHandler):
+    # Keep connections open between requests, so clients can reuse them.
+    # Every reply must therefore say how long its body is.
+    protocol_version = 'HTTP/1.1'
     error_message_format = '<html><head><title>Error</title></head><body><h1>Error %(code)d.</h1><p>%(message)s.</p></body></html>'
     def should_quit(self):
         if self.path == QUIT_URL:
             global quit
             quit = True
+            self.close_connection = 1
             self.send_doc(HTML_MSG % 'Okay, quitting.')
             return True
-    def send_doc(self, doc, code=200):
+        return self.misbehave()
+    def misbehave(self):
+        m = FLAKY_PAT.match(self.path)
+        if m and count_hit(self.path) <= int(m.group(1)):
+            self.send_body(HTML_MSG % 'Try again.', code=503, headers=[('Retry-After', '0')])
+            return True
+        m = SLOW_FIRST_PAT.match(self.path)
+        if m and count_hit(self.path) == 1:
+            time.sleep(int(m.group(1)) / 1000.0)
+    def send_body(self, body, code=200, content_type='text/html', headers=[], head_only=False):
+        m = CACHE_PAT.search(self.path)
+        if m and code == 200:
+            etag = '"%x"' % (zlib.crc32(body) & 0xffffffff)
+            headers = headers + [('Cache-Control', m.group(1)), ('ETag', etag)]
+            if self.headers.get('If-None-Match') == etag:
+                code, body = 304, ''
+        if GZIP_URL_PART in self.path and 'gzip' in self.headers.get('Accept-Encoding', ''):
+            body = gzip_bytes(body)
+            headers = headers + [('Content-Encoding', 'gzip')]
         self.send_response(code)
-        self.send_header("Content-Type", "text/html")
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(body)))
+        for name, value in headers:
+            self.send_header(name, value)
         self.end_headers()
-        self.wfile.write(doc)
+        if not head_only:
+            self.wfile.write(body)
+    def send_doc(self, doc, code=200):
+        self.send_body(doc, code)
     def do_HEAD(self):
         if self.path.endswith('.html'):
-            self.send_response(200)
-            self.send_header("Content-Type", "text/html")
-            self.end_headers()
+            self.send_body(HTML_MSG % self.path, head_only=True)
         else:
             self.send_error(404)
     def do_GET(self):
         if not self.should_quit():
-            if self.path.endswith('.html'):
+            if self.path.startswith(SET_COOKIE_URL):
+                self.send_body(HTML_MSG % 'Cookie set.',
+                        headers=[('Set-Cookie', self.path[len(SET_COOKIE_URL):] + '; Path=/')])
+            elif self.path == GET_COOKIE_URL:
+                self.send_doc(HTML_MSG % self.headers.get('Cookie', ''))
+            elif self.path.endswith('.html'):
                 self.send_doc(HTML_MSG % self.path)
             else:
                 m = SIZE_PAT.match(self.path)
@@ -46,33 +100,65 @@ class MyHandler(BaseHTTPServer.BaseHTTPRequestHandler):
                         while len(txt) < size:
                             txt = txt + txt
                         txt = txt[0:size]
-                        self.send_response(200)
-                        self.send_header("Content-Type", "text/plain")
-                        self.end_headers()
-                        self.wfile.write(txt)
+                        self.send_body(txt, content_type='text/plain')
                 else:
                     self.send_error(404)
+    def read_request_body(self):
+        if self.headers.get('Expect', '').lower() == '100-continue':
+            self.wfile.write('HTTP/1.1 100 Continue\r\n\r\n')
+        if self.headers.get('Transfer-Encoding', '').lower() != 'chunked':
+            return self.rfile.read(int(self.headers.get('Content-Length', 0)))
+        chunks = []
+        while True:
+            size = int(self.rfile.readline().split(';')[0], 16)
+            if not size:
+                # Skip any trailers.
+                while self.rfile.readline().strip():
+                    pass
+                return ''.join(chunks)
+            chunks.append(self.rfile.read(size))
+            self.rfile.readline()
     def do_POST(self):
+        # Take the whole body first; what's left unread would spoil the next
+        # request on the connection.
+        data = self.read_request_body()
         if not self.should_quit():
-            length = int(self.headers['Content-Length'])
-            data = self.rfile.read(length)
-            self.send_doc(HTML_MSG % ('Received %d bytes: "%s"' % (len(data), data)))
+            length = len(data)
+            note = ''
+            if self.headers.get('Transfer-Encoding', '').lower() == 'chunked':
+                note = ' (chunked)'
+            if self.headers.get('Content-Encoding') == 'gzip':
+                data = zlib.decompress(data, 16 + zlib.MAX_WBITS)
+                note = ' (gzip, %d on the wire)' % length
+            if DIGEST_URL_PART in self.path:
+                self.send_doc(HTML_MSG % ('Received %d bytes%s, crc32 %08x' % (
+                    len(data), note, zlib.crc32(data) & 0xffffffff)))
+            else:
+                self.send_doc(HTML_MSG % ('Received %d bytes%s: "%s"' % (len(data), note, data)))
     def do_PUT(self):
         self.do_POST()
+    def do_PURGE(self):
+        self.do_POST()
 
 last_call_lock = None
 last_call = None
 def server_thread_main():
     global quit
     global last_call
-    server_class = BaseHTTPServer.HTTPServer
+    server_class = ThreadingHTTPServer
     httpd = server_class((HOST_NAME, port), MyHandler)
     sys.stderr.write('''Listening on port %s...
   GET /<any path>.html returns simple web pages.
   GET /<any path><number>.txt returns text with size=<number>
   POST /<any url> accepts data and returns html reporting bytes received.
-  PUT /<any url> works like POST.
+  PUT or PURGE /<any url> works like POST.
   HEAD /<any path>.html works.
+  GET, POST, PUT, or PURGE /flaky/<n>/<any path> fails with 503 the first n times.
+  GET, POST, PUT, or PURGE /slow-first/<ms>/<any path> stalls the first time.
+  GET /cache/<cache-control>/<any path> sends that Cache-Control, and an ETag.
+  GET /gzip/<any path> gzips the body, if the client accepts it.
+  POST or PUT bodies sent with Content-Encoding: gzip are unzipped first.
+  POST or PUT /digest/<any path> replies with the body's size and crc32.
   GET, POST, or PUT /quit makes the server exit.
   Most other requests return 404.
 CTRL+C to quit.